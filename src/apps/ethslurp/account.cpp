@@ -104,11 +104,11 @@ bool CAccount::setValueByName(const string_q& fieldName, const string_q& fieldVa
 //---------------------------------------------------------------------------------------------------
 void CAccount::finishParse() {
     // EXISTING_CODE
+    CAbiDecoder *decoder = getAbiDecoder();
+    decoder->addAbi(abi);
     for (size_t i = 0 ; i < transactions.size() ; i++) {
         CTransaction *t = &transactions.at(i);
-        string_q encoding = extract(t->input, 0, 10);
-extern const CFunction *findFunctionByEncoding(const CFunctionArray& array, const string_q& search);
-        t->funcPtr = findFunctionByEncoding(abi.abiByEncoding, encoding);
+        t->funcPtr = decoder->find(t->input);
     }
     // EXISTING_CODE
 }
@@ -125,14 +125,15 @@ bool CAccount::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> addr;
-    archive >> header;
-    archive >> displayString;
-    archive >> pageSize;
-    archive >> lastPage;
-    archive >> lastBlock;
-    archive >> nVisible;
-    archive >> transactions;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(CAccount), 8);
+    fields >> addr;
+    fields >> header;
+    fields >> displayString;
+    fields >> pageSize;
+    fields >> lastPage;
+    fields >> lastBlock;
+    fields >> nVisible;
+    fields >> transactions;
     finishParse();
     return true;
 }
@@ -375,19 +376,5 @@ bool CAccount::handleCustomFormat(CExportContext& ctx, const string_q& fmtIn, vo
     }
     return true;
 }
-
-//---------------------------------------------------------------------------
-const CFunction *findFunctionByEncoding(const CFunctionArray& array, const string_q& enc) {
-    CFunction search;
-    search.encoding = enc;
-    auto i1 = array.cbegin();
-    auto i2 = array.cend();
-    for ( ; i1 != i2 ; ++i1) {
-        if (search == *i1){
-            return &*i1;
-        }
-    }
-    return nullptr;
-}
 // EXISTING_CODE
 }  // namespace qblocks
@@ -612,7 +612,7 @@ bool loadABI(CAbi& abi, const string_q& addr) {
         return false;
 
     cerr << "\tLoading abi file: " << abiFilename << "...\n";
-    if (abi.loadABIFromFile(abiFilename)) {
+    if (loadAbiCompiled(abi, abiFilename)) {
 
         string_q abis1;
 
@@ -17,17 +17,21 @@
 //-----------------------------------------------------------------------
 extern void addDefaultFuncs(CFunctionArray& funcs);
 extern string_q getAssign(const CParameter *p, uint64_t which);
-extern string_q getEventAssign(const CParameter *p, uint64_t which, uint64_t prevIdxs);
+extern string_q getEventAssign(const CParameter *p, uint64_t which);
+extern uint64_t nHeadWords(const CParameter *p);
+extern string_q topicWords(const string_q& encoding);
 
 //-----------------------------------------------------------------------
 extern const char* STR_FACTORY1;
 extern const char* STR_FACTORY2;
+extern const char* STR_CASE2;
+extern const char* STR_DEFAULT;
 extern const char* STR_CLASSDEF;
 extern const char* STR_HEADERFILE;
 extern const char* STR_HEADER_SIGS;
 extern const char* STR_CODE_SIGS;
 extern const char* STR_BLOCK_PATH;
-extern const char* STR_ITEMS;
+extern const char* STR_ASSIGNARRAY;
 extern const char* STR_FORMAT_FUNCDATA;
 
 //-----------------------------------------------------------------------
@@ -244,11 +248,13 @@ int main(int argc, const char *argv[]) {
             string_q classDefs = classDir + "classDefinitions/";
             establishFolder(classDefs);
 
-            string_q funcExterns, evtExterns, funcDecls, evtDecls, sigs, evts;
+            string_q funcExterns, evtExterns, funcDecls, evtDecls, funcSels, evtSels, sigs, evts;
             string_q headers;
             if (!options.isToken()) headers += ("#include \"tokenlib.h\"\n");
             if (!options.isWallet()) headers += ("#ifndef NOWALLETLIB\n#include \"walletlib.h\"\n#endif\n");
-            string_q sources = "src= \\\n", registers, factory1, factory2;
+            string_q sources = "src= \\\n", registers, decoders, factory1, factory2;
+            CStringArray funcCases;            // a selector gets one case, the first function wins
+            CStringArray evtCases, evtBodies;  // events that share a selector share a case
             for (size_t i = 0 ; i < functions.size() ; i++) {
                 const CFunction *func = &functions[i];
                 if (!func->isBuiltin) {
@@ -273,27 +279,38 @@ int main(int argc, const char *argv[]) {
                                 evtExterns += func->Format("extern const string_q evt_[{NAME}]{QB};\n");
                                 string_q decl = "const string_q evt_[{NAME}]{QB} = \"" + func->encoding + "\";\n";
                                 evtDecls += func->Format(decl);
+                                string_q nm = func->name + "{QB}";
+                                string_q sel = extract(func->encoding, 2, 8);
+                                evtSels += "const uint32_t sel_evt_" + nm + " = 0x" + sel + ";\n";
+                                evtSels += "const uint64_t topic_evt_" + nm + "[4] = { ";
+                                evtSels += topicWords(func->encoding) + " };\n";
                                 if (!options.isBuiltin())
                                     evts += func->Format("\tevt_[{NAME}],\n");
                             } else {
                                 funcExterns += func->Format("extern const string_q func_[{NAME}]{QB};\n");
                                 string_q decl = "const string_q func_[{NAME}]{QB} = \"" + func->encoding + "\";\n";
                                 funcDecls += func->Format(decl);
+                                funcSels += "const uint32_t sel_" + func->name + "{QB} = " + func->encoding + ";\n";
+                                decoders += "\tgetAbiDecoder()->addSignature(sel_" + func->name + "{QB}, \"" +
+                                                func->getSignature(SIG_CANONICAL) + "\");\n";
                                 if (!options.isBuiltin())
                                     sigs += func->Format("\tfunc_[{NAME}],\n");
                             }
                         }
-                        string_q fields, assigns1, assigns2, items1;
-                        uint64_t nIndexed = 0;
+                        // parameters are read from the word at their position in the head of the data
+                        string_q fields, assigns1, assigns2;
+                        uint64_t nIndexed = 0, head = 0, dataHead = 0;
                         for (size_t j = 0 ; j < func->inputs.size() ; j++) {
-                            fields   += func->inputs[j].Format("[{TYPE}][ {NAME}]|");
-                            assigns1 += func->inputs[j].Format(getAssign(&func->inputs[j], j));
-                            items1   += "\t\t\titems[nItems++] = \"" + func->inputs[j].type + "\";\n";
-                            nIndexed += func->inputs[j].indexed;
-                            string_q res = func->inputs[j].Format(getEventAssign(&func->inputs[j], j+1, nIndexed));
-                            replace(res, "++", "[");
-                            replace(res, "++", "]");
-                            assigns2 += res;
+                            const CParameter *param = &func->inputs[j];
+                            fields   += param->Format("[{TYPE}][ {NAME}]|");
+                            assigns1 += getAssign(param, head);
+                            head += nHeadWords(param);
+                            if (param->indexed) {
+                                assigns2 += getEventAssign(param, ++nIndexed);
+                            } else {
+                                assigns2 += getEventAssign(param, dataHead);
+                                dataHead += nHeadWords(param);
+                            }
                         }
 
                         string_q base = (func->type == "event" ? "LogEntry" : "Transaction");
@@ -318,14 +335,8 @@ int main(int argc, const char *argv[]) {
                             f1 = string_q(STR_FACTORY1);
                             replaceAll(f1, "[{CLASS}]", theClass);
                             replaceAll(f1, "[{NAME}]", fName);
-                            if (fName == "defFunction")
-                                replaceAll(f1, "encoding == func_[{LOWER}]", "encoding.length() < 10");
-                            else
-                                replaceAll(f1, "[{LOWER}]", fName);
+                            replaceAll(f1, "[{LOWER}]", fName);
                             replaceAll(f1, "[{ASSIGNS1}]", assigns1);
-                            replaceAll(f1, "[{ITEMS1}]", items1);
-                            string_q parseIt = "toFunction(\"" + fName + "\", params, nItems, items)";
-                            replaceAll(f1, "[{PARSEIT}]", parseIt);
                             replaceAll(f1, "[{BASE}]", base);
                             replaceAll(f1, "[{SIGNATURE}]",
                                        substitute(
@@ -334,9 +345,20 @@ int main(int argc, const char *argv[]) {
                                        substitute(func->getSignature(SIG_DEFAULT), "\t", ""),
                                                   "  ", " "), " (", "("), ",", ", "));
                             replace(f1, "[{ENCODING}]", func->getSignature(SIG_ENCODE));
-                            replace(f1, " defFunction(string)", "()");
-                            if (!isConst)
-                                factory1 += f1;
+                            if (!isConst) {
+                                string_q sel = toLower(extract(func->encoding, 2, 8));
+                                size_t c = 0;
+                                while (c < funcCases.size() && funcCases[c] != sel)
+                                    c++;
+                                if (c == funcCases.size()) {
+                                    funcCases.push_back(sel);
+                                    factory1 += f1;
+                                } else {
+                                    cerr << cRed << "Warning: " << cOff << func->name;
+                                    cerr << " has the same selector (0x" << sel << ") as an earlier function. ";
+                                    cerr << "It will not be promoted.\n";
+                                }
+                            }
 
                         } else if (name != "LogEntry") {
                             string_q f2, fName = func->Format("[{NAME}]");
@@ -351,8 +373,17 @@ int main(int argc, const char *argv[]) {
                                     substitute(func->getSignature(SIG_DEFAULT|SIG_IINDEXED), "\t", ""),
                                                "  ", " "), " (", "("), ",", ", "));
                             replace(f2, "[{ENCODING}]", func->getSignature(SIG_ENCODE));
-                            if (!isConst)
-                                factory2 += f2;
+                            if (!isConst) {
+                                string_q sel = toLower(extract(func->encoding, 2, 8));
+                                size_t c = 0;
+                                while (c < evtCases.size() && evtCases[c] != sel)
+                                    c++;
+                                if (c == evtCases.size()) {
+                                    evtCases.push_back(sel);
+                                    evtBodies.push_back(substitute(STR_CASE2, "[{LOWER}]", fName));
+                                }
+                                evtBodies[c] += f2;
+                            }
                         }
 
                         if (name != "logEntry" && !isConst) {
@@ -398,7 +429,10 @@ int main(int argc, const char *argv[]) {
             string_q comment = "//------------------------------------------------------------------------\n";
             funcExterns = (funcExterns.empty() ? "// No functions" : funcExterns);
             evtExterns = (evtExterns.empty() ? "// No events" : evtExterns);
-            replaceAll(headerCode, "[{EXTERNS}]", comment+funcExterns+"\n"+comment+evtExterns);
+            funcSels = (funcSels.empty() ? "// No functions" : funcSels);
+            evtSels = (evtSels.empty() ? "// No events" : evtSels);
+            replaceAll(headerCode, "[{EXTERNS}]", comment+funcExterns+"\n"+comment+evtExterns+"\n"+
+                                                    comment+funcSels+"\n"+comment+evtSels);
             headerCode = substitute(headerCode, "{QB}", (options.isBuiltin() ? "_qb" : ""));
             writeTheCode(classDir + options.prefix + ".h", headerCode);
 
@@ -410,13 +444,19 @@ int main(int argc, const char *argv[]) {
                 writeTheCode(classDir + "CMakeLists.txt", makefile);
             }
 
-            // The library source file
-            replace(factory1, "} else ", "");
-            replace(factory1, "contains(func, \"defFunction|\")", "!contains(func, \"|\")");
-            replace(factory1, " if (encoding == func_[{LOWER}])", "");
-            replace(factory2, "} else ", "");
+            // The library source file. The factories dispatch on the selector with a switch. The
+            // template's closing brace for the old if/else chain closes the switch.
+            for (size_t c = 0 ; c < evtBodies.size() ; c++)
+                factory2 += evtBodies[c] + "\t\t\t\tbreak;\n\n";
+            if (!factory1.empty())
+                factory1 = "\t\tswitch (call.selector) {\n" + factory1 + STR_DEFAULT;
+            if (!factory2.empty())
+                factory2 = "\t\tswitch (topicSelector(p->topics[0])) {\n" + factory2 + STR_DEFAULT;
 
             string_q sourceCode = asciiFileToString(templateFolder + "parselib/parselib.cpp");
+            replace(sourceCode, "if (p && (p->input.length() >= 10 || p->input == \"0x\")) {",
+                                "CAbiData call;\n\tif (p && call.fromInput(p->input)) {");
+            replace(sourceCode, "string_q data = extract(p->data, 2);", "CAbiData data;\n\t\tdata.fromData(p->data);");
             parseInit = "parselib_init(QUITHANDLER qh)";
             if (!options.isBuiltin())
                 replaceAll(sourceCode, "[{PREFIX}]_init(void)", parseInit);
@@ -431,13 +471,13 @@ int main(int argc, const char *argv[]) {
             replaceAll(sourceCode, "[{CODE_SIGS}]", (options.isBuiltin() ? "" : STR_CODE_SIGS));
             replaceAll(sourceCode, "[{ADDR}]", substitute(options.primaryAddr, "0x", ""));
             replaceAll(sourceCode, "[{ABI}]", options.theABI);
-            replaceAll(sourceCode, "[{REGISTERS}]", registers);
+            replaceAll(sourceCode, "[{REGISTERS}]", registers + (decoders.empty() ? "" : "\n" + decoders));
             string_q chainInit = (options.isToken() ?
                                   "\twalletlib_init();\n" :
                                   (options.isWallet() ? "" : "\ttokenlib_init();\n"));
             replaceAll(sourceCode, "[{CHAINLIB}]",  chainInit);
             replaceAll(sourceCode, "[{FACTORY1}]",  factory1.empty() ? "\t\t{\n\t\t\t// No functions\n" : factory1);
-            replaceAll(sourceCode, "[{INIT_CODE}]", factory1.empty() ? "" : STR_ITEMS);
+            replaceAll(sourceCode, "[{INIT_CODE}]", "");
             replaceAll(sourceCode, "[{FACTORY2}]",  factory2.empty() ? "\t\t{\n\t\t\t// No events\n" : factory2);
 
             headers = ("#include \"tokenlib.h\"\n");
@@ -482,38 +522,84 @@ int main(int argc, const char *argv[]) {
 }
 
 //-----------------------------------------------------------------------
-string_q getAssign(const CParameter *p, uint64_t which) {
+// The number of words a parameter occupies in the head of the encoded data. Fixed size arrays
+// are stored in place. Everything else (including dynamic types, which store an offset) is one.
+uint64_t nHeadWords(const CParameter *p) {
+    string_q type = p->type;
+    if (!endsWith(type, ']') || endsWith(type, "[]"))
+        return 1;
+    string_q cnt = extract(type, type.rfind('[') + 1);
+    uint64_t n = toLongU(trimTrailing(cnt, ']'));
+    return (n ? n : 1);
+}
 
-    string_q ass;
-    string_q type = p->Format("[{TYPE}]");
-
-    if (contains(type, "[") && contains(type, "]")) {
-        const char* STR_ASSIGNARRAY =
-        "\t\t\twhile (!params.empty()) {\n"
-        "\t\t\t\tstring_q val = extract(params, 0, 64);\n"
-        "\t\t\t\tparams = extract(params, 64);\n"
-        "\t\t\t\ta->[{NAME}]XXXXa->[{NAME}].size()YYYY = val;\n"
-        "\t\t\t}\n";
-        return p->Format(STR_ASSIGNARRAY);
+//-----------------------------------------------------------------------
+// An event's hash as the four 64-bit words of a topic constant
+string_q topicWords(const string_q& encoding) {
+    string_q hex = padRight(extract(encoding, 2), 64, '0');
+    string_q ret;
+    for (size_t i = 0 ; i < 4 ; i++)
+        ret += string_q(i ? ", " : "") + "0x" + extract(hex, i * 16, 16) + "ULL";
+    return ret;
+}
+
+//-----------------------------------------------------------------------
+// The expression that reads a value of the given type from a word of the decoded data. Hex values
+// from events carry a '0x' prefix, those from functions do not (as it has always been).
+string_q getDecode(const string_q& type, const string_q& src, const string_q& which, bool isEvent) {
+    string_q hex = (isEvent ? "\"0x\" + " : "");
+    string_q word = "(" + which + ")";
+    if (type == "uint" || type == "uint256") { return src + ".getUint" + word;
+    } else if (contains(type, "gas")) { return src + ".getUint64" + word;
+    } else if (contains(type, "uint64")) { return src + ".getUint64" + word;
+    } else if (contains(type, "uint")) { return "(uint32_t)" + src + ".getUint64" + word;
+    } else if (contains(type, "bool")) { return src + ".getBool" + word;
+    } else if (contains(type, "int")) { return src + ".getInt64" + word;
+    } else if (contains(type, "address")) { return src + ".getAddress" + word;
+    } else if (type == "string") { return src + ".getString" + word;
+    } else if (type == "bytes") { return hex + src + ".getTailHex" + word;
     }
+    return hex + src + ".getWordHex" + word;
+}
 
-    if (type == "uint" || type == "uint256") { ass = "toWei(\"0x\"+[{VAL}]);";
-    } else if (contains(type, "gas")) { ass = "toGas([{VAL}]);";
-    } else if (contains(type, "uint64")) { ass = "toLongU([{VAL}]);";
-    } else if (contains(type, "uint")) { ass = "(uint32_t)toLongU([{VAL}]);";
-    } else if (contains(type, "int") || contains(type, "bool")) { ass = "toLong([{VAL}]);";
-    } else if (contains(type, "address")) { ass = "toAddress([{VAL}]);";
-    } else { ass = "[{VAL}];";
+//-----------------------------------------------------------------------
+string_q getArrayAssign(const CParameter *p, uint64_t which, const string_q& src, const string_q& indent) {
+    string_q type = p->type;
+    string_q elem = extract(type, 0, type.rfind('['));
+    string_q ass = STR_ASSIGNARRAY;
+    if (endsWith(type, "[]")) {
+        replace(ass, "[{FIRST}]", src + ".getArray([{WHICH}], first, count);");
+    } else {
+        replace(ass, "[{FIRST}]", "first = [{WHICH}];\n[{TAB}]\tcount = " + asStringU(nHeadWords(p)) + ";");
     }
+    replaceAll(ass, "[{GET}]", getDecode(elem, src, "w", src == "data"));
+    replaceAll(ass, "[{WHICH}]", asStringU(which));
+    replaceAll(ass, "[{NAME}]", p->name);
+    replaceAll(ass, "[{TAB}]", indent);
+    return ass;
+}
 
-    replace(ass, "[{VAL}]", "extract(params, " + asStringU(which) + "*64" + (type == "bytes" ? "" : ", 64") + ")");
-    return p->Format("\t\t\ta->[{NAME}] = " + ass + "\n");
+//-----------------------------------------------------------------------
+string_q getAssign(const CParameter *p, uint64_t which) {
+    if (endsWith(p->type, ']'))
+        return getArrayAssign(p, which, "call", "\t\t\t\t");
+    return "\t\t\t\ta->" + p->name + " = " + getDecode(p->type, "call", asStringU(which), false) + ";\n";
 }
 
 //-----------------------------------------------------------------------
-string_q getEventAssign(const CParameter *p, uint64_t which, uint64_t nIndexed) {
-    string_q type = p->Format("[{TYPE}]"), ass;
-    if (type == "uint" || type == "uint256") { ass = "toWei([{VAL}]);";
+string_q getEventAssign(const CParameter *p, uint64_t which) {
+    string_q type = p->type;
+    if (!p->indexed) {
+        if (endsWith(type, ']'))
+            return getArrayAssign(p, which, "data", "\t\t\t\t\t");
+        return "\t\t\t\t\ta->" + p->name + " = " + getDecode(type, "data", asStringU(which), true) + ";\n";
+    }
+
+    // indexed values are the topics following the event's signature. Addresses and full width
+    // integers are taken directly from the topic, other types are converted from its hex
+    string_q ass;
+    if (type == "uint" || type == "uint256") { ass = "(nTops > [{WHICH}] ? p->topics[[{WHICH}]] : SFUintBN());";
+    } else if (type == "address") { ass = "(nTops > [{WHICH}] ? topicAddress(p->topics[[{WHICH}]]) : \"0x0\");";
     } else if (contains(type, "gas")) { ass = "toGas([{VAL}]);";
     } else if (contains(type, "uint64")) { ass = "toLongU([{VAL}]);";
     } else if (contains(type, "uint")) { ass = "(uint32_t)toLongU([{VAL}]);";
@@ -521,22 +607,9 @@ string_q getEventAssign(const CParameter *p, uint64_t which, uint64_t nIndexed)
     } else if (contains(type, "address")) { ass = "toAddress([{VAL}]);";
     } else { ass = "[{VAL}];";
     }
-
-    if (p->indexed) {
-        replace(ass, "[{VAL}]", "nTops > [{WHICH}] ? fromTopic(p->topics[{IDX}]) : \"\"");
-
-    } else if (type == "bytes") {
-        replace(ass, "[{VAL}]", "\"0x\" + extract(data, [{WHICH}]*64)");
-        which -= (nIndexed+1);
-
-    } else {
-        replace(ass, "[{VAL}]", string_q(type == "address" ? "" : "\"0x\" + ") + "extract(data, [{WHICH}]*64, 64)");
-        which -= (nIndexed+1);
-    }
-    replace(ass, "[{IDX}]", "++" + asStringU(which)+"++");
-    replace(ass, "[{WHICH}]", asStringU(which));
-    string_q fmt = "\t\t\ta->[{NAME}] = " + ass + "\n";
-    return p->Format(fmt);
+    replace(ass, "[{VAL}]", "nTops > [{WHICH}] ? fromTopic(p->topics[[{WHICH}]]) : \"\"");
+    replaceAll(ass, "[{WHICH}]", asStringU(which));
+    return "\t\t\t\t\ta->" + p->name + " = " + ass + "\n";
 }
 
 //-----------------------------------------------------------------------
@@ -556,27 +629,45 @@ string_q getEventAssign(const CParameter *p, uint64_t which, uint64_t nIndexed)
 
 //-----------------------------------------------------------------------
 const char* STR_FACTORY1 =
-"\t\t} else if (encoding == func_[{LOWER}]{QB}) {\n"
-"\t\t\t// [{SIGNATURE}]\n"
-"\t\t\t// [{ENCODING}]\n"
-"\t\t\t[{CLASS}] *a = new [{CLASS}];\n"
-"\t\t\t*(C[{BASE}]*)a = *p;  // NOLINT\n"
+"\t\t\tcase sel_[{LOWER}]{QB}: {\n"
+"\t\t\t\t// [{SIGNATURE}]\n"
+"\t\t\t\t// [{ENCODING}]\n"
+"\t\t\t\t[{CLASS}] *a = new [{CLASS}];\n"
+"\t\t\t\t*(C[{BASE}]*)a = *p;  // NOLINT\n"
 "[{ASSIGNS1}]"
-"[{ITEMS1}]"
-"\t\t\ta->function = [{PARSEIT}];\n"
-"\t\t\treturn a;\n"
+"\t\t\t\ta->funcPtr = getAbiDecoder()->find(call.selector);\n"
+"\t\t\t\treturn a;\n"
+"\t\t\t}\n"
 "\n";
 
+//-----------------------------------------------------------------------
+const char* STR_CASE2 =
+"\t\t\tcase sel_evt_[{LOWER}]{QB}:\n";
+
 //-----------------------------------------------------------------------
 const char* STR_FACTORY2 =
-"\t\t} else if (fromTopic(p->topics[0]) % evt_[{LOWER}]{QB}) {\n"
-"\t\t\t// [{SIGNATURE}]\n"
-"\t\t\t// [{ENCODING}]\n"
-"\t\t\t[{CLASS}] *a = new [{CLASS}];\n"
-"\t\t\t*(C[{BASE}]*)a = *p;  // NOLINT\n"
+"\t\t\t\tif (isTopic(p->topics[0], topic_evt_[{LOWER}]{QB})) {\n"
+"\t\t\t\t\t// [{SIGNATURE}]\n"
+"\t\t\t\t\t// [{ENCODING}]\n"
+"\t\t\t\t\t[{CLASS}] *a = new [{CLASS}];\n"
+"\t\t\t\t\t*(C[{BASE}]*)a = *p;  // NOLINT\n"
 "[{ASSIGNS2}]"
-"\t\t\treturn a;\n"
-"\n";
+"\t\t\t\t\treturn a;\n"
+"\t\t\t\t}\n";
+
+//-----------------------------------------------------------------------
+const char* STR_DEFAULT =
+"\t\t\tdefault:\n"
+"\t\t\t\tbreak;\n";
+
+//-----------------------------------------------------------------------
+const char* STR_ASSIGNARRAY =
+"[{TAB}]{\n"
+"[{TAB}]\tsize_t first = 0, count = 0;\n"
+"[{TAB}]\t[{FIRST}]\n"
+"[{TAB}]\tfor (size_t w = first ; w < first + count ; w++)\n"
+"[{TAB}]\t\ta->[{NAME}].push_back([{GET}]);\n"
+"[{TAB}]}\n";
 
 //-----------------------------------------------------------------------
 const char* STR_CLASSDEF =
@@ -670,14 +761,6 @@ const char* STR_CODE_SIGS =
 //-----------------------------------------------------------------------
 const char* STR_BLOCK_PATH = "etherlib_init(qh);\n\n";
 
-//-----------------------------------------------------------------------
-const char* STR_ITEMS =
-"\t\tstring_q items[256];\n"
-"\t\tsize_t nItems = 0;\n"
-"\n"
-"\t\tstring_q encoding = extract(p->input, 0, 10);\n"
-"\t\tstring_q params   = extract(p->input, 10);\n";
-
 //-----------------------------------------------------------------------
 const char* STR_FORMAT_FUNCDATA =
 "[{name}]\t"
@@ -184,11 +184,14 @@ void rebuildFourByteDB(void) {
     cout << abiPath << "\n";
     forEveryFileInFolder(abiPath+"*", visitABIs, &fileList);
 
+    // new or changed ABIs are compiled into the store as they are found and it is written once
+    CAbiStore store;
+    store.open(abiStorePath());
     CFunctionArray funcArray;
     while (!fileList.empty()) {
         string_q fileName = nextTokenClear(fileList, '\n');
         CAbi abi;
-        abi.loadABIFromFile(fileName);
+        loadAbiCompiled(abi, fileName, &store);
         for (size_t f = 0 ; f < abi.abiByEncoding.size() ; f++) {
             funcArray.push_back(abi.abiByEncoding[f]);
             cout << abi.abiByEncoding[f].encoding << " : ";
@@ -196,6 +199,9 @@ void rebuildFourByteDB(void) {
             cout << abi.abiByEncoding[f].signature << "\n";
         }
     }
+    if (store.nStaged())
+        store.write(abiStorePath());
+
     sort(funcArray.begin(), funcArray.end());
     SFArchive funcCache(WRITING_ARCHIVE);
     if (funcCache.Lock(abiPath+"abis.bin", binaryWriteCreate, LOCK_CREATE)) {
@@ -340,10 +340,22 @@ string_q ptrWriteFmt =
 "    if ([{NAME}])\n"
 "        [{NAME}]->SerializeC(archive);\n";
 
-        fieldArchiveRead  += fld.Format(fld.isPointer ? ptrReadFmt  : "\tarchive >> [{NAME}];\n");
+        fieldArchiveRead  += fld.Format(fld.isPointer ? ptrReadFmt  : "\tfields >> [{NAME}];\n");
         fieldArchiveWrite += fld.Format(fld.isPointer ? ptrWriteFmt : "\tarchive << [{NAME}];\n");
     }
 
+    //------------------------------------------------------------------------------------------------
+    // Fields are read through a CFieldReader so a reader can skip those it does not need. A class
+    // with a pointer field is always read in full.
+    bool hasPointer = false;
+    for (const auto& fld : fieldList)
+        hasPointer |= fld.isPointer;
+    if (hasPointer)
+        replaceAll(fieldArchiveRead, "\tfields >> ", "\tarchive >> ");
+    else if (!fieldList.empty())
+        fieldArchiveRead = "\tCFieldReader fields(archive, GETRUNTIME_CLASS([{CLASS_NAME}]), " +
+                                asStringU(fieldList.size()) + ");\n" + fieldArchiveRead;
+
     //------------------------------------------------------------------------------------------------
     bool hasObjGetter = !fieldGetObj.empty();
     if (hasObjGetter)
@@ -13,7 +13,7 @@
 #include "etherlib.h"
 #include "options.h"
 
-extern bool visitBloom(const string_q& path, void *data);
+extern bool visitBloom(blknum_t bn, const CRawBloom *blooms, size_t nBlooms, void *data);
 //--------------------------------------------------------------
 int main(int argc, const char *argv[]) {
 
@@ -21,38 +21,56 @@ int main(int argc, const char *argv[]) {
 
     COptions opt;
     if (opt.parseArguments(argc, argv)) {
-        forEveryBloomFile( visitBloom, &opt, opt.start, opt.nBlocks, opt.skip );
+        if (opt.addresses.empty()) {
+            forEveryBloomFile( visitBloom, &opt, opt.start, opt.nBlocks, opt.skip );
+
+        } else if (opt.addresses.size() == 1) {
+            CRawBloom query;
+            bloomToRaw(makeBloom(opt.addresses[0]), query);
+            CBloomSummary summary;
+            summary.open(bloomSummaryFolder());
+            summary.forEveryHit(query, visitBloom, &opt, opt.start, opt.nBlocks);
+            summary.saveTelemetry();
+            if (verbose)
+                cerr << summary.nTested << " blocks tested, " << summary.nSkipped << " skipped\n";
+
+        } else {
+            CRawBloomArray queries;
+            for (size_t i = 0 ; i < opt.addresses.size() ; i++) {
+                CRawBloom query;
+                bloomToRaw(makeBloom(opt.addresses[i]), query);
+                queries.push_back(query);
+            }
+            CBloomScanner scanner;
+            vector<CBlockNumArray> hits;
+            scanner.scan(queries, opt.start, opt.nBlocks, hits);
+            for (size_t i = 0 ; i < opt.addresses.size() ; i++) {
+                cout << opt.addresses[i] << ":";
+                for (size_t j = 0 ; j < hits[i].size() ; j++)
+                    cout << " " << hits[i][j];
+                cout << "\n";
+            }
+        }
     }
 
     return 0;
 }
 
 //-----------------------------------------------------------------------
-bool visitBloom(const string_q& path, void *data) {
+bool visitBloom(blknum_t bn, const CRawBloom *blooms, size_t nBlooms, void *data) {
 
-    if (endsWith(path, "/")) {
-        forAllFiles(path + "*", visitBloom, data);
+    COptions *options = (COptions*)data;  // NOLINT
+    CRawBloom joined = blooms[0];
+    for (size_t i = 1 ; i < nBlooms ; i++)
+        for (size_t w = 0 ; w < 32 ; w++)
+            joined.words[w] |= blooms[i].words[w];
+    SFBloom bloom = rawToBloom(joined);
 
-    } else {
 extern bool displayBloom(blknum_t bn, const SFBloom& bloom, void *data);
-        if (endsWith(path, ".bin")) {
-            SFBloom bloom;
-            SFArchive archive(READING_ARCHIVE);
-            if (archive.Lock(path, binaryReadOnly, LOCK_NOWAIT)) {
-                SFBloomArray blooms;
-                archive >> blooms;
-                archive.Release();
-                for (size_t i = 0 ; i < blooms.size() ; i++) {
-                    bloom |= blooms[i];
-                }
-            }
-            COptions *options = (COptions*)data;  // NOLINT
-            if (options->asData)
-                cout << bnFromPath(path) << "," << fileSize(path) << "," << bitsTwiddled(bloom) << "\n";
-            else
-                displayBloom(bnFromPath(path), bloom, data);
-        }
-    }
+    if (options->asData)
+        cout << bn << "," << (nBlooms * sizeof(CRawBloom)) << "," << bitsTwiddled(bloom) << "\n";
+    else
+        displayBloom(bn, bloom, data);
     return true;
 }
 
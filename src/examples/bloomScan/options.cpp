@@ -20,7 +20,8 @@ CParams params[] = {
     CParams( "~end",         "block to end on"),
     CParams( "-mode:<mode>", "if not present, display in 'short' mode, otherwise 'full' mode"),
     CParams( "-data",        "show results as data instead of displaying bloom filters"),
-    CParams( "~@skip",       "optional skip step (default 100)"),
+    CParams( "-address:<addr>", "show only blocks whose blooms may hold this address (may be repeated to scan for many at once)"),
+    CParams( "~@skip",       "optional skip step when no address is given (default 100)"),
     CParams( "",             "Scans blocks looking for saturated bloomFilters.\n"),
 };
 size_t nParams = sizeof(params) / sizeof(CParams);
@@ -45,6 +46,12 @@ bool COptions::parseArguments(string_q& command) {
         } else if (arg == "-d" || arg == "--data") {
             asData = true;
 
+        } else if (startsWith(arg, "-a:") || startsWith(arg, "--address:")) {
+            arg = substitute(substitute(arg, "-a:", ""), "--address:", "");
+            if (!isAddress(arg))
+                return usage(arg + " does not appear to be a valid Ethereum address. Quitting...");
+            addresses.push_back(toLower(arg));
+
         } else if (startsWith(arg, '-')) {  // do not collapse
             if (!builtInCmd(arg)) {
                 return usage("Invalid option: " + arg);
@@ -90,6 +97,7 @@ void COptions::Init(void) {
     skip  = NOPOS;
     mode  = "short";
     asData = false;
+    addresses.clear();
     optionOff(OPT_VERBOSE);
     minArgs = 2;
 }
@@ -21,6 +21,7 @@ public:
     blknum_t skip;
     blknum_t nBlocks;
     bool asData;
+    SFAddressArray addresses;
     string_q mode;
 
          COptions  (void);
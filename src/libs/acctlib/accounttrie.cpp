@@ -0,0 +1,493 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include "accounttrie.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    static const char trieMagic[8] = { 'Q', 'B', 'T', 'R', 'I', 'E', '0', '1' };
+
+    //--------------------------------------------------------------------------
+    inline CTrieNode makeLeaf(uint32_t keyIdx) {
+        CTrieNode n;
+        n.depth = TRIE_LEAF; n.unused = 0; n.mask = 0; n.first = keyIdx;
+        return n;
+    }
+
+    //--------------------------------------------------------------------------
+    inline CTrieNode makeBranch(size_t depth, uint16_t mask, uint32_t first) {
+        CTrieNode n;
+        n.depth = (uint8_t)depth; n.unused = 0; n.mask = mask; n.first = first;
+        return n;
+    }
+
+    //--------------------------------------------------------------------------
+    inline size_t nChildren(const CTrieNode& node) {
+        return (size_t)__builtin_popcount(node.mask);
+    }
+
+    //--------------------------------------------------------------------------
+    CAccountTrie::CAccountTrie(void) : mapped(NULL) {
+        clear();
+    }
+
+    //--------------------------------------------------------------------------
+    CAccountTrie::~CAccountTrie(void) {
+        clear();
+    }
+
+    //--------------------------------------------------------------------------
+    void CAccountTrie::clear(void) {
+        if (mapped) {
+            mapped->close();
+            delete mapped;
+            mapped = NULL;
+        }
+        nodes.clear();
+        keys.clear();
+        values.clear();
+        for (size_t i = 0 ; i < 17 ; i++)
+            freeList[i].clear();
+        nFree = 0;
+        refresh();
+    }
+
+    //--------------------------------------------------------------------------
+    void CAccountTrie::refresh(void) {
+        if (mapped)
+            return;
+        pNodes  = nodes.data();
+        pKeys   = keys.data();
+        pValues = values.data();
+        nNodes  = nodes.size();
+        nKeys   = keys.size();
+    }
+
+    //--------------------------------------------------------------------------
+    // Copy a memory mapped trie into the arena so that it may be modified
+    void CAccountTrie::detach(void) {
+        if (!mapped)
+            return;
+        nodes.assign(pNodes, pNodes + nNodes);
+        keys.assign(pKeys, pKeys + nKeys);
+        values.assign(pValues, pValues + nKeys);
+        mapped->close();
+        delete mapped;
+        mapped = NULL;
+        refresh();
+    }
+
+    //--------------------------------------------------------------------------
+    uint32_t CAccountTrie::allocBlock(size_t cnt) {
+        ASSERT(cnt > 0 && cnt < 17);
+        vector<uint32_t>& fl = freeList[cnt];
+        if (!fl.empty()) {
+            uint32_t ret = fl.back();
+            fl.pop_back();
+            nFree -= cnt;
+            return ret;
+        }
+        uint32_t ret = (uint32_t)nodes.size();
+        nodes.resize(nodes.size() + cnt);
+        return ret;
+    }
+
+    //--------------------------------------------------------------------------
+    void CAccountTrie::freeBlock(uint32_t where, size_t cnt) {
+        freeList[cnt].push_back(where);
+        nFree += cnt;
+    }
+
+    //--------------------------------------------------------------------------
+    uint32_t CAccountTrie::addKey(const CBinAddress& addr, uint64_t value) {
+        keys.push_back(addr);
+        values.push_back(value);
+        return (uint32_t)(keys.size() - 1);
+    }
+
+    //--------------------------------------------------------------------------
+    size_t CAccountTrie::findNode(const CBinAddress& addr) const {
+        if (!nKeys)
+            return NOPOS;
+        uint32_t n = 0;
+        while (!pNodes[n].isLeaf()) {
+            const CTrieNode& node = pNodes[n];
+            uint8_t nib = addr.nibble(node.depth);
+            if (!(node.mask & (1u << nib)))
+                return NOPOS;
+            n = childIndex(node, nib);
+        }
+        return (pKeys[pNodes[n].first] == addr ? n : NOPOS);
+    }
+
+    //--------------------------------------------------------------------------
+    size_t CAccountTrie::findKey(const CBinAddress& addr) const {
+        size_t n = findNode(addr);
+        return (n == NOPOS ? NOPOS : pNodes[n].first);
+    }
+
+    //--------------------------------------------------------------------------
+    uint64_t CAccountTrie::at(const CBinAddress& addr) const {
+        size_t k = findKey(addr);
+        return (k == NOPOS ? 0 : pValues[k]);
+    }
+
+    //--------------------------------------------------------------------------
+    bool CAccountTrie::insert(const CBinAddress& addr, uint64_t value) {
+        return insertKey(addr, value, false);
+    }
+
+    //--------------------------------------------------------------------------
+    bool CAccountTrie::increment(const CBinAddress& addr, uint64_t by) {
+        return insertKey(addr, by, true);
+    }
+
+    //--------------------------------------------------------------------------
+    // Returns true if the address was not previously in the trie
+    bool CAccountTrie::insertKey(const CBinAddress& addr, uint64_t value, bool add) {
+        detach();
+
+        if (keys.empty()) {
+            nodes.resize(1);
+            nodes[0] = makeLeaf(addKey(addr, value));
+            refresh();
+            return true;
+        }
+
+        // Walk down to whichever leaf is closest to the new key. Where the key's nibble is
+        // missing from a branch any child will do since all keys below it share the prefix.
+        uint32_t n = 0;
+        while (!nodes[n].isLeaf()) {
+            uint8_t nib = addr.nibble(nodes[n].depth);
+            n = (nodes[n].mask & (1u << nib)) ? childIndex(nodes[n], nib) : nodes[n].first;
+        }
+
+        uint32_t found = nodes[n].first;
+        size_t diff = firstDiffNibble(addr, keys[found]);
+        if (diff == 40) {
+            values[found] = (add ? values[found] + value : value);
+            return false;
+        }
+
+        // Walk down again to the first node that splits at or below the differing nibble
+        n = 0;
+        while (!nodes[n].isLeaf() && nodes[n].depth < diff)
+            n = childIndex(nodes[n], addr.nibble(nodes[n].depth));
+
+        uint32_t leaf = addKey(addr, value);
+        uint8_t  newNib = addr.nibble(diff);
+        if (!nodes[n].isLeaf() && nodes[n].depth == diff) {
+            // the branch already splits here, give it another child
+            CTrieNode branch = nodes[n];
+            size_t cnt = nChildren(branch);
+            uint32_t block = allocBlock(cnt + 1);
+            uint32_t pos = childIndex(branch, newNib) - branch.first;
+            for (size_t i = 0, j = 0 ; i < cnt + 1 ; i++) {
+                if (i == pos)
+                    nodes[block + i] = makeLeaf(leaf);
+                else
+                    nodes[block + i] = nodes[branch.first + j++];
+            }
+            freeBlock(branch.first, cnt);
+            nodes[n] = makeBranch(diff, (uint16_t)(branch.mask | (1u << newNib)), block);
+
+        } else {
+            // split the node with a new two-way branch in its place
+            CTrieNode old = nodes[n];
+            uint8_t oldNib = keys[found].nibble(diff);
+            uint32_t block = allocBlock(2);
+            nodes[block + (oldNib < newNib ? 0 : 1)] = old;
+            nodes[block + (oldNib < newNib ? 1 : 0)] = makeLeaf(leaf);
+            nodes[n] = makeBranch(diff, (uint16_t)((1u << oldNib) | (1u << newNib)), block);
+        }
+
+        refresh();
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    bool CAccountTrie::remove(const CBinAddress& addr) {
+        if (!contains(addr))
+            return false;
+        detach();
+
+        if (nodes[0].isLeaf()) {
+            clear();
+            return true;
+        }
+
+        uint32_t parent = 0, n = 0;
+        while (!nodes[n].isLeaf()) {
+            parent = n;
+            n = childIndex(nodes[n], addr.nibble(nodes[n].depth));
+        }
+
+        uint32_t keyIdx = nodes[n].first;
+        CTrieNode branch = nodes[parent];
+        size_t cnt = nChildren(branch);
+        uint32_t pos = n - branch.first;
+        if (cnt == 2) {
+            // the branch is no longer needed, its remaining child takes its place
+            nodes[parent] = nodes[branch.first + (pos == 0 ? 1 : 0)];
+            freeBlock(branch.first, 2);
+
+        } else {
+            uint32_t block = allocBlock(cnt - 1);
+            for (size_t i = 0, j = 0 ; i < cnt ; i++)
+                if (i != pos)
+                    nodes[block + j++] = nodes[branch.first + i];
+            freeBlock(branch.first, cnt);
+            uint8_t nib = addr.nibble(branch.depth);
+            nodes[parent] = makeBranch(branch.depth, (uint16_t)(branch.mask & ~(1u << nib)), block);
+        }
+
+        // keep the key store dense by moving the last key into the vacated slot
+        uint32_t last = (uint32_t)(keys.size() - 1);
+        if (keyIdx != last) {
+            refresh();
+            size_t lastNode = findNode(keys[last]);
+            ASSERT(lastNode != NOPOS);
+            keys[keyIdx] = keys[last];
+            values[keyIdx] = values[last];
+            nodes[lastNode].first = keyIdx;
+        }
+        keys.pop_back();
+        values.pop_back();
+        refresh();
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    // Builds the sub-trie for the sorted keys [lo, hi) into the given slot. Because the keys are
+    // sorted, the common prefix of the range is the common prefix of its first and last keys.
+    void CAccountTrie::buildRange(uint32_t slot, size_t lo, size_t hi) {
+        if (hi - lo == 1) {
+            nodes[slot] = makeLeaf((uint32_t)lo);
+            return;
+        }
+
+        size_t depth = firstDiffNibble(keys[lo], keys[hi - 1]);
+        uint16_t mask = 0;
+        for (size_t i = lo ; i < hi ; i++)
+            mask |= (uint16_t)(1u << keys[i].nibble(depth));
+
+        uint32_t block = allocBlock((size_t)__builtin_popcount(mask));
+        nodes[slot] = makeBranch(depth, mask, block);
+
+        size_t start = lo;
+        for (size_t i = lo + 1 ; i <= hi ; i++) {
+            if (i == hi || keys[i].nibble(depth) != keys[start].nibble(depth)) {
+                buildRange(block++, start, i);
+                start = i;
+            }
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    // Replaces the contents of the trie. Addresses must be sorted. Repeated addresses are
+    // collapsed into a single entry whose value is the sum of the repeated values.
+    bool CAccountTrie::bulkLoad(const CBinAddressArray& sortedAddrs, const SFUintArray& vals) {
+        if (sortedAddrs.size() != vals.size())
+            return false;
+        for (size_t i = 1 ; i < sortedAddrs.size() ; i++)
+            if (sortedAddrs[i] < sortedAddrs[i-1])
+                return false;
+
+        clear();
+        keys.reserve(sortedAddrs.size());
+        values.reserve(sortedAddrs.size());
+        for (size_t i = 0 ; i < sortedAddrs.size() ; i++) {
+            if (!keys.empty() && keys.back() == sortedAddrs[i])
+                values.back() += vals[i];
+            else
+                addKey(sortedAddrs[i], vals[i]);
+        }
+
+        if (!keys.empty()) {
+            nodes.reserve(keys.size() * 2);
+            nodes.resize(1);
+            buildRange(0, 0, keys.size());
+        }
+        refresh();
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    static bool collectItem(const CBinAddress& addr, uint64_t value, void *data) {
+        pair<CBinAddressArray, SFUintArray> *p = reinterpret_cast<pair<CBinAddressArray, SFUintArray>*>(data);
+        p->first.push_back(addr);
+        p->second.push_back(value);
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    // Adds the items of another trie into this one (values of common addresses are summed).
+    // Both tries are walked in address order so the result is a linear merge and a rebuild,
+    // which is much cheaper than inserting a large delta one address at a time.
+    bool CAccountTrie::merge(const CAccountTrie& delta) {
+        pair<CBinAddressArray, SFUintArray> ours, theirs;
+        ours.first.reserve(nKeys);
+        ours.second.reserve(nKeys);
+        theirs.first.reserve(delta.nKeys);
+        theirs.second.reserve(delta.nKeys);
+        visitItems(collectItem, &ours);
+        delta.visitItems(collectItem, &theirs);
+
+        pair<CBinAddressArray, SFUintArray> merged;
+        merged.first.reserve(ours.first.size() + theirs.first.size());
+        merged.second.reserve(ours.first.size() + theirs.first.size());
+        size_t i = 0, j = 0;
+        while (i < ours.first.size() || j < theirs.first.size()) {
+            if (j == theirs.first.size() || (i < ours.first.size() && ours.first[i] < theirs.first[j])) {
+                merged.first.push_back(ours.first[i]);
+                merged.second.push_back(ours.second[i++]);
+            } else {
+                // bulkLoad sums the values of a repeated address
+                merged.first.push_back(theirs.first[j]);
+                merged.second.push_back(theirs.second[j++]);
+            }
+        }
+        return bulkLoad(merged.first, merged.second);
+    }
+
+    //--------------------------------------------------------------------------
+    bool CAccountTrie::visitNode(uint32_t n, TRIEVISITFUNC func, void *data) const {
+        const CTrieNode& node = pNodes[n];
+        if (node.isLeaf())
+            return (*func)(pKeys[node.first], pValues[node.first], data);
+        size_t cnt = nChildren(node);
+        for (size_t i = 0 ; i < cnt ; i++)
+            if (!visitNode(node.first + (uint32_t)i, func, data))
+                return false;
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    // Visits every item in address order
+    bool CAccountTrie::visitItems(TRIEVISITFUNC func, void *data) const {
+        ASSERT(func);
+        if (!nKeys)
+            return true;
+        return visitNode(0, func, data);
+    }
+
+    //--------------------------------------------------------------------------
+    uint64_t CAccountTrie::memoryUsed(void) const {
+        return nNodes * sizeof(CTrieNode) + nKeys * (sizeof(CBinAddress) + sizeof(uint64_t));
+    }
+
+    //--------------------------------------------------------------------------
+    bool CAccountTrie::writeToFile(const string_q& fileName) {
+        // After removals the arena has holes and the keys are out of order, so we rebuild a
+        // compact copy before writing. A freshly bulk loaded trie is written as is.
+        if (nFree && !mapped) {
+            pair<CBinAddressArray, SFUintArray> items;
+            items.first.reserve(nKeys);
+            items.second.reserve(nKeys);
+            visitItems(collectItem, &items);
+            bulkLoad(items.first, items.second);
+        }
+
+        string_q created;
+        if (!establishFolder(fileName, created))
+            return false;
+
+        // written aside and renamed into place, so a trie mapped from this file (possibly this
+        // one) keeps reading the old copy rather than a truncated one
+        string_q tmpName = fileName + ".tmp";
+        CBinFile file;
+        if (!file.Lock(tmpName, binaryWriteCreate, LOCK_CREATE))
+            return false;
+
+        CTrieHeader header;
+        bzero(&header, sizeof(header));
+        memcpy(header.magic, trieMagic, sizeof(header.magic));
+        header.nNodes = nNodes;
+        header.nKeys = nKeys;
+        file.Write(&header, sizeof(header), 1);
+        file.Write(pNodes, sizeof(CTrieNode), nNodes);
+        file.Write(pValues, sizeof(uint64_t), nKeys);
+        file.Write(pKeys, sizeof(CBinAddress), nKeys);
+        file.Release();
+        return (::rename(tmpName.c_str(), fileName.c_str()) == 0);
+    }
+
+    //--------------------------------------------------------------------------
+    static bool checkHeader(const CTrieHeader& header, uint64_t fileSz) {
+        if (memcmp(header.magic, trieMagic, sizeof(trieMagic)))
+            return false;
+        uint64_t expected = sizeof(CTrieHeader) + header.nNodes * sizeof(CTrieNode) +
+                                header.nKeys * (sizeof(uint64_t) + sizeof(CBinAddress));
+        return (expected == fileSz);
+    }
+
+    //--------------------------------------------------------------------------
+    bool CAccountTrie::readFromFile(const string_q& fileName) {
+        clear();
+
+        uint64_t fileSz = fileSize(fileName);
+        if (fileSz < sizeof(CTrieHeader))
+            return false;
+
+        CBinFile file;
+        if (!file.Lock(fileName, binaryReadOnly, LOCK_NOWAIT))
+            return false;
+
+        CTrieHeader header;
+        file.Read(&header, sizeof(header), 1);
+        if (!checkHeader(header, fileSz)) {
+            file.Release();
+            return false;
+        }
+
+        nodes.resize(header.nNodes);
+        values.resize(header.nKeys);
+        keys.resize(header.nKeys);
+        file.Read(nodes.data(), sizeof(CTrieNode), header.nNodes);
+        file.Read(values.data(), sizeof(uint64_t), header.nKeys);
+        file.Read(keys.data(), sizeof(CBinAddress), header.nKeys);
+        file.Release();
+        refresh();
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    // Maps the file read only. Lookups and visits use the file in place. Any modification
+    // first copies the trie into memory.
+    bool CAccountTrie::mapFile(const string_q& fileName) {
+        clear();
+
+        CMemMapFile *mm = new CMemMapFile(fileName, CMemMapFile::WholeFile, CMemMapFile::RandomAccess);
+        if (!mm->isValid() || mm->size() < sizeof(CTrieHeader)) {
+            delete mm;
+            return false;
+        }
+
+        const unsigned char *base = mm->getData();
+        CTrieHeader header;
+        memcpy(&header, base, sizeof(header));
+        if (!checkHeader(header, mm->size())) {
+            delete mm;
+            return false;
+        }
+
+        mapped  = mm;
+        nNodes  = header.nNodes;
+        nKeys   = header.nKeys;
+        pNodes  = reinterpret_cast<const CTrieNode*>(base + sizeof(CTrieHeader));
+        pValues = reinterpret_cast<const uint64_t*>(pNodes + nNodes);
+        pKeys   = reinterpret_cast<const CBinAddress*>(pValues + nKeys);
+        return true;
+    }
+
+}  // namespace qblocks
@@ -0,0 +1,117 @@
+#pragma once
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <vector>
+#include "etherlib.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    // A single trie node (eight bytes). A branch splits on the nibble at 'depth' and stores its
+    // children contiguously in the arena starting at 'first', one for each bit set in 'mask'. A
+    // leaf (depth == TRIE_LEAF) stores the index of its key/value pair in 'first'.
+    //--------------------------------------------------------------------------
+    #define TRIE_LEAF ((uint8_t)0xff)
+    class CTrieNode {
+    public:
+        uint8_t  depth;
+        uint8_t  unused;
+        uint16_t mask;
+        uint32_t first;
+        bool isLeaf(void) const { return depth == TRIE_LEAF; }
+    };
+
+    //--------------------------------------------------------------------------
+    // Header of the flat on-disc image (this is the format of accountTree.bin, see accountIndex).
+    // The header is followed by the node array, the value array and the key array, so the file
+    // may be memory mapped and used in place.
+    //--------------------------------------------------------------------------
+    class CTrieHeader {
+    public:
+        char     magic[8];
+        uint64_t nNodes;
+        uint64_t nKeys;
+        uint64_t unused;
+    };
+
+    //--------------------------------------------------------------------------
+    typedef bool (*TRIEVISITFUNC)(const CBinAddress& addr, uint64_t value, void *data);
+
+    //--------------------------------------------------------------------------
+    // A compact, nibble-based Patricia trie keyed by twenty byte addresses holding an integer
+    // for each address. Nodes live in a single arena (with free lists by block size) rather
+    // than on the heap, keys and values are stored in parallel flat arrays. The trie may be
+    // loaded from disc, memory mapped (read only) or bulk loaded from sorted input.
+    //--------------------------------------------------------------------------
+    class CAccountTrie {
+    public:
+                 CAccountTrie (void);
+                ~CAccountTrie (void);
+
+        void     clear        (void);
+
+        bool     insert       (const CBinAddress& addr, uint64_t value);
+        bool     increment    (const CBinAddress& addr, uint64_t by = 1);
+        bool     remove       (const CBinAddress& addr);
+        bool     contains     (const CBinAddress& addr) const { return findKey(addr) != NOPOS; }
+        uint64_t at           (const CBinAddress& addr) const;
+        bool     visitItems   (TRIEVISITFUNC func, void *data) const;
+
+        bool     bulkLoad     (const CBinAddressArray& sortedAddrs, const SFUintArray& values);
+        bool     merge        (const CAccountTrie& delta);
+        bool     readFromFile (const string_q& fileName);
+        bool     mapFile      (const string_q& fileName);
+        bool     writeToFile  (const string_q& fileName);
+
+        uint64_t size         (void) const { return nKeys; }
+        uint64_t nodeCount    (void) const { return nNodes - nFree; }
+        uint64_t memoryUsed   (void) const;
+        bool     isMapped     (void) const { return mapped != NULL; }
+
+    private:
+        // The arena and the key/value stores. When the trie is memory mapped these are empty
+        // and the read pointers below point into the mapped file instead.
+        vector<CTrieNode>   nodes;
+        CBinAddressArray    keys;
+        SFUintArray         values;
+        vector<uint32_t>    freeList[17];
+
+        const CTrieNode    *pNodes;
+        const CBinAddress  *pKeys;
+        const uint64_t     *pValues;
+        uint64_t            nNodes;
+        uint64_t            nKeys;
+        uint64_t            nFree;
+        CMemMapFile        *mapped;
+
+        size_t   findNode     (const CBinAddress& addr) const;
+        size_t   findKey      (const CBinAddress& addr) const;
+        uint32_t allocBlock   (size_t cnt);
+        void     freeBlock    (uint32_t where, size_t cnt);
+        uint32_t addKey       (const CBinAddress& addr, uint64_t value);
+        bool     insertKey    (const CBinAddress& addr, uint64_t value, bool add);
+        void     buildRange   (uint32_t slot, size_t lo, size_t hi);
+        bool     visitNode    (uint32_t n, TRIEVISITFUNC func, void *data) const;
+        void     detach       (void);
+        void     refresh      (void);
+
+        CAccountTrie(const CAccountTrie& trie);
+        CAccountTrie& operator=(const CAccountTrie& trie);
+    };
+
+    //--------------------------------------------------------------------------
+    inline uint32_t childIndex(const CTrieNode& node, uint8_t nibble) {
+        return node.first + (uint32_t)__builtin_popcount(node.mask & ((1u << nibble) - 1));
+    }
+
+}  // namespace qblocks
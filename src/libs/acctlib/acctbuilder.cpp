@@ -0,0 +1,304 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include "acctbuilder.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    // Workers collapse their local lists whenever they grow past this many entries
+    #define COLLAPSE_AT (1 << 22)
+
+    //--------------------------------------------------------------------------
+    size_t defaultThreads(void) {
+        size_t n = (size_t)thread::hardware_concurrency();
+        return (n ? n : 4);
+    }
+
+    //--------------------------------------------------------------------------
+    CAccountTreeBuilder::CAccountTreeBuilder(void) {
+        nThreads       = defaultThreads();
+        chunkSize      = 1000;
+        showProgress   = !isTestMode();
+        nBlocksVisited = 0;
+        nTransVisited  = 0;
+        nAddrsFound    = 0;
+    }
+
+    //--------------------------------------------------------------------------
+    inline bool addrLess(const CAddressCount& a, const CAddressCount& b) {
+        return a.addr < b.addr;
+    }
+
+    //--------------------------------------------------------------------------
+    void collapseSorted(CAddressCountArray& items) {
+        if (items.empty())
+            return;
+        size_t out = 0;
+        for (size_t i = 1 ; i < items.size() ; i++) {
+            if (items[i].addr == items[out].addr) {
+                uint64_t sum = (uint64_t)items[out].count + items[i].count;
+                items[out].count = (uint32_t)min(sum, (uint64_t)UINT32_MAX);
+            } else {
+                items[++out] = items[i];
+            }
+        }
+        items.resize(out + 1);
+    }
+
+    //--------------------------------------------------------------------------
+    // Second level of the radix sort: partition one first-byte bucket on the second byte
+    // through the scratch space, then finish each (small) sub-bucket with a comparison sort.
+    static void sortBucket(CAddressCount *items, CAddressCount *scratch, size_t n) {
+        if (n < 256) {
+            sort(items, items + n, addrLess);
+            return;
+        }
+
+        size_t counts[257];
+        bzero(counts, sizeof(counts));
+        for (size_t i = 0 ; i < n ; i++)
+            counts[items[i].addr.bytes[1] + 1]++;
+        for (size_t b = 1 ; b < 257 ; b++)
+            counts[b] += counts[b-1];
+
+        size_t pos[256];
+        memcpy(pos, counts, sizeof(pos));
+        for (size_t i = 0 ; i < n ; i++)
+            scratch[pos[items[i].addr.bytes[1]]++] = items[i];
+        memcpy(items, scratch, n * sizeof(CAddressCount));
+
+        for (size_t b = 0 ; b < 256 ; b++)
+            sort(items + counts[b], items + counts[b+1], addrLess);
+    }
+
+    //--------------------------------------------------------------------------
+    class CSortContext {
+    public:
+        CAddressCountArray *items;
+        CAddressCountArray  scratch;
+        vector<size_t>      hist;     // nThreads x 256 counts, then scatter offsets
+        size_t              buckets[257];
+        size_t              nThreads;
+        atomic<size_t>      nextBucket;
+        CSortContext(void) : items(NULL), nThreads(0), nextBucket(0) { }
+    };
+
+    //--------------------------------------------------------------------------
+    static void countSlice(CSortContext *ctx, size_t t) {
+        size_t n = ctx->items->size();
+        size_t lo = (n * t) / ctx->nThreads, hi = (n * (t + 1)) / ctx->nThreads;
+        size_t *h = &ctx->hist[t * 256];
+        const CAddressCount *items = ctx->items->data();
+        for (size_t i = lo ; i < hi ; i++)
+            h[items[i].addr.bytes[0]]++;
+    }
+
+    //--------------------------------------------------------------------------
+    static void scatterSlice(CSortContext *ctx, size_t t) {
+        size_t n = ctx->items->size();
+        size_t lo = (n * t) / ctx->nThreads, hi = (n * (t + 1)) / ctx->nThreads;
+        size_t *h = &ctx->hist[t * 256];
+        const CAddressCount *items = ctx->items->data();
+        CAddressCount *out = ctx->scratch.data();
+        for (size_t i = lo ; i < hi ; i++)
+            out[h[items[i].addr.bytes[0]]++] = items[i];
+    }
+
+    //--------------------------------------------------------------------------
+    static void sortBuckets(CSortContext *ctx) {
+        CAddressCount *items = ctx->items->data();
+        CAddressCount *scratch = ctx->scratch.data();
+        for (size_t b = ctx->nextBucket++ ; b < 256 ; b = ctx->nextBucket++) {
+            size_t lo = ctx->buckets[b];
+            sortBucket(items + lo, scratch + lo, ctx->buckets[b+1] - lo);
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    // Parallel most-significant-digit radix sort on the first two bytes of the address. The
+    // first pass is a classic parallel counting sort (histogram, prefix sum, scatter), after
+    // which the 256 buckets are independent and are handed out to the threads.
+    void sortAddresses(CAddressCountArray& items, size_t nThreads) {
+        size_t n = items.size();
+        if (nThreads < 1)
+            nThreads = 1;
+        if (n < (1 << 16)) {
+            sort(items.begin(), items.end(), addrLess);
+            return;
+        }
+
+        CSortContext ctx;
+        ctx.items = &items;
+        ctx.nThreads = nThreads;
+        ctx.scratch.resize(n);
+        ctx.hist.resize(nThreads * 256, 0);
+
+        vector<thread> threads;
+        for (size_t t = 0 ; t < nThreads ; t++)
+            threads.push_back(thread(countSlice, &ctx, t));
+        for (size_t t = 0 ; t < nThreads ; t++)
+            threads[t].join();
+        threads.clear();
+
+        // prefix sum in bucket-major order so each thread scatters into its own region
+        size_t running = 0;
+        for (size_t b = 0 ; b < 256 ; b++) {
+            ctx.buckets[b] = running;
+            for (size_t t = 0 ; t < nThreads ; t++) {
+                size_t cnt = ctx.hist[t * 256 + b];
+                ctx.hist[t * 256 + b] = running;
+                running += cnt;
+            }
+        }
+        ctx.buckets[256] = running;
+
+        for (size_t t = 0 ; t < nThreads ; t++)
+            threads.push_back(thread(scatterSlice, &ctx, t));
+        for (size_t t = 0 ; t < nThreads ; t++)
+            threads[t].join();
+        threads.clear();
+
+        items.swap(ctx.scratch);
+        for (size_t t = 0 ; t < nThreads ; t++)
+            threads.push_back(thread(sortBuckets, &ctx));
+        for (size_t t = 0 ; t < nThreads ; t++)
+            threads[t].join();
+    }
+
+    //--------------------------------------------------------------------------
+    class CExtractContext {
+    public:
+        CAccountTreeBuilder        *builder;
+        vector<CAddressCountArray>  perThread;
+        blknum_t                    start;
+        blknum_t                    end;
+        atomic<blknum_t>            nextBlock;
+        atomic<uint64_t>            nBlocks;
+        atomic<uint64_t>            nTrans;
+        CExtractContext(void) : builder(NULL), start(0), end(0), nextBlock(0), nBlocks(0), nTrans(0) { }
+    };
+
+    //--------------------------------------------------------------------------
+    inline void addAddress(CAddressCountArray& list, const SFAddress& addr) {
+        CAddressCount item;
+        item.addr.fromString(addr.empty() ? "0x0" : addr);
+        item.count = 1;
+        list.push_back(item);
+    }
+
+    //--------------------------------------------------------------------------
+    static void extractWorker(CExtractContext *ctx, size_t id) {
+        CAddressCountArray& local = ctx->perThread[id];
+        blknum_t chunk = ctx->builder->chunkSize;
+        for (blknum_t first = ctx->nextBlock.fetch_add(chunk) ; first < ctx->end ;
+                first = ctx->nextBlock.fetch_add(chunk)) {
+
+            blknum_t last = min(first + chunk, ctx->end);
+            for (blknum_t bn = first ; bn < last ; bn++) {
+                string_q fileName = getBinaryFilename(bn);
+                if (!fileExists(fileName))
+                    continue;  // empty blocks are not cached
+
+                CBlock block;
+                readBlockFromBinary(block, fileName);
+                for (size_t i = 0 ; i < block.transactions.size() ; i++) {
+                    const CTransaction *tr = &block.transactions[i];
+                    addAddress(local, tr->from);
+                    addAddress(local, tr->to);
+                }
+                ctx->nTrans += block.transactions.size();
+                ctx->nBlocks++;
+            }
+
+            if (local.size() > COLLAPSE_AT) {
+                sort(local.begin(), local.end(), addrLess);
+                collapseSorted(local);
+            }
+
+            if (id == 0 && ctx->builder->showProgress) {
+                cerr << "\tblock " << last << " of " << ctx->end << " (" << ctx->nTrans << " transactions)\r";
+                cerr.flush();
+            }
+        }
+        sort(local.begin(), local.end(), addrLess);
+        collapseSorted(local);
+    }
+
+    //--------------------------------------------------------------------------
+    // Returns the sorted list of unique addresses found in the cached blocks of the range
+    bool CAccountTreeBuilder::extract(CAddressCountArray& results, blknum_t start, blknum_t count) {
+        results.clear();
+        if (nThreads < 1)
+            nThreads = 1;
+        if (chunkSize < 1)
+            chunkSize = 1;
+
+        // establish the cache path on this thread, it's initialized once and cached
+        blockCachePath("");
+
+        CExtractContext ctx;
+        ctx.builder = this;
+        ctx.start = start;
+        ctx.end = start + count;
+        ctx.nextBlock = start;
+        ctx.perThread.resize(nThreads);
+
+        vector<thread> threads;
+        for (size_t t = 0 ; t < nThreads ; t++)
+            threads.push_back(thread(extractWorker, &ctx, t));
+        for (size_t t = 0 ; t < nThreads ; t++)
+            threads[t].join();
+
+        size_t total = 0;
+        for (size_t t = 0 ; t < nThreads ; t++)
+            total += ctx.perThread[t].size();
+        results.reserve(total);
+        for (size_t t = 0 ; t < nThreads ; t++) {
+            results.insert(results.end(), ctx.perThread[t].begin(), ctx.perThread[t].end());
+            CAddressCountArray().swap(ctx.perThread[t]);
+        }
+
+        sortAddresses(results, nThreads);
+        collapseSorted(results);
+
+        nBlocksVisited = ctx.nBlocks;
+        nTransVisited  = ctx.nTrans;
+        nAddrsFound    = results.size();
+        if (showProgress)
+            cerr << "\n";
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    bool CAccountTreeBuilder::build(CAccountTrie& trie, blknum_t start, blknum_t count) {
+        CAddressCountArray items;
+        if (!extract(items, start, count))
+            return false;
+
+        CBinAddressArray addrs;
+        SFUintArray values;
+        addrs.reserve(items.size());
+        values.reserve(items.size());
+        for (size_t i = 0 ; i < items.size() ; i++) {
+            addrs.push_back(items[i].addr);
+            values.push_back(items[i].count);
+        }
+        CAddressCountArray().swap(items);
+
+        return trie.bulkLoad(addrs, values);
+    }
+
+}  // namespace qblocks
@@ -0,0 +1,58 @@
+#pragma once
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <vector>
+#include "etherlib.h"
+#include "accounttrie.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    // An address and the number of times it was seen (24 bytes, so it sorts and moves cheaply)
+    class CAddressCount {
+    public:
+        CBinAddress addr;
+        uint32_t    count;
+    };
+    typedef vector<CAddressCount> CAddressCountArray;
+
+    //--------------------------------------------------------------------------
+    // Builds an account trie from the binary block cache. Block ranges are handed out to worker
+    // threads which extract the addresses (from and to of every transaction) and periodically
+    // sort and collapse what they've found. The per-thread results are then radix sorted in
+    // parallel, collapsed once more and bulk loaded into the trie. The value stored for each
+    // address is the number of times it appeared.
+    //--------------------------------------------------------------------------
+    class CAccountTreeBuilder {
+    public:
+        size_t   nThreads;
+        blknum_t chunkSize;
+        bool     showProgress;
+
+        // statistics from the most recent call to extract
+        blknum_t nBlocksVisited;
+        txnum_t  nTransVisited;
+        uint64_t nAddrsFound;
+
+                 CAccountTreeBuilder (void);
+
+        bool     extract             (CAddressCountArray& results, blknum_t start, blknum_t count);
+        bool     build               (CAccountTrie& trie, blknum_t start, blknum_t count);
+    };
+
+    //--------------------------------------------------------------------------
+    extern void   sortAddresses    (CAddressCountArray& items, size_t nThreads);
+    extern void   collapseSorted   (CAddressCountArray& items);
+    extern size_t defaultThreads   (void);
+
+}  // namespace qblocks
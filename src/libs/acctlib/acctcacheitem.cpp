@@ -90,8 +90,9 @@ bool CAcctCacheItem::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> blockNum;
-    archive >> transIndex;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(CAcctCacheItem), 2);
+    fields >> blockNum;
+    fields >> transIndex;
     finishParse();
     return true;
 }
@@ -20,5 +20,10 @@
 #include "infix.h"
 #include "leaf.h"
 #include "treenode.h"
+#include "accounttrie.h"
+#include "acctbuilder.h"
+#include "balanceengine.h"
+#include "watchmatcher.h"
+#include "tokenbalances.h"
 
 using namespace qblocks;  // NOLINT
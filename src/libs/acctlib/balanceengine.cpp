@@ -0,0 +1,373 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <algorithm>
+#include "balanceengine.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    static const char engineMagic[12] = "QBBALANCE01";
+
+    //--------------------------------------------------------------------------
+    inline bool blockLess(const CBalanceDelta& d, blknum_t bn) {
+        return d.bn < bn;
+    }
+
+    //--------------------------------------------------------------------------
+    inline bool blockGreater(blknum_t bn, const CBalanceDelta& d) {
+        return bn < d.bn;
+    }
+
+    //--------------------------------------------------------------------------
+    void CBalanceTimeline::addDelta(blknum_t bn, const SFIntBN& delta) {
+        // The common case: blocks are applied in order, so we either extend the last entry...
+        if (!deltas.empty() && deltas.back().bn == bn) {
+            deltas.back().delta += delta;
+            if (deltas.size() % interval == 0)
+                checkpoints.back() += delta;
+            return;
+        }
+
+        // ...or append a new one
+        if (deltas.empty() || deltas.back().bn < bn) {
+            deltas.push_back(CBalanceDelta(bn, delta));
+            if (deltas.size() % interval == 0) {
+                SFIntBN bal = checkpoints.empty() ? opening : checkpoints.back();
+                for (size_t i = deltas.size() - interval ; i < deltas.size() ; i++)
+                    bal += deltas[i].delta;
+                checkpoints.push_back(bal);
+            }
+            return;
+        }
+
+        // An earlier block. Insert it and recompute the checkpoints that follow.
+        CBalanceDeltaArray::iterator it = lower_bound(deltas.begin(), deltas.end(), bn, blockLess);
+        size_t pos = (size_t)(it - deltas.begin());
+        if (it->bn == bn)
+            it->delta += delta;
+        else
+            deltas.insert(it, CBalanceDelta(bn, delta));
+        rebuild(pos);
+    }
+
+    //--------------------------------------------------------------------------
+    // Recomputes the checkpoints that cover deltas at or after 'pos'
+    void CBalanceTimeline::rebuild(size_t pos) {
+        size_t nValid = pos / interval;
+        checkpoints.resize(nValid);
+        SFIntBN bal = nValid ? checkpoints.back() : opening;
+        for (size_t i = nValid * interval ; i < deltas.size() ; i++) {
+            bal += deltas[i].delta;
+            if ((i + 1) % interval == 0)
+                checkpoints.push_back(bal);
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    // The balance at the end of the given block
+    bool CBalanceTimeline::balanceAt(blknum_t bn, SFIntBN& bal) const {
+        if (bn < openBlock)
+            return false;
+
+        size_t n = (size_t)(upper_bound(deltas.begin(), deltas.end(), bn, blockGreater) - deltas.begin());
+        size_t c = n / interval;
+        bal = c ? checkpoints[c-1] : opening;
+        for (size_t i = c * interval ; i < n ; i++)
+            bal += deltas[i].delta;
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    void CBalanceTimeline::getHistory(CBalanceHistoryArray& history) const {
+        history.clear();
+        SFIntBN bal = opening;
+        for (size_t i = 0 ; i < deltas.size() ; i++) {
+            bal += deltas[i].delta;
+            CBalanceHistory item;
+            item.bn = deltas[i].bn;
+            // a negative balance means data is missing (see reconcile), we report zero
+            item.balance = bal.isNegative() ? SFUintBN(0) : bal.getMagnitude();
+            history.push_back(item);
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    CBalanceEngine::CBalanceEngine(void) {
+        deepScan = false;
+        interval = 32;
+        lastBlock = 0;
+    }
+
+    //--------------------------------------------------------------------------
+    void CBalanceEngine::clear(void) {
+        timelines.clear();
+        index.clear();
+        lastBlock = 0;
+    }
+
+    //--------------------------------------------------------------------------
+    bool CBalanceEngine::watch(const SFAddress& addrIn, const SFIntBN& opening, blknum_t openBlock) {
+        SFAddress addr = toLower(addrIn);
+        if (!isAddress(addr) || isWatched(addr))
+            return false;
+
+        CBalanceTimeline timeline;
+        timeline.address = addr;
+        timeline.opening = opening;
+        timeline.openBlock = openBlock;
+        timeline.interval = (interval ? interval : 1);
+        index[addr] = timelines.size();
+        timelines.push_back(timeline);
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    bool CBalanceEngine::isWatched(const SFAddress& addr) const {
+        return index.find(toLower(addr)) != index.end();
+    }
+
+    //--------------------------------------------------------------------------
+    CBalanceTimeline *CBalanceEngine::findTimeline(const SFAddress& addr) {
+        map<SFAddress, size_t>::const_iterator it = index.find(addr);
+        if (it == index.end())
+            return NULL;
+        return &timelines[it->second];
+    }
+
+    //--------------------------------------------------------------------------
+    const CBalanceTimeline *CBalanceEngine::getTimeline(const SFAddress& addr) const {
+        map<SFAddress, size_t>::const_iterator it = index.find(toLower(addr));
+        if (it == index.end())
+            return NULL;
+        return &timelines[it->second];
+    }
+
+    //--------------------------------------------------------------------------
+    void CBalanceEngine::addDelta(const SFAddress& addr, blknum_t bn, const SFIntBN& delta) {
+        CBalanceTimeline *timeline = findTimeline(toLower(addr));
+        if (!timeline || delta == 0 || (bn < timeline->openBlock))
+            return;
+        timeline->addDelta(bn, delta);
+    }
+
+    //--------------------------------------------------------------------------
+    void CBalanceEngine::transfer(const SFAddress& from, const SFAddress& to, const SFUintBN& amt, blknum_t bn) {
+        if (amt == 0)
+            return;
+        addDelta(from, bn, SFIntBN(amt, -1));
+        addDelta(to, bn, SFIntBN(amt));
+    }
+
+    //--------------------------------------------------------------------------
+    // Static block reward. We don't see uncles, so inclusion rewards are not counted.
+    SFUintBN blockReward(blknum_t bn) {
+        if (bn == 0)
+            return 0;
+        SFUintBN ether = str2BigUint("1000000000000000000");
+        if (bn >= constantinopleBlock)
+            return ether * 2;
+        if (bn >= byzantiumBlock)
+            return ether * 3;
+        return ether * 5;
+    }
+
+    //--------------------------------------------------------------------------
+    static bool isInside(const CStringArray& traceAddress, const CStringArray& parent) {
+        if (traceAddress.size() < parent.size())
+            return false;
+        for (size_t i = 0 ; i < parent.size() ; i++)
+            if (traceAddress[i] != parent[i])
+                return false;
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    // Traces come parent first. A call that failed undoes everything it called, so the transfers
+    // of the traces below it never happened either.
+    void CBalanceEngine::applyTraces(const CTraceArray& traces, blknum_t bn) {
+        vector<const CStringArray*> reverted;
+        for (size_t i = 0 ; i < traces.size() ; i++) {
+            const CTrace *trace = &traces[i];
+            bool undone = false;
+            for (size_t r = 0 ; r < reverted.size() && !undone ; r++)
+                undone = isInside(trace->traceAddress, *reverted[r]);
+            if (undone)
+                continue;
+            if (trace->isError()) {
+                reverted.push_back(&trace->traceAddress);
+                continue;
+            }
+            applyTrace(*trace, bn);
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    void CBalanceEngine::applyTrace(const CTrace& trace, blknum_t bn) {
+        // The top level trace is the transaction itself, which has already been applied
+        if (trace.traceAddress.empty() || trace.isError())
+            return;
+
+        const CTraceAction *action = &trace.action;
+        if (trace.type == "call") {
+            // delegate calls run in the caller's context and move no value
+            if (action->callType != "delegatecall")
+                transfer(action->from, action->to, action->value, bn);
+
+        } else if (trace.type == "create") {
+            transfer(action->from, trace.result.address, action->value, bn);
+
+        } else if (trace.type == "suicide") {
+            transfer(action->address, action->refundAddress, action->balance, bn);
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    void CBalanceEngine::applyTrans(const CTransaction& trans, blknum_t bn) {
+        SFAddress from = trans.from;
+        SFAddress to = (trans.to.empty() ? trans.receipt.contractAddress : trans.to);
+
+        // the sender pays for the gas whether or not the transaction succeeded
+        SFUintBN fee = SFUintBN(trans.receipt.gasUsed) * SFUintBN(trans.gasPrice);
+        addDelta(from, bn, SFIntBN(fee, -1));
+
+        bool failed = (trans.isError || trans.receipt.status == 0);
+        if (failed)
+            return;
+        transfer(from, to, trans.value, bn);
+
+        if (!trans.traces.empty()) {
+            applyTraces(trans.traces, bn);
+
+        } else if (deepScan && trans.input.length() > 2) {
+            // only contract calls can produce internal transfers
+            CTraceArray traces;
+            getTraces(traces, trans.hash);
+            applyTraces(traces, bn);
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    void CBalanceEngine::applyBlock(const CBlock& block) {
+        blknum_t bn = block.blockNumber;
+        SFUintBN fees = 0;
+        for (size_t i = 0 ; i < block.transactions.size() ; i++) {
+            const CTransaction *trans = &block.transactions[i];
+            applyTrans(*trans, bn);
+            fees += SFUintBN(trans->receipt.gasUsed) * SFUintBN(trans->gasPrice);
+        }
+        addDelta(block.miner, bn, SFIntBN(blockReward(bn) + fees));
+        if (bn > lastBlock)
+            lastBlock = bn;
+    }
+
+    //--------------------------------------------------------------------------
+    bool applyBlockToEngine(CBlock& block, void *data) {
+        CBalanceEngine *engine = reinterpret_cast<CBalanceEngine*>(data);
+        engine->applyBlock(block);
+        return !shouldQuit();
+    }
+
+    //--------------------------------------------------------------------------
+    // Corrects the timeline so that it agrees with a balance reported by the node at the end
+    // of the given block. Later queries then build on the node's balance.
+    bool CBalanceEngine::reconcile(const SFAddress& addr, blknum_t bn, const SFIntBN& nodeBal) {
+        CBalanceTimeline *timeline = findTimeline(toLower(addr));
+        if (!timeline)
+            return false;
+        SFIntBN ours;
+        if (!timeline->balanceAt(bn, ours))
+            return false;
+        if (ours != nodeBal)
+            timeline->addDelta(bn, nodeBal - ours);
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    bool CBalanceEngine::getBalance(const SFAddress& addr, blknum_t bn, SFIntBN& bal) const {
+        const CBalanceTimeline *timeline = getTimeline(addr);
+        if (!timeline)
+            return false;
+        return timeline->balanceAt(bn, bal);
+    }
+
+    //--------------------------------------------------------------------------
+    bool CBalanceEngine::getHistory(const SFAddress& addr, CBalanceHistoryArray& history) const {
+        const CBalanceTimeline *timeline = getTimeline(addr);
+        if (!timeline)
+            return false;
+        timeline->getHistory(history);
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    bool CBalanceEngine::writeToFile(const string_q& fileName) const {
+        string_q created;
+        if (!establishFolder(fileName, created))
+            return false;
+
+        SFArchive archive(WRITING_ARCHIVE);
+        if (!archive.Lock(fileName, binaryWriteCreate, LOCK_CREATE))
+            return false;
+
+        archive.Write(engineMagic, sizeof(char), sizeof(engineMagic));
+        archive << lastBlock << (uint64_t)timelines.size();
+        for (size_t i = 0 ; i < timelines.size() ; i++) {
+            const CBalanceTimeline *timeline = &timelines[i];
+            archive << timeline->address << timeline->openBlock << timeline->opening;
+            archive << timeline->interval << (uint64_t)timeline->deltas.size();
+            for (size_t j = 0 ; j < timeline->deltas.size() ; j++)
+                archive << timeline->deltas[j].bn << timeline->deltas[j].delta;
+        }
+        archive.Close();
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    bool CBalanceEngine::readFromFile(const string_q& fileName) {
+        clear();
+
+        if (fileSize(fileName) < sizeof(engineMagic))
+            return false;
+
+        SFArchive archive(READING_ARCHIVE);
+        if (!archive.Lock(fileName, binaryReadOnly, LOCK_NOWAIT))
+            return false;
+
+        char magic[sizeof(engineMagic)];
+        archive.Read(magic, sizeof(char), sizeof(magic));
+        if (memcmp(magic, engineMagic, sizeof(magic))) {
+            archive.Close();
+            return false;
+        }
+
+        uint64_t nTimelines = 0;
+        archive >> lastBlock >> nTimelines;
+        timelines.resize(nTimelines);
+        for (size_t i = 0 ; i < nTimelines ; i++) {
+            CBalanceTimeline *timeline = &timelines[i];
+            uint64_t nDeltas = 0;
+            archive >> timeline->address >> timeline->openBlock >> timeline->opening;
+            archive >> timeline->interval >> nDeltas;
+            if (!timeline->interval)
+                timeline->interval = 1;
+            timeline->deltas.resize(nDeltas);
+            for (size_t j = 0 ; j < nDeltas ; j++)
+                archive >> timeline->deltas[j].bn >> timeline->deltas[j].delta;
+            timeline->rebuild(0);
+            index[timeline->address] = i;
+        }
+        archive.Close();
+        return true;
+    }
+
+}  // namespace qblocks
@@ -0,0 +1,104 @@
+#pragma once
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <map>
+#include <vector>
+#include "etherlib.h"
+#include "balancehistory.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    // The net change in an account's balance during a single block
+    class CBalanceDelta {
+    public:
+        blknum_t bn;
+        SFIntBN  delta;
+        CBalanceDelta(void) : bn(0) { }
+        CBalanceDelta(blknum_t b, const SFIntBN& d) : bn(b), delta(d) { }
+    };
+    typedef vector<CBalanceDelta> CBalanceDeltaArray;
+
+    //--------------------------------------------------------------------------
+    // The balance timeline of a single account. Deltas are kept in block order with a running
+    // balance stored after every 'interval' deltas, so the balance at any block is a binary
+    // search followed by the sum of at most 'interval' deltas.
+    //--------------------------------------------------------------------------
+    class CBalanceTimeline {
+    public:
+        SFAddress          address;
+        blknum_t           openBlock;     // the opening balance is the balance prior to this block
+        SFIntBN            opening;
+        CBalanceDeltaArray deltas;
+        SFBigIntArray      checkpoints;   // checkpoints[i] is the balance after (i+1)*interval deltas
+        uint64_t           interval;
+
+        CBalanceTimeline(void) : openBlock(0), interval(32) { }
+
+        void     addDelta     (blknum_t bn, const SFIntBN& delta);
+        bool     balanceAt    (blknum_t bn, SFIntBN& bal) const;
+        void     getHistory   (CBalanceHistoryArray& history) const;
+        void     rebuild      (size_t pos);
+    };
+
+    //--------------------------------------------------------------------------
+    // Derives the balance history of a set of watched accounts from cached data rather than
+    // asking the node for each (address, block) pair. Each transaction debits the sender the
+    // gas used (from the receipt) and, if it did not fail, moves the value. Internal transfers
+    // (calls, creates and self-destructs) are applied from any traces attached to the
+    // transaction. Miners are credited the static block reward and the fees of the block.
+    //
+    // Uncle rewards and genesis allocations are not visible in the cache. Use 'watch' with a
+    // known balance (for example from the node at the account's first block), and 'reconcile'
+    // to bring the timeline into agreement with the node at any block going forward.
+    //--------------------------------------------------------------------------
+    class CBalanceEngine {
+    public:
+        bool     deepScan;          // fetch traces of contract calls that don't already have them
+        uint64_t interval;          // checkpoint spacing for new timelines
+        blknum_t lastBlock;         // the latest block applied
+
+                 CBalanceEngine (void);
+
+        void     clear          (void);
+        bool     watch          (const SFAddress& addr, const SFIntBN& opening = 0, blknum_t openBlock = 0);
+        bool     isWatched      (const SFAddress& addr) const;
+        size_t   nWatched       (void) const { return timelines.size(); }
+
+        void     applyBlock     (const CBlock& block);
+        void     applyTrans     (const CTransaction& trans, blknum_t bn);
+        void     addDelta       (const SFAddress& addr, blknum_t bn, const SFIntBN& delta);
+        bool     reconcile      (const SFAddress& addr, blknum_t bn, const SFIntBN& nodeBal);
+
+        bool     getBalance     (const SFAddress& addr, blknum_t bn, SFIntBN& bal) const;
+        bool     getHistory     (const SFAddress& addr, CBalanceHistoryArray& history) const;
+        const CBalanceTimeline *getTimeline(const SFAddress& addr) const;
+
+        bool     readFromFile   (const string_q& fileName);
+        bool     writeToFile    (const string_q& fileName) const;
+
+    private:
+        vector<CBalanceTimeline> timelines;
+        map<SFAddress, size_t>   index;
+
+        CBalanceTimeline *findTimeline(const SFAddress& addr);
+        void     transfer       (const SFAddress& from, const SFAddress& to, const SFUintBN& amt, blknum_t bn);
+        void     applyTraces    (const CTraceArray& traces, blknum_t bn);
+        void     applyTrace     (const CTrace& trace, blknum_t bn);
+    };
+
+    //--------------------------------------------------------------------------
+    extern bool     applyBlockToEngine (CBlock& block, void *data);
+    extern SFUintBN blockReward        (blknum_t bn);
+
+}  // namespace qblocks
@@ -89,8 +89,9 @@ bool CBalanceHistory::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> bn;
-    archive >> balance;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(CBalanceHistory), 2);
+    fields >> bn;
+    fields >> balance;
     finishParse();
     return true;
 }
@@ -94,9 +94,10 @@ bool CBalHistory::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> recordID;
-    archive >> timestamp;
-    archive >> balance;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(CBalHistory), 3);
+    fields >> recordID;
+    fields >> timestamp;
+    fields >> balance;
     finishParse();
     return true;
 }
@@ -101,12 +101,13 @@ bool CIncomeStatement::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> begBal;
-    archive >> inflow;
-    archive >> outflow;
-    archive >> gasCostInWei;
-    archive >> endBal;
-    archive >> blockNum;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(CIncomeStatement), 6);
+    fields >> begBal;
+    fields >> inflow;
+    fields >> outflow;
+    fields >> gasCostInWei;
+    fields >> endBal;
+    fields >> blockNum;
     finishParse();
     return true;
 }
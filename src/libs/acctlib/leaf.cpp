@@ -99,8 +99,9 @@ bool CLeaf::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> blocks;
-    archive >> counter;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(CLeaf), 2);
+    fields >> blocks;
+    fields >> counter;
     finishParse();
     return true;
 }
@@ -0,0 +1,218 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include "tokenbalances.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    // keccak("Transfer(address,address,uint256)")
+    static const uint64_t transferTopic[4] = {
+        0xddf252ad1be2c89bULL, 0x69c2b068fc378daaULL, 0x952ba7f163c4a116ULL, 0x28f55a4df523b3efULL
+    };
+
+    //--------------------------------------------------------------------------
+    bool isTransferLog(const CLogEntry& log, SFAddress& from, SFAddress& to, SFUintBN& value) {
+        if (log.topics.empty() || !isTopic(log.topics[0], transferTopic))
+            return false;
+
+        CAbiData data;
+        data.fromData(log.data);
+        if (log.topics.size() == 3 && data.nWords() >= 1) {
+            from  = topicAddress(log.topics[1]);
+            to    = topicAddress(log.topics[2]);
+            value = data.getUint(0);
+            return true;
+
+        } else if (log.topics.size() == 1 && data.nWords() >= 3) {
+            from  = data.getAddress(0);
+            to    = data.getAddress(1);
+            value = data.getUint(2);
+            return true;
+        }
+        return false;
+    }
+
+    //--------------------------------------------------------------------------
+    CTokenBalances::CTokenBalances(void) {
+        interval = 32;
+    }
+
+    //--------------------------------------------------------------------------
+    void CTokenBalances::clear(void) {
+        tokens.clear();
+    }
+
+    //--------------------------------------------------------------------------
+    bool CTokenBalances::watchToken(const SFAddress& tokenIn) {
+        SFAddress token = toLower(tokenIn);
+        if (!isAddress(token) || isWatched(token))
+            return false;
+        tokens[token] = CTokenState();
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    bool CTokenBalances::isWatched(const SFAddress& token) const {
+        return tokens.find(toLower(token)) != tokens.end();
+    }
+
+    //--------------------------------------------------------------------------
+    size_t CTokenBalances::nHolders(const SFAddress& token) const {
+        map<SFAddress, CTokenState>::const_iterator it = tokens.find(toLower(token));
+        return (it == tokens.end() ? 0 : it->second.holders.size());
+    }
+
+    //--------------------------------------------------------------------------
+    uint64_t CTokenBalances::nTransfers(const SFAddress& token) const {
+        map<SFAddress, CTokenState>::const_iterator it = tokens.find(toLower(token));
+        return (it == tokens.end() ? 0 : it->second.nTransfers);
+    }
+
+    //--------------------------------------------------------------------------
+    void CTokenBalances::addDelta(CTokenState& state, const SFAddress& holder, blknum_t bn, const SFIntBN& delta) {
+        map<SFAddress, CBalanceTimeline>::iterator it = state.holders.find(holder);
+        if (it == state.holders.end()) {
+            CBalanceTimeline timeline;
+            timeline.address = holder;
+            timeline.interval = (interval ? interval : 1);
+            it = state.holders.insert(make_pair(holder, timeline)).first;
+        }
+        it->second.addDelta(bn, delta);
+    }
+
+    //--------------------------------------------------------------------------
+    // Applies the log if it is a Transfer emitted by a watched token. Returns true if it was.
+    bool CTokenBalances::applyLog(const CLogEntry& log, blknum_t bn) {
+        map<SFAddress, CTokenState>::iterator it = tokens.find(toLower(log.address));
+        if (it == tokens.end())
+            return false;
+
+        SFAddress from, to;
+        SFUintBN value;
+        if (!isTransferLog(log, from, to, value))
+            return false;
+
+        it->second.nTransfers++;
+        if (value == 0 || from == to)
+            return true;
+        addDelta(it->second, from, bn, SFIntBN(value, -1));
+        addDelta(it->second, to, bn, SFIntBN(value));
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    void CTokenBalances::applyBlock(const CBlock& block) {
+        for (size_t t = 0 ; t < block.transactions.size() ; t++) {
+            const CReceipt *receipt = &block.transactions[t].receipt;
+            for (size_t l = 0 ; l < receipt->logs.size() ; l++)
+                applyLog(receipt->logs[l], block.blockNumber);
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    // Replays every Transfer the log index knows of for this token. Each block holding a hit is
+    // read from the cache once. Returns the number of transfers applied. A token with nothing
+    // to apply is left unwatched, so getBalance fails and the caller asks the node instead.
+    size_t CTokenBalances::loadToken(const SFAddress& token, const CLogIndex& index, blknum_t lastBlock) {
+        CLogQuery query;
+        query.address = toLower(token);
+        query.topic = toTopic("0xddf252ad1be2c89b69c2b068fc378daa952ba7f163c4a11628f55a4df523b3ef");
+        query.hasTopic = true;
+        query.lastBlock = lastBlock;
+        CLogIndexRecordArray hits;
+        if (!index.find(query, hits))
+            return 0;
+        bool added = watchToken(token);
+
+        size_t nApplied = 0;
+        CBlock block;
+        for (size_t i = 0 ; i < hits.size() ; i++) {
+            if (i == 0 || hits[i].blockNum != block.blockNumber) {
+                block = CBlock();
+                readBlockFromBinary(block, getBinaryFilename(hits[i].blockNum));
+                block.blockNumber = hits[i].blockNum;
+            }
+            if (hits[i].txIndex >= block.transactions.size())
+                continue;
+            const CReceipt *receipt = &block.transactions[hits[i].txIndex].receipt;
+            for (size_t l = 0 ; l < receipt->logs.size() ; l++) {
+                if (receipt->logs[l].logIndex == hits[i].logIndex) {
+                    nApplied += applyLog(receipt->logs[l], hits[i].blockNum);
+                    break;
+                }
+            }
+        }
+        // the hits were in blocks missing from the cache
+        if (added && !nApplied)
+            tokens.erase(toLower(token));
+        return nApplied;
+    }
+
+    //--------------------------------------------------------------------------
+    const CBalanceTimeline *CTokenBalances::getTimeline(const SFAddress& token, const SFAddress& holder) const {
+        map<SFAddress, CTokenState>::const_iterator it = tokens.find(toLower(token));
+        if (it == tokens.end())
+            return NULL;
+        map<SFAddress, CBalanceTimeline>::const_iterator h = it->second.holders.find(toLower(holder));
+        return (h == it->second.holders.end() ? NULL : &h->second);
+    }
+
+    //--------------------------------------------------------------------------
+    // The balance at the end of the given block. A holder with no transfers has a zero balance.
+    // Returns false only if the token is not being watched.
+    bool CTokenBalances::getBalance(const SFAddress& token, const SFAddress& holder, blknum_t bn, SFUintBN& bal) const {
+        if (!isWatched(token))
+            return false;
+        bal = 0;
+        const CBalanceTimeline *timeline = getTimeline(token, holder);
+        SFIntBN val;
+        if (timeline && timeline->balanceAt(bn, val) && !val.isNegative())
+            bal = val.getMagnitude();
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    // Compares up to nSamples evenly spaced holders with 'func' at the given block. Holders that
+    // disagree are corrected from that block on and returned in 'corrected'.
+    size_t CTokenBalances::validate(const SFAddress& token, blknum_t bn, size_t nSamples,
+                                        TOKENBALFUNC func, SFAddressArray& corrected) {
+        corrected.clear();
+        map<SFAddress, CTokenState>::iterator it = tokens.find(toLower(token));
+        if (it == tokens.end() || !func || !nSamples)
+            return 0;
+
+        // the mint address is not a holder
+        vector<CBalanceTimeline*> candidates;
+        map<SFAddress, CBalanceTimeline>::iterator h = it->second.holders.begin();
+        for ( ; h != it->second.holders.end() ; ++h)
+            if (!zeroAddr(h->first))
+                candidates.push_back(&h->second);
+
+        size_t step = max((size_t)1, candidates.size() / nSamples);
+        size_t nChecked = 0;
+        for (size_t i = 0 ; i < candidates.size() && nChecked < nSamples ; i += step) {
+            CBalanceTimeline *timeline = candidates[i];
+            nChecked++;
+            SFIntBN ours;
+            if (!timeline->balanceAt(bn, ours))
+                continue;
+            SFIntBN theirs = SFIntBN((*func)(it->first, timeline->address, bn));
+            if (ours != theirs) {
+                timeline->addDelta(bn, theirs - ours);
+                corrected.push_back(timeline->address);
+            }
+        }
+        return nChecked;
+    }
+
+}  // namespace qblocks
@@ -0,0 +1,69 @@
+#pragma once
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <map>
+#include "etherlib.h"
+#include "balanceengine.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    // Asks someone else (usually the node, through eth_call) for a holder's balance of a token
+    typedef SFUintBN (*TOKENBALFUNC)(const SFAddress& token, const SFAddress& holder, blknum_t bn);
+
+    //--------------------------------------------------------------------------
+    // Reads an ERC20 Transfer(address,address,uint256) event (the event tokenlib promotes to
+    // QTransferEvent). Both the indexed and the older non-indexed layouts are accepted.
+    extern bool isTransferLog(const CLogEntry& log, SFAddress& from, SFAddress& to, SFUintBN& value);
+
+    //--------------------------------------------------------------------------
+    // ERC20 balances rebuilt from Transfer events in the local cache instead of one eth_call per
+    // (token, holder, block). Each holder of a watched token gets a CBalanceTimeline, so the
+    // balance at any block is answered from memory. Tokens that mint or burn without emitting
+    // Transfer events drift from the contract; 'validate' samples holders against the node and
+    // corrects the ones that disagree.
+    //--------------------------------------------------------------------------
+    class CTokenBalances {
+    public:
+        uint64_t interval;          // checkpoint spacing for new timelines
+
+                 CTokenBalances (void);
+
+        void     clear          (void);
+        bool     watchToken     (const SFAddress& token);
+        bool     isWatched      (const SFAddress& token) const;
+        size_t   nHolders       (const SFAddress& token) const;
+        uint64_t nTransfers     (const SFAddress& token) const;
+
+        bool     applyLog       (const CLogEntry& log, blknum_t bn);
+        void     applyBlock     (const CBlock& block);
+        size_t   loadToken      (const SFAddress& token, const CLogIndex& index, blknum_t lastBlock = NOPOS);
+
+        bool     getBalance     (const SFAddress& token, const SFAddress& holder, blknum_t bn, SFUintBN& bal) const;
+        size_t   validate       (const SFAddress& token, blknum_t bn, size_t nSamples,
+                                    TOKENBALFUNC func, SFAddressArray& corrected);
+        const CBalanceTimeline *getTimeline(const SFAddress& token, const SFAddress& holder) const;
+
+    private:
+        class CTokenState {
+        public:
+            uint64_t                         nTransfers;
+            map<SFAddress, CBalanceTimeline> holders;
+            CTokenState(void) : nTransfers(0) { }
+        };
+        map<SFAddress, CTokenState> tokens;
+
+        void     addDelta       (CTokenState& state, const SFAddress& holder, blknum_t bn, const SFIntBN& delta);
+    };
+
+}  // namespace qblocks
@@ -91,8 +91,9 @@ bool CTreeNode::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> index;
-    archive >> prefixS;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(CTreeNode), 2);
+    fields >> index;
+    fields >> prefixS;
     finishParse();
     return true;
 }
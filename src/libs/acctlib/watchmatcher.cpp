@@ -0,0 +1,245 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include "watchmatcher.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    #define BLOOM_SHIFT  21             // each of the three bloom bits uses 21 bits of the hash
+    #define MIN_BLOOM    (1 << 12)
+    #define MAX_BLOOM    (1 << BLOOM_SHIFT)
+
+    //--------------------------------------------------------------------------
+    inline uint64_t slotIndex(uint64_t h, uint64_t mask) {
+        // re-mix so the table index is independent of the bloom bits
+        return (((h ^ (h >> 31)) * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+    }
+
+    //--------------------------------------------------------------------------
+    inline uint64_t nextPow2(uint64_t n) {
+        uint64_t ret = 1;
+        while (ret < n)
+            ret <<= 1;
+        return ret;
+    }
+
+    //--------------------------------------------------------------------------
+    CWatchMatcher::CWatchMatcher(void) {
+        tableMask = 0;
+        bloomMask = 0;
+        nEntries = 0;
+        nTested = nPassedBloom = nMatched = 0;
+    }
+
+    //--------------------------------------------------------------------------
+    size_t CWatchMatcher::compile(const CAccountWatchArray& watches) {
+        CBinAddressArray addrs;
+        addrs.reserve(watches.size());
+        for (size_t i = 0 ; i < watches.size() ; i++)
+            addrs.push_back(CBinAddress(watches[i].address));
+        return compile(addrs);
+    }
+
+    //--------------------------------------------------------------------------
+    // Returns the number of unique addresses. Hits report the index into the given array (the
+    // watch index). If an address is present more than once the first one wins.
+    size_t CWatchMatcher::compile(const CBinAddressArray& addrs) {
+        nEntries = 0;
+        nTested = nPassedBloom = nMatched = 0;
+
+        // a load factor of at most one half keeps probe sequences short
+        uint64_t cap = nextPow2(max((uint64_t)16, (uint64_t)addrs.size() * 2));
+        CSlot empty;
+        empty.watch = NO_WATCH;
+        table.assign(cap, empty);
+        tableMask = cap - 1;
+
+        // sixteen bits per address with three probes is well under a one percent false
+        // positive rate, capped so the bloom stays in the second level cache
+        uint64_t bits = min((uint64_t)MAX_BLOOM, max((uint64_t)MIN_BLOOM, nextPow2(addrs.size() * 16)));
+        bloom.assign(bits / 64, 0);
+        bloomMask = bits - 1;
+
+        for (size_t i = 0 ; i < addrs.size() ; i++) {
+            const CBinAddress& addr = addrs[i];
+            uint64_t h = addr.hash();
+            uint64_t slot = slotIndex(h, tableMask);
+            while (table[slot].watch != NO_WATCH && table[slot].addr != addr)
+                slot = (slot + 1) & tableMask;
+            if (table[slot].watch != NO_WATCH)
+                continue;
+            table[slot].addr = addr;
+            table[slot].watch = (uint32_t)i;
+            for (size_t k = 0 ; k < 3 ; k++) {
+                uint64_t bit = (h >> (k * BLOOM_SHIFT)) & bloomMask;
+                bloom[bit >> 6] |= (1ULL << (bit & 63));
+            }
+            nEntries++;
+        }
+        return nEntries;
+    }
+
+    //--------------------------------------------------------------------------
+    inline bool CWatchMatcher::inBloom(uint64_t h) const {
+        uint64_t b0 = h & bloomMask;
+        uint64_t b1 = (h >> BLOOM_SHIFT) & bloomMask;
+        uint64_t b2 = (h >> (2 * BLOOM_SHIFT)) & bloomMask;
+        return ((bloom[b0 >> 6] >> (b0 & 63)) & (bloom[b1 >> 6] >> (b1 & 63)) & (bloom[b2 >> 6] >> (b2 & 63)) & 1);
+    }
+
+    //--------------------------------------------------------------------------
+    inline size_t CWatchMatcher::probe(const CBinAddress& addr, uint64_t h) const {
+        uint64_t slot = slotIndex(h, tableMask);
+        while (table[slot].watch != NO_WATCH) {
+            if (table[slot].addr == addr)
+                return table[slot].watch;
+            slot = (slot + 1) & tableMask;
+        }
+        return NOPOS;
+    }
+
+    //--------------------------------------------------------------------------
+    size_t CWatchMatcher::find(const CBinAddress& addr) {
+        if (!nEntries)
+            return NOPOS;
+        nTested++;
+        uint64_t h = addr.hash();
+        if (!inBloom(h))
+            return NOPOS;
+        nPassedBloom++;
+        size_t ret = probe(addr, h);
+        if (ret != NOPOS)
+            nMatched++;
+        return ret;
+    }
+
+    //--------------------------------------------------------------------------
+    // Tests many addresses at once. On return hits[i] is the index of the watch matching
+    // addrs[i] or NO_WATCH. The work is done in passes over flat arrays (hash, bloom test,
+    // prefetch, probe) rather than one address at a time. The first two passes are branch
+    // free, which lets the compiler vectorize them, and the table is only touched for the
+    // few addresses that pass the bloom, with their slots already on the way into cache.
+    size_t CWatchMatcher::matchBatch(const CBinAddress *addrs, size_t n, vector<uint32_t>& hits) {
+        hits.assign(n, NO_WATCH);
+        if (!nEntries || !n)
+            return 0;
+
+        hashBuf.resize(n);
+        passBuf.resize(n);
+        uint64_t *hashes = hashBuf.data();
+        uint8_t *pass = passBuf.data();
+
+        for (size_t i = 0 ; i < n ; i++)
+            hashes[i] = addrs[i].hash();
+
+        size_t nPass = 0;
+        for (size_t i = 0 ; i < n ; i++) {
+            pass[i] = (uint8_t)inBloom(hashes[i]);
+            nPass += pass[i];
+        }
+        nTested += n;
+        nPassedBloom += nPass;
+        if (!nPass)
+            return 0;
+
+        for (size_t i = 0 ; i < n ; i++)
+            if (pass[i])
+                __builtin_prefetch(&table[slotIndex(hashes[i], tableMask)]);
+
+        size_t nHits = 0;
+        for (size_t i = 0 ; i < n ; i++) {
+            if (pass[i]) {
+                size_t w = probe(addrs[i], hashes[i]);
+                if (w != NOPOS) {
+                    hits[i] = (uint32_t)w;
+                    nHits++;
+                }
+            }
+        }
+        nMatched += nHits;
+        return nHits;
+    }
+
+    //--------------------------------------------------------------------------
+    inline void addAddr(CBinAddressArray& addrs, vector<uint32_t>& trans, const SFAddress& addr, size_t tr) {
+        if (addr.empty())
+            return;
+        addrs.push_back(CBinAddress(addr));
+        trans.push_back((uint32_t)tr);
+    }
+
+    //--------------------------------------------------------------------------
+    // Collects every address in the block (senders, recipients, created contracts, the miner
+    // and, if present, the addresses in the traces) and reports each watch hit once per
+    // transaction, in transaction order.
+    size_t CWatchMatcher::matchBlock(const CBlock& block, CWatchHitArray& hits, bool useTraces) {
+        hits.clear();
+        addrBuf.clear();
+        transBuf.clear();
+
+        addAddr(addrBuf, transBuf, block.miner, NO_WATCH);
+        for (size_t i = 0 ; i < block.transactions.size() ; i++) {
+            const CTransaction *trans = &block.transactions[i];
+            addAddr(addrBuf, transBuf, trans->from, i);
+            addAddr(addrBuf, transBuf, trans->to, i);
+            addAddr(addrBuf, transBuf, trans->receipt.contractAddress, i);
+            if (useTraces) {
+                for (size_t t = 0 ; t < trans->traces.size() ; t++) {
+                    const CTrace *trace = &trans->traces[t];
+                    addAddr(addrBuf, transBuf, trace->action.from, i);
+                    addAddr(addrBuf, transBuf, trace->action.to, i);
+                    addAddr(addrBuf, transBuf, trace->action.address, i);
+                    addAddr(addrBuf, transBuf, trace->action.refundAddress, i);
+                    addAddr(addrBuf, transBuf, trace->result.address, i);
+                }
+            }
+        }
+
+        if (!matchBatch(addrBuf.data(), addrBuf.size(), hitBuf))
+            return 0;
+
+        for (size_t i = 0 ; i < hitBuf.size() ; i++) {
+            if (hitBuf[i] == NO_WATCH)
+                continue;
+            size_t tr = (transBuf[i] == NO_WATCH ? NOPOS : transBuf[i]);
+            bool dup = false;
+            for (size_t j = hits.size() ; j > 0 && hits[j-1].trans == tr && !dup ; j--)
+                dup = (hits[j-1].watch == hitBuf[i]);
+            if (!dup)
+                hits.push_back(CWatchHit(hitBuf[i], tr));
+        }
+        return hits.size();
+    }
+
+    //--------------------------------------------------------------------------
+    // Matches a block in the cache. A compressed block carries a table of its unique addresses,
+    // which is matched first: if none of them is watched the block is neither decompressed nor
+    // parsed and 'block' is left empty, even if it held an earlier block. Otherwise (or for a
+    // block without the table) the block is read, reusing the memory of any earlier block, and
+    // matched as usual.
+    size_t CWatchMatcher::matchCachedBlock(const string_q& fileName, CBlock& block, CWatchHitArray& hits,
+                                            bool useTraces) {
+        hits.clear();
+        if (readBlockAddresses(fileName, tableBuf) && !matchBatch(tableBuf.data(), tableBuf.size(), hitBuf)) {
+            block = CBlock();
+            return 0;
+        }
+        block.resetForRead();
+        if (!readBlockFromBinary(block, fileName)) {
+            block = CBlock();
+            return 0;
+        }
+        return matchBlock(block, hits, useTraces);
+    }
+
+}  // namespace qblocks
@@ -0,0 +1,84 @@
+#pragma once
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <vector>
+#include "etherlib.h"
+#include "accountwatch.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    #define NO_WATCH ((uint32_t)-1)
+
+    //--------------------------------------------------------------------------
+    // A watch that was hit by an address in a block. 'trans' is the index of the transaction
+    // in the block (NOPOS for the miner).
+    class CWatchHit {
+    public:
+        size_t watch;
+        size_t trans;
+        CWatchHit(void) : watch(NOPOS), trans(NOPOS) { }
+        CWatchHit(size_t w, size_t t) : watch(w), trans(t) { }
+    };
+    typedef vector<CWatchHit> CWatchHitArray;
+
+    //--------------------------------------------------------------------------
+    // Compiles a watch list into an open addressing hash set keyed by the binary address and
+    // a prefilter bloom sized to stay in cache. Lookups check the bloom first, so the great
+    // majority of addresses (those not watched) never touch the table.
+    //--------------------------------------------------------------------------
+    class CWatchMatcher {
+    public:
+        // statistics since the last call to compile
+        uint64_t nTested;
+        uint64_t nPassedBloom;
+        uint64_t nMatched;
+
+                 CWatchMatcher  (void);
+
+        size_t   compile        (const CAccountWatchArray& watches);
+        size_t   compile        (const CBinAddressArray& addrs);
+        size_t   size           (void) const { return nEntries; }
+
+        size_t   find           (const CBinAddress& addr);
+        size_t   find           (const SFAddress& addr) { return find(CBinAddress(addr)); }
+        size_t   matchBatch     (const CBinAddress *addrs, size_t n, vector<uint32_t>& hits);
+        size_t   matchBlock     (const CBlock& block, CWatchHitArray& hits, bool useTraces = true);
+        size_t   matchCachedBlock(const string_q& fileName, CBlock& block, CWatchHitArray& hits,
+                                    bool useTraces = true);
+
+    private:
+        class CSlot {
+        public:
+            CBinAddress addr;
+            uint32_t    watch;  // NO_WATCH if unused
+        };
+        vector<CSlot>    table;
+        vector<uint64_t> bloom;
+        uint64_t         tableMask;
+        uint64_t         bloomMask;
+        size_t           nEntries;
+
+        // scratch space, kept to avoid reallocating for every block
+        CBinAddressArray addrBuf;
+        vector<uint32_t> transBuf;
+        vector<uint32_t> hitBuf;
+        vector<uint64_t> hashBuf;
+        vector<uint8_t>  passBuf;
+        CBinAddressArray tableBuf;
+
+        bool     inBloom        (uint64_t h) const;
+        size_t   probe          (const CBinAddress& addr, uint64_t h) const;
+    };
+
+}  // namespace qblocks
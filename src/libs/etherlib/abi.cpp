@@ -110,8 +110,9 @@ bool CAbi::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> abiByName;
-    archive >> abiByEncoding;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(CAbi), 2);
+    fields >> abiByName;
+    fields >> abiByEncoding;
     finishParse();
     return true;
 }
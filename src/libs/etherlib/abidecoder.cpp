@@ -0,0 +1,455 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include "abidecoder.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    static const uint8_t zeroWord[32] = { 0 };
+    static const char   *hexChars = "0123456789abcdef";
+
+    //--------------------------------------------------------------------------
+    inline int hexVal(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    //--------------------------------------------------------------------------
+    static string_q bytesToHex(const uint8_t *b, size_t n) {
+        string_q ret(n * 2, '0');
+        for (size_t i = 0 ; i < n ; i++) {
+            ret[i * 2]     = hexChars[b[i] >> 4];
+            ret[i * 2 + 1] = hexChars[b[i] & 0x0f];
+        }
+        return ret;
+    }
+
+    //--------------------------------------------------------------------------
+    static bool readSelector(const char *s, size_t n, uint32_t& sel) {
+        if (n < 8)
+            return false;
+        sel = 0;
+        for (size_t i = 0 ; i < 8 ; i++) {
+            int v = hexVal(s[i]);
+            if (v < 0)
+                return false;
+            sel = (sel << 4) | (uint32_t)v;
+        }
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    bool toSelector(const string_q& hexIn, uint32_t& sel) {
+        const char *s = hexIn.c_str();
+        size_t n = hexIn.length();
+        if (n > 1 && s[0] == '0' && s[1] == 'x') {
+            s += 2;
+            n -= 2;
+        }
+        return readSelector(s, n, sel);
+    }
+
+    //--------------------------------------------------------------------------
+    uint32_t topicSelector(const SFUintBN& topic) {
+        return (uint32_t)(topic.getBlock(3) >> 32);
+    }
+
+    //--------------------------------------------------------------------------
+    bool isTopic(const SFUintBN& topic, const uint64_t hash[4]) {
+        return topic.getBlock(3) == hash[0] &&
+                topic.getBlock(2) == hash[1] &&
+                topic.getBlock(1) == hash[2] &&
+                topic.getBlock(0) == hash[3];
+    }
+
+    //--------------------------------------------------------------------------
+    SFAddress topicAddress(const SFUintBN& topic) {
+        CAbiData data;
+        data.bytes.resize(32);
+        for (size_t b = 0 ; b < 4 ; b++) {
+            uint64_t v = topic.getBlock((unsigned int)(3 - b));
+            for (size_t j = 0 ; j < 8 ; j++)
+                data.bytes[b * 8 + j] = (uint8_t)(v >> (56 - j * 8));
+        }
+        return data.getAddress(0);
+    }
+
+    //--------------------------------------------------------------------------
+    bool CAbiData::fromHex(const char *s, size_t n) {
+        size_t nBytes = n / 2;
+        bytes.resize(((nBytes + 31) / 32) * 32);  // pad to a whole number of words
+        for (size_t i = 0 ; i < nBytes ; i++) {
+            int hi = hexVal(s[i * 2]), lo = hexVal(s[i * 2 + 1]);
+            if (hi < 0 || lo < 0) {
+                bytes.clear();
+                return false;
+            }
+            bytes[i] = (uint8_t)((hi << 4) | lo);
+        }
+        for (size_t i = nBytes ; i < bytes.size() ; i++)
+            bytes[i] = 0;
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    bool CAbiData::fromInput(const string_q& input) {
+        const char *s = input.c_str();
+        size_t n = input.length();
+        if (n > 1 && s[0] == '0' && s[1] == 'x') {
+            s += 2;
+            n -= 2;
+        }
+        selector = 0;
+        bytes.clear();
+        if (!readSelector(s, n, selector))
+            return false;
+        return fromHex(s + 8, n - 8);
+    }
+
+    //--------------------------------------------------------------------------
+    bool CAbiData::fromData(const string_q& data) {
+        const char *s = data.c_str();
+        size_t n = data.length();
+        if (n > 1 && s[0] == '0' && s[1] == 'x') {
+            s += 2;
+            n -= 2;
+        }
+        selector = 0;
+        return fromHex(s, n);
+    }
+
+    //--------------------------------------------------------------------------
+    const uint8_t *CAbiData::word(size_t i) const {
+        if (i >= nWords())
+            return zeroWord;
+        return &bytes[i * 32];
+    }
+
+    //--------------------------------------------------------------------------
+    SFAddress CAbiData::getAddress(size_t i) const {
+        // same as toAddress: shortened only if the leading twelve bytes are zero
+        const uint8_t *w = word(i);
+        if (!memcmp(w, zeroWord, 12))
+            return "0x" + bytesToHex(w + 12, 20);
+        return "0x" + bytesToHex(w, 32);
+    }
+
+    //--------------------------------------------------------------------------
+    SFUintBN CAbiData::getUint(size_t i) const {
+        const uint8_t *w = word(i);
+        uint64_t blocks[4];
+        for (size_t b = 0 ; b < 4 ; b++) {
+            const uint8_t *p = w + (3 - b) * 8;  // the least significant block comes first
+            uint64_t v = 0;
+            for (size_t j = 0 ; j < 8 ; j++)
+                v = (v << 8) | p[j];
+            blocks[b] = v;
+        }
+        return SFUintBN(blocks, 4);
+    }
+
+    //--------------------------------------------------------------------------
+    uint64_t CAbiData::getUint64(size_t i) const {
+        const uint8_t *w = word(i);
+        if (memcmp(w, zeroWord, 24))
+            return NOPOS;
+        uint64_t v = 0;
+        for (size_t j = 24 ; j < 32 ; j++)
+            v = (v << 8) | w[j];
+        return v;
+    }
+
+    //--------------------------------------------------------------------------
+    int64_t CAbiData::getInt64(size_t i) const {
+        const uint8_t *w = word(i);
+        uint64_t v = 0;
+        for (size_t j = 24 ; j < 32 ; j++)
+            v = (v << 8) | w[j];
+        return (int64_t)v;
+    }
+
+    //--------------------------------------------------------------------------
+    bool CAbiData::getBool(size_t i) const {
+        return memcmp(word(i), zeroWord, 32) != 0;
+    }
+
+    //--------------------------------------------------------------------------
+    string_q CAbiData::getWordHex(size_t i) const {
+        return bytesToHex(word(i), 32);
+    }
+
+    //--------------------------------------------------------------------------
+    string_q CAbiData::getTailHex(size_t i) const {
+        if (i >= nWords())
+            return "";
+        return bytesToHex(&bytes[i * 32], bytes.size() - i * 32);
+    }
+
+    //--------------------------------------------------------------------------
+    // The value of a dynamic type is found at the offset stored in its head word. It starts with
+    // its length. Returns the byte position of the value and its length clamped to the data.
+    bool CAbiData::getDynamic(size_t i, size_t& start, size_t& len) const {
+        start = len = 0;
+        uint64_t offset = getUint64(i);
+        if (offset == NOPOS || offset / 32 >= nWords())
+            return false;
+        size_t lenWord = offset / 32;
+        start = (lenWord + 1) * 32;
+        len = getUint64(lenWord);
+        if (start > bytes.size())
+            start = bytes.size();
+        if (len > bytes.size() - start)
+            len = bytes.size() - start;
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    string_q CAbiData::getString(size_t i) const {
+        size_t start, len;
+        if (!getDynamic(i, start, len) || len == 0)
+            return "";
+        return string_q((const char*)&bytes[start], len);
+    }
+
+    //--------------------------------------------------------------------------
+    // A dynamic array is stored like a string, but its length counts words instead of bytes.
+    bool CAbiData::getArray(size_t i, size_t& first, size_t& count) const {
+        first = count = 0;
+        uint64_t offset = getUint64(i);
+        if (offset == NOPOS || offset / 32 >= nWords())
+            return false;
+        first = offset / 32 + 1;
+        count = getUint64(offset / 32);
+        if (count > nWords() - first)
+            count = nWords() - first;
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    CAbiDecoder::CAbiDecoder(void) : mask(0) {
+    }
+
+    //--------------------------------------------------------------------------
+    CAbiDecoder::~CAbiDecoder(void) {
+        clear();
+    }
+
+    //--------------------------------------------------------------------------
+    void CAbiDecoder::clear(void) {
+        for (size_t i = 0 ; i < funcs.size() ; i++)
+            delete funcs[i];
+        funcs.clear();
+        table.clear();
+        mask = 0;
+    }
+
+    //--------------------------------------------------------------------------
+    bool CAbiDecoder::insert(uint32_t sel, CFunction *func) {
+        if ((funcs.size() + 1) * 2 > table.size()) {
+            // grow to keep the load at or below one half
+            vector<CSlot> old;
+            old.swap(table);
+            size_t size = (old.empty() ? 64 : old.size() * 2);
+            CSlot empty;
+            empty.sel = 0;
+            empty.idx = NO_FUNC;
+            table.resize(size, empty);
+            mask = (uint32_t)(size - 1);
+            for (size_t i = 0 ; i < old.size() ; i++) {
+                if (old[i].idx == NO_FUNC)
+                    continue;
+                uint32_t pos = old[i].sel & mask;
+                while (table[pos].idx != NO_FUNC)
+                    pos = (pos + 1) & mask;
+                table[pos] = old[i];
+            }
+        }
+
+        uint32_t pos = sel & mask;
+        while (table[pos].idx != NO_FUNC) {
+            if (table[pos].sel == sel)
+                return false;
+            pos = (pos + 1) & mask;
+        }
+        table[pos].sel = sel;
+        table[pos].idx = (uint32_t)funcs.size();
+        funcs.push_back(func);
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    bool CAbiDecoder::addFunction(const CFunction& func) {
+        // events carry a full 32-byte topic, not a selector, and are not kept here
+        uint32_t sel;
+        if (func.encoding.length() != 10 || !toSelector(func.encoding, sel))
+            return false;
+        if (find(sel))
+            return false;
+
+        // copied field by field, the copy constructor re-hashes the signature
+        CFunction *copy = new CFunction;
+        copy->name      = func.name;
+        copy->type      = func.type;
+        copy->anonymous = func.anonymous;
+        copy->constant  = func.constant;
+        copy->payable   = func.payable;
+        copy->signature = func.signature;
+        copy->encoding  = func.encoding;
+        copy->inputs    = func.inputs;
+        copy->outputs   = func.outputs;
+        copy->hasAddrs  = func.hasAddrs;
+        copy->isBuiltin = func.isBuiltin;
+        copy->origName  = func.origName;
+        return insert(sel, copy);
+    }
+
+    //--------------------------------------------------------------------------
+    size_t CAbiDecoder::addAbi(const CAbi& abi) {
+        size_t nAdded = 0;
+        for (size_t i = 0 ; i < abi.abiByEncoding.size() ; i++)
+            nAdded += addFunction(abi.abiByEncoding[i]);
+        return nAdded;
+    }
+
+    //--------------------------------------------------------------------------
+    // Adds a function from its canonical signature (for example 'transfer(address,uint256)')
+    // without needing to hash it.
+    bool CAbiDecoder::addSignature(uint32_t sel, const string_q& sig) {
+        if (find(sel))
+            return false;
+
+        CFunction *func = new CFunction;
+        func->type = "function";
+        func->signature = sig;
+        func->encoding = "0x" + padLeft(toLower(string_q(to_hex(SFUintBN((uint64_t)sel)).c_str())), 8, '0');
+
+        string_q params = sig;
+        func->name = nextTokenClear(params, '(');
+        params = substitute(params, ")", "");
+        while (!params.empty()) {
+            CParameter param;
+            param.type = nextTokenClear(params, ',');
+            param.name = "param_" + asStringU(func->inputs.size());
+            func->inputs.push_back(param);
+        }
+        return insert(sel, func);
+    }
+
+    //--------------------------------------------------------------------------
+    const CFunction *CAbiDecoder::find(uint32_t sel) const {
+        if (table.empty())
+            return NULL;
+        uint32_t pos = sel & mask;
+        while (table[pos].idx != NO_FUNC) {
+            if (table[pos].sel == sel)
+                return funcs[table[pos].idx];
+            pos = (pos + 1) & mask;
+        }
+        return NULL;
+    }
+
+    //--------------------------------------------------------------------------
+    const CFunction *CAbiDecoder::find(const string_q& input) const {
+        uint32_t sel;
+        if (!toSelector(input, sel))
+            return NULL;
+        return find(sel);
+    }
+
+    //--------------------------------------------------------------------------
+    CAbiDecoder *getAbiDecoder(void) {
+        static CAbiDecoder theDecoder;
+        return &theDecoder;
+    }
+
+    //--------------------------------------------------------------------------
+    static string_q escapeString(const uint8_t *b, size_t n) {
+        string_q ret;
+        ret.reserve(n);
+        for (size_t i = 0 ; i < n ; i++) {
+            char c = (char)b[i];
+            if (c == '\n')
+                ret += "\\n";
+            else if (c == '\"')
+                ret += "\\\"";
+            else if (c != '\r')
+                ret += c;
+        }
+        return ret;
+    }
+
+    //--------------------------------------------------------------------------
+    // Each value is formatted as 'parse' in transaction.cpp formats the same type
+    static string_q articulateValue(const string_q& t, const CAbiData& data, size_t item) {
+        bool isDynamic = (t == "string" || t == "bytes" || contains(t, "[]"));
+
+        if (t == "address") {
+            string_q hex = trimLeading(data.getWordHex(item), '0');
+            return "0x" + padLeft(hex, 40, '0');
+
+        } else if (t == "bool") {
+            return (data.getBool(item) ? "true" : "false");
+
+        } else if (t == "vote") {
+            return (data.getBool(item) ? "Yea" : "Nay");
+
+        } else if (t == "uint3") {
+            return padNum3(data.getUint64(item));
+
+        } else if (t == "bytes256") {
+            const uint8_t *w = data.word(item);
+            size_t i = 0;
+            while (i < 32 && !w[i])
+                i++;
+            return string_q((const char*)w + i, 32 - i);
+
+        } else if (contains(t, "int") && !isDynamic) {
+            return asStringBN(data.getUint(item));
+
+        } else if (contains(t, "bytes") && !isDynamic) {
+            return data.getWordHex(item);
+
+        } else if (isDynamic) {
+            size_t start, len;
+            data.getDynamic(item, start, len);
+            const uint8_t *b = (len ? &data.bytes[start] : zeroWord);
+            if (t == "string")
+                return "\"" + escapeString(b, len) + "\"";
+            return "0x" + bytesToHex(b, len);
+        }
+
+        return "unknown type: " + t;
+    }
+
+    //--------------------------------------------------------------------------
+    string_q articulate(const CFunction& func, const CAbiData& data) {
+        string_q ret = "[ \"" + func.name + "\", \"";
+        for (size_t i = 0 ; i < func.inputs.size() ; i++) {
+            if (i)
+                ret += "\", \"";
+            ret += articulateValue(func.inputs[i].type, data, i);
+        }
+        return ret + "\" ]";
+    }
+
+    //--------------------------------------------------------------------------
+    string_q articulate(const CFunction& func, const string_q& input) {
+        CAbiData data;
+        if (!data.fromInput(input))
+            return " ";
+        return articulate(func, data);
+    }
+
+}  // namespace qblocks
@@ -0,0 +1,115 @@
+#pragma once
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <vector>
+#include "abi.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    #define NO_FUNC ((uint32_t)-1)
+
+    //--------------------------------------------------------------------------
+    // The four byte selector at the front of a hex string (a transaction's input or an event's
+    // topic). Returns false if the string is too short or is not hex.
+    extern bool     toSelector    (const string_q& hexIn, uint32_t& sel);
+    extern uint32_t topicSelector (const SFUintBN& topic);
+
+    //--------------------------------------------------------------------------
+    // Compares a topic to a 32-byte hash held as four 64-bit words (most significant first). The
+    // generated libraries keep event signatures in this form so matching does not format the topic.
+    extern bool     isTopic       (const SFUintBN& topic, const uint64_t hash[4]);
+
+    //--------------------------------------------------------------------------
+    // An indexed address read from its topic (the same result as toAddress(fromTopic(topic))).
+    extern SFAddress topicAddress  (const SFUintBN& topic);
+
+    //--------------------------------------------------------------------------
+    // ABI encoded data, converted from hex to bytes once. Values are read directly from the
+    // 32-byte words instead of from substrings of the hex. Words past the end read as zero.
+    //--------------------------------------------------------------------------
+    class CAbiData {
+    public:
+        uint32_t        selector;
+        vector<uint8_t> bytes;     // the encoded parameters (the selector is not included)
+
+        CAbiData(void) : selector(0) { }
+
+        bool      fromInput   (const string_q& input);  // a transaction's input (selector first)
+        bool      fromData    (const string_q& data);   // a log's data (no selector)
+
+        size_t    nWords      (void) const { return bytes.size() / 32; }
+        const uint8_t *word   (size_t i) const;
+
+        SFAddress getAddress  (size_t i) const;
+        SFUintBN  getUint     (size_t i) const;
+        uint64_t  getUint64   (size_t i) const;  // NOPOS if the value does not fit
+        int64_t   getInt64    (size_t i) const;  // the low 64 bits, sign extended
+        bool      getBool     (size_t i) const;
+        string_q  getWordHex  (size_t i) const;  // the word as 64 hex characters (no '0x')
+        string_q  getTailHex  (size_t i) const;  // every byte from the i-th word on (no '0x')
+        bool      getDynamic  (size_t i, size_t& start, size_t& len) const;
+        string_q  getString   (size_t i) const;
+        bool      getArray    (size_t i, size_t& first, size_t& count) const;  // in words
+
+    private:
+        bool      fromHex     (const char *s, size_t n);
+    };
+
+    //--------------------------------------------------------------------------
+    // Every known function keyed by its four byte selector in an open addressing hash table.
+    // Selectors are the leading bytes of a hash, so they are used as their own hash. When two
+    // ABIs share a selector the first one loaded wins. The table owns copies of the functions,
+    // so pointers returned by 'find' remain valid until 'clear' is called.
+    //--------------------------------------------------------------------------
+    class CAbiDecoder {
+    public:
+                 CAbiDecoder  (void);
+                 ~CAbiDecoder (void);
+
+        void     clear        (void);
+        size_t   addAbi       (const CAbi& abi);
+        bool     addFunction  (const CFunction& func);
+        bool     addSignature (uint32_t sel, const string_q& sig);
+        size_t   size         (void) const { return funcs.size(); }
+
+        const CFunction *find (uint32_t sel) const;
+        const CFunction *find (const string_q& input) const;
+
+    private:
+        class CSlot {
+        public:
+            uint32_t sel;
+            uint32_t idx;  // NO_FUNC if unused
+        };
+        vector<CFunction*> funcs;
+        vector<CSlot>      table;
+        uint32_t           mask;
+
+        bool     insert       (uint32_t sel, CFunction *func);
+
+        CAbiDecoder(const CAbiDecoder&);
+        CAbiDecoder& operator=(const CAbiDecoder&);
+    };
+
+    //--------------------------------------------------------------------------
+    // The process-wide table. Libraries register their functions when they are initialized.
+    extern CAbiDecoder *getAbiDecoder(void);
+
+    //--------------------------------------------------------------------------
+    // Produces the articulated form of a call: [ "name", "param1", "param2", ... ]. This is only
+    // done when a display asks for it, never while scanning.
+    extern string_q articulate(const CFunction& func, const CAbiData& data);
+    extern string_q articulate(const CFunction& func, const string_q& input);
+
+}  // namespace qblocks
@@ -15,3 +15,5 @@
 #include "parameter.h"
 #include "function.h"
 #include "abi.h"
+#include "abidecoder.h"
+#include "abistore.h"
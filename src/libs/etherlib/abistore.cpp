@@ -0,0 +1,356 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <algorithm>
+#include "abistore.h"
+#include "abidecoder.h"
+#include "node.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    static const char storeMagic[8] = { 'Q', 'B', 'A', 'B', 'I', 'S', 'T', '2' };
+
+    //--------------------------------------------------------------------------
+    // FNV-1a. Only used to notice that a source file has changed.
+    uint64_t abiSourceHash(const string_q& contents) {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (size_t i = 0 ; i < contents.length() ; i++) {
+            h ^= (uint8_t)contents[i];
+            h *= 0x100000001b3ULL;
+        }
+        return h;
+    }
+
+    //--------------------------------------------------------------------------
+    // Tells whether a source file has changed without reading it. Zero if there is no such file.
+    uint64_t abiSourceStamp(const string_q& fileName) {
+        struct stat statBuf;
+        if (stat(fileName.c_str(), &statBuf) != 0)
+            return 0;
+        uint64_t parts[3] = { (uint64_t)statBuf.st_size, (uint64_t)statBuf.st_mtime, (uint64_t)statBuf.st_ino };
+        return abiSourceHash(string_q((const char*)parts, sizeof(parts)));  // NOLINT
+    }
+
+    //--------------------------------------------------------------------------
+    string_q abiStorePath(void) {
+        return blockCachePath("abis/compiled.bin");
+    }
+
+    //--------------------------------------------------------------------------
+    CAbiStore::CAbiStore(void)
+        : mapped(NULL), pEntries(NULL), pFuncs(NULL), pParams(NULL), pChars(NULL) {
+        bzero(&header, sizeof(header));
+    }
+
+    //--------------------------------------------------------------------------
+    CAbiStore::~CAbiStore(void) {
+        close();
+    }
+
+    //--------------------------------------------------------------------------
+    void CAbiStore::close(void) {
+        if (mapped)
+            delete mapped;
+        mapped   = NULL;
+        pEntries = NULL;
+        pFuncs   = NULL;
+        pParams  = NULL;
+        pChars   = NULL;
+        bzero(&header, sizeof(header));
+        staged.clear();
+    }
+
+    //--------------------------------------------------------------------------
+    size_t CAbiStore::size(void) const {
+        size_t ret = staged.size();
+        for (size_t i = 0 ; i < header.nEntries ; i++)
+            ret += (staged.find(pChars + pEntries[i].key) == staged.end());
+        return ret;
+    }
+
+    //--------------------------------------------------------------------------
+    static bool checkHeader(const CAbiStoreHeader& header, uint64_t fileSz) {
+        if (memcmp(header.magic, storeMagic, sizeof(storeMagic)))
+            return false;
+        uint64_t expected = sizeof(CAbiStoreHeader) +
+                                (uint64_t)header.nEntries * sizeof(CAbiStoreEntry) +
+                                (uint64_t)header.nFuncs * sizeof(CStoredFunction) +
+                                (uint64_t)header.nParams * sizeof(CStoredParameter) +
+                                header.nChars;
+        return (expected == fileSz && header.nChars > 0);
+    }
+
+    //--------------------------------------------------------------------------
+    // Maps the store read only. A missing or damaged file leaves the store empty.
+    bool CAbiStore::open(const string_q& fileName) {
+        close();
+        if (!fileExists(fileName) || fileSize(fileName) < sizeof(CAbiStoreHeader))
+            return false;
+
+        CMemMapFile *mm = new CMemMapFile(fileName, CMemMapFile::WholeFile, CMemMapFile::RandomAccess);
+        if (!mm->isValid() || mm->size() < sizeof(CAbiStoreHeader)) {
+            delete mm;
+            return false;
+        }
+
+        const unsigned char *base = mm->getData();
+        memcpy(&header, base, sizeof(header));
+        if (!checkHeader(header, mm->size())) {
+            bzero(&header, sizeof(header));
+            delete mm;
+            return false;
+        }
+
+        mapped   = mm;
+        pEntries = reinterpret_cast<const CAbiStoreEntry*>(base + sizeof(CAbiStoreHeader));
+        pFuncs   = reinterpret_cast<const CStoredFunction*>(pEntries + header.nEntries);
+        pParams  = reinterpret_cast<const CStoredParameter*>(pFuncs + header.nFuncs);
+        pChars   = reinterpret_cast<const char*>(pParams + header.nParams);
+        if (pChars[header.nChars - 1] != '\0')  // every string must end inside the table
+            close();
+        return (mapped != NULL);
+    }
+
+    //--------------------------------------------------------------------------
+    const CAbiStoreEntry *CAbiStore::findEntry(const string_q& key) const {
+        size_t lo = 0, hi = header.nEntries;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            int cmp = strcmp(pChars + pEntries[mid].key, key.c_str());
+            if (cmp == 0)
+                return &pEntries[mid];
+            if (cmp < 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return NULL;
+    }
+
+    //--------------------------------------------------------------------------
+    // The encoding and signature are copied from the store, so copying the function later does
+    // not hash the signature again (see CFunction::finishParse).
+    void CAbiStore::readFunction(const CStoredFunction& sf, CFunction& func) const {
+        func.name      = pChars + sf.name;
+        func.type      = pChars + sf.type;
+        func.anonymous = (sf.flags & STORE_ANONYMOUS);
+        func.constant  = (sf.flags & STORE_CONSTANT);
+        func.payable   = (sf.flags & STORE_PAYABLE);
+        func.signature = pChars + sf.signature;
+        func.encoding  = pChars + sf.encoding;
+        func.inputs.reserve(sf.nInputs);
+        func.outputs.reserve(sf.nOutputs);
+        for (size_t i = 0 ; i < (size_t)sf.nInputs + sf.nOutputs ; i++) {
+            const CStoredParameter *sp = &pParams[sf.firstParam + i];
+            CParameter param;
+            param.name      = pChars + sp->name;
+            param.type      = pChars + sp->type;
+            param.indexed   = (sp->flags & STORE_INDEXED);
+            param.isPointer = (sp->flags & STORE_POINTER);
+            param.isArray   = (sp->flags & STORE_ARRAY);
+            param.isObject  = (sp->flags & STORE_OBJECT);
+            if (i < sf.nInputs) {
+                func.inputs.push_back(param);
+                func.hasAddrs |= (param.type == "address");
+            } else {
+                func.outputs.push_back(param);
+            }
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    bool CAbiStore::find(const string_q& key, uint64_t srcHash, CAbi& abi) const {
+        map<string_q, CStaged>::const_iterator it = staged.find(key);
+        if (it != staged.end()) {
+            if (it->second.srcHash != srcHash)
+                return false;
+            abi.abiByName = it->second.funcs;
+
+        } else {
+            const CAbiStoreEntry *entry = findEntry(key);
+            if (!entry || entry->srcHash != srcHash ||
+                (uint64_t)entry->firstFunc + entry->nFuncs > header.nFuncs)
+                return false;
+            // constructed in place, a copy of an empty function would hash its signature
+            abi.abiByName.clear();
+            abi.abiByName.resize(entry->nFuncs);
+            for (size_t i = 0 ; i < entry->nFuncs ; i++) {
+                const CStoredFunction *sf = &pFuncs[entry->firstFunc + i];
+                if ((uint64_t)sf->firstParam + sf->nInputs + sf->nOutputs > header.nParams)
+                    return false;
+                readFunction(*sf, abi.abiByName[i]);
+            }
+        }
+
+        // functions are stored in name order
+        abi.abiByEncoding = abi.abiByName;
+        sort(abi.abiByEncoding.begin(), abi.abiByEncoding.end());  // encoding is default sort
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    void CAbiStore::add(const string_q& key, uint64_t srcHash, const CAbi& abi) {
+        CStaged& item = staged[key];
+        item.srcHash = srcHash;
+        item.funcs = abi.abiByName;
+    }
+
+    //--------------------------------------------------------------------------
+    // Collects strings into the table, storing each one only once.
+    class CStringTable {
+    public:
+        string_q                  chars;
+        map<string_q, uint32_t>   offsets;
+        uint32_t add(const string_q& str) {
+            map<string_q, uint32_t>::iterator it = offsets.find(str);
+            if (it != offsets.end())
+                return it->second;
+            uint32_t off = (uint32_t)chars.length();
+            chars.append(str.c_str(), str.length() + 1);  // including the terminator
+            offsets[str] = off;
+            return off;
+        }
+    };
+
+    //--------------------------------------------------------------------------
+    static void compileFunction(const CFunction& func, CStringTable& strings,
+                                    vector<CStoredFunction>& funcs, vector<CStoredParameter>& params) {
+        CStoredFunction sf;
+        bzero(&sf, sizeof(sf));
+        sf.name       = strings.add(func.name);
+        sf.type       = strings.add(func.type);
+        sf.signature  = strings.add(func.signature);
+        sf.encoding   = strings.add(func.encoding);
+        sf.flags      = (func.anonymous ? STORE_ANONYMOUS : 0) |
+                            (func.constant ? STORE_CONSTANT : 0) |
+                            (func.payable ? STORE_PAYABLE : 0);
+        sf.firstParam = (uint32_t)params.size();
+        sf.nInputs    = (uint16_t)func.inputs.size();
+        sf.nOutputs   = (uint16_t)func.outputs.size();
+        toSelector(func.encoding, sf.selector);
+        CAbiData hash;
+        if (hash.fromData(func.encoding) && hash.nWords())
+            memcpy(sf.topic, hash.word(0), sizeof(sf.topic));
+        funcs.push_back(sf);
+
+        for (size_t i = 0 ; i < (size_t)sf.nInputs + sf.nOutputs ; i++) {
+            const CParameter *p = (i < sf.nInputs ? &func.inputs[i] : &func.outputs[i - sf.nInputs]);
+            CStoredParameter sp;
+            sp.name  = strings.add(p->name);
+            sp.type  = strings.add(p->type);
+            sp.flags = (p->indexed ? STORE_INDEXED : 0) |
+                            (p->isPointer ? STORE_POINTER : 0) |
+                            (p->isArray ? STORE_ARRAY : 0) |
+                            (p->isObject ? STORE_OBJECT : 0);
+            params.push_back(sp);
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    // Writes every entry (those in the mapped file that were not replaced and those added since
+    // it was opened) to a new file and then moves it into place, so a mapped copy stays valid.
+    bool CAbiStore::write(const string_q& fileName) const {
+        CStringTable strings;
+        vector<CAbiStoreEntry> entries;
+        vector<CStoredFunction> funcs;
+        vector<CStoredParameter> params;
+
+        // both lists are sorted by key, so merging them keeps the entries sorted
+        map<string_q, CStaged>::const_iterator it = staged.begin();
+        size_t m = 0;
+        while (m < header.nEntries || it != staged.end()) {
+            const char *mappedKey = (m < header.nEntries ? pChars + pEntries[m].key : NULL);
+            bool useMapped = mappedKey && (it == staged.end() || strcmp(mappedKey, it->first.c_str()) < 0);
+            if (mappedKey && it != staged.end() && it->first == mappedKey) {
+                m++;  // replaced by the staged copy
+                continue;
+            }
+
+            CAbiStoreEntry entry;
+            bzero(&entry, sizeof(entry));
+            entry.firstFunc = (uint32_t)funcs.size();
+            if (useMapped) {
+                const CAbiStoreEntry *src = &pEntries[m++];
+                entry.srcHash = src->srcHash;
+                entry.key = strings.add(pChars + src->key);
+                for (size_t i = 0 ; i < src->nFuncs ; i++) {
+                    CFunction func;
+                    readFunction(pFuncs[src->firstFunc + i], func);
+                    compileFunction(func, strings, funcs, params);
+                }
+            } else {
+                entry.srcHash = it->second.srcHash;
+                entry.key = strings.add(it->first);
+                for (size_t i = 0 ; i < it->second.funcs.size() ; i++)
+                    compileFunction(it->second.funcs[i], strings, funcs, params);
+                ++it;
+            }
+            entry.nFuncs = (uint32_t)funcs.size() - entry.firstFunc;
+            entries.push_back(entry);
+        }
+        if (strings.chars.empty())
+            strings.add("");
+
+        string_q created;
+        if (!establishFolder(fileName, created))
+            return false;
+
+        // two processes may be adding ABIs at once, each writes its own copy
+        string_q tmpName = fileName + "." + asStringU((uint64_t)getpid()) + ".tmp";
+        CBinFile file;
+        if (!file.Lock(tmpName, binaryWriteCreate, LOCK_CREATE))
+            return false;
+
+        CAbiStoreHeader hdr;
+        bzero(&hdr, sizeof(hdr));
+        memcpy(hdr.magic, storeMagic, sizeof(hdr.magic));
+        hdr.nEntries = (uint32_t)entries.size();
+        hdr.nFuncs   = (uint32_t)funcs.size();
+        hdr.nParams  = (uint32_t)params.size();
+        hdr.nChars   = (uint32_t)strings.chars.length();
+        file.Write(&hdr, sizeof(hdr), 1);
+        file.Write(entries.data(), sizeof(CAbiStoreEntry), entries.size());
+        file.Write(funcs.data(), sizeof(CStoredFunction), funcs.size());
+        file.Write(params.data(), sizeof(CStoredParameter), params.size());
+        file.Write(strings.chars.c_str(), 1, strings.chars.length());
+        file.Release();
+        return (::rename(tmpName.c_str(), fileName.c_str()) == 0);
+    }
+
+    //--------------------------------------------------------------------------
+    // ABIs with the same file name in different folders are different ABIs, so the store is
+    // keyed by the full path
+    bool loadAbiCompiled(CAbi& abi, const string_q& jsonFile, CAbiStore *store) {
+        uint64_t stamp = abiSourceStamp(jsonFile);
+        if (!stamp || !fileSize(jsonFile))
+            return false;
+
+        string_q key = CFilename(jsonFile).getFullPath();
+        CAbiStore single;
+        if (!store) {
+            single.open(abiStorePath());
+            store = &single;
+        }
+        if (store->find(key, stamp, abi))
+            return true;
+
+        // not compiled yet (or the source changed): parse the JSON and add it to the store
+        if (!abi.loadABIFromFile(jsonFile))
+            return false;
+        store->add(key, stamp, abi);
+        if (store == &single)
+            single.write(abiStorePath());
+        return true;
+    }
+
+}  // namespace qblocks
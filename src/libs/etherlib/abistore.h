@@ -0,0 +1,129 @@
+#pragma once
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <map>
+#include <vector>
+#include "abi.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    // Layout of the compiled ABI store (abis/compiled.bin). The header is followed by the entry
+    // array (one per source file, sorted by key), the function array, the parameter array and
+    // the string table. Strings are stored once, so equal names and types have equal offsets.
+    //--------------------------------------------------------------------------
+    class CAbiStoreHeader {
+    public:
+        char     magic[8];
+        uint32_t nEntries;
+        uint32_t nFuncs;
+        uint32_t nParams;
+        uint32_t nChars;
+    };
+
+    //--------------------------------------------------------------------------
+    class CAbiStoreEntry {
+    public:
+        uint64_t srcHash;    // abiSourceStamp of the JSON file the functions were compiled from
+        uint32_t key;        // the source's full path
+        uint32_t firstFunc;
+        uint32_t nFuncs;
+        uint32_t unused;
+    };
+
+    //--------------------------------------------------------------------------
+    #define STORE_ANONYMOUS (1<<0)
+    #define STORE_CONSTANT  (1<<1)
+    #define STORE_PAYABLE   (1<<2)
+    #define STORE_INDEXED   (1<<0)
+    #define STORE_POINTER   (1<<1)
+    #define STORE_ARRAY     (1<<2)
+    #define STORE_OBJECT    (1<<3)
+
+    //--------------------------------------------------------------------------
+    class CStoredFunction {
+    public:
+        uint8_t  topic[32];  // the full hash for events, the selector followed by zeros otherwise
+        uint32_t selector;
+        uint32_t name;
+        uint32_t type;
+        uint32_t signature;
+        uint32_t encoding;
+        uint32_t firstParam;  // the inputs followed by the outputs
+        uint16_t nInputs;
+        uint16_t nOutputs;
+        uint32_t flags;
+    };
+
+    //--------------------------------------------------------------------------
+    class CStoredParameter {
+    public:
+        uint32_t name;
+        uint32_t type;
+        uint32_t flags;
+    };
+
+    //--------------------------------------------------------------------------
+    // All known ABIs compiled into a single memory mapped file. Loading an ABI from the store
+    // does not parse JSON and does not hash signatures. An entry is only used if its source file
+    // has not changed (same size, modification time and inode). Changed or new ABIs are added
+    // and the whole file is rewritten.
+    //--------------------------------------------------------------------------
+    class CAbiStore {
+    public:
+                 CAbiStore  (void);
+                 ~CAbiStore (void);
+
+        bool     open       (const string_q& fileName);
+        void     close      (void);
+        size_t   size       (void) const;
+
+        bool     find       (const string_q& key, uint64_t srcHash, CAbi& abi) const;
+        void     add        (const string_q& key, uint64_t srcHash, const CAbi& abi);
+        bool     write      (const string_q& fileName) const;
+        size_t   nStaged    (void) const { return staged.size(); }
+
+    private:
+        class CStaged {
+        public:
+            uint64_t       srcHash;
+            CFunctionArray funcs;
+        };
+
+        CMemMapFile             *mapped;
+        const CAbiStoreEntry    *pEntries;
+        const CStoredFunction   *pFuncs;
+        const CStoredParameter  *pParams;
+        const char              *pChars;
+        CAbiStoreHeader          header;
+        map<string_q, CStaged>   staged;
+
+        const CAbiStoreEntry *findEntry(const string_q& key) const;
+        void     readFunction(const CStoredFunction& sf, CFunction& func) const;
+
+        CAbiStore(const CAbiStore&);
+        CAbiStore& operator=(const CAbiStore&);
+    };
+
+    //--------------------------------------------------------------------------
+    extern uint64_t abiSourceHash  (const string_q& contents);
+    extern uint64_t abiSourceStamp (const string_q& fileName);
+    extern string_q abiStorePath   (void);
+
+    //--------------------------------------------------------------------------
+    // Loads an ABI from its JSON file, by way of the store if it has been compiled before. A caller
+    // loading many ABIs passes its own open store and writes it once when done. Otherwise the
+    // store is opened for this one ABI, and written if the ABI was not in it.
+    extern bool     loadAbiCompiled(CAbi& abi, const string_q& jsonFile, CAbiStore *store = NULL);
+
+}  // namespace qblocks
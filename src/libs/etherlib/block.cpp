@@ -155,17 +155,18 @@ bool CBlock::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> gasLimit;
-    archive >> gasUsed;
-    archive >> hash;
-    archive >> blockNumber;
-    archive >> parentHash;
-    archive >> miner;
-    archive >> difficulty;
-    archive >> price;
-    archive >> finalized;
-    archive >> timestamp;
-    archive >> transactions;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(CBlock), 11);
+    fields >> gasLimit;
+    fields >> gasUsed;
+    fields >> hash;
+    fields >> blockNumber;
+    fields >> parentHash;
+    fields >> miner;
+    fields >> difficulty;
+    fields >> price;
+    fields >> finalized;
+    fields >> timestamp;
+    fields >> transactions;
     finishParse();
     return true;
 }
@@ -570,6 +571,27 @@ bool CBlock::forEveryAddress(ADDRESSFUNC func, TRANSFUNC filterFunc, void *data)
     }
     return true;
 }
+
+//---------------------------------------------------------------------------
+// Readies a block that has been used before for a binary read into the same object. Every field
+// goes back to its default, but the transactions and their logs are kept (each one reset) along
+// with the memory behind their strings, so the read overwrites them rather than allocating new
+// ones. The read sizes the arrays itself, so only use this before a binary read.
+void CBlock::resetForRead(void) {
+    CTransactionArray keptTrans;
+    keptTrans.swap(transactions);
+    initialize();
+    transactions.swap(keptTrans);
+    for (size_t i = 0 ; i < transactions.size() ; i++) {
+        CTransaction *trans = &transactions.at(i);  // taking a non-const reference
+        CLogEntryArray keptLogs;
+        keptLogs.swap(trans->receipt.logs);
+        trans->initialize();
+        trans->receipt.logs.swap(keptLogs);
+        for (size_t l = 0 ; l < trans->receipt.logs.size() ; l++)
+            trans->receipt.logs.at(l).initialize();
+    }
+}
 // EXISTING_CODE
 }  // namespace qblocks
 
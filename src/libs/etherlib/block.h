@@ -56,6 +56,7 @@ public:
     // EXISTING_CODE
     bool forEveryAddress      (ADDRESSFUNC func, TRANSFUNC filt, void *data);
     bool forEveryUniqueAddress(ADDRESSFUNC func, TRANSFUNC filt, void *data);
+    void resetForRead         (void);
     // EXISTING_CODE
     friend bool operator<(const CBlock& v1, const CBlock& v2);
     friend ostream& operator<<(ostream& os, const CBlock& item);
@@ -0,0 +1,388 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include "etherlib.h"
+#include "blockcompress.h"
+
+namespace qblocks {
+
+    extern bool readNodeFromBinary(CBaseNode& item, const string_q& fileName);
+    extern bool writeNodeToBinary(const CBaseNode& node, const string_q& fileName);
+
+    //--------------------------------------------------------------------------
+    static const char packedMagic[4] = { 'Q', 'B', 'Z', '2' };
+    static const char tablelessMagic[4] = { 'Q', 'B', 'Z', '1' };
+
+    //--------------------------------------------------------------------------
+    // Blocks sampled from an era to train its dictionary
+    #define TRAIN_SAMPLES 256
+    #define TRAIN_PROBES  100
+
+    //--------------------------------------------------------------------------
+    CBlockDictionary::CBlockDictionary(const string_q& d) : data(d), id(2166136261U) {
+        for (size_t i = 0 ; i < data.length() ; i++)
+            id = (id ^ (uint8_t)data[i]) * 16777619U;
+        if (!id)
+            id = 1;
+    }
+
+    //--------------------------------------------------------------------------
+    CBlockDictionaries::~CBlockDictionaries(void) {
+        clear();
+    }
+
+    //--------------------------------------------------------------------------
+    void CBlockDictionaries::clear(void) {
+        lock_guard<mutex> guard(lock);
+        for (map<uint32_t, CBlockDictionary*>::iterator it = dicts.begin() ; it != dicts.end() ; ++it)
+            if (it->second)
+                delete it->second;
+        dicts.clear();
+    }
+
+    //--------------------------------------------------------------------------
+    string_q CBlockDictionaries::fileName(uint32_t era) const {
+        return (folder.empty() ? blockCachePath("dicts/") : folder) + "era_" + padLeft(asStringU(era), 4, '0') + ".dict";
+    }
+
+    //--------------------------------------------------------------------------
+    const CBlockDictionary *CBlockDictionaries::get(uint32_t era) {
+        lock_guard<mutex> guard(lock);
+        map<uint32_t, CBlockDictionary*>::iterator it = dicts.find(era);
+        if (it != dicts.end())
+            return it->second;
+
+        CBlockDictionary *dict = NULL;
+        string_q path = fileName(era);
+        if (fileExists(path)) {
+            CMemMapFile file(path);
+            if (file.isValid())
+                dict = new CBlockDictionary(string_q((const char*)file.getData(), file.size()));  // NOLINT
+        }
+        dicts[era] = dict;
+        return dict;
+    }
+
+    //--------------------------------------------------------------------------
+    // Blocks name the dictionary they were packed with, so a dictionary file is never replaced.
+    // It is written under a name of its own and linked into place, which fails if another process
+    // got there first; its dictionary is then picked up by the next get and this one is dropped.
+    bool CBlockDictionaries::train(uint32_t era, const CStringArray& samples) {
+        if (get(era))
+            return true;
+
+        string_q data;
+        trainDictionary(samples, BLOCK_DICT_SIZE, data);
+        if (data.empty())
+            return false;
+
+        string_q path = fileName(era);
+        string_q created;
+        if (!establishFolder(path, created))
+            return false;
+        string_q tmpName = path + "." + asStringU((uint64_t)getpid()) + ".tmp";
+        SFArchive archive(WRITING_ARCHIVE);
+        if (!archive.Lock(tmpName, binaryWriteCreate, LOCK_CREATE))
+            return false;
+        archive.Write(data.data(), sizeof(char), data.length());
+        archive.Release();
+
+        bool linked = (::link(tmpName.c_str(), path.c_str()) == 0);
+        ::remove(tmpName.c_str());
+
+        lock_guard<mutex> guard(lock);
+        if (!linked) {
+            if (!dicts[era])
+                dicts.erase(era);
+            return false;
+        }
+        dicts[era] = new CBlockDictionary(data);
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    CBlockDictionaries& blockDictionaries(void) {
+        static CBlockDictionaries theDictionaries;
+        return theDictionaries;
+    }
+
+    //--------------------------------------------------------------------------
+    bool serializeBlock(const CBlock& block, string_q& raw, CArchiveDictionary *dict) {
+        char *buf = NULL;
+        size_t size = 0;
+        SFArchive archive(WRITING_ARCHIVE);
+        archive.m_fp = open_memstream(&buf, &size);
+        if (!archive.m_fp)
+            return false;
+        archive.m_dictionary = dict;
+        block.SerializeC(archive);
+        archive.Close();
+        raw = string_q(buf, size);
+        free(buf);
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    bool packBlock(const CBlock& block, string_q& packed) {
+        CArchiveDictionary tables;
+        string_q raw;
+        if (!serializeBlock(block, raw, &tables))
+            return false;
+
+        CBlockRecordHeader header;
+        memcpy(header.magic, packedMagic, sizeof(header.magic));
+        header.era = (uint32_t)(block.blockNumber / BLOCK_ERA_SIZE);
+        header.dictId = 0;
+        header.rawSize = (uint32_t)raw.length();
+        const CBlockDictionary *dict = blockDictionaries().get(header.era);
+        if (dict)
+            header.dictId = dict->id;
+
+        uint32_t nAddrs = (uint32_t)tables.addresses.size();
+        uint32_t nHashes = (uint32_t)tables.hashes.size();
+        packed = string_q((const char*)&header, sizeof(header));  // NOLINT
+        packed.append((const char*)&nAddrs, sizeof(nAddrs));  // NOLINT
+        packed.append((const char*)&nHashes, sizeof(nHashes));  // NOLINT
+        for (size_t i = 0 ; i < nAddrs ; i++)
+            packed.append((const char*)tables.addresses[i].bytes, sizeof(tables.addresses[i].bytes));  // NOLINT
+        for (size_t i = 0 ; i < nHashes ; i++)
+            packed.append((const char*)tables.hashes[i].bytes, sizeof(tables.hashes[i].bytes));  // NOLINT
+        lz4Compress((const uint8_t*)raw.data(), raw.length(), packed,  // NOLINT
+                        (dict ? (const uint8_t*)dict->data.data() : NULL), (dict ? dict->data.length() : 0));  // NOLINT
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    static bool hasTables(const uint8_t *data) {
+        return !memcmp(data, packedMagic, sizeof(packedMagic));
+    }
+
+    //--------------------------------------------------------------------------
+    bool isPackedBlock(const uint8_t *data, size_t len) {
+        return (len >= sizeof(CBlockRecordHeader) &&
+                    (hasTables(data) || !memcmp(data, tablelessMagic, sizeof(tablelessMagic))));
+    }
+
+    //--------------------------------------------------------------------------
+    // Finds the tables (if the format has them) and the start of the compressed body
+    static bool findTables(const uint8_t *data, size_t len, uint32_t& nAddrs, uint32_t& nHashes, size_t& body) {
+        nAddrs = nHashes = 0;
+        body = sizeof(CBlockRecordHeader);
+        if (!hasTables(data))
+            return true;
+        if (len - body < 2 * sizeof(uint32_t))
+            return false;
+        memcpy(&nAddrs, data + body, sizeof(nAddrs));
+        memcpy(&nHashes, data + body + sizeof(nAddrs), sizeof(nHashes));
+        body += 2 * sizeof(uint32_t);
+        uint64_t tableSize = (uint64_t)nAddrs * sizeof(CBinAddress) + (uint64_t)nHashes * sizeof(CBinHash);
+        if (len - body < tableSize)
+            return false;
+        body += tableSize;
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    bool packedBlockAddresses(const uint8_t *data, size_t len, CBinAddressArray& addrs) {
+        addrs.clear();
+        uint32_t nAddrs, nHashes;
+        size_t body;
+        if (!isPackedBlock(data, len) || !hasTables(data) || !findTables(data, len, nAddrs, nHashes, body))
+            return false;
+        addrs.resize(nAddrs);
+        const uint8_t *table = data + sizeof(CBlockRecordHeader) + 2 * sizeof(uint32_t);
+        for (size_t i = 0 ; i < nAddrs ; i++)
+            memcpy(addrs[i].bytes, table + i * sizeof(addrs[i].bytes), sizeof(addrs[i].bytes));
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    bool unpackBlock(const uint8_t *data, size_t len, CBlock& block, const CFieldProjection *projection) {
+        uint32_t nAddrs, nHashes;
+        size_t body;
+        if (!isPackedBlock(data, len) || !findTables(data, len, nAddrs, nHashes, body))
+            return false;
+
+        CBlockRecordHeader header;
+        memcpy(&header, data, sizeof(header));
+        const CBlockDictionary *dict = NULL;
+        if (header.dictId) {
+            dict = blockDictionaries().get(header.era);
+            if (!dict || dict->id != header.dictId) {
+                cerr << "The dictionary of era " << header.era << " is missing or is not the one the block was "
+                        "compressed with.\n";
+                return false;
+            }
+        }
+
+        string_q raw(header.rawSize, '\0');
+        if (!lz4Decompress(data + body, len - body, (uint8_t*)&raw[0], raw.length(),  // NOLINT
+                            (dict ? (const uint8_t*)dict->data.data() : NULL), (dict ? dict->data.length() : 0)))  // NOLINT
+            return false;
+
+        CArchiveDictionary tables;
+        if (hasTables(data)) {
+            const uint8_t *table = data + sizeof(header) + 2 * sizeof(uint32_t);
+            tables.addresses.resize(nAddrs);
+            for (size_t i = 0 ; i < nAddrs ; i++, table += sizeof(CBinAddress))
+                memcpy(tables.addresses[i].bytes, table, sizeof(CBinAddress));
+            tables.hashes.resize(nHashes);
+            for (size_t i = 0 ; i < nHashes ; i++, table += sizeof(CBinHash))
+                memcpy(tables.hashes[i].bytes, table, sizeof(CBinHash));
+        }
+
+        SFArchive archive(READING_ARCHIVE);
+        archive.m_fp = fmemopen(&raw[0], raw.length(), binaryReadOnly);
+        if (!archive.m_fp)
+            return false;
+        archive.m_dictionary = (hasTables(data) ? &tables : NULL);
+        archive.m_projection = projection;
+        block.Serialize(archive);
+        archive.Close();
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    bool writePackedBlock(const CBlock& block, const string_q& fileName) {
+        string_q packed;
+        if (!packBlock(block, packed))
+            return false;
+
+        string_q created;
+        if (!establishFolder(fileName, created))
+            return false;
+        if (!created.empty() && !isTestMode())
+            cerr << "mkdir(" << created << ")" << string_q(75, ' ') << "\n";
+        SFArchive blockCache(WRITING_ARCHIVE);
+        if (!blockCache.Lock(fileName, binaryWriteCreate, LOCK_CREATE))
+            return false;
+        blockCache.Write(packed.data(), sizeof(char), packed.length());
+        blockCache.Release();
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    // Maps the file and decodes it straight from the mapping. Sets 'packed' to false (and
+    // reads nothing) if the file is not a compressed block.
+    static bool readMapped(CBlock& block, const string_q& fileName, bool& packed, const CFieldProjection *projection) {
+        packed = false;
+        CMemMapFile file;
+        if (!file.open(fileName, CMemMapFile::WholeFile, CMemMapFile::SequentialScan))
+            return false;
+        packed = isPackedBlock(file.getData(), file.size());
+        return (packed && unpackBlock(file.getData(), file.size(), block, projection));
+    }
+
+    //--------------------------------------------------------------------------
+    bool readPackedBlock(CBlock& block, const string_q& fileName, const CFieldProjection *projection) {
+        bool packed = false;
+        bool ret = readMapped(block, fileName, packed, projection);
+        if (packed)
+            return ret;
+        if (!projection)
+            return readNodeFromBinary(block, fileName);
+
+        SFArchive blockCache(READING_ARCHIVE);
+        if (!blockCache.Lock(fileName, binaryReadOnly, LOCK_NOWAIT))
+            return false;
+        blockCache.m_projection = projection;
+        block.Serialize(blockCache);
+        blockCache.Close();
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    bool readBlockAddresses(const string_q& fileName, CBinAddressArray& addrs) {
+        addrs.clear();
+        CMemMapFile file;
+        if (!file.open(fileName))
+            return false;
+        return packedBlockAddresses(file.getData(), file.size(), addrs);
+    }
+
+    //--------------------------------------------------------------------------
+    // True if the file is already compressed in the current format
+    static bool isPackedFile(const string_q& fileName, uint64_t& size) {
+        CMemMapFile file;
+        if (!file.open(fileName))
+            return false;
+        size = file.size();
+        return (isPackedBlock(file.getData(), file.size()) && hasTables(file.getData()));
+    }
+
+    //--------------------------------------------------------------------------
+    // Serializations of blocks spread across the era, taken from the cache
+    static void sampleEra(uint32_t era, CStringArray& samples) {
+        blknum_t first = (blknum_t)era * BLOCK_ERA_SIZE;
+        blknum_t step = BLOCK_ERA_SIZE / TRAIN_SAMPLES;
+        for (size_t s = 0 ; s < TRAIN_SAMPLES ; s++) {
+            for (blknum_t bn = first + s * step ; bn < first + s * step + TRAIN_PROBES ; bn++) {
+                string_q fileName = getBinaryFilename(bn);
+                if (!fileExists(fileName))
+                    continue;
+                CBlock block;
+                CArchiveDictionary tables;
+                string_q raw;
+                if (readPackedBlock(block, fileName) && serializeBlock(block, raw, &tables))
+                    samples.push_back(raw);
+                break;
+            }
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    bool compressCachedBlocks(blknum_t first, blknum_t last, uint64_t& rawBytes, uint64_t& packedBytes) {
+        rawBytes = packedBytes = 0;
+        uint32_t trained = (uint32_t)NOPOS;
+        for (blknum_t bn = first ; bn <= last ; bn++) {
+            string_q fileName = getBinaryFilename(bn);
+            uint64_t size = 0;
+            if (!fileExists(fileName) || isPackedFile(fileName, size))
+                continue;
+
+            uint32_t era = (uint32_t)(bn / BLOCK_ERA_SIZE);
+            if (era != trained && !blockDictionaries().get(era)) {
+                CStringArray samples;
+                sampleEra(era, samples);
+                if (!blockDictionaries().train(era, samples) && !blockDictionaries().get(era))
+                    cerr << "Could not train a dictionary for era " << era << ". Compressing without one.\n";
+            }
+            trained = era;
+
+            // blocks compressed in the earlier format are rewritten with their tables
+            CBlock block;
+            if (!readPackedBlock(block, fileName))
+                return false;
+            string_q tmpName = fileName + ".tmp";
+            if (!writePackedBlock(block, tmpName))
+                return false;
+
+            // make sure it reads back before it replaces the original, which a reader may have mapped
+            CBlock check;
+            string_q before, after;
+            if (!readPackedBlock(check, tmpName) || !serializeBlock(block, before) ||
+                    !serializeBlock(check, after) || before != after) {
+                cerr << "Block " << bn << " did not read back after compression. Quitting...\n";
+                ::remove(tmpName.c_str());
+                return false;
+            }
+            if (::rename(tmpName.c_str(), fileName.c_str()) != 0)
+                return false;
+            rawBytes += size;
+            packedBytes += fileSize(fileName);
+            if (!isTestMode() && !(bn % 1000))
+                cerr << "Compressed to block " << bn << "\r";
+        }
+        return true;
+    }
+
+}  // namespace qblocks
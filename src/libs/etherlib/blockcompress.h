@@ -0,0 +1,105 @@
+#pragma once
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <map>
+#include <mutex>
+#include "block.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    // Blocks that share a dictionary. Each era's dictionary is trained from its own blocks,
+    // since what recurs in them (contracts, selectors, events) changes over time.
+    #define BLOCK_ERA_SIZE  1000000
+    #define BLOCK_DICT_SIZE 32768
+
+    //--------------------------------------------------------------------------
+    // A compressed block file (blocks/xx/yy/zz/<block>.bin) starts with this header. In the
+    // current format ("QBZ2") it is followed by the number of addresses and of hashes in the
+    // block (two uint32), the addresses (20 bytes each) and hashes (32 bytes each) in binary,
+    // and then the LZ4 compressed serialization of the block, in which every address and hash
+    // is a four byte index into those tables. The first format ("QBZ1", still read) has no
+    // tables. An uncompressed file starts with the block's m_deleted flag, so the magic tells
+    // them apart. dictId is zero if the block was compressed without a dictionary, and rawSize
+    // is the size of the serialization before LZ4.
+    //--------------------------------------------------------------------------
+    class CBlockRecordHeader {
+    public:
+        char     magic[4];
+        uint32_t era;
+        uint32_t dictId;
+        uint32_t rawSize;
+    };
+
+    //--------------------------------------------------------------------------
+    class CBlockDictionary {
+    public:
+        string_q data;
+        uint32_t id;  // a hash of the contents, never zero
+        explicit CBlockDictionary(const string_q& d);
+    };
+
+    //--------------------------------------------------------------------------
+    // The era dictionaries (dicts/era_<era>.dict in the block cache), loaded once and kept. A
+    // dictionary is never replaced once written, because the blocks compressed with it need it.
+    //--------------------------------------------------------------------------
+    class CBlockDictionaries {
+    public:
+        string_q folder;  // empty for dicts/ in the block cache
+
+                                CBlockDictionaries (void) { }
+                                ~CBlockDictionaries(void);
+
+        const CBlockDictionary *get                (uint32_t era);
+        bool                    train              (uint32_t era, const CStringArray& samples);
+        void                    clear              (void);
+        string_q                fileName           (uint32_t era) const;
+
+    private:
+        map<uint32_t, CBlockDictionary*> dicts;  // NULL if the era has none
+        mutex                            lock;
+
+        CBlockDictionaries(const CBlockDictionaries&);
+        CBlockDictionaries& operator=(const CBlockDictionaries&);
+    };
+    extern CBlockDictionaries& blockDictionaries(void);
+
+    //--------------------------------------------------------------------------
+    // The block's serialization as it would be written uncompressed or, given a dictionary,
+    // with its addresses and hashes replaced by references into the dictionary
+    extern bool serializeBlock  (const CBlock& block, string_q& raw, CArchiveDictionary *dict = NULL);
+    extern bool packBlock       (const CBlock& block, string_q& packed);
+    extern bool unpackBlock     (const uint8_t *data, size_t len, CBlock& block,
+                                    const CFieldProjection *projection = NULL);
+    extern bool isPackedBlock   (const uint8_t *data, size_t len);
+
+    //--------------------------------------------------------------------------
+    // The unique addresses in a compressed block (its address table), without decompressing
+    // it. A reader matches these once, and a block none of whose addresses are watched need
+    // not be decompressed at all. Only lower case addresses (as the node returns them) go into
+    // the table. Returns false for a block written in a format without the table.
+    extern bool packedBlockAddresses(const uint8_t *data, size_t len, CBinAddressArray& addrs);
+    extern bool readBlockAddresses  (const string_q& fileName, CBinAddressArray& addrs);
+
+    //--------------------------------------------------------------------------
+    // Writes the block compressed. readBlockFromBinary reads either form, mapping the file, and
+    // decodes only the fields in the projection if one is given.
+    extern bool writePackedBlock(const CBlock& block, const string_q& fileName);
+    extern bool readPackedBlock (CBlock& block, const string_q& fileName, const CFieldProjection *projection = NULL);
+
+    //--------------------------------------------------------------------------
+    // Rewrites the cached blocks from first to last (inclusive) compressed, training the
+    // dictionary of any era that has none from that era's cached blocks
+    extern bool compressCachedBlocks(blknum_t first, blknum_t last, uint64_t& rawBytes, uint64_t& packedBytes);
+
+}  // namespace qblocks
@@ -25,10 +25,12 @@ void CBlockOptions::Init(void) {
 }
 
 //--------------------------------------------------------------------------------
+// Only the header is needed, so we do not ask for the transactions or their receipts
 uint64_t findBlockNumByHash(const SFHash& hash, void *data) {
     ASSERT(isHash(hash));
     CBlock block;
-    if (!getBlock(block, hash)) {
+    getObjectViaRPC(block, "eth_getBlockByHash", "[" + quote(hash) + ",false]");
+    if (block.hash.empty()) {  // the node returned null
         cerr << "Block hash '" << hash << "' does not appear to be a valid block hash. Quitting...";
         exit(0);
     }
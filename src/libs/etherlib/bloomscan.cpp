@@ -0,0 +1,196 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include "etherlib.h"
+#include "bloomscan.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    // Blocks whose blooms stay in the cache while every query is run over them
+    #define TILE_BLOCKS 64
+
+    //--------------------------------------------------------------------------
+    CBloomQuery::CBloomQuery(const CRawBloom& bloom) : nWords(0) {
+        for (uint8_t i = 0 ; i < 32 ; i++) {
+            if (bloom.words[i]) {
+                index[nWords] = i;
+                mask[nWords] = bloom.words[i];
+                nWords++;
+            }
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    void matchBlooms(const CBloomQueryArray& queries, const CRawBloom *blooms, const uint32_t *offsets,
+                        blknum_t firstBlock, size_t nBlocks, vector<CBlockNumArray>& hits) {
+        if (hits.size() < queries.size())
+            hits.resize(queries.size());
+        for (size_t tile = 0 ; tile < nBlocks ; tile += TILE_BLOCKS) {
+            size_t tileEnd = min(tile + TILE_BLOCKS, nBlocks);
+            for (size_t q = 0 ; q < queries.size() ; q++) {
+                const CBloomQuery& query = queries[q];
+                for (size_t b = tile ; b < tileEnd ; b++) {
+                    for (uint32_t i = offsets[b] ; i < offsets[b+1] ; i++) {
+                        if (query.isHit(blooms[i])) {
+                            hits[q].push_back(firstBlock + b);
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    CBloomScanner::CBloomScanner(void) : chunkSize(10000), scanBlooms(forEveryBloom) {
+        size_t n = (size_t)thread::hardware_concurrency();
+        nThreads = (n ? n : 4);
+    }
+
+    //--------------------------------------------------------------------------
+    // The blooms of blocks that are not in a segment, laid out as a segment would have them. If
+    // 'segment' is set, only blocks it has no blooms for are kept (blocks cached after the segment
+    // was written), as forEveryBloom does.
+    class CLooseBlooms {
+    public:
+        blknum_t             first;
+        const CBloomSegment *segment;
+        CRawBloomArray       blooms;
+        vector<uint32_t>     offsets;
+        explicit CLooseBlooms(blknum_t f, const CBloomSegment *s = NULL) : first(f), segment(s) { }
+        void fill(blknum_t bn) {
+            while (offsets.size() <= bn - first)
+                offsets.push_back((uint32_t)blooms.size());
+        }
+    };
+
+    //--------------------------------------------------------------------------
+    static bool collectBlooms(blknum_t bn, const CRawBloom *blooms, size_t nBlooms, void *data) {
+        CLooseBlooms *loose = (CLooseBlooms*)data;  // NOLINT
+        if (bn < loose->first)
+            return true;
+        const CRawBloom *inSegment;
+        if (loose->segment && loose->segment->getBlooms(bn, inSegment))
+            return true;
+        loose->fill(bn);
+        loose->blooms.insert(loose->blooms.end(), blooms, blooms + nBlooms);
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    class CScanContext {
+    public:
+        const CBloomScanner            *scanner;
+        const CBloomQueryArray         *queries;
+        blknum_t                        end;
+        atomic<blknum_t>                nextBlock;
+        vector< vector<CBlockNumArray> > perThread;
+        CScanContext(void) : scanner(NULL), queries(NULL), end(0), nextBlock(0) { }
+    };
+
+    //--------------------------------------------------------------------------
+    static void scanWorker(CScanContext *ctx, size_t id) {
+        vector<CBlockNumArray>& hits = ctx->perThread[id];
+        hits.resize(ctx->queries->size());
+
+        CBloomSegment segment;
+        blknum_t openFor = NOPOS;
+        blknum_t chunk = ctx->scanner->chunkSize;
+        for (blknum_t first = ctx->nextBlock.fetch_add(chunk) ; first < ctx->end ;
+                first = ctx->nextBlock.fetch_add(chunk)) {
+
+            blknum_t last = min(first + chunk, ctx->end);
+            blknum_t bn = first;
+            while (bn < last) {
+                blknum_t segFirst = (bn / BLOOM_SEGMENT_SIZE) * BLOOM_SEGMENT_SIZE;
+                blknum_t segEnd = min(last, segFirst + BLOOM_SEGMENT_SIZE);
+                if (openFor != segFirst) {
+                    segment.open(bloomSegmentPath(bn, ctx->scanner->folder));
+                    openFor = segFirst;
+                }
+
+                if (segment.covers(bn)) {
+                    blknum_t to = min(segEnd, segment.firstBlock() + segment.nBlocks());
+                    const uint32_t *offsets = segment.offsets() + (bn - segment.firstBlock());
+                    matchBlooms(*ctx->queries, segment.blooms(), offsets, bn, to - bn, hits);
+
+                    // blocks the segment has no blooms for may have their own files
+                    bool anyEmpty = false;
+                    for (blknum_t b = 0 ; b < to - bn && !anyEmpty ; b++)
+                        anyEmpty = (offsets[b] == offsets[b+1]);
+                    if (anyEmpty) {
+                        CLooseBlooms loose(bn, &segment);
+                        (*ctx->scanner->scanBlooms)(collectBlooms, &loose, bn, to - bn);
+                        loose.fill(to);
+                        matchBlooms(*ctx->queries, loose.blooms.data(), loose.offsets.data(), bn, to - bn, hits);
+                    }
+                    bn = to;
+                }
+
+                if (bn < segEnd) {
+                    CLooseBlooms loose(bn);
+                    (*ctx->scanner->scanBlooms)(collectBlooms, &loose, bn, segEnd - bn);
+                    loose.fill(segEnd);
+                    matchBlooms(*ctx->queries, loose.blooms.data(), loose.offsets.data(), bn, segEnd - bn, hits);
+                    bn = segEnd;
+                }
+            }
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    // hits[i] is the sorted list of blocks whose blooms may hold everything in queries[i]
+    bool CBloomScanner::scan(const CRawBloomArray& queries, blknum_t start, blknum_t count,
+                                vector<CBlockNumArray>& hits) {
+        hits.clear();
+        hits.resize(queries.size());
+        if (queries.empty())
+            return true;
+        if (nThreads < 1)
+            nThreads = 1;
+        if (chunkSize < 1)
+            chunkSize = 1;
+
+        // establish the cache path on this thread, it's initialized once and cached
+        blockCachePath("");
+
+        CBloomQueryArray reduced;
+        for (size_t i = 0 ; i < queries.size() ; i++)
+            reduced.push_back(CBloomQuery(queries[i]));
+
+        CScanContext ctx;
+        ctx.scanner = this;
+        ctx.queries = &reduced;
+        ctx.end = (count == NOPOS ? getLatestBlockFromCache() + 1 : start + count);
+        ctx.nextBlock = start;
+        ctx.perThread.resize(nThreads);
+
+        vector<thread> threads;
+        for (size_t t = 0 ; t < nThreads ; t++)
+            threads.push_back(thread(scanWorker, &ctx, t));
+        for (size_t t = 0 ; t < nThreads ; t++)
+            threads[t].join();
+
+        // each thread's hits are in order, but the threads took chunks in no particular order
+        for (size_t q = 0 ; q < queries.size() ; q++) {
+            for (size_t t = 0 ; t < nThreads ; t++)
+                hits[q].insert(hits[q].end(), ctx.perThread[t][q].begin(), ctx.perThread[t][q].end());
+            sort(hits[q].begin(), hits[q].end());
+        }
+        return true;
+    }
+
+}  // namespace qblocks
@@ -0,0 +1,60 @@
+#pragma once
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include "bloomsummary.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    // A query bloom reduced to its non-zero words. An address sets three bits, so a query
+    // touches at most three of a bloom's 32 words.
+    class CBloomQuery {
+    public:
+        uint8_t  nWords;
+        uint8_t  index[32];
+        uint64_t mask[32];
+
+        explicit CBloomQuery(const CRawBloom& bloom);
+        bool     isHit(const CRawBloom& bloom) const {
+            for (uint8_t i = 0 ; i < nWords ; i++)
+                if ((bloom.words[index[i]] & mask[i]) != mask[i])
+                    return false;
+            return true;
+        }
+    };
+    typedef vector<CBloomQuery> CBloomQueryArray;
+
+    //--------------------------------------------------------------------------
+    // Tests every query against the blooms of blocks firstBlock up to firstBlock + nBlocks. The
+    // blooms of block firstBlock + i are blooms[offsets[i]] up to blooms[offsets[i+1]]. A block
+    // found by a query is added to that query's list of hits.
+    extern void matchBlooms(const CBloomQueryArray& queries, const CRawBloom *blooms, const uint32_t *offsets,
+                                blknum_t firstBlock, size_t nBlocks, vector<CBlockNumArray>& hits);
+
+    //--------------------------------------------------------------------------
+    // Scans a range of blocks for many addresses in one pass. The range is handed out to the
+    // threads a chunk at a time, each thread reading its chunk's blooms once for all queries.
+    //--------------------------------------------------------------------------
+    class CBloomScanner {
+    public:
+        size_t         nThreads;
+        blknum_t       chunkSize;   // blocks handed to a thread at a time
+        string_q       folder;      // where the segments are (empty for blooms/segments/)
+        BLOOMSCANFUNC  scanBlooms;  // blocks not in a segment or empty in it (forEveryBloom)
+
+                       CBloomScanner(void);
+        bool           scan         (const CRawBloomArray& queries, blknum_t start, blknum_t count,
+                                          vector<CBlockNumArray>& hits);
+    };
+
+}  // namespace qblocks
@@ -0,0 +1,392 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include "etherlib.h"
+#include "bloomsegment.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    static const char segmentMagic[8] = { 'Q', 'B', 'B', 'L', 'O', 'O', 'M', '1' };
+
+    //--------------------------------------------------------------------------
+    void bloomToRaw(const SFBloom& bloom, CRawBloom& raw) {
+        for (unsigned int i = 0 ; i < 32 ; i++)
+            raw.words[i] = bloom.getBlock(i);
+    }
+
+    //--------------------------------------------------------------------------
+    SFBloom rawToBloom(const CRawBloom& raw) {
+        return SFBloom(raw.words, 32);
+    }
+
+    //--------------------------------------------------------------------------
+    // The hex is most significant first, so the last sixteen digits are the first word
+    bool hexToRaw(const string_q& hex, CRawBloom& raw) {
+        bzero(&raw, sizeof(raw));
+        size_t start = (startsWith(hex, "0x") ? 2 : 0);
+        if (hex.length() - start > 512)
+            return false;
+        for (size_t i = hex.length() ; i > start ; i--) {
+            char c = hex[i-1];
+            uint64_t nibble;
+            if (c >= '0' && c <= '9')
+                nibble = uint64_t(c - '0');
+            else if (c >= 'a' && c <= 'f')
+                nibble = uint64_t(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F')
+                nibble = uint64_t(c - 'A' + 10);
+            else
+                return false;
+            size_t pos = hex.length() - i;
+            raw.words[pos / 16] |= (nibble << ((pos % 16) * 4));
+        }
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    // The offsets are padded to a multiple of eight bytes so the blooms are aligned
+    static uint64_t bloomsStart(uint64_t nBlocks) {
+        return sizeof(CBloomSegmentHeader) + ((nBlocks + 2) & ~(uint64_t)1) * sizeof(uint32_t);
+    }
+
+    //--------------------------------------------------------------------------
+    string_q bloomSegmentPath(blknum_t bn, const string_q& folder) {
+        blknum_t first = (bn / BLOOM_SEGMENT_SIZE) * BLOOM_SEGMENT_SIZE;
+        return (folder.empty() ? bloomFolder + "segments/" : folder) + padLeft(asStringU(first), 9, '0') + ".seg";
+    }
+
+    //--------------------------------------------------------------------------
+    CBloomSegment::CBloomSegment(void) : mapped(NULL), pOffsets(NULL), pBlooms(NULL) {
+        bzero(&header, sizeof(header));
+    }
+
+    //--------------------------------------------------------------------------
+    CBloomSegment::~CBloomSegment(void) {
+        close();
+    }
+
+    //--------------------------------------------------------------------------
+    void CBloomSegment::close(void) {
+        if (mapped)
+            delete mapped;
+        mapped   = NULL;
+        pOffsets = NULL;
+        pBlooms  = NULL;
+        bzero(&header, sizeof(header));
+    }
+
+    //--------------------------------------------------------------------------
+    static bool checkHeader(const CBloomSegmentHeader& header, uint64_t fileSz) {
+        if (memcmp(header.magic, segmentMagic, sizeof(segmentMagic)))
+            return false;
+        return (fileSz == bloomsStart(header.nBlocks) + (uint64_t)header.nBlooms * sizeof(CRawBloom));
+    }
+
+    //--------------------------------------------------------------------------
+    // Maps the segment read only. A missing or damaged file leaves the segment closed.
+    bool CBloomSegment::open(const string_q& fileName) {
+        close();
+        if (!fileExists(fileName) || fileSize(fileName) < sizeof(CBloomSegmentHeader))
+            return false;
+
+        CMemMapFile *mm = new CMemMapFile(fileName, CMemMapFile::WholeFile, CMemMapFile::SequentialScan);
+        if (!mm->isValid() || mm->size() < sizeof(CBloomSegmentHeader)) {
+            delete mm;
+            return false;
+        }
+
+        const unsigned char *base = mm->getData();
+        memcpy(&header, base, sizeof(header));
+        const uint32_t *offsets = reinterpret_cast<const uint32_t*>(base + sizeof(CBloomSegmentHeader));
+        if (!checkHeader(header, mm->size()) || offsets[header.nBlocks] != header.nBlooms) {
+            bzero(&header, sizeof(header));
+            delete mm;
+            return false;
+        }
+
+        mapped   = mm;
+        pOffsets = offsets;
+        pBlooms  = reinterpret_cast<const CRawBloom*>(base + bloomsStart(header.nBlocks));
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    bool CBloomSegment::covers(blknum_t bn) const {
+        return (isOpen() && bn >= header.firstBlock && bn < header.firstBlock + header.nBlocks);
+    }
+
+    //--------------------------------------------------------------------------
+    // The number of blooms for the block (zero if it has none or is not in the segment)
+    size_t CBloomSegment::getBlooms(blknum_t bn, const CRawBloom *& blooms) const {
+        blooms = NULL;
+        if (!covers(bn))
+            return 0;
+        size_t i = (size_t)(bn - header.firstBlock);
+        blooms = pBlooms + pOffsets[i];
+        return pOffsets[i+1] - pOffsets[i];
+    }
+
+    //--------------------------------------------------------------------------
+    // Visits the blocks in [start, stop) that have blooms, in order
+    bool CBloomSegment::forEveryBlock(BLOOMVISITFUNC func, void *data, blknum_t start, blknum_t stop) const {
+        if (!func || !isOpen())
+            return false;
+        start = max(start, (blknum_t)header.firstBlock);
+        stop  = min(stop,  (blknum_t)(header.firstBlock + header.nBlocks));
+        for (blknum_t bn = start ; bn < stop ; bn++) {
+            const CRawBloom *blooms;
+            size_t n = getBlooms(bn, blooms);
+            if (n && !(*func)(bn, blooms, n, data))
+                return false;
+        }
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    bool writeBloomSegment(const string_q& fileName, blknum_t firstBlock, const vector<CRawBloomArray>& perBlock) {
+        CBloomSegmentHeader hdr;
+        bzero(&hdr, sizeof(hdr));
+        memcpy(hdr.magic, segmentMagic, sizeof(hdr.magic));
+        hdr.firstBlock = firstBlock;
+        hdr.nBlocks = (uint32_t)perBlock.size();
+
+        vector<uint32_t> offsets((bloomsStart(hdr.nBlocks) - sizeof(CBloomSegmentHeader)) / sizeof(uint32_t), 0);
+        for (size_t i = 0 ; i < perBlock.size() ; i++) {
+            offsets[i] = hdr.nBlooms;
+            hdr.nBlooms += (uint32_t)perBlock[i].size();
+        }
+        offsets[perBlock.size()] = hdr.nBlooms;
+
+        string_q created;
+        if (!establishFolder(fileName, created))
+            return false;
+
+        string_q tmpName = fileName + ".tmp";
+        CBinFile file;
+        if (!file.Lock(tmpName, binaryWriteCreate, LOCK_CREATE))
+            return false;
+        file.Write(&hdr, sizeof(hdr), 1);
+        file.Write(offsets.data(), sizeof(uint32_t), offsets.size());
+        for (size_t i = 0 ; i < perBlock.size() ; i++)
+            if (perBlock[i].size())
+                file.Write(perBlock[i].data(), sizeof(CRawBloom), perBlock[i].size());
+        file.Release();
+
+        return (::rename(tmpName.c_str(), fileName.c_str()) == 0);
+    }
+
+    //--------------------------------------------------------------------------
+    static void toRawArray(const SFBloomArray& blooms, CRawBloomArray& raw) {
+        raw.resize(blooms.size());
+        for (size_t i = 0 ; i < blooms.size() ; i++)
+            bloomToRaw(blooms[i], raw[i]);
+    }
+
+    //--------------------------------------------------------------------------
+    // Per-block bloom files (blooms/xx/yy/zz/<block>.bin) between two block numbers
+    class CBloomFiles {
+    public:
+        blknum_t        start;
+        blknum_t        stop;
+        BLOOMVISITFUNC  func;
+        void           *data;
+        CStringArray    found;
+        CBloomFiles(blknum_t st, blknum_t sp) : start(st), stop(sp), func(NULL), data(NULL) { }
+    };
+
+    //--------------------------------------------------------------------------
+    static bool visitBloomFile(const string_q& path, void *data) {
+        CBloomFiles *files = (CBloomFiles*)data;  // NOLINT
+        if (!endsWith(path, ".bin"))
+            return true;
+        blknum_t bn = bnFromPath(path);
+        if (bn < files->start || bn >= files->stop)
+            return true;
+        if (!files->func) {
+            files->found.push_back(path);
+            return true;
+        }
+
+        SFBloomArray blooms;
+        CRawBloomArray raw;
+        if (readBloomArray(blooms, path))
+            toRawArray(blooms, raw);
+        return (raw.empty() || (*files->func)(bn, raw.data(), raw.size(), files->data));
+    }
+
+    //--------------------------------------------------------------------------
+    // Globbing the 1000 block folders sorts the files, so they arrive in block order
+    static bool forEveryBloomFileIn(CBloomFiles& files) {
+        for (blknum_t b = (files.start / 1000) * 1000 ; b < files.stop ; b += 1000) {
+            string_q path = substitute(getBinaryPath(b), "/blocks/", "/blooms/");
+            if (folderExists(path) && !forAllFiles(path + "*.bin", visitBloomFile, &files))
+                return false;
+        }
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    // Folds the per-block files of every segment touching [firstBlock, lastBlock] into the
+    // segment files. A segment already on disk is kept and the files are laid over it, so
+    // migrating again after more blocks are cached extends the segment. With 'removeOld' the
+    // per-block files are removed once the new segment reads back.
+    bool migrateBlooms(blknum_t firstBlock, blknum_t lastBlock, bool removeOld) {
+        for (blknum_t seg = (firstBlock / BLOOM_SEGMENT_SIZE) * BLOOM_SEGMENT_SIZE ; seg <= lastBlock ; seg += BLOOM_SEGMENT_SIZE) {
+
+            string_q fileName = bloomSegmentPath(seg);
+            CBloomSegment existing;
+            existing.open(fileName);
+
+            blknum_t nBlocks = min(lastBlock - seg + 1, (blknum_t)BLOOM_SEGMENT_SIZE);
+            nBlocks = max(nBlocks, existing.nBlocks());
+            vector<CRawBloomArray> perBlock(nBlocks);
+            for (blknum_t i = 0 ; i < existing.nBlocks() ; i++) {
+                const CRawBloom *blooms;
+                size_t n = existing.getBlooms(seg + i, blooms);
+                perBlock[i].assign(blooms, blooms + n);
+            }
+            existing.close();
+
+            CBloomFiles files(seg, seg + nBlocks);
+            forEveryBloomFileIn(files);
+            if (files.found.empty())
+                continue;
+
+            size_t nBlooms = 0;
+            for (size_t i = 0 ; i < files.found.size() ; i++) {
+                SFBloomArray blooms;
+                if (readBloomArray(blooms, files.found[i]))
+                    toRawArray(blooms, perBlock[bnFromPath(files.found[i]) - seg]);
+            }
+            for (size_t i = 0 ; i < perBlock.size() ; i++)
+                nBlooms += perBlock[i].size();
+
+            if (!writeBloomSegment(fileName, seg, perBlock))
+                return false;
+
+            CBloomSegment check;
+            if (!check.open(fileName) || check.nBlooms() != nBlooms)
+                return false;
+            check.close();
+
+            if (verbose)
+                cerr << "Wrote " << nBlooms << " blooms for " << nBlocks << " blocks to " << fileName << "\n";
+            if (removeOld)
+                for (size_t i = 0 ; i < files.found.size() ; i++)
+                    ::remove(files.found[i].c_str());
+        }
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    static string_q bloomFileName(blknum_t bn) {
+        return substitute(getBinaryFilename(bn), "/blocks/", "/blooms/");
+    }
+
+    //--------------------------------------------------------------------------
+    // A block's blooms from its segment if the segment has any for it, from its own file otherwise
+    // (a block cached after its segment was written has no entry there)
+    bool readBlooms(blknum_t bn, SFBloomArray& blooms) {
+        blooms.clear();
+        CBloomSegment segment;
+        bool covered = (segment.open(bloomSegmentPath(bn)) && segment.covers(bn));
+        if (covered) {
+            const CRawBloom *raw;
+            size_t n = segment.getBlooms(bn, raw);
+            for (size_t i = 0 ; i < n ; i++)
+                blooms.push_back(rawToBloom(raw[i]));
+            if (n)
+                return true;
+        }
+        return (readBloomArray(blooms, bloomFileName(bn)) || covered);
+    }
+
+    //--------------------------------------------------------------------------
+    // Visits the blooms of the blocks in [start, start + count) in block order. A block's blooms
+    // come from its segment if the segment has any for it and from its own file otherwise, which
+    // covers blocks cached since the last migration, inside or past the end of a segment.
+    bool forEveryBloom(BLOOMVISITFUNC func, void *data, blknum_t start, blknum_t count) {
+        if (!func)
+            return false;
+
+        blknum_t stop = (count == NOPOS ? getLatestBlockFromCache() + 1 : start + count);
+        for (blknum_t seg = (start / BLOOM_SEGMENT_SIZE) * BLOOM_SEGMENT_SIZE ; seg < stop ; seg += BLOOM_SEGMENT_SIZE) {
+            blknum_t from = max(start, seg);
+            blknum_t to   = min(stop, seg + BLOOM_SEGMENT_SIZE);
+
+            CBloomSegment segment;
+            if (!segment.open(bloomSegmentPath(seg))) {
+                CBloomFiles files(from, to);
+                files.func = func;
+                files.data = data;
+                if (!forEveryBloomFileIn(files))
+                    return false;
+                continue;
+            }
+
+            // the files come sorted, so they are merged with the segment in one pass
+            CBloomFiles files(from, to);
+            forEveryBloomFileIn(files);
+            size_t f = 0;
+            for (blknum_t bn = from ; bn < to ; bn++) {
+                const CRawBloom *blooms;
+                size_t n = segment.getBlooms(bn, blooms);
+                while (f < files.found.size() && bnFromPath(files.found[f]) < bn)
+                    f++;
+                CRawBloomArray raw;
+                if (!n && f < files.found.size() && bnFromPath(files.found[f]) == bn) {
+                    SFBloomArray fromFile;
+                    if (readBloomArray(fromFile, files.found[f]))
+                        toRawArray(fromFile, raw);
+                    blooms = raw.data();
+                    n = raw.size();
+                }
+                if (n && !(*func)(bn, blooms, n, data))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    class CSkipVisit {
+    public:
+        BLOOMVISITFUNC  func;
+        void           *data;
+        blknum_t        start;
+        blknum_t        skip;
+    };
+
+    //--------------------------------------------------------------------------
+    static bool visitEvery(blknum_t bn, const CRawBloom *blooms, size_t nBlooms, void *data) {
+        CSkipVisit *visit = (CSkipVisit*)data;  // NOLINT
+        if ((bn - visit->start) % visit->skip)
+            return true;
+        return (*visit->func)(bn, blooms, nBlooms, visit->data);
+    }
+
+    //--------------------------------------------------------------------------
+    // Every 'skip'th block of forEveryBloom. Once used to glob the per-block files directly,
+    // which missed every block moved into a segment by 'getBloom --migrate'.
+    bool forEveryBloomFile(BLOOMVISITFUNC func, void *data, blknum_t start, blknum_t count, blknum_t skip) {
+        if (!func || skip <= 1)
+            return forEveryBloom(func, data, start, count);
+        CSkipVisit visit;
+        visit.func  = func;
+        visit.data  = data;
+        visit.start = start;
+        visit.skip  = skip;
+        return forEveryBloom(visitEvery, &visit, start, count);
+    }
+
+}  // namespace qblocks
@@ -0,0 +1,109 @@
+#pragma once
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <vector>
+#include "utillib.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    // Blocks per segment file. Segments start at multiples of this number.
+    #define BLOOM_SEGMENT_SIZE 100000
+
+    //--------------------------------------------------------------------------
+    // A bloom as it is stored in a segment: the 2048 bits as 32 words, least significant first
+    class CRawBloom {
+    public:
+        uint64_t words[32];
+    };
+    typedef vector<CRawBloom> CRawBloomArray;
+
+    //--------------------------------------------------------------------------
+    extern void    bloomToRaw(const SFBloom& bloom, CRawBloom& raw);
+    extern SFBloom rawToBloom(const CRawBloom& raw);
+    extern bool    hexToRaw  (const string_q& hex, CRawBloom& raw);  // a logsBloom as the node sends it
+
+    //--------------------------------------------------------------------------
+    inline bool isBloomHit(const CRawBloom& test, const CRawBloom& filter) {
+        for (size_t i = 0 ; i < 32 ; i++)
+            if ((test.words[i] & filter.words[i]) != test.words[i])
+                return false;
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    inline size_t bitsTwiddled(const CRawBloom& bloom) {
+        size_t count = 0;
+        for (size_t i = 0 ; i < 32 ; i++)
+            count += (size_t)__builtin_popcountll(bloom.words[i]);
+        return count;
+    }
+
+    //--------------------------------------------------------------------------
+    // Layout of a segment file (blooms/segments/<first block>.seg). The header is followed by
+    // nBlocks + 1 offsets and then by the blooms. The blooms of block firstBlock + i are those
+    // from offsets[i] up to offsets[i+1], so a block without blooms costs four bytes.
+    //--------------------------------------------------------------------------
+    class CBloomSegmentHeader {
+    public:
+        char     magic[8];
+        uint64_t firstBlock;
+        uint32_t nBlocks;
+        uint32_t nBlooms;
+    };
+
+    //--------------------------------------------------------------------------
+    typedef bool (*BLOOMVISITFUNC)(blknum_t bn, const CRawBloom *blooms, size_t nBlooms, void *data);
+
+    //--------------------------------------------------------------------------
+    // The blooms of a run of blocks in one memory mapped file, so a scan reads a segment from
+    // front to back rather than opening a file per block.
+    //--------------------------------------------------------------------------
+    class CBloomSegment {
+    public:
+                 CBloomSegment  (void);
+                 ~CBloomSegment (void);
+
+        bool     open           (const string_q& fileName);
+        void     close          (void);
+        bool     isOpen         (void) const { return (mapped != NULL); }
+        blknum_t firstBlock     (void) const { return header.firstBlock; }
+        blknum_t nBlocks        (void) const { return header.nBlocks; }
+        size_t   nBlooms        (void) const { return header.nBlooms; }
+        bool     covers         (blknum_t bn) const;
+
+        size_t   getBlooms      (blknum_t bn, const CRawBloom *& blooms) const;
+        const uint32_t  *offsets(void) const { return pOffsets; }
+        const CRawBloom *blooms (void) const { return pBlooms; }
+        bool     forEveryBlock  (BLOOMVISITFUNC func, void *data, blknum_t start, blknum_t stop) const;
+
+    private:
+        CMemMapFile         *mapped;
+        const uint32_t      *pOffsets;
+        const CRawBloom     *pBlooms;
+        CBloomSegmentHeader  header;
+
+        CBloomSegment(const CBloomSegment&);
+        CBloomSegment& operator=(const CBloomSegment&);
+    };
+
+    //--------------------------------------------------------------------------
+    extern string_q bloomSegmentPath  (blknum_t bn, const string_q& folder = "");  // folder defaults to blooms/segments/
+    extern bool     writeBloomSegment (const string_q& fileName, blknum_t firstBlock,
+                                            const vector<CRawBloomArray>& perBlock);
+    extern bool     migrateBlooms     (blknum_t firstBlock, blknum_t lastBlock, bool removeOld);
+    extern bool     readBlooms        (blknum_t bn, SFBloomArray& blooms);
+    extern bool     forEveryBloom     (BLOOMVISITFUNC func, void *data, blknum_t start, blknum_t count);
+    extern bool     forEveryBloomFile (BLOOMVISITFUNC func, void *data, blknum_t start, blknum_t count, blknum_t skip = 1);
+
+}  // namespace qblocks
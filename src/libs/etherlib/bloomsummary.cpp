@@ -0,0 +1,319 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include "etherlib.h"
+#include "bloomsummary.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    const blknum_t summarySpans[BLOOM_SUMMARY_LEVELS] = { 100, 10000, 1000000 };
+
+    //--------------------------------------------------------------------------
+    void packBlooms(const CRawBloom *blooms, size_t n, CRawBloomArray& packed, size_t maxBits) {
+        for (size_t i = 0 ; i < n ; i++) {
+            if (!packed.empty()) {
+                CRawBloom joined = packed.back();
+                for (size_t w = 0 ; w < 32 ; w++)
+                    joined.words[w] |= blooms[i].words[w];
+                if (bitsTwiddled(joined) <= maxBits) {
+                    packed.back() = joined;
+                    continue;
+                }
+            }
+            packed.push_back(blooms[i]);
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    string_q bloomSummaryFolder(void) {
+        return bloomFolder + "segments/";
+    }
+
+    //--------------------------------------------------------------------------
+    CBloomSummary::CBloomSummary(void)
+        : scanBlooms(forEveryBloom), nSkipped(0), nTested(0), covered(0) {
+    }
+
+    //--------------------------------------------------------------------------
+    string_q CBloomSummary::levelPath(size_t level) const {
+        return folder + "summary." + asStringU(summarySpans[level]) + ".seg";
+    }
+
+    //--------------------------------------------------------------------------
+    // Missing levels are fine: they have no entries and update builds them. Without summary.toml
+    // the last entry of the lowest level may be incomplete, so only the ones before it are trusted.
+    bool CBloomSummary::open(const string_q& folderIn) {
+        close();
+        folder = folderIn;
+        tuning.load(tuningPath());
+        telemetry.load(telemetryPath());
+        bool ret = true;
+        for (size_t i = 0 ; i < BLOOM_SUMMARY_LEVELS ; i++)
+            ret = levels[i].open(levelPath(i)) && ret;
+
+        blknum_t nEntries = nNodes(0);
+        covered = (nEntries ? (nEntries - 1) * summarySpans[0] : 0);
+        if (fileExists(statePath())) {
+            CToml toml(statePath());
+            covered = toLongU(toml.getConfigStr("settings", "covered", "0"));
+        }
+        covered = min(covered, nEntries * summarySpans[0]);
+        return ret;
+    }
+
+    //--------------------------------------------------------------------------
+    void CBloomSummary::close(void) {
+        for (size_t i = 0 ; i < BLOOM_SUMMARY_LEVELS ; i++)
+            levels[i].close();
+    }
+
+    //--------------------------------------------------------------------------
+    // Collects an entry's blooms so its maxBits can be chosen once all of its blocks are seen
+    class CSummaryBuild {
+    public:
+        vector<CRawBloomArray> *nodes;
+        const CBloomTuning     *tuning;
+        CBloomTelemetry        *telemetry;
+        blknum_t                lastBlock;
+        blknum_t                node;
+        CRawBloomArray          pending;
+        uint64_t                nBits;
+
+        CSummaryBuild(void) : nodes(NULL), tuning(NULL), telemetry(NULL), lastBlock(0), node(0), nBits(0) { }
+        void flush(void);
+    };
+
+    //--------------------------------------------------------------------------
+    // Entries are sampled for the tuner once, when all of their blocks are in
+    void CSummaryBuild::flush(void) {
+        if (pending.empty())
+            return;
+        blknum_t span = summarySpans[0];
+        packBlooms(pending.data(), pending.size(), nodes->at(node), tuning->maxBitsFor(nBits, span));
+        if ((node + 1) * span - 1 <= lastBlock && node >= telemetry->sampledTo) {
+            telemetry->bands[densityBand(nBits, span)].add(pending.data(), pending.size());
+            telemetry->sampledTo = node + 1;
+        }
+        pending.clear();
+        nBits = 0;
+    }
+
+    //--------------------------------------------------------------------------
+    static bool packBlock(blknum_t bn, const CRawBloom *blooms, size_t nBlooms, void *data) {
+        CSummaryBuild *build = (CSummaryBuild*)data;  // NOLINT
+        blknum_t node = bn / summarySpans[0];
+        if (node >= build->nodes->size())
+            return true;
+        if (node != build->node) {
+            build->flush();
+            build->node = node;
+        }
+        build->pending.insert(build->pending.end(), blooms, blooms + nBlooms);
+        for (size_t i = 0 ; i < nBlooms ; i++)
+            build->nBits += bitsTwiddled(blooms[i]);
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    // Summarizes the blocks up to 'lastBlock'. The last entry of each level may have been written
+    // before its run of blocks was complete, so it is rebuilt along with everything after it.
+    bool CBloomSummary::update(blknum_t lastBlock) {
+        blknum_t lastScan = max(lastBlock, covered ? covered - 1 : 0);
+
+        vector<CRawBloomArray> nodes[BLOOM_SUMMARY_LEVELS];
+        blknum_t changed = 0;  // the first rebuilt entry of the level below
+        for (size_t level = 0 ; level < BLOOM_SUMMARY_LEVELS ; level++) {
+            const CBloomSegment& existing = levels[level];
+            blknum_t span = summarySpans[level];
+            blknum_t have = existing.nBlocks();
+            blknum_t need = lastScan / span + 1;
+            if (level)
+                need = max(need, (blknum_t)(nodes[level-1].size() - 1) * summarySpans[level-1] / span + 1);
+            nodes[level].resize(max(need, have));
+
+            blknum_t first = (level ? changed * summarySpans[level-1] / span : (have ? have - 1 : 0));
+            for (blknum_t i = 0 ; i < first && i < have ; i++) {
+                const CRawBloom *blooms;
+                size_t n = existing.getBlooms(i, blooms);
+                nodes[level][i].assign(blooms, blooms + n);
+            }
+
+            if (level == 0) {
+                CSummaryBuild build;
+                build.nodes     = &nodes[0];
+                build.tuning    = &tuning;
+                build.telemetry = &telemetry;
+                build.lastBlock = lastScan;
+                build.node      = first;
+                if (!(*scanBlooms)(packBlock, &build, first * span, lastScan - first * span + 1))
+                    return false;
+                build.flush();
+            } else {
+                // the entries below stand in for the blocks when measuring how busy they are
+                const vector<CRawBloomArray>& below = nodes[level-1];
+                blknum_t ratio = span / summarySpans[level-1];
+                for (blknum_t p = first ; p * ratio < below.size() ; p++) {
+                    blknum_t end = min((p + 1) * ratio, (blknum_t)below.size());
+                    uint64_t nBits = 0;
+                    for (blknum_t c = p * ratio ; c < end ; c++)
+                        for (size_t i = 0 ; i < below[c].size() ; i++)
+                            nBits += bitsTwiddled(below[c][i]);
+                    size_t maxBits = tuning.maxBitsFor(nBits, span);
+                    for (blknum_t c = p * ratio ; c < end ; c++)
+                        packBlooms(below[c].data(), below[c].size(), nodes[level][p], maxBits);
+                }
+            }
+            changed = first;
+        }
+
+        close();
+        for (size_t level = 0 ; level < BLOOM_SUMMARY_LEVELS ; level++)
+            if (!writeBloomSegment(levelPath(level), 0, nodes[level]))
+                return false;
+        // written after the summaries, so a crash in between leaves a count that is too small
+        CToml toml("");
+        toml.setFilename(statePath());
+        toml.setConfigInt("settings", "covered", lastScan + 1);
+        if (!toml.writeFile() || !saveTelemetry())
+            return false;
+        return open(folder);
+    }
+
+    //--------------------------------------------------------------------------
+    // Entries not yet written match everything so those blocks are still searched
+    bool CBloomSummary::nodeHits(size_t level, blknum_t node, const CRawBloom& query) const {
+        if (node >= levels[level].nBlocks())
+            return true;
+        const CRawBloom *blooms;
+        size_t n = levels[level].getBlooms(node, blooms);
+        for (size_t i = 0 ; i < n ; i++)
+            if (isBloomHit(query, blooms[i]))
+                return true;
+        return false;
+    }
+
+    //--------------------------------------------------------------------------
+    class CBloomSearch {
+    public:
+        const CRawBloom *query;
+        BLOOMVISITFUNC   func;
+        void            *data;
+        CBloomSummary   *summary;
+        uint64_t         nBlockHits;
+    };
+
+    //--------------------------------------------------------------------------
+    static bool testBlock(blknum_t bn, const CRawBloom *blooms, size_t nBlooms, void *data) {
+        CBloomSearch *search = (CBloomSearch*)data;  // NOLINT
+        search->summary->nTested++;
+        for (size_t i = 0 ; i < nBlooms ; i++) {
+            if (isBloomHit(*search->query, blooms[i])) {
+                search->nBlockHits++;
+                search->summary->telemetry.at(bn).nBlockHits++;
+                return (*search->func)(bn, blooms, nBlooms, search->data);
+            }
+        }
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    // An entry of the lowest level that matched is a false hit if none of its blocks did. The
+    // model's prediction is kept for every entry that was not a true hit.
+    bool CBloomSummary::testEntry(blknum_t node, blknum_t lo, blknum_t hi, bool hit, void *data) {
+        CBloomSearch *search = (CBloomSearch*)data;  // NOLINT
+        const CRawBloom *blooms;
+        size_t n = levels[0].getBlooms(node, blooms);
+        CBloomRangeStats& stats = telemetry.at(lo);
+        stats.nTested++;
+        if (!hit) {
+            stats.expected += falseMatchChance(blooms, n);
+            nSkipped += (hi - lo);
+            return true;
+        }
+
+        uint64_t before = search->nBlockHits;
+        bool ret = (*scanBlooms)(testBlock, search, lo, hi - lo);
+        if (search->nBlockHits > before) {
+            stats.nTrue++;
+        } else {
+            stats.nFalse++;
+            stats.expected += falseMatchChance(blooms, n);
+        }
+        return ret;
+    }
+
+    //--------------------------------------------------------------------------
+    bool CBloomSummary::descend(size_t level, blknum_t node, blknum_t from, blknum_t to, void *data) {
+        CBloomSearch *search = (CBloomSearch*)data;  // NOLINT
+        blknum_t span = summarySpans[level];
+        blknum_t lo = max(from, node * span), hi = min(to, (node + 1) * span);
+        if (lo >= hi)
+            return true;
+
+        bool hit = nodeHits(level, node, *search->query);
+        if (level == 0)
+            return testEntry(node, lo, hi, hit, search);
+
+        if (!hit) {
+            nSkipped += (hi - lo);
+            return true;
+        }
+
+        blknum_t childSpan = summarySpans[level-1];
+        for (blknum_t child = lo / childSpan ; child * childSpan < hi ; child++)
+            if (!descend(level - 1, child, lo, hi, search))
+                return false;
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    // Visits the blocks in [start, start + count) whose blooms may hold everything in 'query',
+    // in block order. Blocks past the summaries are tested one by one.
+    bool CBloomSummary::forEveryHit(const CRawBloom& query, BLOOMVISITFUNC func, void *data,
+                                        blknum_t start, blknum_t count) {
+        if (!func)
+            return false;
+
+        CBloomSearch search;
+        search.query      = &query;
+        search.func       = func;
+        search.data       = data;
+        search.summary    = this;
+        search.nBlockHits = 0;
+
+        blknum_t stop = (count == NOPOS ? NOPOS : start + count);
+        blknum_t summed = min(stop, covered);
+        size_t top = BLOOM_SUMMARY_LEVELS - 1;
+        for (blknum_t node = start / summarySpans[top] ; node * summarySpans[top] < summed ; node++)
+            if (!descend(top, node, start, summed, &search))
+                return false;
+
+        if (stop <= covered)
+            return true;
+        blknum_t from = max(start, covered);
+        return (*scanBlooms)(testBlock, &search, from, (count == NOPOS ? NOPOS : stop - from));
+    }
+
+    //--------------------------------------------------------------------------
+    // Chooses the maxBits for summaries built from now on. Entries already written keep theirs.
+    bool CBloomSummary::tune(void) {
+        tuneBlooms(telemetry, tuning);
+        return tuning.save(tuningPath()) && saveTelemetry();
+    }
+
+    //--------------------------------------------------------------------------
+    bool CBloomSummary::saveTelemetry(void) const {
+        return telemetry.save(telemetryPath());
+    }
+
+}  // namespace qblocks
@@ -0,0 +1,82 @@
+#pragma once
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include "bloomtune.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    // Three levels of summaries, over 100, 10,000 and 1,000,000 blocks
+    #define BLOOM_SUMMARY_LEVELS 3
+    extern const blknum_t summarySpans[BLOOM_SUMMARY_LEVELS];
+
+    //--------------------------------------------------------------------------
+    typedef bool (*BLOOMSCANFUNC)(BLOOMVISITFUNC func, void *data, blknum_t start, blknum_t count);
+
+    //--------------------------------------------------------------------------
+    // ORs each bloom into the last packed bloom unless that would set more than 'maxBits' bits,
+    // in which case it starts a new one
+    extern void packBlooms(const CRawBloom *blooms, size_t n, CRawBloomArray& packed, size_t maxBits);
+
+    //--------------------------------------------------------------------------
+    // Summaries of the per-block blooms over ever larger runs of blocks, so a search for an
+    // address only reads the blooms of blocks in runs whose summary matches. ORing a million
+    // blocks into one bloom would set every bit, so a summary is a list of blooms, each filled
+    // to at most 'maxBits' bits, which depends on how busy the blocks are (see bloomtune.h). Each
+    // level is a segment file (blooms/segments/summary.<span>.seg) whose i-th entry summarizes
+    // blocks i * span up to (i + 1) * span. The last entry may stop part way through its span;
+    // summary.toml records how many blocks were summarized so a search tests the rest one by one.
+    //--------------------------------------------------------------------------
+    class CBloomSummary {
+    public:
+        BLOOMSCANFUNC    scanBlooms;  // where the per-block blooms come from (forEveryBloom)
+        uint64_t         nSkipped;    // blocks passed over because a summary did not match
+        uint64_t         nTested;     // blocks whose own blooms were tested
+        CBloomTuning     tuning;      // maxBits by density band (tuning.toml)
+        CBloomTelemetry  telemetry;   // counts from building and searching (telemetry.toml)
+
+                 CBloomSummary  (void);
+
+        bool     open           (const string_q& folder);
+        void     close          (void);
+        size_t   nNodes         (size_t level) const { return levels[level].nBlocks(); }
+        blknum_t nCovered       (void) const { return covered; }
+
+        bool     update         (blknum_t lastBlock);
+        bool     forEveryHit    (const CRawBloom& query, BLOOMVISITFUNC func, void *data,
+                                        blknum_t start, blknum_t count);
+
+        bool     tune           (void);
+        bool     saveTelemetry  (void) const;
+
+    private:
+        string_q       folder;
+        CBloomSegment  levels[BLOOM_SUMMARY_LEVELS];
+        blknum_t       covered;  // blocks 0 up to here are summarized
+
+        bool     nodeHits       (size_t level, blknum_t node, const CRawBloom& query) const;
+        bool     descend        (size_t level, blknum_t node, blknum_t from, blknum_t to, void *search);
+        bool     testEntry      (blknum_t node, blknum_t lo, blknum_t hi, bool hit, void *search);
+        string_q levelPath      (size_t level) const;
+        string_q statePath      (void) const { return folder + "summary.toml"; }
+        string_q tuningPath     (void) const { return folder + "tuning.toml"; }
+        string_q telemetryPath  (void) const { return folder + "telemetry.toml"; }
+
+        CBloomSummary(const CBloomSummary&);
+        CBloomSummary& operator=(const CBloomSummary&);
+    };
+
+    //--------------------------------------------------------------------------
+    extern string_q bloomSummaryFolder(void);
+
+}  // namespace qblocks
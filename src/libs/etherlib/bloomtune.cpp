@@ -0,0 +1,224 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include "etherlib.h"
+#include "bloomtune.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    // Bits per block: fewer than 32, 128, 512, or more
+    const uint64_t bandLimits[BLOOM_BANDS - 1] = { 32, 128, 512 };
+    const size_t maxBitsCandidates[BLOOM_CANDIDATES] = { 64, 128, 256, 384, 512, 768, 1024, 1536 };
+
+    //--------------------------------------------------------------------------
+    size_t densityBand(uint64_t nBits, blknum_t nBlocks) {
+        uint64_t perBlock = (nBlocks ? nBits / nBlocks : 0);
+        for (size_t i = 0 ; i < BLOOM_BANDS - 1 ; i++)
+            if (perBlock < bandLimits[i])
+                return i;
+        return BLOOM_BANDS - 1;
+    }
+
+    //--------------------------------------------------------------------------
+    // An address sets three bits, each of which is set in a bloom holding 'bits' bits with a
+    // chance of bits / 2048
+    double falseMatchChance(const CRawBloom *blooms, size_t n) {
+        double miss = 1.;
+        for (size_t i = 0 ; i < n ; i++) {
+            double fill = bitsTwiddled(blooms[i]) / 2048.;
+            miss *= (1. - fill * fill * fill);
+        }
+        return 1. - miss;
+    }
+
+    //--------------------------------------------------------------------------
+    CBloomBandSample::CBloomBandSample(void) : nNodes(0), nBlooms(0) {
+        for (size_t c = 0 ; c < BLOOM_CANDIDATES ; c++) {
+            nPacked[c] = 0;
+            expected[c] = 0.;
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    void CBloomBandSample::add(const CRawBloom *blooms, size_t n) {
+        nNodes++;
+        nBlooms += n;
+        for (size_t c = 0 ; c < BLOOM_CANDIDATES ; c++) {
+            CRawBloomArray packed;
+            packBlooms(blooms, n, packed, maxBitsCandidates[c]);
+            nPacked[c] += packed.size();
+            expected[c] += falseMatchChance(packed.data(), packed.size());
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    static uint64_t tomlUint(const CToml& toml, const string_q& group, const string_q& key) {
+        return toLongU(toml.getConfigStr(group, key, "0"));
+    }
+
+    //--------------------------------------------------------------------------
+    static double tomlDouble(const CToml& toml, const string_q& group, const string_q& key) {
+        return str2Double(toml.getConfigStr(group, key, "0"));
+    }
+
+    //--------------------------------------------------------------------------
+    bool CBloomTelemetry::load(const string_q& fileName) {
+        ranges.clear();
+        for (size_t b = 0 ; b < BLOOM_BANDS ; b++)
+            bands[b] = CBloomBandSample();
+        sampledTo = 0;
+        if (!fileExists(fileName))
+            return false;
+
+        CToml toml(fileName);
+        sampledTo = tomlUint(toml, "settings", "sampledTo");
+        for (size_t b = 0 ; b < BLOOM_BANDS ; b++) {
+            string_q group = "band_" + asStringU(b);
+            bands[b].nNodes  = tomlUint(toml, group, "nNodes");
+            bands[b].nBlooms = tomlUint(toml, group, "nBlooms");
+            for (size_t c = 0 ; c < BLOOM_CANDIDATES ; c++) {
+                string_q bits = asStringU(maxBitsCandidates[c]);
+                bands[b].nPacked[c]  = tomlUint(toml, group, "nPacked_" + bits);
+                bands[b].expected[c] = tomlDouble(toml, group, "expected_" + bits);
+            }
+        }
+
+        for (size_t i = 0 ; i < toml.groups.size() ; i++) {
+            const string_q& group = toml.groups[i].groupName;
+            if (!startsWith(group, "range_"))
+                continue;
+            CBloomRangeStats& stats = ranges[toLongU(substitute(group, "range_", ""))];
+            stats.nTested     = tomlUint  (toml, group, "nTested");
+            stats.nTrue       = tomlUint  (toml, group, "nTrue");
+            stats.nFalse      = tomlUint  (toml, group, "nFalse");
+            stats.expected    = tomlDouble(toml, group, "expected");
+            stats.nBlockHits  = tomlUint  (toml, group, "nBlockHits");
+            stats.nBlockFalse = tomlUint  (toml, group, "nBlockFalse");
+        }
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    bool CBloomTelemetry::save(const string_q& fileName) const {
+        string_q created;
+        if (!establishFolder(fileName, created))
+            return false;
+
+        CToml toml("");
+        toml.setFilename(fileName);
+        toml.setConfigInt("settings", "sampledTo", sampledTo);
+        for (size_t b = 0 ; b < BLOOM_BANDS ; b++) {
+            string_q group = "band_" + asStringU(b);
+            toml.setConfigInt(group, "nNodes",  bands[b].nNodes);
+            toml.setConfigInt(group, "nBlooms", bands[b].nBlooms);
+            for (size_t c = 0 ; c < BLOOM_CANDIDATES ; c++) {
+                string_q bits = asStringU(maxBitsCandidates[c]);
+                toml.setConfigInt(group, "nPacked_" + bits, bands[b].nPacked[c]);
+                toml.setConfigStr(group, "expected_" + bits, double2Str(bands[b].expected[c]));
+            }
+        }
+
+        for (map<blknum_t, CBloomRangeStats>::const_iterator it = ranges.begin() ; it != ranges.end() ; ++it) {
+            string_q group = "range_" + asStringU(it->first);
+            toml.setConfigInt(group, "nTested",     it->second.nTested);
+            toml.setConfigInt(group, "nTrue",       it->second.nTrue);
+            toml.setConfigInt(group, "nFalse",      it->second.nFalse);
+            toml.setConfigStr(group, "expected",    double2Str(it->second.expected));
+            toml.setConfigInt(group, "nBlockHits",  it->second.nBlockHits);
+            toml.setConfigInt(group, "nBlockFalse", it->second.nBlockFalse);
+        }
+        return toml.writeFile();
+    }
+
+    //--------------------------------------------------------------------------
+    CBloomTuning::CBloomTuning(void) : correction(1.) {
+        for (size_t b = 0 ; b < BLOOM_BANDS ; b++) {
+            maxBits[b] = 512;
+            nBlooms[b] = 0.;
+            cost[b]    = 0.;
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    bool CBloomTuning::load(const string_q& fileName) {
+        *this = CBloomTuning();
+        if (!fileExists(fileName))
+            return false;
+
+        CToml toml(fileName);
+        correction = str2Double(toml.getConfigStr("settings", "correction", "1"));
+        for (size_t b = 0 ; b < BLOOM_BANDS ; b++) {
+            string_q group = "band_" + asStringU(b);
+            maxBits[b] = toml.getConfigInt(group, "maxBits", maxBits[b]);
+            nBlooms[b] = tomlDouble(toml, group, "nBlooms");
+            cost[b]    = tomlDouble(toml, group, "cost");
+        }
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    bool CBloomTuning::save(const string_q& fileName) const {
+        string_q created;
+        if (!establishFolder(fileName, created))
+            return false;
+
+        CToml toml("");
+        toml.setFilename(fileName);
+        toml.setConfigStr("settings", "correction", double2Str(correction, 4));
+        for (size_t b = 0 ; b < BLOOM_BANDS ; b++) {
+            string_q group = "band_" + asStringU(b);
+            toml.setConfigInt(group, "maxBits", maxBits[b]);
+            toml.setConfigStr(group, "nBlooms", double2Str(nBlooms[b], 2));
+            toml.setConfigStr(group, "cost",    double2Str(cost[b], 0));
+        }
+        return toml.writeFile();
+    }
+
+    //--------------------------------------------------------------------------
+    // Too few false hits to measure leaves the model as it is
+    #define MIN_MEASURED 20.
+
+    //--------------------------------------------------------------------------
+    void tuneBlooms(const CBloomTelemetry& telemetry, CBloomTuning& tuning) {
+        uint64_t nFalse = 0;
+        double expected = 0.;
+        for (map<blknum_t, CBloomRangeStats>::const_iterator it = telemetry.ranges.begin() ;
+                it != telemetry.ranges.end() ; ++it) {
+            nFalse   += it->second.nFalse;
+            expected += it->second.expected;
+        }
+        tuning.correction = 1.;
+        if (expected >= MIN_MEASURED || nFalse >= MIN_MEASURED)
+            tuning.correction = min(4., max(.25, nFalse / max(expected, 1.)));
+
+        for (size_t b = 0 ; b < BLOOM_BANDS ; b++) {
+            const CBloomBandSample& band = telemetry.bands[b];
+            if (!band.nNodes)
+                continue;
+
+            // an entry's packed blooms are always read, its blocks' blooms only on a hit
+            double rawBlooms = double(band.nBlooms) / band.nNodes;
+            for (size_t c = 0 ; c < BLOOM_CANDIDATES ; c++) {
+                double packed = double(band.nPacked[c]) / band.nNodes;
+                double falseHit = min(1., tuning.correction * band.expected[c] / band.nNodes);
+                double cost = (packed + falseHit * rawBlooms) * sizeof(CRawBloom);
+                if (c == 0 || cost < tuning.cost[b]) {
+                    tuning.maxBits[b] = maxBitsCandidates[c];
+                    tuning.nBlooms[b] = packed;
+                    tuning.cost[b]    = cost;
+                }
+            }
+        }
+    }
+
+}  // namespace qblocks
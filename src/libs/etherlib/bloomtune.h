@@ -0,0 +1,105 @@
+#pragma once
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include "bloomsegment.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    // Summary entries are grouped by how many bits their blocks' blooms set per block. Each
+    // band gets its own maxBits.
+    #define BLOOM_BANDS 4
+    extern const uint64_t bandLimits[BLOOM_BANDS - 1];
+    extern size_t densityBand(uint64_t nBits, blknum_t nBlocks);
+
+    //--------------------------------------------------------------------------
+    // The maxBits the tuner chooses from
+    #define BLOOM_CANDIDATES 8
+    extern const size_t maxBitsCandidates[BLOOM_CANDIDATES];
+
+    //--------------------------------------------------------------------------
+    // The chance that an address not in any of 'blooms' matches at least one of them
+    extern double falseMatchChance(const CRawBloom *blooms, size_t n);
+
+    //--------------------------------------------------------------------------
+    // What searches found in one range of BLOOM_SEGMENT_SIZE blocks. A summary entry is a true
+    // hit if one of its blocks' own blooms also matched, and a false hit if none did. 'expected'
+    // is the number of false hits the model predicted for the entries that were not true hits.
+    class CBloomRangeStats {
+    public:
+        uint64_t nTested;
+        uint64_t nTrue;
+        uint64_t nFalse;
+        double   expected;
+        uint64_t nBlockHits;   // blocks whose own blooms matched
+        uint64_t nBlockFalse;  // of those, blocks the caller read and found nothing in
+
+        CBloomRangeStats(void) : nTested(0), nTrue(0), nFalse(0), expected(0.),
+                                    nBlockHits(0), nBlockFalse(0) { }
+    };
+
+    //--------------------------------------------------------------------------
+    // Complete summary entries of one density band, and how they would have packed at each of
+    // the candidate maxBits
+    class CBloomBandSample {
+    public:
+        uint64_t nNodes;
+        uint64_t nBlooms;                     // per-block blooms in those entries
+        uint64_t nPacked[BLOOM_CANDIDATES];
+        double   expected[BLOOM_CANDIDATES];  // sum of falseMatchChance of the packed entries
+
+        CBloomBandSample(void);
+        void add(const CRawBloom *blooms, size_t n);
+    };
+
+    //--------------------------------------------------------------------------
+    // Counts gathered while building and searching the summaries. Kept in telemetry.toml
+    // next to the summaries and added to by each run.
+    class CBloomTelemetry {
+    public:
+        map<blknum_t, CBloomRangeStats> ranges;  // by the first block of the range
+        CBloomBandSample                bands[BLOOM_BANDS];
+        blknum_t                        sampledTo;  // summary entries below this are in 'bands'
+
+        CBloomTelemetry(void) : sampledTo(0) { }
+
+        CBloomRangeStats& at        (blknum_t bn) { return ranges[bn - (bn % BLOOM_SEGMENT_SIZE)]; }
+        void              confirmHit(blknum_t bn, bool found) { if (!found) at(bn).nBlockFalse++; }
+        bool              load      (const string_q& fileName);
+        bool              save      (const string_q& fileName) const;
+    };
+
+    //--------------------------------------------------------------------------
+    // The maxBits chosen for each density band, with the blooms per summary entry and the
+    // bytes read per entry (by a search for an address that is not there) expected from it.
+    // Kept in tuning.toml next to the summaries.
+    class CBloomTuning {
+    public:
+        size_t maxBits   [BLOOM_BANDS];
+        double nBlooms   [BLOOM_BANDS];
+        double cost      [BLOOM_BANDS];
+        double correction;  // measured false hits over the model's prediction
+
+        CBloomTuning(void);
+
+        size_t maxBitsFor(uint64_t nBits, blknum_t nBlocks) const { return maxBits[densityBand(nBits, nBlocks)]; }
+        bool   load      (const string_q& fileName);
+        bool   save      (const string_q& fileName) const;
+    };
+
+    //--------------------------------------------------------------------------
+    // Picks for each sampled band the maxBits with the fewest expected bytes read per entry.
+    // The model's false hit rate is scaled by what the searches measured.
+    extern void tuneBlooms(const CBloomTelemetry& telemetry, CBloomTuning& tuning);
+
+}  // namespace qblocks
@@ -19,13 +19,23 @@
 #include "logentry.h"
 #include "pricequote.h"
 #include "pricesource.h"
+#include "priceseries.h"
 #include "trace.h"
 #include "traceaction.h"
 #include "traceresult.h"
 #include "rpcresult.h"
 #include "miniblock.h"
 #include "node.h"
+#include "blockcompress.h"
 #include "blooms.h"
+#include "bloomsegment.h"
+#include "bloomtune.h"
+#include "bloomsummary.h"
+#include "bloomscan.h"
 #include "blockoptions.h"
+#include "logindex.h"
+#include "node_ipc.h"
+#include "rpccache.h"
+#include "toolserver.h"
 
 using namespace qblocks;  // NOLINT
@@ -125,8 +125,13 @@ void CFunction::finishParse() {
     // EXISTING_CODE
     for (size_t i = 0 ; i < inputs.size() ; i++)
         hasAddrs |= (inputs[i].type == "address");
-    signature = getSignature(SIG_CANONICAL);
-    encoding  = encodeItem();
+    // The encoding is a hash of the signature (a call to the node), so it is only recomputed if
+    // the signature changed. Copies and functions read from the ABI store keep their encoding.
+    string_q sig = getSignature(SIG_CANONICAL);
+    if (encoding.empty() || sig != signature) {
+        signature = sig;
+        encoding  = encodeItem();
+    }
     // The input parameters need to have a name. If not, we provide one
     int cnt = 0;
     for (size_t i = 0 ; i < inputs.size() ; i++) {
@@ -148,15 +153,16 @@ bool CFunction::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> name;
-    archive >> type;
-    archive >> anonymous;
-    archive >> constant;
-    archive >> payable;
-    archive >> signature;
-    archive >> encoding;
-    archive >> inputs;
-    archive >> outputs;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(CFunction), 9);
+    fields >> name;
+    fields >> type;
+    fields >> anonymous;
+    fields >> constant;
+    fields >> payable;
+    fields >> signature;
+    fields >> encoding;
+    fields >> inputs;
+    fields >> outputs;
     finishParse();
     return true;
 }
@@ -106,10 +106,11 @@ bool CLogEntry::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> address;
-    archive >> data;
-    archive >> logIndex;
-    archive >> topics;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(CLogEntry), 4);
+    fields >> address;
+    fields >> data;
+    fields >> logIndex;
+    fields >> topics;
     finishParse();
     return true;
 }
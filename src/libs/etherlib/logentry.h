@@ -45,6 +45,7 @@ public:
 
     // EXISTING_CODE
     const CReceipt *pReceipt;
+    friend class CBlock;
     // EXISTING_CODE
     friend bool operator<(const CLogEntry& v1, const CLogEntry& v2);
     friend ostream& operator<<(ostream& os, const CLogEntry& item);
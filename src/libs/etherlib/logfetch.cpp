@@ -0,0 +1,298 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <algorithm>
+#include "logfetch.h"
+
+namespace qblocks {
+
+    //-------------------------------------------------------------------------
+    CLogFetcher::CLogFetcher(void)
+        : chunk(5000), minChunk(1), maxChunk(500000), width(4),
+          targetLogs(2000), maxBytes(8 * 1024 * 1024), sendRequests(callRPCMany),
+          nRequests(0), nSplits(0) {
+    }
+
+    //-------------------------------------------------------------------------
+    string_q CLogFetcher::getParams(blknum_t start, blknum_t end) const {
+        string_q ret = "[{\"fromBlock\":\"" + toHex(start) + "\",\"toBlock\":\"" + toHex(end) + "\"";
+        if (addresses.size() == 1) {
+            ret += ",\"address\":\"" + addresses[0] + "\"";
+        } else if (addresses.size() > 1) {
+            ret += ",\"address\":[";
+            for (size_t i = 0 ; i < addresses.size() ; i++)
+                ret += (i ? ",\"" : "\"") + addresses[i] + "\"";
+            ret += "]";
+        }
+        if (!topic.empty())
+            ret += ",\"topics\":[\"" + topic + "\"]";
+        return ret + "}]";
+    }
+
+    //-------------------------------------------------------------------------
+    // False if the node refused the request (an error, a time out or no result at all)
+    bool parseLogs(const string_q& response, CFetchedLogArray& logs) {
+        logs.clear();
+        CJsonStream stream;
+        stream.reset(response.length());
+        stream.feed(response.c_str(), response.length());
+        const string_q& cleaned = stream.cleaned;
+        if (!contains(cleaned, "result:") || contains(cleaned, "{error:") || contains(cleaned, ",error:"))
+            return false;
+
+        string_q result = stream.getResult();
+        char *p = (char*)result.c_str();  // NOLINT
+        while (p && *p) {
+            logs.resize(logs.size() + 1);
+            CFetchedLog& item = logs.back();
+            item.trans.receipt.pTrans = &item.trans;
+            item.log.pReceipt = &item.trans.receipt;
+            size_t nFields = 0;
+            p = item.log.parseJson(p, nFields);
+            item.log.pReceipt = NULL;
+            item.trans.receipt.pTrans = NULL;
+            if (!nFields)
+                logs.pop_back();
+        }
+        return true;
+    }
+
+    //-------------------------------------------------------------------------
+    class CLogPiece {
+    public:
+        blknum_t         first;
+        blknum_t         last;
+        CFetchedLogArray logs;
+        CLogPiece(blknum_t f = 0, blknum_t l = 0) : first(f), last(l) { }
+    };
+
+    //-------------------------------------------------------------------------
+    static bool sortByFirst(const CLogPiece& a, const CLogPiece& b) {
+        return a.first < b.first;
+    }
+
+    //-------------------------------------------------------------------------
+    // Each round asks for up to 'width' pieces: refused pieces first (they are the earliest),
+    // then new ones from where the last new piece ended. Answered pieces wait in 'answered'
+    // until every earlier piece has been answered, then their logs go to the visitor.
+    bool CLogFetcher::fetch(blknum_t start, blknum_t end, LOGVISITFUNC func, void *data) {
+        if (!func || start > end)
+            return true;
+
+        vector<CLogPiece> refused;
+        map<blknum_t, CLogPiece> answered;
+        blknum_t cursor = start;    // the first block not yet asked for
+        blknum_t nextEmit = start;  // the first block not yet visited
+        while (nextEmit <= end) {
+
+            vector<CLogPiece> round;
+            while (round.size() < width && !refused.empty()) {
+                round.push_back(refused.front());
+                refused.erase(refused.begin());
+            }
+            while (round.size() < width && cursor <= end) {
+                blknum_t last = (end - cursor < chunk ? end : cursor + max(chunk, (blknum_t)1) - 1);
+                round.push_back(CLogPiece(cursor, last));
+                cursor = last + 1;
+            }
+
+            CRPCRequestArray requests;
+            for (size_t i = 0 ; i < round.size() ; i++)
+                requests.push_back(CRPCRequest("eth_getLogs", getParams(round[i].first, round[i].last)));
+            CStringArray responses;
+            (*sendRequests)(requests, responses, true);
+            nRequests += requests.size();
+
+            bool tooBig = false, sparse = true;
+            for (size_t i = 0 ; i < round.size() ; i++) {
+                CLogPiece& piece = round[i];
+                blknum_t span = piece.last - piece.first + 1;
+                if (i >= responses.size() || !parseLogs(responses[i], piece.logs)) {
+                    if (span == 1) {
+                        cerr << "eth_getLogs failed for block " << piece.first << ". Quitting...\n";
+                        return false;
+                    }
+                    blknum_t mid = piece.first + span / 2;
+                    refused.push_back(CLogPiece(piece.first, mid - 1));
+                    refused.push_back(CLogPiece(mid, piece.last));
+                    chunk = max(minChunk, min(chunk, span / 2));
+                    nSplits++;
+                    sparse = false;
+                    continue;
+                }
+                if (piece.logs.size() > targetLogs || responses[i].length() > maxBytes)
+                    tooBig = true;
+                if (piece.logs.size() * 4 >= targetLogs)
+                    sparse = false;
+                CLogPiece& dest = answered[piece.first];
+                dest.first = piece.first;
+                dest.last  = piece.last;
+                dest.logs.swap(piece.logs);
+            }
+            sort(refused.begin(), refused.end(), sortByFirst);
+
+            if (tooBig)
+                chunk = max(minChunk, chunk / 2);
+            else if (sparse)
+                chunk = min(maxChunk, chunk * 2);
+
+            while (!answered.empty() && answered.begin()->first == nextEmit) {
+                CLogPiece& piece = answered.begin()->second;
+                for (size_t i = 0 ; i < piece.logs.size() ; i++) {
+                    CFetchedLog& item = piece.logs[i];
+                    item.trans.receipt.pTrans = &item.trans;
+                    item.log.pReceipt = &item.trans.receipt;
+                    if (!(*func)(item.log, data))
+                        return false;
+                }
+                nextEmit = piece.last + 1;
+                answered.erase(answered.begin());
+            }
+        }
+        return true;
+    }
+
+    //-------------------------------------------------------------------------
+    CBloomLogReader::CBloomLogReader(void)
+        : width(100), sendRequests(callRPCMany), nBlocks(0), nReceipts(0), nParsed(0) {
+        bzero(&topicBloom, sizeof(topicBloom));
+    }
+
+    //-------------------------------------------------------------------------
+    bool CBloomLogReader::mayHold(const CRawBloom& bloom) const {
+        bool ret = addressBlooms.empty();
+        for (size_t i = 0 ; i < addressBlooms.size() && !ret ; i++)
+            ret = isBloomHit(addressBlooms[i], bloom);
+        return ret && (topic.empty() || isBloomHit(topicBloom, bloom));
+    }
+
+    //-------------------------------------------------------------------------
+    // A bloom's match may be false, so the logs themselves are checked
+    bool CBloomLogReader::isMatch(const CLogEntry& log) const {
+        if (!topic.empty() && (log.topics.empty() || fromTopic(log.topics[0]) != toLower(topic)))
+            return false;
+        if (addresses.empty())
+            return true;
+        for (size_t i = 0 ; i < addresses.size() ; i++)
+            if (toLower(addresses[i]) == toLower(log.address))
+                return true;
+        return false;
+    }
+
+    //-------------------------------------------------------------------------
+    // Where the value of 'name' starts in a node's response, whether or not it is still quoted
+    static size_t valueStart(const string_q& json, const string_q& name) {
+        size_t pos = json.find(name);
+        while (pos != string::npos) {
+            size_t p = pos + name.length();
+            if (p < json.length() && json[p] == '"')
+                p++;
+            if (p < json.length() && json[p] == ':') {
+                p++;
+                while (p < json.length() && (json[p] == ' ' || json[p] == '"'))
+                    p++;
+                return p;
+            }
+            pos = json.find(name, pos + 1);
+        }
+        return string::npos;
+    }
+
+    //-------------------------------------------------------------------------
+    static bool readBloom(const string_q& json, CRawBloom& bloom) {
+        size_t start = valueStart(json, "logsBloom");
+        if (start == string::npos)
+            return false;
+        size_t end = json.find_first_of("\",}] ", start);
+        return hexToRaw(extract(json, start, (end == string::npos ? json.length() : end) - start), bloom);
+    }
+
+    //-------------------------------------------------------------------------
+    // A block asked for without its transactions lists their hashes
+    static void readHashes(const string_q& json, CStringArray& hashes) {
+        size_t start = valueStart(json, "transactions");
+        if (start == string::npos || json[start] != '[')
+            return;
+        size_t end = json.find(']', start);
+        string_q list = extract(json, start + 1, (end == string::npos ? json.length() : end) - start - 1);
+        while (!list.empty()) {
+            string_q hash = trim(substitute(nextTokenClear(list, ','), "\"", ""));
+            if (isHash(hash))
+                hashes.push_back(hash);
+        }
+    }
+
+    //-------------------------------------------------------------------------
+    // Each round asks for 'width' blocks (without their transactions), then for the receipts
+    // of the blocks whose logsBloom may match, then parses the receipts whose logsBloom does.
+    bool CBloomLogReader::read(blknum_t start, blknum_t end, LOGVISITFUNC func, void *data) {
+        if (!func || start > end)
+            return true;
+
+        if (addressBlooms.empty()) {
+            for (size_t i = 0 ; i < addresses.size() ; i++) {
+                CRawBloom bloom;
+                bloomToRaw(makeBloom(toLower(addresses[i])), bloom);
+                addressBlooms.push_back(bloom);
+            }
+        }
+        if (!topic.empty() && !bitsTwiddled(topicBloom))
+            bloomToRaw(makeBloom(toLower(topic)), topicBloom);
+
+        for (blknum_t first = start ; first <= end ; first += max(width, (size_t)1)) {
+            blknum_t last = min(end, first + max(width, (size_t)1) - 1);
+
+            CRPCRequestArray requests;
+            for (blknum_t bn = first ; bn <= last ; bn++)
+                requests.push_back(CRPCRequest("eth_getBlockByNumber", "[" + quote(toHex(bn)) + ",false]"));
+            CStringArray blocks;
+            (*sendRequests)(requests, blocks, false);
+            nBlocks += requests.size();
+
+            CRPCRequestArray receiptRequests;
+            for (size_t i = 0 ; i < requests.size() ; i++) {
+                CRawBloom bloom;
+                if (i >= blocks.size() || !readBloom(blocks[i], bloom)) {
+                    cerr << "Could not read the logsBloom of block " << (first + i) << ". Quitting...\n";
+                    return false;
+                }
+                if (!mayHold(bloom))
+                    continue;
+                CStringArray hashes;
+                readHashes(blocks[i], hashes);
+                for (size_t h = 0 ; h < hashes.size() ; h++)
+                    receiptRequests.push_back(CRPCRequest("eth_getTransactionReceipt", "[" + quote(hashes[h]) + "]"));
+            }
+            CStringArray receipts;
+            (*sendRequests)(receiptRequests, receipts, false);
+            nReceipts += receiptRequests.size();
+
+            for (size_t r = 0 ; r < receipts.size() ; r++) {
+                CRawBloom bloom;
+                if (!readBloom(receipts[r], bloom) || !mayHold(bloom))
+                    continue;
+                nParsed++;
+                CTransaction trans;
+                trans.receipt.pTrans = &trans;
+                trans.receipt.parseJson((char *)receipts[r].c_str());  // NOLINT
+                for (size_t l = 0 ; l < trans.receipt.logs.size() ; l++) {
+                    CLogEntry& log = trans.receipt.logs[l];
+                    log.pReceipt = &trans.receipt;
+                    if (isMatch(log) && !(*func)(log, data))
+                        return false;
+                }
+            }
+        }
+        return true;
+    }
+
+}  // namespace qblocks
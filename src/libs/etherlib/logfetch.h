@@ -0,0 +1,86 @@
+#pragma once
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include "node.h"
+
+namespace qblocks {
+
+    //-------------------------------------------------------------------------
+    typedef bool (*RPCMANYFUNC)(const CRPCRequestArray& requests, CStringArray& results, bool raw);
+
+    //-------------------------------------------------------------------------
+    // Pulls an address's (or a topic's) logs from the node with eth_getLogs. Rather than one
+    // request for the whole range, which a busy contract turns into a time out or an enormous
+    // response, the range is asked for in pieces, several at a time. A piece the node refuses
+    // is split in two and asked for again. The size of the next pieces halves when a response
+    // is too large and doubles while responses are sparse. The logs reach the visitor in block
+    // order no matter in which order the pieces are answered.
+    //-------------------------------------------------------------------------
+    class CLogFetcher {
+    public:
+        SFAddressArray addresses;  // empty for any address
+        string_q       topic;      // the first topic to match, empty for any
+        blknum_t       chunk;      // blocks asked for in the next piece
+        blknum_t       minChunk;
+        blknum_t       maxChunk;
+        size_t         width;      // pieces asked for at once
+        size_t         targetLogs; // responses with more logs shrink the pieces, a quarter as many grow them
+        size_t         maxBytes;   // responses larger than this shrink the pieces
+        RPCMANYFUNC    sendRequests;
+
+        size_t         nRequests;
+        size_t         nSplits;
+
+                 CLogFetcher (void);
+        bool     fetch       (blknum_t start, blknum_t end, LOGVISITFUNC func, void *data);  // 'end' included
+        string_q getParams   (blknum_t start, blknum_t end) const;
+    };
+
+    //-------------------------------------------------------------------------
+    // The same query for nodes that do not answer eth_getLogs (or answer it slowly). Each
+    // block's logsBloom is checked before any of its receipts is asked for, and each
+    // receipt's logsBloom before its logs are parsed, so a block that cannot hold a match
+    // costs one small request and a contract that rarely logs costs little more than that.
+    //-------------------------------------------------------------------------
+    class CBloomLogReader {
+    public:
+        SFAddressArray addresses;     // empty for any address
+        string_q       topic;         // the first topic to match, empty for any
+        size_t         width;         // blocks asked for at once
+        RPCMANYFUNC    sendRequests;
+        CRawBloomArray addressBlooms; // made from 'addresses' by read() if empty
+        CRawBloom      topicBloom;    // made from 'topic' by read() if empty
+
+        size_t         nBlocks;       // blocks whose logsBloom was checked
+        size_t         nReceipts;     // receipts asked for
+        size_t         nParsed;       // receipts whose logs were parsed
+
+                 CBloomLogReader (void);
+        bool     read            (blknum_t start, blknum_t end, LOGVISITFUNC func, void *data);  // 'end' included
+        bool     mayHold         (const CRawBloom& bloom) const;
+        bool     isMatch         (const CLogEntry& log) const;
+    };
+
+    //-------------------------------------------------------------------------
+    // A log from eth_getLogs. The transaction carries its block number, transaction index and hash.
+    class CFetchedLog {
+    public:
+        CTransaction trans;
+        CLogEntry    log;
+    };
+    typedef vector<CFetchedLog> CFetchedLogArray;
+
+    //-------------------------------------------------------------------------
+    extern bool parseLogs(const string_q& response, CFetchedLogArray& logs);
+
+}  // namespace qblocks
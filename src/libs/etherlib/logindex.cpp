@@ -0,0 +1,448 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <algorithm>
+#include "logindex.h"
+#include "node.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    static const char indexMagic[8] = { 'Q', 'B', 'L', 'O', 'G', 'I', 'X', '1' };
+
+    //--------------------------------------------------------------------------
+    string_q logIndexPath(void) {
+        return blockCachePath("logs/index.bin");
+    }
+
+    //--------------------------------------------------------------------------
+    string_q logJournalPath(void) {
+        return blockCachePath("logs/journal.bin");
+    }
+
+    //--------------------------------------------------------------------------
+    static uint8_t nibble(char c) {
+        if (c >= '0' && c <= '9') return (uint8_t)(c - '0');
+        if (c >= 'a' && c <= 'f') return (uint8_t)(c - 'a' + 10);
+        if (c >= 'A' && c <= 'F') return (uint8_t)(c - 'A' + 10);
+        return 0;
+    }
+
+    //--------------------------------------------------------------------------
+    static void toAddressBytes(const SFAddress& addr, uint8_t out[20]) {
+        string_q hex = padLeft(substitute(toLower(addr), "0x", ""), 40, '0');
+        for (size_t i = 0 ; i < 20 ; i++)
+            out[i] = (uint8_t)((nibble(hex[i * 2]) << 4) | nibble(hex[i * 2 + 1]));
+    }
+
+    //--------------------------------------------------------------------------
+    static void toTopicBytes(const SFUintBN& topic, uint8_t out[32]) {
+        for (size_t b = 0 ; b < 4 ; b++) {
+            uint64_t v = topic.getBlock((unsigned int)(3 - b));
+            for (size_t j = 0 ; j < 8 ; j++)
+                out[b * 8 + j] = (uint8_t)(v >> (56 - j * 8));
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    SFAddress CLogIndexRecord::getAddress(void) const {
+        static const char *hexDigits = "0123456789abcdef";
+        string_q ret = "0x";
+        for (size_t i = 0 ; i < 20 ; i++) {
+            ret += hexDigits[address[i] >> 4];
+            ret += hexDigits[address[i] & 0xf];
+        }
+        return ret;
+    }
+
+    //--------------------------------------------------------------------------
+    SFUintBN CLogIndexRecord::getTopic(void) const {
+        SFUintBN ret;
+        for (size_t i = 0 ; i < 32 ; i++)
+            ret = (ret << 8) + SFUintBN((uint64_t)topic[i]);
+        return ret;
+    }
+
+    //--------------------------------------------------------------------------
+    // Index order: address, topic, block, transaction, log
+    static int cmpRecord(const CLogIndexRecord& a, const CLogIndexRecord& b) {
+        int ret = memcmp(a.address, b.address, sizeof(a.address));
+        if (ret) return ret;
+        ret = memcmp(a.topic, b.topic, sizeof(a.topic));
+        if (ret) return ret;
+        if (a.blockNum != b.blockNum) return (a.blockNum < b.blockNum ? -1 : 1);
+        if (a.txIndex  != b.txIndex)  return (a.txIndex  < b.txIndex  ? -1 : 1);
+        if (a.logIndex != b.logIndex) return (a.logIndex < b.logIndex ? -1 : 1);
+        return 0;
+    }
+
+    //--------------------------------------------------------------------------
+    static int cmpBlock(const CLogIndexRecord& a, const CLogIndexRecord& b) {
+        if (a.blockNum != b.blockNum) return (a.blockNum < b.blockNum ? -1 : 1);
+        if (a.txIndex  != b.txIndex)  return (a.txIndex  < b.txIndex  ? -1 : 1);
+        if (a.logIndex != b.logIndex) return (a.logIndex < b.logIndex ? -1 : 1);
+        return 0;
+    }
+
+    //--------------------------------------------------------------------------
+    static int cmpTopic(const CLogIndexRecord& a, const CLogIndexRecord& b) {
+        int ret = memcmp(a.topic, b.topic, sizeof(a.topic));
+        return (ret ? ret : cmpBlock(a, b));
+    }
+
+    static bool lessRecord(const CLogIndexRecord& a, const CLogIndexRecord& b) { return cmpRecord(a, b) < 0; }
+    static bool sameRecord(const CLogIndexRecord& a, const CLogIndexRecord& b) { return cmpRecord(a, b) == 0; }
+    static bool lessBlock (const CLogIndexRecord& a, const CLogIndexRecord& b) { return cmpBlock(a, b) < 0; }
+    static bool sameBlock (const CLogIndexRecord& a, const CLogIndexRecord& b) { return cmpBlock(a, b) == 0; }
+
+    //--------------------------------------------------------------------------
+    size_t getLogRecords(const CBlock& block, CLogIndexRecordArray& records) {
+        for (size_t t = 0 ; t < block.transactions.size() ; t++) {
+            const CReceipt *receipt = &block.transactions[t].receipt;
+            for (size_t l = 0 ; l < receipt->logs.size() ; l++) {
+                const CLogEntry *log = &receipt->logs[l];
+                CLogIndexRecord rec;
+                bzero(&rec, sizeof(rec));
+                toAddressBytes(log->address, rec.address);
+                if (log->topics.size())
+                    toTopicBytes(log->topics[0], rec.topic);
+                rec.blockNum = (uint32_t)block.blockNumber;
+                rec.txIndex  = (uint32_t)t;
+                rec.logIndex = (uint32_t)log->logIndex;
+                records.push_back(rec);
+            }
+        }
+        return records.size();
+    }
+
+    //--------------------------------------------------------------------------
+    // Called as each block is written to the cache, so it only appends. The index picks the
+    // records up on the next compact.
+    bool appendBlockLogs(const CBlock& block, const string_q& journalFile) {
+        CLogIndexRecordArray records;
+        if (!getLogRecords(block, records))
+            return true;
+
+        string_q created;
+        if (!establishFolder(journalFile, created))
+            return false;
+        CBinFile file;
+        if (!file.Lock(journalFile, binaryWriteAppend, LOCK_CREATE))
+            return false;
+        file.Write(records.data(), sizeof(CLogIndexRecord), records.size());
+        file.Release();
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    CLogIndex::CLogIndex(void) : mapped(NULL), pRecords(NULL), pByTopic(NULL), pByBlock(NULL) {
+        bzero(&header, sizeof(header));
+    }
+
+    //--------------------------------------------------------------------------
+    CLogIndex::~CLogIndex(void) {
+        close();
+    }
+
+    //--------------------------------------------------------------------------
+    void CLogIndex::closeIndex(void) {
+        if (mapped)
+            delete mapped;
+        mapped   = NULL;
+        pRecords = NULL;
+        pByTopic = NULL;
+        pByBlock = NULL;
+        bzero(&header, sizeof(header));
+    }
+
+    //--------------------------------------------------------------------------
+    void CLogIndex::close(void) {
+        closeIndex();
+        journal.clear();
+    }
+
+    //--------------------------------------------------------------------------
+    static bool checkHeader(const CLogIndexHeader& header, uint64_t fileSz) {
+        if (memcmp(header.magic, indexMagic, sizeof(indexMagic)))
+            return false;
+        uint64_t expected = sizeof(CLogIndexHeader) +
+                                (uint64_t)header.nRecords * (sizeof(CLogIndexRecord) + 2 * sizeof(uint32_t));
+        return (expected == fileSz);
+    }
+
+    //--------------------------------------------------------------------------
+    bool CLogIndex::openIndex(void) {
+        closeIndex();
+        if (!fileExists(indexFile) || fileSize(indexFile) < sizeof(CLogIndexHeader))
+            return false;
+
+        CMemMapFile *mm = new CMemMapFile(indexFile, CMemMapFile::WholeFile, CMemMapFile::RandomAccess);
+        if (!mm->isValid() || mm->size() < sizeof(CLogIndexHeader)) {
+            delete mm;
+            return false;
+        }
+
+        const unsigned char *base = mm->getData();
+        memcpy(&header, base, sizeof(header));
+        if (!checkHeader(header, mm->size())) {
+            bzero(&header, sizeof(header));
+            delete mm;
+            return false;
+        }
+
+        mapped   = mm;
+        pRecords = reinterpret_cast<const CLogIndexRecord*>(base + sizeof(CLogIndexHeader));
+        pByTopic = reinterpret_cast<const uint32_t*>(pRecords + header.nRecords);
+        pByBlock = pByTopic + header.nRecords;
+        for (size_t i = 0 ; i < header.nRecords ; i++) {
+            if (pByTopic[i] >= header.nRecords || pByBlock[i] >= header.nRecords) {
+                closeIndex();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    static bool readRecords(const string_q& fileName, CLogIndexRecordArray& records) {
+        records.clear();
+        if (!fileExists(fileName))
+            return true;
+        CBinFile file;
+        if (!file.Lock(fileName, binaryReadOnly, LOCK_NOWAIT))
+            return false;
+        // a record cut short by an interrupted append is dropped
+        records.resize(fileSize(fileName) / sizeof(CLogIndexRecord));
+        if (records.size())
+            file.Read(records.data(), sizeof(CLogIndexRecord), records.size());
+        file.Release();
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    // Maps the index and reads the journal. Either may be missing, in which case it is empty.
+    bool CLogIndex::open(const string_q& indexFileIn, const string_q& journalFileIn) {
+        close();
+        indexFile   = indexFileIn;
+        journalFile = journalFileIn;
+        openIndex();
+
+        readRecords(journalFile, journal);
+        // the journal is scanned on every query, so a long one is folded in before it is used
+        if (journal.size() > MAX_JOURNALED)
+            compact();
+        return (mapped != NULL || !journal.empty());
+    }
+
+    //--------------------------------------------------------------------------
+    size_t CLogIndex::size(void) const {
+        return header.nRecords + journal.size();
+    }
+
+    //--------------------------------------------------------------------------
+    blknum_t CLogIndex::lastBlock(void) const {
+        blknum_t ret = header.lastBlock;
+        for (size_t i = 0 ; i < journal.size() ; i++)
+            ret = max(ret, (blknum_t)journal[i].blockNum);
+        return ret;
+    }
+
+    //--------------------------------------------------------------------------
+    static bool matches(const CLogIndexRecord& rec, const CLogIndexRecord& key, const CLogQuery& query) {
+        if (rec.blockNum < query.firstBlock || rec.blockNum > query.lastBlock)
+            return false;
+        if (!query.address.empty() && memcmp(rec.address, key.address, sizeof(key.address)))
+            return false;
+        if (query.hasTopic && memcmp(rec.topic, key.topic, sizeof(key.topic)))
+            return false;
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    // Returns matching logs in block order. An address query is a range of the sorted records,
+    // a topic-only query a range of the topic order, and a block range alone a range of the
+    // block order. The journal is small and is scanned.
+    size_t CLogIndex::find(const CLogQuery& query, CLogIndexRecordArray& results) const {
+        results.clear();
+
+        CLogIndexRecord key;
+        bzero(&key, sizeof(key));
+        if (!query.address.empty())
+            toAddressBytes(query.address, key.address);
+        if (query.hasTopic)
+            toTopicBytes(query.topic, key.topic);
+        key.blockNum = (uint32_t)min(query.firstBlock, (blknum_t)0xffffffff);
+
+        size_t n = header.nRecords;
+        if (!query.address.empty()) {
+            if (!query.hasTopic)
+                key.blockNum = 0;
+            const CLogIndexRecord *p = lower_bound(pRecords, pRecords + n, key, lessRecord);
+            for ( ; p < pRecords + n && !memcmp(p->address, key.address, sizeof(key.address)) ; p++) {
+                if (query.hasTopic && (memcmp(p->topic, key.topic, sizeof(key.topic)) || p->blockNum > query.lastBlock))
+                    break;
+                if (matches(*p, key, query))
+                    results.push_back(*p);
+            }
+
+        } else if (query.hasTopic) {
+            size_t lo = 0, hi = n;
+            while (lo < hi) {
+                size_t mid = (lo + hi) / 2;
+                if (cmpTopic(pRecords[pByTopic[mid]], key) < 0)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            for ( ; lo < n ; lo++) {
+                const CLogIndexRecord *p = &pRecords[pByTopic[lo]];
+                if (memcmp(p->topic, key.topic, sizeof(key.topic)) || p->blockNum > query.lastBlock)
+                    break;
+                results.push_back(*p);
+            }
+
+        } else {
+            size_t lo = 0, hi = n;
+            while (lo < hi) {
+                size_t mid = (lo + hi) / 2;
+                if (pRecords[pByBlock[mid]].blockNum < key.blockNum)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            for ( ; lo < n && pRecords[pByBlock[lo]].blockNum <= query.lastBlock ; lo++)
+                results.push_back(pRecords[pByBlock[lo]]);
+        }
+
+        for (size_t i = 0 ; i < journal.size() ; i++)
+            if (matches(journal[i], key, query))
+                results.push_back(journal[i]);
+
+        // a block cached more than once has its logs journaled more than once
+        sort(results.begin(), results.end(), lessBlock);
+        results.erase(unique(results.begin(), results.end(), sameBlock), results.end());
+        return results.size();
+    }
+
+    //--------------------------------------------------------------------------
+    class CTopicOrder {
+    public:
+        const CLogIndexRecordArray *recs;
+        explicit CTopicOrder(const CLogIndexRecordArray *r) : recs(r) { }
+        bool operator()(uint32_t a, uint32_t b) const { return cmpTopic((*recs)[a], (*recs)[b]) < 0; }
+    };
+
+    //--------------------------------------------------------------------------
+    class CBlockOrder {
+    public:
+        const CLogIndexRecordArray *recs;
+        explicit CBlockOrder(const CLogIndexRecordArray *r) : recs(r) { }
+        bool operator()(uint32_t a, uint32_t b) const { return cmpBlock((*recs)[a], (*recs)[b]) < 0; }
+    };
+
+    //--------------------------------------------------------------------------
+    // Moves the journal aside while holding its lock, so appends made while the index is rebuilt
+    // go to a new journal rather than to one that is about to be removed
+    static bool takeJournal(const string_q& journalFile, const string_q& asideFile) {
+        CBinFile file;
+        if (!file.Lock(journalFile, binaryWriteAppend, LOCK_CREATE))
+            return false;
+        bool ret = (::rename(journalFile.c_str(), asideFile.c_str()) == 0);
+        file.Release();
+        return ret;
+    }
+
+    //--------------------------------------------------------------------------
+    // Puts records taken from the journal back if they could not be folded into the index
+    static void returnJournal(const string_q& journalFile, const string_q& asideFile,
+                                const CLogIndexRecordArray& records) {
+        CBinFile file;
+        if (records.size() && file.Lock(journalFile, binaryWriteAppend, LOCK_CREATE)) {
+            file.Write(records.data(), sizeof(CLogIndexRecord), records.size());
+            file.Release();
+        }
+        ::remove(asideFile.c_str());
+    }
+
+    //--------------------------------------------------------------------------
+    // Folds the journal into the index, rewriting the index file and emptying the journal. Only
+    // one process compacts at a time (the index's lock). The journal is taken under its own lock
+    // and the index is mapped again before they are merged, so neither records appended since
+    // open nor another process's compaction are lost.
+    bool CLogIndex::compact(void) {
+        if (journal.empty() && mapped)
+            return true;
+
+        string_q created;
+        if (!establishFolder(indexFile, created))
+            return false;
+
+        CBinFile indexLock;
+        if (!indexLock.Lock(indexFile, binaryWriteAppend, LOCK_WAIT))
+            return false;
+
+        string_q pid = asStringU((uint64_t)getpid());
+        string_q asideFile = journalFile + "." + pid + ".tmp";
+        CLogIndexRecordArray taken;
+        if (fileExists(journalFile)) {
+            if (!takeJournal(journalFile, asideFile))
+                return false;
+            if (!readRecords(asideFile, taken))
+                return false;  // the records stay aside rather than be removed unread
+        }
+        openIndex();
+
+        CLogIndexRecordArray records;
+        records.reserve(header.nRecords + taken.size());
+        records.insert(records.end(), pRecords, pRecords + header.nRecords);
+        records.insert(records.end(), taken.begin(), taken.end());
+        sort(records.begin(), records.end(), lessRecord);
+        records.erase(unique(records.begin(), records.end(), sameRecord), records.end());
+
+        vector<uint32_t> byTopic(records.size()), byBlock(records.size());
+        CLogIndexHeader hdr;
+        bzero(&hdr, sizeof(hdr));
+        memcpy(hdr.magic, indexMagic, sizeof(hdr.magic));
+        hdr.nRecords = (uint32_t)records.size();
+        for (uint32_t i = 0 ; i < hdr.nRecords ; i++) {
+            byTopic[i] = byBlock[i] = i;
+            hdr.lastBlock = max(hdr.lastBlock, (uint64_t)records[i].blockNum);
+        }
+        sort(byTopic.begin(), byTopic.end(), CTopicOrder(&records));
+        sort(byBlock.begin(), byBlock.end(), CBlockOrder(&records));
+
+        string_q tmpName = indexFile + "." + pid + ".tmp";
+        CBinFile file;
+        if (!file.Lock(tmpName, binaryWriteCreate, LOCK_CREATE)) {
+            returnJournal(journalFile, asideFile, taken);
+            return false;
+        }
+        file.Write(&hdr, sizeof(hdr), 1);
+        file.Write(records.data(), sizeof(CLogIndexRecord), records.size());
+        file.Write(byTopic.data(), sizeof(uint32_t), byTopic.size());
+        file.Write(byBlock.data(), sizeof(uint32_t), byBlock.size());
+        file.Release();
+
+        closeIndex();
+        if (::rename(tmpName.c_str(), indexFile.c_str()) != 0) {
+            ::remove(tmpName.c_str());
+            returnJournal(journalFile, asideFile, taken);
+            openIndex();
+            return false;
+        }
+
+        ::remove(asideFile.c_str());
+        journal.clear();
+        return openIndex();
+    }
+
+}  // namespace qblocks
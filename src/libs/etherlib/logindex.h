@@ -0,0 +1,108 @@
+#pragma once
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <vector>
+#include "block.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    // One log in the index. The address and topic are stored big endian so records sort with memcmp.
+    // A log with no topics is indexed under a zero topic.
+    //--------------------------------------------------------------------------
+    class CLogIndexRecord {
+    public:
+        uint8_t  address[20];
+        uint8_t  topic[32];
+        uint32_t blockNum;
+        uint32_t txIndex;    // position of the transaction in the block
+        uint32_t logIndex;   // the log's logIndex field
+
+        SFAddress getAddress(void) const;
+        SFUintBN  getTopic  (void) const;
+    };
+    typedef vector<CLogIndexRecord> CLogIndexRecordArray;
+
+    //--------------------------------------------------------------------------
+    // Layout of the index file (logs/index.bin). The header is followed by the records sorted by
+    // address, topic, block, transaction and log, then by two arrays of record positions: one
+    // in topic order and one in block order.
+    //--------------------------------------------------------------------------
+    class CLogIndexHeader {
+    public:
+        char     magic[8];
+        uint32_t nRecords;
+        uint32_t unused;
+        uint64_t lastBlock;
+    };
+
+    //--------------------------------------------------------------------------
+    // Any combination of address, topic and block range. Empty fields match everything.
+    class CLogQuery {
+    public:
+        SFAddress address;
+        SFUintBN  topic;
+        bool      hasTopic;
+        blknum_t  firstBlock;
+        blknum_t  lastBlock;
+        CLogQuery(void) : hasTopic(false), firstBlock(0), lastBlock(NOPOS) { }
+    };
+
+    //--------------------------------------------------------------------------
+    // Longer journals are compacted when the index is opened
+    #define MAX_JOURNALED 4096
+
+    //--------------------------------------------------------------------------
+    // A persistent index from (address, topic0) to (block, transaction, log) over the receipts in
+    // the block cache. New blocks are appended to a journal as they are cached (if 'indexLogs' is
+    // set in quickBlocks.toml), compact folds the journal into the memory mapped index. Queries see
+    // both.
+    //--------------------------------------------------------------------------
+    class CLogIndex {
+    public:
+                 CLogIndex  (void);
+                 ~CLogIndex (void);
+
+        bool     open       (const string_q& indexFile, const string_q& journalFile);
+        void     close      (void);
+        size_t   size       (void) const;
+        size_t   nJournaled (void) const { return journal.size(); }
+        blknum_t lastBlock  (void) const;
+
+        size_t   find       (const CLogQuery& query, CLogIndexRecordArray& results) const;
+        bool     compact    (void);
+
+    private:
+        string_q                 indexFile;
+        string_q                 journalFile;
+        CMemMapFile             *mapped;
+        const CLogIndexRecord   *pRecords;
+        const uint32_t          *pByTopic;
+        const uint32_t          *pByBlock;
+        CLogIndexHeader          header;
+        CLogIndexRecordArray     journal;
+
+        bool     openIndex  (void);
+        void     closeIndex (void);
+
+        CLogIndex(const CLogIndex&);
+        CLogIndex& operator=(const CLogIndex&);
+    };
+
+    //--------------------------------------------------------------------------
+    extern size_t   getLogRecords     (const CBlock& block, CLogIndexRecordArray& records);
+    extern bool     appendBlockLogs   (const CBlock& block, const string_q& journalFile);
+    extern string_q logIndexPath      (void);
+    extern string_q logJournalPath    (void);
+
+}  // namespace qblocks
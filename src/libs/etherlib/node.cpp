@@ -12,6 +12,7 @@
  *-------------------------------------------------------------------------------------------*/
 #include <string>
 #include "node.h"
+#include "rpccache.h"
 
 namespace qblocks {
 
@@ -71,6 +72,11 @@ extern void registerQuitHandler(QUITHANDLER qh);
 
     //-------------------------------------------------------------------------
     void etherlib_cleanup(void) {
+        if (verbose > 1) {
+            CRPCCache *memo = getRPCCache();
+            cerr << "RPC cache: " << memo->hits << " hits (" << memo->diskHits << " from disk), "
+                    << memo->misses << " misses\n";
+        }
         getCurl(true);
         clearInMemoryCache();
         if (theQuitHandler)
@@ -155,31 +161,64 @@ extern void registerQuitHandler(QUITHANDLER qh);
     }
 
     //-------------------------------------------------------------------------
-    bool queryBlock(CBlock& block, const string_q& datIn, bool needTrace, bool byHash) {
+    // Reads a block into an object that may hold an earlier block, reusing its memory
+    static bool rereadBlockFromBinary(CBlock& block, const string_q& fileName, const CFieldProjection *projection) {
+        block.resetForRead();
+        if (readBlockFromBinary(block, fileName, projection))
+            return true;
+        block = CBlock();
+        return false;
+    }
+
+    //-------------------------------------------------------------------------
+    bool queryBlock(CBlock& block, const string_q& datIn, bool needTrace, bool byHash,
+                        const CFieldProjection *projection) {
         size_t unused = 0;
-        return queryBlock(block, datIn, needTrace, byHash, unused);
+        return queryBlock(block, datIn, needTrace, byHash, unused, projection);
     }
 
     //-------------------------------------------------------------------------
-    bool queryBlock(CBlock& block, const string_q& datIn, bool needTrace, bool byHash, size_t& nTraces) {
+    // Transaction fields that come from (or, for isError, are checked against) the receipt
+    static const char *receiptFields[] = {
+        "receipt", "isError", "gasUsed", "gasCost", "events",
+    };
 
+    //-------------------------------------------------------------------------
+    // True unless the projection shows that no field read from a receipt will be asked for
+    bool needsReceipts(const CFieldProjection *projection) {
+        if (!projection)
+            return true;
+        if (!projection->wantsField(GETRUNTIME_CLASS(CBlock), "transactions"))
+            return false;
+        for (size_t i = 0 ; i < sizeof(receiptFields) / sizeof(receiptFields[0]) ; i++)
+            if (projection->wantsField(GETRUNTIME_CLASS(CTransaction), receiptFields[i]))
+                return true;
+        return false;
+    }
+
+    //-------------------------------------------------------------------------
+    bool queryBlock(CBlock& block, const string_q& datIn, bool needTrace, bool byHash, size_t& nTraces,
+                        const CFieldProjection *projection) {
+
+        nTraces = 0;
         if (datIn == "latest")
-            return queryBlock(block, asStringU(getLatestBlockFromClient()), needTrace, false);
+            return queryBlock(block, asStringU(getLatestBlockFromClient()), needTrace, false, nTraces, projection);
 
         if (isHash(datIn)) {
             HIDE_FIELD(CTransaction, "receipt");
+            block = CBlock();
             getObjectViaRPC(block, "eth_getBlockByHash", "["+quote(datIn)+",true]");
 
         } else {
             uint64_t num = toLongU(datIn);
             if (getCurlContext()->provider == "binary" && fileSize(getBinaryFilename(num)) > 0) {
                 UNHIDE_FIELD(CTransaction, "receipt");
-                block = CBlock();
-                return readBlockFromBinary(block, getBinaryFilename(num));
+                return rereadBlockFromBinary(block, getBinaryFilename(num), projection);
 
             }
 
             HIDE_FIELD(CTransaction, "receipt");
+            block = CBlock();  // the caller may be reusing the block
             getObjectViaRPC(block, "eth_getBlockByNumber", "["+quote(toHex(num))+",true]");
         }
 
@@ -187,15 +226,29 @@ extern void registerQuitHandler(QUITHANDLER qh);
         if (!block.transactions.size())
             return false;
 
-        // We have the transactions, but we also want the receipts, and we need an error indication
-        nTraces = 0;
+        // Receipts (and the traces that stand in for their error status) are only fetched if
+        // one of the caller's fields needs them
+        if (!needsReceipts(projection)) {
+            for (size_t i = 0 ; i < block.transactions.size() ; i++)
+                block.transactions.at(i).pBlock = &block;
+            return true;
+        }
+
+        // We have the transactions, but we also want the receipts (asked for all at once so
+        // an IPC connection can pipeline them), and we need an error indication
+        CRPCRequestArray requests;
+        for (size_t i = 0 ; i < block.transactions.size() ; i++)
+            requests.push_back(CRPCRequest("eth_getTransactionReceipt", "[\"" + fixHash(block.transactions[i].hash) + "\"]"));
+        CStringArray receipts;
+        callRPCMany(requests, receipts, false);
+
         for (size_t i = 0 ; i < block.transactions.size() ; i++) {
             CTransaction *trans = &block.transactions.at(i);  // taking a non-const reference
             trans->pBlock = &block;
 
             UNHIDE_FIELD(CTransaction, "receipt");
             CReceipt receipt;
-            getReceipt(receipt, trans->hash);
+            receipt.parseJson((char *)receipts[i].c_str());  // NOLINT
             trans->receipt = receipt;  // deep copy
             if (block.blockNumber >= byzantiumBlock) {
                 trans->isError = (receipt.status == 0);
@@ -485,13 +538,21 @@ extern void registerQuitHandler(QUITHANDLER qh);
     //-----------------------------------------------------------------------
     bool writeBlockToBinary(const CBlock& block, const string_q& fileName) {
         // SFArchive blockCache(READING_ARCHIVE);  -- so search hits
-        return writeNodeToBinary(block, fileName);
+        // blocks are compressed as they are cached if asked to (see blockcompress.h)
+        bool written = (getGlobalConfig()->getConfigBool("settings", "compressBlocks", false) ?
+                            writePackedBlock(block, fileName) : writeNodeToBinary(block, fileName));
+        if (!written)
+            return false;
+        // if asked to, the block's logs go into the log index as the block is cached (see logindex.h)
+        if (getGlobalConfig()->getConfigBool("settings", "indexLogs", false))
+            appendBlockLogs(block, logJournalPath());
+        return true;
     }
 
     //-----------------------------------------------------------------------
-    bool readBlockFromBinary(CBlock& block, const string_q& fileName) {
+    bool readBlockFromBinary(CBlock& block, const string_q& fileName, const CFieldProjection *projection) {
         // SFArchive blockCache(READING_ARCHIVE);  -- so search hits
-        return readNodeFromBinary(block, fileName);
+        return readPackedBlock(block, fileName, projection);
     }
 
     //----------------------------------------------------------------------------------
@@ -566,12 +627,12 @@ extern void registerQuitHandler(QUITHANDLER qh);
         if (!func)
             return false;
 
+        // One block is read into over and over, so its memory is reused
+        CBlock block;
         for (uint64_t i = start ; i < start + count - 1 ; i = i + skip) {
             string_q fileName = getBinaryFilename(i);
-            CBlock block;
             if (fileExists(fileName)) {
-                block = CBlock();
-                readBlockFromBinary(block, fileName);
+                rereadBlockFromBinary(block, fileName, NULL);
             } else {
                 getBlock(block, i);
             }
@@ -596,8 +657,8 @@ extern void registerQuitHandler(QUITHANDLER qh);
             return false;
 
         // Read every block from number start to start+count
+        CBlock block;
         for (uint64_t i = start ; i < start + count ; i = i + skip) {
-            CBlock block;
             getBlock(block, i);
             if (!(*func)(block, data))
                 return false;
@@ -626,11 +687,11 @@ extern void registerQuitHandler(QUITHANDLER qh);
             fullBlockCache.Read(contents, sizeof(uint64_t), nItems);
             fullBlockCache.Release();  // release it since we don't need it any longer
 
+            CBlock block;
             for (uint64_t i = 0 ; i < nItems ; i = i + skip) {
                 // TODO(tjayrush): This should be a binary search not a scan. This is why it appears to wait
                 uint64_t item = contents[i];
                 if (inRange(item, start, start + count - 1)) {
-                    CBlock block;
                     if (getBlock(block, contents[i])) {
                         bool ret = (*func)(block, data);
                         if (!ret) {
@@ -672,9 +733,9 @@ extern void registerQuitHandler(QUITHANDLER qh);
 
             contents[0] = 0;  // Starting point (because we are build the empty list from the non-empty list)
             uint64_t cnt = start;
+            CBlock block;
             for (uint64_t i = 1 ; i < nItems ; i = i + skip) {  // first one is assumed to be the '0' block
                 while (cnt < contents[i]) {
-                    CBlock block;
                     // Both 'queryBlock' and 'getBlock' return false if there are no
                     // transactions, so we ignore the return value
                     getBlock(block, cnt);
@@ -693,26 +754,6 @@ extern void registerQuitHandler(QUITHANDLER qh);
         return true;
     }
 
-    //-------------------------------------------------------------------------
-    bool forEveryBloomFile(FILEVISITOR func, void *data, uint64_t start, uint64_t count, uint64_t skip) {
-
-        // If the caller does not specify start/end block numbers, visit every bloom file
-        if (start == 0 || count == (uint64_t)-1)
-            return forEveryFileInFolder(bloomFolder, func, data);
-
-        // The user is asking for certain files and not others. The bext we can do is limit which folders
-        // to visit, which we do here. Caller must protect against too early or too late files by number.
-        // Use interger math to figure out which folders to visit
-        blknum_t st = (start / 1000) * 1000;
-        blknum_t ed = ((start+count+1000) / 1000) * 1000;
-        for (blknum_t b = st ; b < ed ; b += 1000) {
-            string_q path = substitute(getBinaryPath(b), "/blocks/", "/blooms/");
-            if (!forEveryFileInFolder(path, func, data))
-                return false;
-        }
-        return true;
-    }
-
     //-------------------------------------------------------------------------
     bool forEveryTraceInTransaction(TRACEVISITFUNC func, void *data, const CTransaction& trans) {
 
@@ -722,8 +763,7 @@ extern void registerQuitHandler(QUITHANDLER qh);
         CTraceArray traces;
         getTraces(traces, trans.hash);
         for (size_t i = 0 ; i < traces.size() ; i++) {
-            CTrace trace = traces[i];
-            if (!(*func)(trace, data))
+            if (!(*func)(traces.at(i), data))
                 return false;
         }
 
@@ -747,14 +787,31 @@ extern void registerQuitHandler(QUITHANDLER qh);
 
 //        cout << "Visiting " << trans.receipt.logs.size() << " logs\n";
 //        cout.flush();
+        // The visitor may change what it is given, so it gets a copy. One copy is reused
+        // for every log, so its memory is only allocated once.
+        CLogEntry log;
         for (size_t i = 0 ; i < trans.receipt.logs.size() ; i++) {
-            CLogEntry log = trans.receipt.logs[i];
+            log = trans.receipt.logs[i];
             if (!(*func)(log, data))
                 return false;
         }
         return true;
     }
 
+    //-------------------------------------------------------------------------
+    bool forEveryLogInTransaction(LOGVISITFUNC func, void *data, CTransaction& trans) {
+
+        if (!func)
+            return false;
+
+        // The transaction is not const, so the visitor gets each log itself
+        for (size_t i = 0 ; i < trans.receipt.logs.size() ; i++) {
+            if (!(*func)(trans.receipt.logs.at(i), data))
+                return false;
+        }
+        return true;
+    }
+
     //-------------------------------------------------------------------------
     bool forEveryLogInBlock(LOGVISITFUNC func, void *data, const CBlock& block) {
 //        cout << "Visiting " << block.transactions.size() << " transactions\n";
@@ -766,14 +823,25 @@ extern void registerQuitHandler(QUITHANDLER qh);
         return true;
     }
 
+    //-------------------------------------------------------------------------
+    bool forEveryLogInBlock(LOGVISITFUNC func, void *data, CBlock& block) {
+        for (size_t i = 0 ; i < block.transactions.size() ; i++) {
+            if (!forEveryLogInTransaction(func, data, block.transactions.at(i)))
+                return false;
+        }
+        return true;
+    }
+
     //-------------------------------------------------------------------------
     bool forEveryTransactionInBlock(TRANSVISITFUNC func, void *data, const CBlock& block) {
 
         if (!func)
             return false;
 
+        // One copy, reused for every transaction (see forEveryLogInTransaction)
+        CTransaction trans;
         for (size_t i = 0 ; i < block.transactions.size() ; i++) {
-            CTransaction trans = block.transactions[i];
+            trans = block.transactions[i];
             if (!(*func)(trans, data))
                 return false;
         }
@@ -781,6 +849,20 @@ extern void registerQuitHandler(QUITHANDLER qh);
         return true;
     }
 
+    //-------------------------------------------------------------------------
+    bool forEveryTransactionInBlock(TRANSVISITFUNC func, void *data, CBlock& block) {
+
+        if (!func)
+            return false;
+
+        for (size_t i = 0 ; i < block.transactions.size() ; i++) {
+            if (!(*func)(block.transactions.at(i), data))
+                return false;
+        }
+
+        return true;
+    }
+
     //-------------------------------------------------------------------------
     bool forEveryTransactionInList(TRANSVISITFUNC func, void *data, const string_q& trans_list) {
 
@@ -40,8 +40,11 @@ namespace qblocks {
 
     //-------------------------------------------------------------------------
     extern bool     queryBlock              (CBlock& block,       const string_q& num, bool needTrace, bool byHash,
-                                                                    size_t& nTraces);
-    extern bool     queryBlock              (CBlock& block,       const string_q& num, bool needTrace, bool byHash);
+                                                                    size_t& nTraces,
+                                                const CFieldProjection *projection = NULL);
+    extern bool     queryBlock              (CBlock& block,       const string_q& num, bool needTrace, bool byHash,
+                                                const CFieldProjection *projection = NULL);
+    extern bool     needsReceipts           (const CFieldProjection *projection);
 
     //-------------------------------------------------------------------------
     // lower level access to the node's responses
@@ -65,7 +68,8 @@ namespace qblocks {
 
     //-----------------------------------------------------------------------
     extern bool     writeBlockToBinary      (const CBlock& block, const string_q& fileName);
-    extern bool     readBlockFromBinary     (      CBlock& block, const string_q& fileName);
+    extern bool     readBlockFromBinary     (      CBlock& block, const string_q& fileName,
+                                                const CFieldProjection *projection = NULL);
 
     //-------------------------------------------------------------------------
     extern string_q getVersionFromClient    (void);
@@ -105,19 +109,20 @@ namespace qblocks {
     extern bool forEveryEmptyBlockOnDisc     (BLOCKVISITFUNC func, void *data, uint64_t start, uint64_t count, uint64_t skip=1);  // NOLINT
 
     //-------------------------------------------------------------------------
-    // forEvery functions
-    extern bool forEveryBloomFile            (FILEVISITOR    func, void *data, uint64_t start, uint64_t count, uint64_t skip = 1);  // NOLINT
-    //-------------------------------------------------------------------------
-    // forEvery functions
+    // forEvery functions. Given a const block or transaction, the visitor gets a copy of each
+    // item (one copy, reused). Given a non-const one, it gets the item itself.
     extern bool forEveryTransactionInList    (TRANSVISITFUNC func, void *data, const string_q& trans_list);
     extern bool forEveryTransactionInBlock   (TRANSVISITFUNC func, void *data, const CBlock& block);
+    extern bool forEveryTransactionInBlock   (TRANSVISITFUNC func, void *data, CBlock& block);
 
     //-------------------------------------------------------------------------
     // forEvery functions
     extern bool forEveryTraceInTransaction   (TRACEVISITFUNC func, void *data, const CTransaction& trans);
     extern bool forEveryTraceInBlock         (TRACEVISITFUNC func, void *data, const CBlock& block);
     extern bool forEveryLogInTransaction     (LOGVISITFUNC func,   void *data, const CTransaction& trans);
+    extern bool forEveryLogInTransaction     (LOGVISITFUNC func,   void *data, CTransaction& trans);
     extern bool forEveryLogInBlock           (LOGVISITFUNC func,   void *data, const CBlock& block);
+    extern bool forEveryLogInBlock           (LOGVISITFUNC func,   void *data, CBlock& block);
 
     //-------------------------------------------------------------------------
     extern string_q blockCachePath(const string_q& _part);
@@ -12,6 +12,8 @@
  *-------------------------------------------------------------------------------------------*/
 #include "node.h"
 #include "node_curl.h"
+#include "node_ipc.h"
+#include "rpccache.h"
 
 namespace qblocks {
 
@@ -21,7 +23,13 @@ namespace qblocks {
     extern size_t nullCallback(char *ptr, size_t size, size_t nmemb, void *userdata);
 
     //-------------------------------------------------------------------------
-    CCurlContext::CCurlContext(void) {
+    // Starting around block 3804005, there was a hack wherein the byte code 5b5b5b5b5b5b5b5b5b5b5b5b
+    // repeated thousands of times, doing nothing. If we don't handle this, it dominates the scanning
+    // for no reason
+    static const char *hackPattern = "5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b";
+
+    //-------------------------------------------------------------------------
+    CCurlContext::CCurlContext(void) : hackMatcher(hackPattern), errorMatcher("erro") {
         headers      = "Content-Type: application/json\n";
         baseURL      = "http://localhost:8545";
         callBackFunc = writeCallback;
@@ -60,6 +68,11 @@ namespace qblocks {
         is_error     = false;
         postData     = "";
         result       = "";
+        keepRaw      = true;
+        expected     = 0;
+        stream.reset();
+        hackMatcher.reset();
+        errorMatcher.reset();
 //      source       = "binary";
     }
 
@@ -78,6 +91,26 @@ namespace qblocks {
         return prev;
     }
 
+    //-------------------------------------------------------------------------
+    static string_q providerURL(void) {
+        if (getCurlContext()->provider == "remote")
+            return "https://pmainnet.infura.io/";
+        else if (getCurlContext()->provider == "ropsten")
+            return "https://testnet.infura.io/";
+        return getCurlContext()->baseURL;
+    }
+
+    //-------------------------------------------------------------------------
+    static struct curl_slist *curlHeaders(void) {
+        struct curl_slist *headers = NULL;
+        string_q head = getCurlContext()->headers;
+        while (!head.empty()) {
+            string_q next = nextTokenClear(head, '\n');
+            headers = curl_slist_append(headers, (char*)next.c_str());  // NOLINT
+        }
+        return headers;
+    }
+
     //-------------------------------------------------------------------------
     CURL *getCurl(bool cleanup) {
         static CURL *curl = NULL;
@@ -89,22 +122,9 @@ namespace qblocks {
                 exit(0);
             }
 
-            string_q head = getCurlContext()->headers;
-            while (!head.empty()) {
-                string_q next = nextTokenClear(head, '\n');
-                headers = curl_slist_append(headers, (char*)next.c_str());  // NOLINT
-            }
+            headers = curlHeaders();
             curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-
-            if (getCurlContext()->provider == "remote") {
-                curl_easy_setopt(curl, CURLOPT_URL, "https://pmainnet.infura.io/");
-
-            } else if (getCurlContext()->provider == "ropsten") {
-                curl_easy_setopt(curl, CURLOPT_URL, "https://testnet.infura.io/");
-
-            } else {
-                curl_easy_setopt(curl, CURLOPT_URL, getCurlContext()->baseURL.c_str());
-            }
+            curl_easy_setopt(curl, CURLOPT_URL, providerURL().c_str());
 
         } else if (cleanup) {
 
@@ -120,22 +140,62 @@ namespace qblocks {
         return curl;
     }
 
+    //-------------------------------------------------------------------------
+    // The node's IPC socket if one is configured, reachable, and the request is for the local node
+    static CIpcConnection *getLocalIpc(void) {
+        string_q provider = getCurlContext()->provider;
+        if (provider == "remote" || provider == "ropsten")
+            return NULL;
+        return getIpcConnection();
+    }
+
+    //-------------------------------------------------------------------------
+    // Sends the current post data over IPC if we can, otherwise through curl. The IPC response
+    // goes through the same write callback curl would have used.
+    static CURLcode performRequest(void) {
+        CIpcConnection *ipc = getLocalIpc();
+        string_q response;
+        if (!ipc || !ipc->call(getCurlContext()->postData, response))
+            return curl_easy_perform(getCurl());
+
+        CCurlContext *ctx = getCurlContext();
+        size_t len = response.length();
+        ctx->expected = len;
+        if (!len)
+            return CURLE_OK;
+        if ((*ctx->callBackFunc)((char*)response.c_str(), 1, len, ctx) != len)  // NOLINT
+            return CURLE_WRITE_ERROR;
+        return CURLE_OK;
+    }
+
     //-------------------------------------------------------------------------
     bool isNodeRunning(void) {
+        if (getRPCCache()->nodeIsAlive())
+            return true;
         CURLCALLBACKFUNC prev = getCurlContext()->setCurlCallback(nullCallback);
         getCurlContext()->setPostData("web3_clientVersion", "[]");
-        CURLcode res = curl_easy_perform(getCurl());
+        CURLcode res = performRequest();
         getCurlContext()->setCurlCallback(prev);
+        if (res == CURLE_OK)
+            getRPCCache()->nodeAnswered();
         return (res == CURLE_OK);
     }
 
     //-------------------------------------------------------------------------
     string_q callRPC(const string_q& method, const string_q& params, bool raw) {
 
+        // only writeCallback leaves the whole answer for us, other callbacks have side effects
+        bool memoize = (getCurlContext()->callBackFunc == writeCallback);
+        string_q memo;
+        if (memoize && getRPCCache()->lookup(method, params, raw, memo))
+            return memo;
+
         // getCurlContext()->callBackFunc = writeCallback;
         getCurlContext()->setPostData(method, params);
+        // other callbacks fill 'result' themselves, so only writeCallback can stream the response
+        getCurlContext()->keepRaw = (raw || getCurlContext()->callBackFunc != writeCallback);
 
-        CURLcode res = curl_easy_perform(getCurl());
+        CURLcode res = performRequest();
         if (res != CURLE_OK && !getCurlContext()->earlyAbort) {
             string_q currentSource = getCurlContext()->provider;
             string_q fallBack = getEnvStr("FALLBACK");
@@ -176,16 +236,18 @@ namespace qblocks {
             exit(0);
         }
 
-        if (getCurlContext()->result.empty()) {
+        CCurlContext *ctx = getCurlContext();
+        const string_q& received = (ctx->keepRaw ? ctx->result : ctx->stream.cleaned);
+        if (received.empty()) {
             cerr << cYellow;
             cerr << "\n";
             cerr << "\tWarning:" << cOff << "The Ethereum node  resulted in an empty\n";
             cerr << "\tresponse. It is impossible forQuickBlocks to proceed. Quitting...\n";
             cerr << "\n";
             exit(0);
-        } else if (contains(getCurlContext()->result, "error")) {
+        } else if (contains(received, "error")) {
             if (verbose > 1) {
-                cerr << getCurlContext()->result;
+                cerr << received;
                 cerr << getCurlContext()->postData << "\n";
             }
         }
@@ -194,16 +256,167 @@ namespace qblocks {
         //    cout << "\n" << string_q(80, '-') << "\n";
         //    cout << thePost << "\n";
         cout << string_q(60, '=') << "\n";
-        cout << "received: " << getCurlContext()->result << "\n";
+        cout << "received: " << received << "\n";
         cout.flush();
 #endif
 
-        if (raw)
-            return getCurlContext()->result;
-        CRPCResult generic;
-        char *p = cleanUpJson((char*)getCurlContext()->result.c_str());  // NOLINT
-        generic.parseJson(p);
-        return generic.result;
+        getRPCCache()->nodeAnswered();
+        string_q ret;
+        if (raw) {
+            ret = ctx->result;
+        } else if (!ctx->keepRaw) {
+            ret = ctx->stream.getResult();
+        } else {
+            CRPCResult generic;
+            char *p = cleanUpJson((char*)ctx->result.c_str());  // NOLINT
+            generic.parseJson(p);
+            ret = generic.result;
+        }
+        // a non-raw answer to a failed request is indistinguishable from a real one, so look at the response
+        if (memoize && !isRPCError(received))
+            getRPCCache()->store(method, params, raw, ret);
+        return ret;
+    }
+
+    //-------------------------------------------------------------------------
+    static size_t appendCallback(char *ptr, size_t size, size_t nmemb, void *userdata) {
+        ((string_q*)userdata)->append(ptr, size * nmemb);  // NOLINT
+        return size * nmemb;
+    }
+
+    //-------------------------------------------------------------------------
+    // Sends the posts over HTTP on up to 'width' connections at once. A response is left empty
+    // if its transfer failed, so the caller may retry it through callRPC.
+    static void performMany(const CStringArray& posts, CStringArray& responses, size_t width) {
+        responses.clear();
+        responses.resize(posts.size());
+
+        CURLM *multi = curl_multi_init();
+        if (!multi)
+            return;
+        struct curl_slist *headers = curlHeaders();
+        string_q url = providerURL();
+
+        map<CURL*, size_t> inFlight;
+        size_t next = 0;
+        while (next < posts.size() || !inFlight.empty()) {
+            while (next < posts.size() && inFlight.size() < width) {
+                CURL *easy = curl_easy_init();
+                if (!easy)
+                    break;
+                curl_easy_setopt(easy, CURLOPT_URL,           url.c_str());
+                curl_easy_setopt(easy, CURLOPT_HTTPHEADER,    headers);
+                curl_easy_setopt(easy, CURLOPT_POSTFIELDS,    posts[next].c_str());
+                curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE, posts[next].length());
+                curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, appendCallback);
+                curl_easy_setopt(easy, CURLOPT_WRITEDATA,     &responses[next]);
+                curl_multi_add_handle(multi, easy);
+                inFlight[easy] = next++;
+            }
+            if (inFlight.empty())
+                break;
+
+            int stillRunning = 0;
+            if (curl_multi_perform(multi, &stillRunning) != CURLM_OK)
+                break;
+
+            CURLMsg *msg;
+            int nLeft = 0;
+            while ((msg = curl_multi_info_read(multi, &nLeft)) != NULL) {
+                if (msg->msg != CURLMSG_DONE)
+                    continue;
+                CURL *easy = msg->easy_handle;
+                long code = 0;
+                curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &code);
+                if (msg->data.result != CURLE_OK) {
+                    responses[inFlight[easy]] = "";
+                } else if (code < 200 || code >= 300) {
+                    // the body is an error page (or a rate limiter's message), not an answer
+                    cerr << cYellow << "\tWarning: " << cOff << "The Ethereum node answered request ";
+                    cerr << inFlight[easy] << " of a batch with HTTP status " << code << ". Sending it again.\n";
+                    responses[inFlight[easy]] = "";
+                }
+                inFlight.erase(easy);
+                curl_multi_remove_handle(multi, easy);
+                curl_easy_cleanup(easy);
+            }
+            if (stillRunning)
+                curl_multi_wait(multi, NULL, 0, 1000, NULL);
+        }
+
+        // only if we stopped early
+        for (map<CURL*, size_t>::iterator it = inFlight.begin() ; it != inFlight.end() ; it++) {
+            responses[it->second] = "";
+            curl_multi_remove_handle(multi, it->first);
+            curl_easy_cleanup(it->first);
+        }
+        curl_multi_cleanup(multi);
+        curl_slist_free_all(headers);
+    }
+
+    //-------------------------------------------------------------------------
+    // Requests already answered come from the memo cache. The rest are sent together: pipelined
+    // over IPC, or over several HTTP connections at once ('rpcConnections' in [settings], four
+    // by default). Any request whose transfer fails, or whose HTTP status is not 2xx, is sent
+    // again through callRPC, which reports the failure.
+    bool callRPCMany(const CRPCRequestArray& requests, CStringArray& results, bool raw) {
+        results.clear();
+        if (requests.empty())
+            return true;
+
+        if (getCurlContext()->callBackFunc != writeCallback) {
+            for (size_t i = 0 ; i < requests.size() ; i++)
+                results.push_back(callRPC(requests[i].method, requests[i].params, raw));
+            return true;
+        }
+
+        results.resize(requests.size());
+        vector<size_t> which;
+        CStringArray posts, responses;
+        for (size_t i = 0 ; i < requests.size() ; i++) {
+            if (getRPCCache()->lookup(requests[i].method, requests[i].params, raw, results[i]))
+                continue;
+            string_q post = "{";
+            post += quote("jsonrpc") + ":" + quote("2.0") + ",";
+            post += quote("method")  + ":" + quote(requests[i].method) + ",";
+            post += quote("params")  + ":" + requests[i].params + ",";
+            post += quote("id")      + ":" + quote(asStringU(i + 1));
+            post += "}";
+            posts.push_back(post);
+            which.push_back(i);
+        }
+        if (posts.empty())
+            return true;
+
+        CIpcConnection *ipc = getLocalIpc();
+        if (ipc) {
+            if (!ipc->pipeline(posts, responses))
+                responses.clear();
+        } else if (posts.size() > 1) {
+            size_t width = toLongU(getGlobalConfig()->getConfigStr("settings", "rpcConnections", "4"));
+            performMany(posts, responses, max(width, (size_t)1));
+        }
+
+        for (size_t i = 0 ; i < which.size() ; i++) {
+            const CRPCRequest& req = requests[which[i]];
+            string_q& res = results[which[i]];
+            if (i >= responses.size() || responses[i].empty()) {
+                res = callRPC(req.method, req.params, raw);
+                continue;
+            }
+            getRPCCache()->nodeAnswered();
+            if (raw) {
+                res = responses[i];
+            } else {
+                CJsonStream stream;
+                stream.reset(responses[i].length());
+                stream.feed(responses[i].c_str(), responses[i].length());
+                res = stream.getResult();
+            }
+            if (!isRPCError(responses[i]))
+                getRPCCache()->store(req.method, req.params, raw, res);
+        }
+        return true;
     }
 
     //-------------------------------------------------------------------------
@@ -214,19 +427,31 @@ namespace qblocks {
     }
 
     //-------------------------------------------------------------------------
+    // Responses arrive in pieces. Large ones (traces, full blocks) are cleaned and searched for
+    // their result as they arrive, so they are held once rather than copied, kept raw, then cleaned.
     size_t writeCallback(char *ptr, size_t size, size_t nmemb, void *userdata) {
-        string_q part;
-        part.reserve(size*nmemb+1);
-        char *s = (char*)part.c_str();  // NOLINT
-        strncpy(s, ptr, size * nmemb);
-        s[size*nmemb]='\0';
         ASSERT(userdata);
         CCurlContext *data = (CCurlContext*)userdata;  // NOLINT
-        data->result += s;
-        // Starting around block 3804005, there was a hack wherein the byte code 5b5b5b5b5b5b5b5b5b5b5b5b
-        // repeated thousands of times, doing nothing. If we don't handle this, it dominates the scanning
-        // for no reason
-        if (strstr(s, "5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b") != NULL) {
+        size_t n = size * nmemb;
+
+        string_q& dest = (data->keepRaw ? data->result : data->stream.cleaned);
+        if (dest.empty()) {
+            size_t expected = data->expected;
+            if (!expected) {
+#if LIBCURL_VERSION_NUM >= 0x073700
+                curl_off_t len = -1;
+                if (curl_easy_getinfo(getCurl(), CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &len) == CURLE_OK && len > 0)
+                    expected = (size_t)len;
+#else
+                double len = -1.;
+                if (curl_easy_getinfo(getCurl(), CURLINFO_CONTENT_LENGTH_DOWNLOAD, &len) == CURLE_OK && len > 0.)
+                    expected = (size_t)len;
+#endif
+            }
+            dest.reserve(max(expected, n));
+        }
+
+        if (data->hackMatcher.feed(ptr, n)) {
             // This is the hack trace (there are many), so skip it
             cerr << "Curl response contains '5b5b5b5b5b5b5b5b5b5b5b5b5b5b5b'. Aborting.\n";
             cerr.flush();
@@ -234,21 +459,24 @@ namespace qblocks {
             return 0;
         }
 
+        if (data->keepRaw)
+            data->result.append(ptr, n);
+        else
+            data->stream.feed(ptr, n);
+
 //        if (shouldQuit()) {
 //            getCurlContext()->earlyAbort = true;
 //            return 0;
 //        }
 
-        return size * nmemb;
+        return n;
     }
 
     //-------------------------------------------------------------------------
     size_t traceCallback(char *ptr, size_t size, size_t nmemb, void *userdata) {
-        // Curl does not close the string, so we have to
-        ptr[size*nmemb-1] = '\0';
         CCurlContext *data = (CCurlContext*)userdata;  // NOLINT
         data->result = "ok";
-        if (strstr(ptr, "erro") != NULL) {
+        if (data->errorMatcher.feed(ptr, size * nmemb)) {
             data->result = "error";
             getCurlContext()->is_error = true;
             getCurlContext()->earlyAbort = true;
@@ -263,6 +491,154 @@ namespace qblocks {
         return size * nmemb;
     }
 
+    //-------------------------------------------------------------------------
+    CRollingMatcher::CRollingMatcher(const string_q& pat) : pattern(pat), matched(0) {
+        fallback.resize(pattern.length() + 1, 0);
+        size_t k = 0;
+        for (size_t i = 1 ; i < pattern.length() ; i++) {
+            while (k && pattern[i] != pattern[k])
+                k = fallback[k];
+            if (pattern[i] == pattern[k])
+                k++;
+            fallback[i + 1] = k;
+        }
+    }
+
+    //-------------------------------------------------------------------------
+    // True once the pattern has been seen, whether in this chunk or spanning earlier ones
+    bool CRollingMatcher::feed(const char *s, size_t n) {
+        if (pattern.empty())
+            return true;
+        for (size_t i = 0 ; i < n ; i++) {
+            while (matched && s[i] != pattern[matched])
+                matched = fallback[matched];
+            if (s[i] == pattern[matched])
+                matched++;
+            if (matched == pattern.length()) {
+                matched = fallback[matched];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //-------------------------------------------------------------------------
+    void CJsonStream::reset(size_t expected) {
+        cleaned     = "";
+        cleaned.reserve(expected);
+        state       = OUTSIDE;
+        nameStart   = 0;
+        valStart    = 0;
+        level       = 0;
+        isResult    = false;
+        resultStart = 0;
+        resultEnd   = 0;
+        hasResult   = false;
+    }
+
+    //-------------------------------------------------------------------------
+    void CJsonStream::endValue(size_t pos) {
+        if (isResult) {
+            resultStart = valStart;
+            resultEnd   = pos;
+            hasResult   = true;
+        }
+        state = AFTER_VAL;
+    }
+
+    //-------------------------------------------------------------------------
+    // Follows CBaseNode::parseJson one character at a time: a value that starts with '[' ends at
+    // its matching ']' (brackets excluded), any other value ends at the first ',' or '}' outside
+    // of braces. One comma may follow a value. A '{', '}' or ']' where a name should be ends the
+    // top level object.
+    void CJsonStream::feed(const char *s, size_t n) {
+        for (size_t i = 0 ; i < n ; i++) {
+            char ch = s[i];
+            if (ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t' || ch == '\0' || ch == '\"')
+                continue;
+            size_t pos = cleaned.length();
+            cleaned += ch;
+
+            switch (state) {
+                case OUTSIDE:
+                    if (ch == '{')
+                        state = NAME_START;
+                    break;
+
+                case NAME_START:
+                    nameStart = pos;
+                    state = IN_NAME;
+                    break;
+
+                case IN_NAME:
+                    if (ch == ':') {
+                        isResult = (pos - nameStart == 6 && !strncasecmp(cleaned.c_str() + nameStart, "result", 6));
+                        state = IN_VAL;
+                    }
+                    break;
+
+                case IN_VAL:
+                    level = 1;
+                    if (ch == '[') {
+                        valStart = pos + 1;
+                        state = IN_ARRAY;
+                        break;
+                    }
+                    valStart = pos;
+                    state = IN_PLAIN;
+                    // the first character of a plain value is part of it and may end it
+                    // fall through
+
+                case IN_PLAIN:
+                    if (ch == '{') {
+                        level++;
+                    } else if (level == 1 && (ch == ',' || ch == '}')) {
+                        endValue(pos);
+                    } else if (ch == '}') {
+                        level--;
+                    }
+                    break;
+
+                case IN_ARRAY:
+                    if (ch == '[') {
+                        level++;
+                    } else if (ch == ']') {
+                        if (level == 1)
+                            endValue(pos);
+                        else
+                            level--;
+                    }
+                    break;
+
+                case AFTER_VAL:
+                case AFTER_COMMA:
+                    if (state == AFTER_VAL && ch == ',') {
+                        state = AFTER_COMMA;
+                    } else if (ch == '{' || ch == '}' || ch == ']') {
+                        state = DONE;
+                    } else {
+                        nameStart = pos;
+                        state = IN_NAME;
+                    }
+                    break;
+
+                case DONE:
+                    break;
+            }
+        }
+    }
+
+    //-------------------------------------------------------------------------
+    // The value of the last top level 'result' field. A value cut off by the end of the response
+    // runs to the end, as it does in parseJson.
+    string_q CJsonStream::getResult(void) const {
+        if (isResult && (state == IN_PLAIN || state == IN_ARRAY))
+            return cleaned.substr(valStart);
+        if (!hasResult)
+            return "";
+        return cleaned.substr(resultStart, resultEnd - resultStart);
+    }
+
     //-------------------------------------------------------------------------
     size_t nullCallback(char *ptr, size_t size, size_t nmemb, void *userdata) {
         return size * nmemb;
@@ -18,6 +18,47 @@ namespace qblocks {
     //-------------------------------------------------------------------------
     typedef size_t (*CURLCALLBACKFUNC)(char *ptr, size_t size, size_t nmemb, void *userdata);
 
+    //-------------------------------------------------------------------------
+    // Finds a fixed pattern in a stream of chunks, including a match split across two chunks
+    class CRollingMatcher {
+    public:
+        explicit CRollingMatcher(const string_q& pat);
+        void     reset  (void) { matched = 0; }
+        bool     feed   (const char *s, size_t n);
+
+    private:
+        string_q       pattern;
+        vector<size_t> fallback;  // longest proper prefix that is also a suffix, per prefix length
+        size_t         matched;
+    };
+
+    //-------------------------------------------------------------------------
+    // Consumes a JSON-RPC response as it downloads. White space and quotes are dropped on the way
+    // in (as cleanUpJson would) and the top level 'result' field is located with the same rules
+    // CBaseNode::parseJson uses, so callRPC returns it without parsing the response again.
+    class CJsonStream {
+    public:
+        string_q cleaned;
+
+                 CJsonStream (void) { reset(); }
+        void     reset       (size_t expected = 0);
+        void     feed        (const char *s, size_t n);
+        string_q getResult   (void) const;
+
+    private:
+        enum { OUTSIDE, NAME_START, IN_NAME, IN_VAL, IN_ARRAY, IN_PLAIN, AFTER_VAL, AFTER_COMMA, DONE } state;
+        size_t   nameStart;
+        size_t   valStart;
+        size_t   level;
+        bool     isResult;
+        size_t   resultStart;
+        size_t   resultEnd;
+        bool     hasResult;
+
+        void     endValue    (size_t pos);
+    };
+
+    //-------------------------------------------------------------------------
     class CCurlContext {
     public:
         string_q         headers;
@@ -25,7 +66,12 @@ namespace qblocks {
         CURLCALLBACKFUNC callBackFunc;
         bool             earlyAbort;
         string_q         postData;
-        string_q         result;
+        string_q         result;      // the raw response (only kept for raw requests)
+        bool             keepRaw;
+        CJsonStream      stream;      // the cleaned response and its 'result' field
+        size_t           expected;    // the response's size if known before it arrives
+        CRollingMatcher  hackMatcher; // watches for the 5b5b... hack in traces
+        CRollingMatcher  errorMatcher;
         string_q         provider;
         bool             is_error;
         size_t           theID;
@@ -37,11 +83,22 @@ namespace qblocks {
         CURLCALLBACKFUNC setCurlCallback(CURLCALLBACKFUNC func);
     };
 
+    //-------------------------------------------------------------------------
+    class CRPCRequest {
+    public:
+        string_q method;
+        string_q params;
+        CRPCRequest(const string_q& m = "", const string_q& p = "[]") : method(m), params(p) { }
+    };
+    typedef vector<CRPCRequest> CRPCRequestArray;
+
+    //-------------------------------------------------------------------------
     extern CURL         *getCurl         (bool cleanup = false);
     extern bool          isNodeRunning   (void);
     extern bool          nodeHasBalances (void);
     extern bool          getObjectViaRPC (CBaseNode &node, const string_q& method, const string_q& params);
     extern string_q      callRPC         (const string_q& method, const string_q& params, bool raw);
+    extern bool          callRPCMany     (const CRPCRequestArray& requests, CStringArray& results, bool raw);
     extern CCurlContext *getCurlContext  (void);
     extern size_t        writeCallback   (char *ptr, size_t size, size_t nmemb, void *userdata);
     extern size_t        traceCallback   (char *ptr, size_t size, size_t nmemb, void *userdata);
@@ -0,0 +1,247 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "node_ipc.h"
+
+namespace qblocks {
+
+    //-------------------------------------------------------------------------
+    #ifdef MSG_NOSIGNAL
+    #define SEND_FLAGS MSG_NOSIGNAL
+    #else
+    #define SEND_FLAGS 0
+    #endif
+
+    //-------------------------------------------------------------------------
+    CIpcConnection::CIpcConnection(void) : fd(-1) {
+    }
+
+    //-------------------------------------------------------------------------
+    CIpcConnection::~CIpcConnection(void) {
+        close();
+    }
+
+    //-------------------------------------------------------------------------
+    bool CIpcConnection::open(const string_q& path) {
+        close();
+        struct sockaddr_un addr;
+        bzero(&addr, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.empty() || path.length() >= sizeof(addr.sun_path))
+            return false;
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return false;
+#ifdef SO_NOSIGPIPE
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+        if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+            close();
+            return false;
+        }
+        // reads and writes never wait, pipeline waits in poll for whichever can proceed
+        int flags = fcntl(fd, F_GETFL, 0);
+        if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    //-------------------------------------------------------------------------
+    void CIpcConnection::close(void) {
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+        pending = "";
+    }
+
+    //-------------------------------------------------------------------------
+    // One past the end of the first complete object or array at or after 'start', or NOPOS if
+    // the value is not complete yet.
+    size_t jsonValueEnd(const string_q& str, size_t start) {
+        size_t depth = 0;
+        bool inString = false;
+        for (size_t i = start ; i < str.length() ; i++) {
+            char ch = str[i];
+            if (inString) {
+                if (ch == '\\')
+                    i++;
+                else if (ch == '"')
+                    inString = false;
+            } else if (ch == '"') {
+                inString = true;
+            } else if (ch == '{' || ch == '[') {
+                depth++;
+            } else if (ch == '}' || ch == ']') {
+                if (depth && --depth == 0)
+                    return i + 1;
+            }
+        }
+        return NOPOS;
+    }
+
+    //-------------------------------------------------------------------------
+    // The top level "id" of a response (numbers or quoted numbers), zero if there is none
+    uint64_t jsonRpcId(const string_q& response) {
+        size_t depth = 0;
+        for (size_t i = 0 ; i < response.length() ; i++) {
+            char ch = response[i];
+            if (ch == '"') {
+                size_t end = i + 1;
+                while (end < response.length() && response[end] != '"')
+                    end += (response[end] == '\\' ? 2 : 1);
+                if (depth == 1 && response.compare(i, end - i + 1, "\"id\"") == 0) {
+                    size_t p = end + 1;
+                    while (p < response.length() && (isspace(response[p]) || response[p] == ':' || response[p] == '"'))
+                        p++;
+                    return toLongU(extract(response, p, 20));
+                }
+                i = end;
+            } else if (ch == '{' || ch == '[') {
+                depth++;
+            } else if (ch == '}' || ch == ']') {
+                depth--;
+            }
+        }
+        return 0;
+    }
+
+    //-------------------------------------------------------------------------
+    // Moves the first complete response out of 'pending'
+    bool CIpcConnection::nextResponse(string_q& response) {
+        size_t end = jsonValueEnd(pending, 0);
+        if (end == NOPOS)
+            return false;
+        size_t start = pending.find_first_of("{[");
+        response = pending.substr(start, end - start);
+        pending.erase(0, end);
+        return true;
+    }
+
+    //-------------------------------------------------------------------------
+    // Appends whatever has arrived to 'pending'. False (and the connection is closed) if the
+    // node has gone away.
+    bool CIpcConnection::receive(void) {
+        char buff[64 * 1024];
+        ssize_t n = recv(fd, buff, sizeof(buff), 0);
+        if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+            return true;
+        if (n <= 0) {
+            close();
+            return false;
+        }
+        pending.append(buff, (size_t)n);
+        return true;
+    }
+
+    //-------------------------------------------------------------------------
+    bool CIpcConnection::call(const string_q& request, string_q& response) {
+        CStringArray requests, responses;
+        requests.push_back(request);
+        if (!pipeline(requests, responses))
+            return false;
+        response = responses[0];
+        return true;
+    }
+
+    //-------------------------------------------------------------------------
+    // Writes the requests while reading whatever responses have arrived. The socket does not
+    // block, so a large batch is written a piece at a time as the node reads it, and responses
+    // are read as they come rather than after the last request is written. Otherwise a node
+    // that answers as it reads would fill its side of the socket and stop reading. Each request
+    // must carry a different id.
+    bool CIpcConnection::pipeline(const CStringArray& requests, CStringArray& responses) {
+        responses.clear();
+        if (!isOpen())
+            return false;
+
+        map<uint64_t, size_t> byId;
+        for (size_t i = 0 ; i < requests.size() ; i++)
+            byId[jsonRpcId(requests[i])] = i;
+        if (byId.size() != requests.size())
+            return false;
+        responses.resize(requests.size());
+
+        string_q out;
+        for (size_t i = 0 ; i < requests.size() ; i++)
+            out += requests[i] + "\n";
+
+        size_t written = 0, nReceived = 0;
+        while (nReceived < requests.size()) {
+            struct pollfd pfd;
+            pfd.fd = fd;
+            pfd.events = (short)(POLLIN | (written < out.length() ? POLLOUT : 0));
+            pfd.revents = 0;
+            if (poll(&pfd, 1, -1) < 0) {
+                if (errno == EINTR)
+                    continue;
+                close();
+                return false;
+            }
+
+            if ((pfd.revents & POLLOUT) && written < out.length()) {
+                ssize_t n = send(fd, out.c_str() + written, out.length() - written, SEND_FLAGS);
+                if (n < 0 && errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) {
+                    close();
+                    return false;
+                }
+                written += (size_t)max(n, (ssize_t)0);
+            }
+
+            if (pfd.revents & (POLLIN | POLLHUP | POLLERR)) {
+                if (!receive())
+                    return false;
+                string_q response;
+                while (nReceived < requests.size() && nextResponse(response)) {
+                    map<uint64_t, size_t>::iterator it = byId.find(jsonRpcId(response));
+                    if (it != byId.end() && responses[it->second].empty()) {
+                        responses[it->second] = response;
+                        nReceived++;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    //-------------------------------------------------------------------------
+    // The connection named by ipcPath in the [settings] group of quickBlocks.toml. Tried once per
+    // process. NULL if it is not configured or cannot be reached, in which case we use HTTP.
+    // 'reset' closes the connection (a forked process must not share its parent's) so that the
+    // next call opens a new one
+    CIpcConnection *getIpcConnection(bool reset) {
+        static CIpcConnection connection;
+        static bool tried = false;
+        if (reset) {
+            connection.close();
+            tried = false;
+            return NULL;
+        }
+        if (!tried) {
+            tried = true;
+            string_q path = getGlobalConfig()->getConfigStr("settings", "ipcPath", "");
+            replace(path, "~/", getHomeFolder());
+            if (!path.empty() && !connection.open(path) && verbose)
+                cerr << "Could not connect to " << path << ". Using HTTP.\n";
+        }
+        return (connection.isOpen() ? &connection : NULL);
+    }
+
+}  // namespace qblocks
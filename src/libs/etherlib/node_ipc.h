@@ -0,0 +1,52 @@
+#pragma once
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include "utillib.h"
+
+namespace qblocks {
+
+    //-------------------------------------------------------------------------
+    // JSON-RPC over the node's Unix domain socket (geth.ipc, jsonrpc.ipc). There is no framing
+    // on the socket, so responses are split where each top level JSON value ends. 'pipeline'
+    // writes many requests before reading any response and pairs the responses with the
+    // requests by their ids, so the node may answer in any order.
+    //-------------------------------------------------------------------------
+    class CIpcConnection {
+    public:
+                 CIpcConnection  (void);
+                 ~CIpcConnection (void);
+
+        bool     open            (const string_q& path);
+        void     close           (void);
+        bool     isOpen          (void) const { return (fd >= 0); }
+
+        bool     call            (const string_q& request, string_q& response);
+        bool     pipeline        (const CStringArray& requests, CStringArray& responses);
+
+    private:
+        int      fd;
+        string_q pending;   // received bytes not yet returned as a response
+
+        bool     nextResponse    (string_q& response);
+        bool     receive         (void);
+
+        CIpcConnection(const CIpcConnection&);
+        CIpcConnection& operator=(const CIpcConnection&);
+    };
+
+    //-------------------------------------------------------------------------
+    extern size_t          jsonValueEnd     (const string_q& str, size_t start);
+    extern uint64_t        jsonRpcId        (const string_q& response);
+    extern CIpcConnection *getIpcConnection (bool reset = false);
+
+}  // namespace qblocks
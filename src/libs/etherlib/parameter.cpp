@@ -99,13 +99,14 @@ bool CParameter::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> indexed;
-    archive >> name;
-    archive >> type;
-    archive >> isPointer;
-    archive >> isArray;
-    archive >> isObject;
-    archive >> strDefault;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(CParameter), 7);
+    fields >> indexed;
+    fields >> name;
+    fields >> type;
+    fields >> isPointer;
+    fields >> isArray;
+    fields >> isObject;
+    fields >> strDefault;
     finishParse();
     return true;
 }
@@ -18,6 +18,7 @@
 #include "pricequote.h"
 #include "etherlib.h"
 #include "pricesource.h"
+#include "priceseries.h"
 
 namespace qblocks {
 
@@ -99,8 +100,9 @@ bool CPriceQuote::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> timestamp;
-    archive >> close;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(CPriceQuote), 2);
+    fields >> timestamp;
+    fields >> close;
     finishParse();
     return true;
 }
@@ -256,32 +258,22 @@ ostream& operator<<(ostream& os, const CPriceQuote& item) {
 //---------------------------------------------------------------------------
 // EXISTING_CODE
 //-----------------------------------------------------------------------------------
+static bool quoteBefore(timestamp_t ts, const CPriceQuote& quote) {
+    return ts < (timestamp_t)quote.timestamp;
+}
+
+//-----------------------------------------------------------------------------------
+// The last quote at or before 'ts'. The exchange's history has gaps, so we search.
 uint64_t indexFromTimeStamp(const CPriceQuoteArray& quotes, timestamp_t ts) {
-    timestamp_t first = (timestamp_t)quotes[0].timestamp;
-    if (ts < first)
-        return 0;
-    timestamp_t since = ts - first;
-    return min(quotes.size()-1, size_t(since / (5*60)));
+    CPriceQuoteArray::const_iterator it = upper_bound(quotes.begin(), quotes.end(), ts, quoteBefore);
+    return (it == quotes.begin() ? 0 : uint64_t(it - quotes.begin()) - 1);
 }
 
 //-----------------------------------------------------------------------
 string_q asDollars(timestamp_t ts, SFUintBN weiIn) {
     if (weiIn == 0)
         return "";
-    static CPriceQuoteArray quotes;
-    if (!quotes.size()) {
-        string_q message;
-        CPriceSource source;
-        if (!loadPriceData(source, quotes, false, message, 1)) {
-            cerr << "Cannot load price data. Quitting.\n";
-            exit(0);
-        }
-    }
-    uint64_t index = indexFromTimeStamp(quotes, ts);
-    const CPriceQuote *q = &quotes[index];  // taking a non-const reference
-    double price = q->close * 100.0;
-    uint64_t pInt = (uint64_t)price;
-    weiIn *= pInt;
+    weiIn *= getPriceSeries()->priceAt(ts);
     weiIn /= 100;
     return wei2Ether(to_string(weiIn).c_str());
 }
@@ -302,11 +294,14 @@ string_q insertCommas(const string_q& dIn) {
 
 //-----------------------------------------------------------------------
 string_q dispDollars(timestamp_t ts, SFUintBN weiIn) {
-    string_q sBal = asDollars(ts, weiIn);
-    string_q d = nextTokenClear(sBal, '.');
-    d = insertCommas(d);
-    sBal = (sBal.empty() ? "0.00" : d + "." + extract(sBal, 0, 2));
-    return sBal;
+    if (weiIn == 0)
+        return "0.00";
+    return getPriceSeries()->toDollars(ts, weiIn);
+}
+
+//-----------------------------------------------------------------------
+void dispDollars(const CWeiAtTimeArray& rows, CStringArray& dollars) {
+    getPriceSeries()->toDollars(rows, dollars);
 }
 // EXISTING_CODE
 }  // namespace qblocks
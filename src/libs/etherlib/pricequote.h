@@ -135,6 +135,7 @@ extern SFArchive& operator<<(SFArchive& archive, const CPriceQuoteArray& array);
 extern uint64_t indexFromTimeStamp(const CPriceQuoteArray& quotes, timestamp_t ts);
 extern string_q asDollars(timestamp_t ts, SFUintBN weiIn);
 extern string_q dispDollars(timestamp_t ts, SFUintBN weiIn);
+extern string_q insertCommas(const string_q& dIn);
 // EXISTING_CODE
 }  // namespace qblocks
 
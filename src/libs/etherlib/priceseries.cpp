@@ -0,0 +1,291 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include "priceseries.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    static const char seriesMagic[8] = { 'Q', 'B', 'P', 'R', 'I', 'C', 'E', '1' };
+
+    //--------------------------------------------------------------------------
+    string_q priceSeriesPath(const CPriceSource& source) {
+        return substitute(source.getDatabasePath(), ".bin", ".col");
+    }
+
+    //--------------------------------------------------------------------------
+    CPriceSeries::CPriceSeries(void) : mapped(NULL), pRecords(NULL) {
+        bzero(&header, sizeof(header));
+    }
+
+    //--------------------------------------------------------------------------
+    CPriceSeries::~CPriceSeries(void) {
+        close();
+    }
+
+    //--------------------------------------------------------------------------
+    void CPriceSeries::close(void) {
+        if (mapped)
+            delete mapped;
+        mapped   = NULL;
+        pRecords = NULL;
+        bzero(&header, sizeof(header));
+    }
+
+    //--------------------------------------------------------------------------
+    static bool checkHeader(const CPriceSeriesHeader& header, uint64_t fileSz) {
+        if (memcmp(header.magic, seriesMagic, sizeof(seriesMagic)))
+            return false;
+        uint64_t expected = sizeof(CPriceSeriesHeader) + (uint64_t)header.nQuotes * sizeof(CPriceRecord);
+        return (expected == fileSz && header.nQuotes > 0);
+    }
+
+    //--------------------------------------------------------------------------
+    // Maps the series read only. A missing, empty or damaged file leaves the series empty.
+    bool CPriceSeries::open(const string_q& fileName) {
+        close();
+        if (!fileExists(fileName) || fileSize(fileName) < sizeof(CPriceSeriesHeader))
+            return false;
+
+        CMemMapFile *mm = new CMemMapFile(fileName, CMemMapFile::WholeFile, CMemMapFile::RandomAccess);
+        if (!mm->isValid() || mm->size() < sizeof(CPriceSeriesHeader)) {
+            delete mm;
+            return false;
+        }
+
+        const unsigned char *base = mm->getData();
+        memcpy(&header, base, sizeof(header));
+        if (!checkHeader(header, mm->size())) {
+            bzero(&header, sizeof(header));
+            delete mm;
+            return false;
+        }
+
+        mapped   = mm;
+        pRecords = reinterpret_cast<const CPriceRecord*>(base + sizeof(CPriceSeriesHeader));
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    // The position of the last quote at or before 'ts' (the first quote if 'ts' is earlier than
+    // all of them). Callers walking forward in time pass the previous answer as 'hint', which
+    // is usually right or one short. Otherwise interpolation steps alternate with halving
+    // steps, so an uneven series never costs more than twice a binary search.
+    size_t CPriceSeries::indexOf(timestamp_t ts, size_t hint) const {
+        size_t n = header.nQuotes;
+        if (!n || ts <= pRecords[0].timestamp)
+            return 0;
+        if (ts >= pRecords[n-1].timestamp)
+            return n - 1;
+
+        if (hint < n - 1 && pRecords[hint].timestamp <= ts) {
+            if (ts < pRecords[hint+1].timestamp)
+                return hint;
+            if (hint < n - 2 && ts < pRecords[hint+2].timestamp)
+                return hint + 1;
+        }
+
+        // pRecords[lo].timestamp <= ts < pRecords[hi].timestamp
+        size_t lo = 0, hi = n - 1;
+        bool interpolate = true;
+        while (hi - lo > 1) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (interpolate) {
+                uint64_t span = (uint64_t)(pRecords[hi].timestamp - pRecords[lo].timestamp);
+                uint64_t into = (uint64_t)(ts - pRecords[lo].timestamp);
+                mid = lo + (size_t)(into * (hi - lo) / span);
+                mid = min(max(mid, lo + 1), hi - 1);
+            }
+            interpolate = !interpolate;
+            if (pRecords[mid].timestamp <= ts)
+                lo = mid;
+            else
+                hi = mid;
+        }
+        return lo;
+    }
+
+    //--------------------------------------------------------------------------
+    uint64_t CPriceSeries::priceAt(timestamp_t ts) const {
+        return (header.nQuotes ? pRecords[indexOf(ts)].cents : 0);
+    }
+
+    //--------------------------------------------------------------------------
+    // Divides the 128 bit number in limbs[0..3] (least significant first) by 'd' in place
+    static uint32_t divideLimbs(uint32_t limbs[4], uint32_t d) {
+        uint64_t rem = 0;
+        for (int i = 3 ; i >= 0 ; i--) {
+            uint64_t cur = (rem << 32) | limbs[i];
+            limbs[i] = (uint32_t)(cur / d);
+            rem = cur % d;
+        }
+        return (uint32_t)rem;
+    }
+
+    //--------------------------------------------------------------------------
+    // Truncated cents for 'wei' at a price of 'priceCents' per ether, which is what
+    // wei * price / 10^18 gives with big numbers, without using big numbers. The wei are split
+    // into whole ether and two nine digit parts of the remainder so that no product exceeds
+    // 64 bits. Returns false if the value is too large to be done this way.
+    bool weiToCents(const SFUintBN& wei, uint64_t priceCents, uint64_t& cents) {
+        cents = 0;
+        if (wei.bitLength() > 128 || priceCents > 0xffffffffULL)
+            return false;
+
+        uint32_t limbs[4];
+        for (unsigned int i = 0 ; i < 2 ; i++) {
+            uint64_t block = wei.getBlock(i);
+            limbs[2*i]   = (uint32_t)(block & 0xffffffff);
+            limbs[2*i+1] = (uint32_t)(block >> 32);
+        }
+        uint64_t lowNine  = divideLimbs(limbs, 1000000000);
+        uint64_t highNine = divideLimbs(limbs, 1000000000);
+        if (limbs[2] || limbs[3])
+            return false;
+        uint64_t ether = ((uint64_t)limbs[1] << 32) | limbs[0];
+
+        uint64_t frac = (highNine * priceCents + (lowNine * priceCents) / 1000000000) / 1000000000;
+        if (priceCents && ether > (UINT64_MAX - frac) / priceCents)
+            return false;
+        cents = ether * priceCents + frac;
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    // As dispDollars has always shown them: commas every three digits and two decimals
+    string_q centsToDollars(uint64_t cents) {
+        char buff[40];
+        char *e = buff + sizeof(buff) - 1;
+        char *p = e;
+        *p = '\0';
+        *--p = (char)('0' + cents % 10); cents /= 10;
+        *--p = (char)('0' + cents % 10); cents /= 10;
+        *--p = '.';
+        size_t nDigits = 0;
+        do {
+            if (nDigits && !(nDigits % 3))
+                *--p = ',';
+            *--p = (char)('0' + cents % 10);
+            cents /= 10;
+            nDigits++;
+        } while (cents);
+        return string_q(p, (size_t)(e - p));
+    }
+
+    //--------------------------------------------------------------------------
+    bool CPriceSeries::toCents(timestamp_t ts, const SFUintBN& wei, uint64_t& cents) const {
+        return weiToCents(wei, priceAt(ts), cents);
+    }
+
+    //--------------------------------------------------------------------------
+    static string_q bigDollars(const SFUintBN& wei, uint64_t priceCents) {
+        SFUintBN cents = wei * SFUintBN(priceCents);
+        cents /= str2BigUint("1000000000000000000");
+        string_q d = to_string(cents).c_str();
+        if (d.length() < 3)
+            d = substitute(padLeft(d, 3), " ", "0");
+        string_q whole = extract(d, 0, d.length() - 2);
+        return insertCommas(whole) + "." + extract(d, d.length() - 2);
+    }
+
+    //--------------------------------------------------------------------------
+    string_q CPriceSeries::toDollars(timestamp_t ts, const SFUintBN& wei) const {
+        uint64_t price = priceAt(ts);
+        uint64_t cents;
+        if (weiToCents(wei, price, cents))
+            return centsToDollars(cents);
+        return bigDollars(wei, price);
+    }
+
+    //--------------------------------------------------------------------------
+    // The bulk form of toDollars for exports. Rows in time order find their quote in constant time.
+    void CPriceSeries::toDollars(const CWeiAtTimeArray& rows, CStringArray& dollars) const {
+        dollars.clear();
+        dollars.reserve(rows.size());
+        size_t pos = NOPOS;
+        for (size_t i = 0 ; i < rows.size() ; i++) {
+            uint64_t price = 0;
+            if (header.nQuotes) {
+                pos = indexOf(rows[i].timestamp, pos);
+                price = pRecords[pos].cents;
+            }
+            uint64_t cents;
+            if (weiToCents(rows[i].wei, price, cents))
+                dollars.push_back(centsToDollars(cents));
+            else
+                dollars.push_back(bigDollars(rows[i].wei, price));
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    bool writePriceSeries(const string_q& fileName, const CPriceQuoteArray& quotes) {
+        if (quotes.empty())
+            return false;
+
+        string_q created;
+        if (!establishFolder(fileName, created))
+            return false;
+
+        vector<CPriceRecord> records;
+        records.reserve(quotes.size());
+        for (size_t i = 0 ; i < quotes.size() ; i++) {
+            CPriceRecord rec;
+            rec.timestamp = quotes[i].timestamp;
+            rec.cents     = (uint64_t)(quotes[i].close * 100.0);
+            // the search needs increasing timestamps, a repeated quote replaces the earlier one
+            if (records.size() && records.back().timestamp >= rec.timestamp) {
+                if (records.back().timestamp == rec.timestamp)
+                    records.back() = rec;
+                continue;
+            }
+            records.push_back(rec);
+        }
+
+        string_q tmpName = fileName + ".tmp";
+        CBinFile file;
+        if (!file.Lock(tmpName, binaryWriteCreate, LOCK_CREATE))
+            return false;
+
+        CPriceSeriesHeader hdr;
+        bzero(&hdr, sizeof(hdr));
+        memcpy(hdr.magic, seriesMagic, sizeof(hdr.magic));
+        hdr.nQuotes = (uint32_t)records.size();
+        file.Write(&hdr, sizeof(hdr), 1);
+        file.Write(records.data(), sizeof(CPriceRecord), records.size());
+        file.Release();
+        return (::rename(tmpName.c_str(), fileName.c_str()) == 0);
+    }
+
+    //--------------------------------------------------------------------------
+    // The default (Poloniex USDT_ETH) series, rebuilt from the price database when the database
+    // is newer. Quits if there is no price data at all.
+    const CPriceSeries *getPriceSeries(void) {
+        static CPriceSeries series;
+        if (series.size())
+            return &series;
+
+        CPriceSource source;
+        string_q seriesFile = priceSeriesPath(source);
+        if (!fileExists(seriesFile) || fileLastModifyDate(source.getDatabasePath()) > fileLastModifyDate(seriesFile)) {
+            string_q message;
+            CPriceQuoteArray quotes;
+            if (loadPriceData(source, quotes, false, message, 1))
+                writePriceSeries(seriesFile, quotes);
+        }
+        if (!series.open(seriesFile)) {
+            cerr << "Cannot load price data. Quitting.\n";
+            exit(0);
+        }
+        return &series;
+    }
+
+}  // namespace qblocks
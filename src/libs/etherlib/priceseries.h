@@ -0,0 +1,86 @@
+#pragma once
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <vector>
+#include "pricesource.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    // Layout of the price column file (prices/<source>_<pair>.col). The header is followed by
+    // the quotes in timestamp order. Prices are stored in cents, the precision asDollars has
+    // always used.
+    //--------------------------------------------------------------------------
+    class CPriceSeriesHeader {
+    public:
+        char     magic[8];
+        uint32_t nQuotes;
+        uint32_t unused;
+    };
+
+    //--------------------------------------------------------------------------
+    class CPriceRecord {
+    public:
+        int64_t  timestamp;
+        uint64_t cents;
+    };
+
+    //--------------------------------------------------------------------------
+    // One row of a --dollars export
+    class CWeiAtTime {
+    public:
+        timestamp_t timestamp;
+        SFUintBN    wei;
+        CWeiAtTime(timestamp_t ts = 0, const SFUintBN& w = 0) : timestamp(ts), wei(w) { }
+    };
+    typedef vector<CWeiAtTime> CWeiAtTimeArray;
+
+    //--------------------------------------------------------------------------
+    // The price database as a memory mapped column of (timestamp, cents). Lookups find the last
+    // quote at or before a timestamp by searching the actual timestamps, so gaps in the
+    // exchange's history do not shift every later price.
+    //--------------------------------------------------------------------------
+    class CPriceSeries {
+    public:
+                 CPriceSeries  (void);
+                 ~CPriceSeries (void);
+
+        bool     open          (const string_q& fileName);
+        void     close         (void);
+        size_t   size          (void) const { return header.nQuotes; }
+        const CPriceRecord& operator[](size_t i) const { return pRecords[i]; }
+
+        size_t   indexOf       (timestamp_t ts, size_t hint = NOPOS) const;
+        uint64_t priceAt       (timestamp_t ts) const;
+        bool     toCents       (timestamp_t ts, const SFUintBN& wei, uint64_t& cents) const;
+        string_q toDollars     (timestamp_t ts, const SFUintBN& wei) const;
+        void     toDollars     (const CWeiAtTimeArray& rows, CStringArray& dollars) const;
+
+    private:
+        CMemMapFile         *mapped;
+        const CPriceRecord  *pRecords;
+        CPriceSeriesHeader   header;
+
+        CPriceSeries(const CPriceSeries&);
+        CPriceSeries& operator=(const CPriceSeries&);
+    };
+
+    //--------------------------------------------------------------------------
+    extern bool     writePriceSeries (const string_q& fileName, const CPriceQuoteArray& quotes);
+    extern string_q priceSeriesPath  (const CPriceSource& source);
+    extern bool     weiToCents       (const SFUintBN& wei, uint64_t priceCents, uint64_t& cents);
+    extern string_q centsToDollars   (uint64_t cents);
+    extern const CPriceSeries *getPriceSeries(void);
+    extern void     dispDollars      (const CWeiAtTimeArray& rows, CStringArray& dollars);
+
+}  // namespace qblocks
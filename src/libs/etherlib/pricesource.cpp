@@ -174,6 +174,7 @@ namespace qblocks {
                 priceCache << lastRead.m_nSeconds;
                 priceCache << quotes;
                 priceCache.Close();
+                writePriceSeries(priceSeriesPath(source), quotes);
                 if (verbose) {
                     cerr << "Wrote " << quotes.size() << " price quotes to file ";
                     cerr << "(lastRead: " << lastRead << ").\n";
@@ -64,9 +64,13 @@ bool CReceipt::setValueByName(const string_q& fieldName, const string_q& fieldVa
         *((string_q*)&fieldValue) = asStringU(NO_STATUS);  // NOLINT
     }
 
-    if (pTrans)
+    if (pTrans) {
+        // logs from eth_getLogs name their transaction this way
+        if (fieldName == "transactionHash")
+            return ((CTransaction*)pTrans)->setValueByName("hash", fieldValue);  // NOLINT
         if (((CTransaction*)pTrans)->setValueByName(fieldName, fieldValue))  // NOLINT
             return true;
+    }
     // EXISTING_CODE
 
     switch (tolower(fieldName[0])) {
@@ -119,10 +123,11 @@ bool CReceipt::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> contractAddress;
-    archive >> gasUsed;
-    archive >> logs;
-    archive >> status;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(CReceipt), 4);
+    fields >> contractAddress;
+    fields >> gasUsed;
+    fields >> logs;
+    fields >> status;
     finishParse();
     return true;
 }
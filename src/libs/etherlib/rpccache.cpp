@@ -0,0 +1,241 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include "rpccache.h"
+#include "abistore.h"
+#include "node.h"
+
+namespace qblocks {
+
+    //-------------------------------------------------------------------------
+    class CMethodClass {
+    public:
+        const char *method;
+        rpccache_t  cls;
+    };
+
+    //-------------------------------------------------------------------------
+    // Methods not listed here are never cached. eth_getLogs is left out because its answers
+    // can be enormous and are seldom asked for twice.
+    static const CMethodClass methodClasses[] = {
+        { "eth_getBlockByHash",                      RPC_IMMUTABLE },
+        { "eth_getTransactionByHash",                RPC_IMMUTABLE },
+        { "eth_getTransactionReceipt",               RPC_IMMUTABLE },
+        { "eth_getTransactionByBlockHashAndIndex",   RPC_IMMUTABLE },
+        { "eth_getUncleByBlockHashAndIndex",         RPC_IMMUTABLE },
+        { "trace_transaction",                       RPC_IMMUTABLE },
+        { "trace_get",                               RPC_IMMUTABLE },
+        { "web3_sha3",                               RPC_IMMUTABLE },
+        { "eth_getBlockByNumber",                    RPC_HISTORY },
+        { "eth_getTransactionByBlockNumberAndIndex", RPC_HISTORY },
+        { "eth_getUncleByBlockNumberAndIndex",       RPC_HISTORY },
+        { "eth_getBalance",                          RPC_HISTORY },
+        { "eth_getCode",                             RPC_HISTORY },
+        { "eth_getStorageAt",                        RPC_HISTORY },
+        { "eth_getTransactionCount",                 RPC_HISTORY },
+        { "eth_call",                                RPC_HISTORY },
+        { "trace_block",                             RPC_HISTORY },
+        { "web3_clientVersion",                      RPC_SESSION },
+        { "net_version",                             RPC_SESSION },
+        { "eth_protocolVersion",                     RPC_SESSION },
+        { "eth_blockNumber",                         RPC_HEAD },
+        { "eth_syncing",                             RPC_HEAD },
+        { "eth_gasPrice",                            RPC_HEAD },
+        { "eth_accounts",                            RPC_HEAD },
+    };
+    static const size_t nMethodClasses = sizeof(methodClasses) / sizeof(CMethodClass);
+
+    //-------------------------------------------------------------------------
+    // Historical requests that name the head of the chain (or omit a block, as eth_getCode may)
+    // are only good as long as the head.
+    rpccache_t rpcCacheClass(const string_q& method, const string_q& params) {
+        for (size_t i = 0 ; i < nMethodClasses ; i++) {
+            if (method == methodClasses[i].method) {
+                rpccache_t cls = methodClasses[i].cls;
+                if (cls == RPC_HISTORY && (contains(params, "latest") || contains(params, "pending")))
+                    return RPC_HEAD;
+                if (cls == RPC_HISTORY && method == "eth_getCode" && !contains(params, ","))
+                    return RPC_HEAD;
+                return cls;
+            }
+        }
+        return RPC_NOCACHE;
+    }
+
+    //-------------------------------------------------------------------------
+    bool isRPCError(const string_q& response) {
+        size_t level = 0;
+        bool inString = false;
+        size_t nameStart = NOPOS;
+        for (size_t i = 0 ; i < response.length() ; i++) {
+            char ch = response[i];
+            if (inString) {
+                if (ch == '\\') {
+                    i++;
+                } else if (ch == '"') {
+                    inString = false;
+                    // a string directly inside the outer object followed by a colon is a member name
+                    if (level == 1 && nameStart != NOPOS) {
+                        size_t next = response.find_first_not_of(" \t\r\n", i + 1);
+                        if (next != string::npos && response[next] == ':' &&
+                                response.compare(nameStart, i - nameStart, "error") == 0)
+                            return true;
+                    }
+                    nameStart = NOPOS;
+                }
+            } else if (ch == '"') {
+                inString = true;
+                nameStart = i + 1;
+            } else if (ch == '{' || ch == '[') {
+                level++;
+            } else if (ch == '}' || ch == ']') {
+                level--;
+            }
+        }
+        return false;
+    }
+
+    //-------------------------------------------------------------------------
+    CRPCCache::CRPCCache(void) : hits(0), misses(0), diskHits(0), bytes(0), maxBytes(64 << 20),
+                                 headTTL(5), lastAnswer(0) {
+    }
+
+    //-------------------------------------------------------------------------
+    void CRPCCache::clear(void) {
+        entries.clear();
+        recent.clear();
+        bytes = 0;
+        hits = misses = diskHits = 0;
+        lastAnswer = 0;
+    }
+
+    //-------------------------------------------------------------------------
+    static string_q cacheKey(const string_q& method, const string_q& params, bool raw) {
+        return method + (raw ? "|raw|" : "|") + params;
+    }
+
+    //-------------------------------------------------------------------------
+    // Spread over 256 folders so no one folder grows too large
+    string_q CRPCCache::diskName(const string_q& key) const {
+        string_q hex = padLeft(toHex(abiSourceHash(key)).substr(2), 16, '0');
+        return diskFolder + extract(hex, 0, 2) + "/" + hex + ".txt";
+    }
+
+    //-------------------------------------------------------------------------
+    bool CRPCCache::lookup(const string_q& method, const string_q& params, bool raw, string_q& value) {
+        rpccache_t cls = rpcCacheClass(method, params);
+        if (cls == RPC_NOCACHE)
+            return false;
+
+        string_q key = cacheKey(method, params, raw);
+        map<string_q, CEntry>::iterator it = entries.find(key);
+        if (it != entries.end()) {
+            if (cls != RPC_HEAD || time(NULL) - it->second.stored <= headTTL) {
+                recent.splice(recent.begin(), recent, it->second.used);
+                value = it->second.value;
+                hits++;
+                return true;
+            }
+            drop(it);
+        }
+
+        if (cls == RPC_IMMUTABLE && !diskFolder.empty()) {
+            // the key is stored on the first line in case two keys share a file name
+            string_q fileName = diskName(key);
+            if (fileExists(fileName)) {
+                string_q contents = binaryFileToString(fileName);
+                size_t eol = contents.find('\n');
+                if (eol != string::npos && contents.compare(0, eol, key) == 0) {
+                    value = contents.substr(eol + 1);
+                    keep(key, value);
+                    hits++;
+                    diskHits++;
+                    return true;
+                }
+            }
+        }
+
+        misses++;
+        return false;
+    }
+
+    //-------------------------------------------------------------------------
+    static bool worthKeeping(const string_q& value) {
+        return !value.empty() && value != "null";
+    }
+
+    //-------------------------------------------------------------------------
+    void CRPCCache::store(const string_q& method, const string_q& params, bool raw, const string_q& value) {
+        rpccache_t cls = rpcCacheClass(method, params);
+        if (cls == RPC_NOCACHE || !worthKeeping(value))
+            return;
+        if (raw && contains(value, "\"result\":null"))
+            return;
+
+        string_q key = cacheKey(method, params, raw);
+        keep(key, value);
+
+        if (cls == RPC_IMMUTABLE && !diskFolder.empty()) {
+            string_q fileName = diskName(key);
+            if (!fileExists(fileName) && establishFolder(fileName)) {
+                string_q tmpName = fileName + ".tmp";
+                stringToAsciiFile(tmpName, key + "\n" + value);
+                ::rename(tmpName.c_str(), fileName.c_str());
+            }
+        }
+    }
+
+    //-------------------------------------------------------------------------
+    void CRPCCache::keep(const string_q& key, const string_q& value) {
+        map<string_q, CEntry>::iterator it = entries.find(key);
+        if (it != entries.end())
+            drop(it);
+        // an answer larger than the whole budget would only push out everything else
+        if (key.length() + value.length() > maxBytes)
+            return;
+        recent.push_front(key);
+        CEntry& entry = entries[key];
+        entry.value  = value;
+        entry.stored = time(NULL);
+        entry.used   = recent.begin();
+        bytes += key.length() + value.length();
+        evict();
+    }
+
+    //-------------------------------------------------------------------------
+    void CRPCCache::drop(map<string_q, CEntry>::iterator it) {
+        bytes -= it->first.length() + it->second.value.length();
+        recent.erase(it->second.used);
+        entries.erase(it);
+    }
+
+    //-------------------------------------------------------------------------
+    void CRPCCache::evict(void) {
+        while (bytes > maxBytes && !recent.empty())
+            drop(entries.find(recent.back()));
+    }
+
+    //-------------------------------------------------------------------------
+    CRPCCache *getRPCCache(void) {
+        static CRPCCache cache;
+        static bool configured = false;
+        if (!configured) {
+            configured = true;
+            cache.setHeadTTL((time_t)toLongU(getGlobalConfig()->getConfigStr("settings", "rpcHeadTTL", "5")));
+            cache.setMaxBytes(toLongU(getGlobalConfig()->getConfigStr("settings", "rpcMemoryMB", "64")) << 20);
+            if (getGlobalConfig()->getConfigBool("settings", "rpcCache", false))
+                cache.setDiskFolder(blockCachePath("rpc/"));
+        }
+        return &cache;
+    }
+
+}  // namespace qblocks
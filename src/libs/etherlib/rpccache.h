@@ -0,0 +1,88 @@
+#pragma once
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <list>
+#include "utillib.h"
+
+namespace qblocks {
+
+    //-------------------------------------------------------------------------
+    // How long the answer to a read only request stays good
+    typedef enum {
+        RPC_NOCACHE = 0,  // writes, filters and anything we do not recognize
+        RPC_HEAD,         // depends on the head of the chain (eth_blockNumber, 'latest'), good for a few seconds
+        RPC_SESSION,      // does not change while the node runs (web3_clientVersion), good for the process
+        RPC_HISTORY,      // historical data asked for by block number, good for the process
+        RPC_IMMUTABLE     // data asked for by hash, good forever (and may be kept on disk)
+    } rpccache_t;
+
+    extern rpccache_t rpcCacheClass(const string_q& method, const string_q& params);
+
+    // True if the JSON-RPC response has an 'error' member at its top level. Errors nested in the
+    // result (a reverted trace, for example) are part of a good answer.
+    extern bool isRPCError(const string_q& response);
+
+    //-------------------------------------------------------------------------
+    // Memoizes callRPC by (method, params). Everything lives in memory for the process; if
+    // 'rpcCache' is set in the [settings] group of quickBlocks.toml, answers to requests by hash
+    // are also kept under the cache folder so later runs do not ask again. Errors and empty or
+    // null answers are never kept. Memory is bounded by a byte budget ('rpcMemoryMB', 64 MB by
+    // default); the least recently used answers are dropped first.
+    //-------------------------------------------------------------------------
+    class CRPCCache {
+    public:
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t diskHits;
+
+                 CRPCCache    (void);
+
+        bool     lookup       (const string_q& method, const string_q& params, bool raw, string_q& value);
+        void     store        (const string_q& method, const string_q& params, bool raw, const string_q& value);
+        void     clear        (void);
+
+        void     setHeadTTL   (time_t secs) { headTTL = secs; }
+        void     setDiskFolder(const string_q& folder) { diskFolder = folder; }
+        void     setMaxBytes  (size_t bytes) { maxBytes = bytes; evict(); }
+        size_t   nBytes       (void) const { return bytes; }
+        size_t   nEntries     (void) const { return entries.size(); }
+
+        // isNodeRunning asks the node for nothing if we heard from it within the head TTL
+        void     nodeAnswered (void) { lastAnswer = time(NULL); }
+        bool     nodeIsAlive  (void) const { return (lastAnswer && time(NULL) - lastAnswer <= headTTL); }
+
+    private:
+        class CEntry {
+        public:
+            string_q value;
+            time_t   stored;
+            list<string_q>::iterator used;  // where the key sits in 'recent'
+            CEntry(void) : stored(0) { }
+        };
+        map<string_q, CEntry> entries;
+        list<string_q> recent;  // keys, most recently used first
+        size_t   bytes;
+        size_t   maxBytes;
+        time_t   headTTL;
+        time_t   lastAnswer;
+        string_q diskFolder;  // empty if answers are not kept on disk
+
+        string_q diskName     (const string_q& key) const;
+        void     keep         (const string_q& key, const string_q& value);
+        void     drop         (map<string_q, CEntry>::iterator it);
+        void     evict        (void);
+    };
+
+    extern CRPCCache *getRPCCache(void);
+
+}  // namespace qblocks
@@ -94,9 +94,10 @@ bool CRPCResult::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> jsonrpc;
-    archive >> result;
-    archive >> id;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(CRPCResult), 3);
+    fields >> jsonrpc;
+    fields >> result;
+    fields >> id;
     finishParse();
     return true;
 }
@@ -0,0 +1,357 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "etherlib.h"
+#include "toolserver.h"
+
+extern char **environ;
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    // A request is a length, sent together with the caller's stdin, stdout and stderr, followed
+    // by that many bytes: the working folder, the argument count, the arguments and the
+    // environment, each ending in '\0'. The reply is the command's exit status.
+    //--------------------------------------------------------------------------
+    #define N_STREAMS 3
+    #define MAX_REQUEST (1 << 20)  // far more than any command line and environment
+
+    //--------------------------------------------------------------------------
+    string_q serverSocketPath(const string_q& programName) {
+        return configPath("servers/" + programName + ".sock");
+    }
+
+    //--------------------------------------------------------------------------
+    static bool fillAddress(struct sockaddr_un& addr, const string_q& path) {
+        bzero(&addr, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.length() >= sizeof(addr.sun_path))
+            return false;
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    static bool writeAll(int fd, const void *buff, size_t len) {
+        const char *p = reinterpret_cast<const char*>(buff);
+        while (len) {
+            ssize_t n = write(fd, p, len);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            p += n;
+            len -= (size_t)n;
+        }
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    static bool readAll(int fd, void *buff, size_t len) {
+        char *p = reinterpret_cast<char*>(buff);
+        while (len) {
+            ssize_t n = read(fd, p, len);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            p += n;
+            len -= (size_t)n;
+        }
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    static bool sendHeader(int sock, uint32_t len) {
+        int fds[N_STREAMS] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+        char control[CMSG_SPACE(sizeof(fds))];
+        bzero(control, sizeof(control));
+
+        struct iovec iov;
+        iov.iov_base = &len;
+        iov.iov_len  = sizeof(len);
+
+        struct msghdr msg;
+        bzero(&msg, sizeof(msg));
+        msg.msg_iov        = &iov;
+        msg.msg_iovlen     = 1;
+        msg.msg_control    = control;
+        msg.msg_controllen = sizeof(control);
+
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type  = SCM_RIGHTS;
+        cmsg->cmsg_len   = CMSG_LEN(sizeof(fds));
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+        return (sendmsg(sock, &msg, 0) == (ssize_t)sizeof(len));
+    }
+
+    //--------------------------------------------------------------------------
+    static bool receiveHeader(int sock, uint32_t& len, int fds[N_STREAMS]) {
+        char control[CMSG_SPACE(sizeof(int) * N_STREAMS)];
+        bzero(control, sizeof(control));
+
+        struct iovec iov;
+        iov.iov_base = &len;
+        iov.iov_len  = sizeof(len);
+
+        struct msghdr msg;
+        bzero(&msg, sizeof(msg));
+        msg.msg_iov        = &iov;
+        msg.msg_iovlen     = 1;
+        msg.msg_control    = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (recvmsg(sock, &msg, 0) != (ssize_t)sizeof(len))
+            return false;
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(int) * N_STREAMS))
+            return false;
+        memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * N_STREAMS);
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    // If a server for this program is listening, it runs the command and we exit with its status.
+    // Otherwise (no server, a stale socket, or a server that goes away) we return and run it here.
+    void forwardToServer(int argc, const char *argv[]) {
+        if (argc > 1 && string_q(argv[1]) == "--serve")
+            return;
+
+        string_q path = serverSocketPath(basename((char*)argv[0]));  // NOLINT
+        struct sockaddr_un addr;
+        if (!fileExists(path) || !fillAddress(addr, path))
+            return;
+
+        int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (sock < 0)
+            return;
+        if (connect(sock, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+            ::close(sock);
+            return;
+        }
+
+        char cwd[PATH_MAX];
+        if (!getcwd(cwd, sizeof(cwd))) {
+            ::close(sock);
+            return;
+        }
+
+        string_q payload = string_q(cwd) + '\0' + asStringU((uint64_t)argc) + '\0';
+        for (int i = 0 ; i < argc ; i++)
+            payload += string_q(argv[i]) + '\0';
+        for (char **e = environ ; e && *e ; e++)
+            payload += string_q(*e) + '\0';
+
+        int32_t status = 0;
+        bool sent = sendHeader(sock, (uint32_t)payload.length()) &&
+                        writeAll(sock, payload.c_str(), payload.length());
+        bool done = sent && readAll(sock, &status, sizeof(status));
+        ::close(sock);
+        if (!sent)
+            return;
+        // Once the server has the command, running it again here could repeat its output
+        exit(done ? status : 1);
+    }
+
+    //--------------------------------------------------------------------------
+    static volatile sig_atomic_t stopServing = 0;
+    static void stopHandler(int signum) {
+        stopServing = 1;
+    }
+
+    //--------------------------------------------------------------------------
+    // The arguments of the command being run. They must outlive serveRequests.
+    static CStringArray        serverArgs;
+    static vector<const char*> serverArgv;
+
+    //--------------------------------------------------------------------------
+    // In the forked command: take over the caller's streams, folder, arguments and environment.
+    static bool adoptRequest(const string_q& payloadIn, int fds[N_STREAMS], int& argc, const char **&argv) {
+        for (int i = 0 ; i < N_STREAMS ; i++) {
+            if (fds[i] != i) {
+                dup2(fds[i], i);
+                ::close(fds[i]);
+            }
+        }
+
+        // split on '\0'
+        CStringArray fields;
+        size_t start = 0;
+        for (size_t i = 0 ; i < payloadIn.length() ; i++) {
+            if (payloadIn[i] == '\0') {
+                fields.push_back(payloadIn.substr(start, i - start));
+                start = i + 1;
+            }
+        }
+        if (fields.size() < 2 || chdir(fields[0].c_str()) != 0)
+            return false;
+
+        size_t nArgs = toLongU(fields[1]);
+        if (nArgs == 0 || fields.size() < 2 + nArgs)
+            return false;
+
+        serverArgs.assign(fields.begin() + 2, fields.begin() + 2 + (int64_t)nArgs);
+        serverArgv.clear();
+        for (size_t i = 0 ; i < serverArgs.size() ; i++)
+            serverArgv.push_back(serverArgs[i].c_str());
+        serverArgv.push_back(NULL);
+        argc = (int)nArgs;
+        argv = serverArgv.data();
+
+        // the caller's environment replaces ours (test mode, colors, fallbacks, ...)
+        CStringArray names;
+        for (char **e = environ ; e && *e ; e++) {
+            string_q entry = *e;
+            names.push_back(nextTokenClear(entry, '='));
+        }
+        for (size_t i = 0 ; i < names.size() ; i++)
+            unsetenv(names[i].c_str());
+        for (size_t i = 2 + nArgs ; i < fields.size() ; i++) {
+            string_q val = fields[i];
+            string_q name = nextTokenClear(val, '=');
+            if (!name.empty())
+                setenv(name.c_str(), val.c_str(), true);
+        }
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    // Loaded once in the server, shared copy-on-write with every command it forks
+    static void warmCaches(WARMUPFUNC warmup) {
+        getGlobalConfig();
+        if (fileExists(priceSeriesPath(CPriceSource())))
+            getPriceSeries();
+        CDefaultOptions names;
+        names.namesFile = CFilename(configPath("names/names.txt"));
+        if (fileExists(names.namesFile.getFullPath()))
+            names.loadNames();
+        if (warmup)
+            (*warmup)();
+    }
+
+    //--------------------------------------------------------------------------
+    // Unless the first argument is --serve, returns true at once. Otherwise loads the caches and
+    // serves commands until SIGINT or SIGTERM, then returns false. Each command is run in a
+    // grandchild of the server: the child waits for it, reports its status to the caller and
+    // goes away, and the grandchild returns true with the command's arguments in argc/argv.
+    bool serveRequests(int& argc, const char **&argv, WARMUPFUNC warmup) {
+        if (argc < 2 || string_q(argv[1]) != "--serve")
+            return true;
+
+        string_q path = serverSocketPath(basename((char*)argv[0]));  // NOLINT
+        establishFolder(path);
+        struct sockaddr_un addr;
+        if (!fillAddress(addr, path)) {
+            cerr << "Socket path too long: " << path << "\n";
+            return false;
+        }
+
+        int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0)
+            return false;
+        if (fileExists(path)) {
+            // a live server keeps its socket, a dead one leaves it behind
+            if (connect(listener, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+                cerr << "A server is already listening on " << path << "\n";
+                ::close(listener);
+                return false;
+            }
+            ::remove(path.c_str());
+            ::close(listener);
+            listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        }
+        if (bind(listener, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 64) != 0) {
+            cerr << "Could not listen on " << path << "\n";
+            ::close(listener);
+            return false;
+        }
+
+        warmCaches(warmup);
+
+        struct sigaction stopAction, oldInt, oldTerm, oldChild, ignore;
+        bzero(&stopAction, sizeof(stopAction));
+        stopAction.sa_handler = stopHandler;
+        sigemptyset(&stopAction.sa_mask);
+        sigaction(SIGINT,  &stopAction, &oldInt);
+        sigaction(SIGTERM, &stopAction, &oldTerm);
+        bzero(&ignore, sizeof(ignore));
+        ignore.sa_handler = SIG_IGN;
+        sigemptyset(&ignore.sa_mask);
+        sigaction(SIGCHLD, &ignore, &oldChild);  // reap the children without waiting
+        sigaction(SIGPIPE, &ignore, NULL);
+
+        cerr << cTeal << "Serving " << basename((char*)argv[0]) << " on " << path << cOff << "\n";  // NOLINT
+        while (!stopServing) {
+            int conn = accept(listener, NULL, NULL);
+            if (conn < 0)
+                continue;  // interrupted
+
+            uint32_t len = 0;
+            int fds[N_STREAMS] = { -1, -1, -1 };
+            string_q payload;
+            bool ok = receiveHeader(conn, len, fds) && len <= MAX_REQUEST;
+            if (ok) {
+                char *buff = new char[len + 1];
+                ok = readAll(conn, buff, len);
+                payload = string_q(buff, len);
+                delete [] buff;
+            }
+
+            cout.flush();
+            cerr.flush();
+            pid_t child = (ok ? fork() : -1);
+            if (child == 0) {
+                ::close(listener);
+                sigaction(SIGCHLD, &oldChild, NULL);
+                pid_t grandChild = fork();
+                if (grandChild == 0) {
+                    ::close(conn);
+                    // the node connections opened by etherlib_init belong to the server, so the
+                    // command opens its own rather than interleaving with other commands on them
+                    getCurl(true);
+                    getIpcConnection(true);
+                    sigaction(SIGINT,  &oldInt,  NULL);
+                    sigaction(SIGTERM, &oldTerm, NULL);
+                    signal(SIGPIPE, SIG_DFL);
+                    if (adoptRequest(payload, fds, argc, argv))
+                        return true;
+                    _exit(1);
+                }
+                for (int i = 0 ; i < N_STREAMS ; i++)
+                    ::close(fds[i]);
+                int waited = 1;
+                if (grandChild > 0)
+                    waitpid(grandChild, &waited, 0);
+                int32_t status = (grandChild > 0 && WIFEXITED(waited) ? WEXITSTATUS(waited) : 1);
+                writeAll(conn, &status, sizeof(status));
+                _exit(0);
+            }
+
+            for (int i = 0 ; i < N_STREAMS ; i++)
+                if (fds[i] >= 0)
+                    ::close(fds[i]);
+            ::close(conn);
+        }
+
+        ::close(listener);
+        ::remove(path.c_str());
+        cerr << cTeal << "Stopped serving " << basename((char*)argv[0]) << cOff << "\n";  // NOLINT
+        return false;
+    }
+
+}  // namespace qblocks
@@ -0,0 +1,36 @@
+#pragma once
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include "utillib.h"
+
+namespace qblocks {
+
+    //--------------------------------------------------------------------------
+    // Resident tools. A tool started as 'tool --serve' initializes once, loads its caches and
+    // listens on ~/.quickBlocks/servers/<tool>.sock. A later 'tool args' finds the socket and
+    // hands over its arguments, working folder, environment and standard streams. The server
+    // forks, so each command runs the tool's own code with warm caches, writes straight to the
+    // caller's streams and cannot disturb the next command. A tool's main looks like this:
+    //
+    //      forwardToServer(argc, argv);      // does not return if a server ran the command
+    //      etherlib_init();
+    //      if (!serveRequests(argc, argv))   // returns in each forked command
+    //          return 0;
+    //--------------------------------------------------------------------------
+    typedef void (*WARMUPFUNC)(void);
+
+    extern void     forwardToServer   (int argc, const char *argv[]);
+    extern bool     serveRequests     (int& argc, const char **&argv, WARMUPFUNC warmup = NULL);
+    extern string_q serverSocketPath  (const string_q& programName);
+
+}  // namespace qblocks
@@ -124,16 +124,17 @@ bool CTrace::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> blockHash;
-    archive >> blockNumber;
-    archive >> subtraces;
-    archive >> traceAddress;
-    archive >> transactionHash;
-    archive >> transactionPosition;
-    archive >> type;
-    archive >> error;
-    archive >> action;
-    archive >> result;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(CTrace), 10);
+    fields >> blockHash;
+    fields >> blockNumber;
+    fields >> subtraces;
+    fields >> traceAddress;
+    fields >> transactionHash;
+    fields >> transactionPosition;
+    fields >> type;
+    fields >> error;
+    fields >> action;
+    fields >> result;
     finishParse();
     return true;
 }
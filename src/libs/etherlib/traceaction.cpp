@@ -113,16 +113,17 @@ bool CTraceAction::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> address;
-    archive >> balance;
-    archive >> callType;
-    archive >> from;
-    archive >> gas;
-    archive >> init;
-    archive >> input;
-    archive >> refundAddress;
-    archive >> to;
-    archive >> value;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(CTraceAction), 10);
+    fields >> address;
+    fields >> balance;
+    fields >> callType;
+    fields >> from;
+    fields >> gas;
+    fields >> init;
+    fields >> input;
+    fields >> refundAddress;
+    fields >> to;
+    fields >> value;
     finishParse();
     return true;
 }
@@ -97,10 +97,11 @@ bool CTraceResult::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> address;
-    archive >> code;
-    archive >> gasUsed;
-    archive >> output;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(CTraceResult), 4);
+    fields >> address;
+    fields >> code;
+    fields >> gasUsed;
+    fields >> output;
     finishParse();
     return true;
 }
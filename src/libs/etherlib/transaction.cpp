@@ -63,12 +63,11 @@ bool CTransaction::setValueByName(const string_q& fieldName, const string_q& fie
 
     if ( fieldName % "input" ) {
         input = fieldValue;
-        function = Format("[{FUNCTION}]");
+        function = "";  // articulated on demand
         return true;
 
     } else if ( fieldName % "value" ) {
         value = canonicalWei(fieldValue);
-        ether = str2Double(Format("[{ETHER}]"));
         return true;
 
     } else if ( fieldName % "contractAddress" ) {
@@ -132,8 +131,7 @@ bool CTransaction::setValueByName(const string_q& fieldName, const string_q& fie
 //---------------------------------------------------------------------------------------------------
 void CTransaction::finishParse() {
     // EXISTING_CODE
-    function = Format("[{FUNCTION}]");
-    ether = str2Double(Format("[{ETHER}]"));
+    function = "";  // articulated on demand
     receipt.pTrans = this;
     // EXISTING_CODE
 }
@@ -150,21 +148,22 @@ bool CTransaction::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> hash;
-    archive >> blockHash;
-    archive >> blockNumber;
-    archive >> transactionIndex;
-    archive >> nonce;
-    archive >> timestamp;
-    archive >> from;
-    archive >> to;
-    archive >> value;
-    archive >> gas;
-    archive >> gasPrice;
-    archive >> input;
-    archive >> isError;
-    archive >> isInternal;
-    archive >> receipt;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(CTransaction), 15);
+    fields >> hash;
+    fields >> blockHash;
+    fields >> blockNumber;
+    fields >> transactionIndex;
+    fields >> nonce;
+    fields >> timestamp;
+    fields >> from;
+    fields >> to;
+    fields >> value;
+    fields >> gas;
+    fields >> gasPrice;
+    fields >> input;
+    fields >> isError;
+    fields >> isInternal;
+    fields >> receipt;
     finishParse();
     return true;
 }
@@ -297,9 +296,12 @@ string_q nextTransactionChunk_custom(const string_q& fieldIn, const void *dataPt
             // EXISTING_CODE
             case 'a':
                 if ( fieldIn % "articulated" ) {
-                    if (tra->function.empty() || tra->function == " ")
+                    if (!tra->function.empty() && tra->function != " ")
+                        return tra->function;
+                    string_q ret = tra->inputToFunction();
+                    if (ret == " ")
                         return "[ \"" + tra->input + "\" ]";
-                    return tra->function;
+                    return ret;
                 }
                 break;
             case 'c':
@@ -595,13 +597,8 @@ string_q CTransaction::inputToFunction(void) const {
     if (input.length() < 10)
         return " ";
 
-    if (funcPtr) {
-        string_q items[256];
-        size_t nItems = 0;
-        for (size_t i = 0 ; i < funcPtr->inputs.size() ; i++)
-            items[nItems++] = funcPtr->inputs[i].type;
-        return toFunction(funcPtr->name, input, nItems, items);
-    }
+    if (funcPtr)
+        return articulate(*funcPtr, input);
 
     return " ";
 }
@@ -59,10 +59,10 @@ public:
     const CBlock *pBlock;
     const CFunction *funcPtr;
     string_q function;
-    double ether;
     CTraceArray traces;
 
     string_q inputToFunction(void) const;
+    friend class CBlock;
     // EXISTING_CODE
     friend bool operator<(const CTransaction& v1, const CTransaction& v2);
     friend ostream& operator<<(ostream& os, const CTransaction& item);
@@ -131,7 +131,7 @@ inline void CTransaction::initialize(void) {
     pBlock = NULL;
     function = "";
     funcPtr = NULL;
-    ether = 0.;
+    traces.clear();
     // EXISTING_CODE
 }
 
@@ -160,7 +160,7 @@ inline void CTransaction::duplicate(const CTransaction& tr) {
     pBlock = tr.pBlock;  // no deep copy, we don't own it
     funcPtr = tr.funcPtr;
     function = tr.function;
-    ether = tr.ether;
+    traces = tr.traces;
     // EXISTING_CODE
     finishParse();
 }
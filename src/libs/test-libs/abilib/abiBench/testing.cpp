@@ -0,0 +1,313 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <map>
+#include <string>
+#include "etherlib.h"
+#include "tokenlib.h"
+#include "testing.h"
+#include "options.h"
+
+//------------------------------------------------------------------------
+class CThisTest : public testing::Test {
+public:
+                 CThisTest(void) : Test() {}
+    virtual void SetUp    (void) {}
+    virtual void TearDown (void) {}
+};
+
+//------------------------------------------------------------------------
+// The token factory as grabABI generated it before the selector switch (string comparison of
+// the encoding, substrings of the hex for each parameter, and articulation of every call).
+const CTransaction *promoteToTokenOld(const CTransaction *p) {
+    if (p && (p->input.length() >= 10 || p->input == "0x")) {
+        string_q items[256];
+        size_t nItems = 0;
+
+        string_q encoding = extract(p->input, 0, 10);
+        string_q params   = extract(p->input, 10);
+
+        if (encoding == func_approve_qb) {
+            QApprove *a = new QApprove;
+            *(CTransaction*)a = *p;  // NOLINT
+            a->_spender = toAddress(extract(params, 0*64, 64));
+            a->_value = toWei("0x"+extract(params, 1*64, 64));
+            items[nItems++] = "address";
+            items[nItems++] = "uint256";
+            a->function = toFunction("approve", params, nItems, items);
+            return a;
+
+        } else if (encoding == func_approveAndCall_qb) {
+            QApproveAndCall *a = new QApproveAndCall;
+            *(CTransaction*)a = *p;  // NOLINT
+            a->_spender = toAddress(extract(params, 0*64, 64));
+            a->_value = toWei("0x"+extract(params, 1*64, 64));
+            a->_extraData = extract(params, 2*64);
+            items[nItems++] = "address";
+            items[nItems++] = "uint256";
+            items[nItems++] = "bytes";
+            a->function = toFunction("approveAndCall", params, nItems, items);
+            return a;
+
+        } else if (encoding == func_transfer_qb) {
+            QTransfer *a = new QTransfer;
+            *(CTransaction*)a = *p;  // NOLINT
+            a->_to = toAddress(extract(params, 0*64, 64));
+            a->_value = toWei("0x"+extract(params, 1*64, 64));
+            items[nItems++] = "address";
+            items[nItems++] = "uint256";
+            a->function = toFunction("transfer", params, nItems, items);
+            return a;
+
+        } else if (encoding == func_transferFrom_qb) {
+            QTransferFrom *a = new QTransferFrom;
+            *(CTransaction*)a = *p;  // NOLINT
+            a->_from = toAddress(extract(params, 0*64, 64));
+            a->_to = toAddress(extract(params, 1*64, 64));
+            a->_value = toWei("0x"+extract(params, 2*64, 64));
+            items[nItems++] = "address";
+            items[nItems++] = "address";
+            items[nItems++] = "uint256";
+            a->function = toFunction("transferFrom", params, nItems, items);
+            return a;
+        }
+    }
+    return NULL;
+}
+
+//------------------------------------------------------------------------
+const CLogEntry *promoteToTokenEventOld(const CLogEntry *p) {
+    size_t nTops = p->topics.size();
+    if (nTops > 0) {
+        string_q data = extract(p->data, 2);
+        if (fromTopic(p->topics[0]) % evt_Approval_qb) {
+            QApprovalEvent *a = new QApprovalEvent;
+            *(CLogEntry*)a = *p;  // NOLINT
+            a->_owner = toAddress(nTops > 1 ? fromTopic(p->topics[1]) : "");
+            a->_spender = toAddress(nTops > 2 ? fromTopic(p->topics[2]) : "");
+            a->_value = toWei("0x" + extract(data, 0*64, 64));
+            return a;
+
+        } else if (fromTopic(p->topics[0]) % evt_Transfer_qb) {
+            QTransferEvent *a = new QTransferEvent;
+            *(CLogEntry*)a = *p;  // NOLINT
+            a->_from = toAddress(nTops > 1 ? fromTopic(p->topics[1]) : "");
+            a->_to = toAddress(nTops > 2 ? fromTopic(p->topics[2]) : "");
+            a->_value = toWei("0x" + extract(data, 0*64, 64));
+            return a;
+        }
+    }
+    return NULL;
+}
+
+//------------------------------------------------------------------------
+static string_q className(const CBaseNode *node) {
+    return (node ? string_q(node->getRuntimeClass()->m_ClassName) : "none");
+}
+
+//------------------------------------------------------------------------
+// True if the two factories decoded the same values (the new one does not articulate).
+static bool sameCall(const CTransaction *o, const CTransaction *n) {
+    if (className(o) != className(n))
+        return false;
+    if (!o)
+        return true;
+    string_q cl = className(o);
+    if (cl == "QTransfer") {
+        const QTransfer *a = (const QTransfer *)o, *b = (const QTransfer *)n;
+        return a->_to == b->_to && a->_value == b->_value;
+    } else if (cl == "QTransferFrom") {
+        const QTransferFrom *a = (const QTransferFrom *)o, *b = (const QTransferFrom *)n;
+        return a->_from == b->_from && a->_to == b->_to && a->_value == b->_value;
+    } else if (cl == "QApprove") {
+        const QApprove *a = (const QApprove *)o, *b = (const QApprove *)n;
+        return a->_spender == b->_spender && a->_value == b->_value;
+    } else if (cl == "QApproveAndCall") {
+        const QApproveAndCall *a = (const QApproveAndCall *)o, *b = (const QApproveAndCall *)n;
+        return a->_spender == b->_spender && a->_value == b->_value && a->_extraData == b->_extraData;
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------
+static bool sameEvent(const CLogEntry *o, const CLogEntry *n) {
+    if (className(o) != className(n))
+        return false;
+    if (!o)
+        return true;
+    if (className(o) == "QTransferEvent") {
+        const QTransferEvent *a = (const QTransferEvent *)o, *b = (const QTransferEvent *)n;
+        return a->_from == b->_from && a->_to == b->_to && a->_value == b->_value;
+    }
+    const QApprovalEvent *a = (const QApprovalEvent *)o, *b = (const QApprovalEvent *)n;
+    return a->_owner == b->_owner && a->_spender == b->_spender && a->_value == b->_value;
+}
+
+//------------------------------------------------------------------------
+static bool loadCorpus(const string_q& fileName, CTransactionArray& corpus) {
+    string_q contents = asciiFileToString(fileName);
+    while (!contents.empty()) {
+        CTransaction trans;
+        trans.input = nextTokenClear(contents, '\n');
+        if (!trans.input.empty())
+            corpus.push_back(trans);
+    }
+    return !corpus.empty();
+}
+
+//------------------------------------------------------------------------
+// Events for the corpus: a Transfer for every transfer call, an Approval for every approval,
+// and (so the misses are exercised too) a log whose first topic is the call's first word.
+static void makeLogs(const CTransactionArray& corpus, CLogEntryArray& logs) {
+    for (size_t i = 0 ; i < corpus.size() ; i++) {
+        CAbiData call;
+        CLogEntry log;
+        if (!call.fromInput(corpus[i].input)) {
+            log.topics.push_back(toTopic("0x" + padLeft(asStringU(i), 64, '0')));
+
+        } else if (call.selector == sel_transfer_qb || call.selector == sel_approve_qb) {
+            log.topics.push_back(toTopic(call.selector == sel_transfer_qb ? evt_Transfer_qb : evt_Approval_qb));
+            log.topics.push_back(toTopic("0x" + padLeft(asStringU(i + 1), 64, '0')));
+            log.topics.push_back(toTopic("0x" + call.getWordHex(0)));
+            log.data = "0x" + call.getWordHex(1);
+
+        } else {
+            log.topics.push_back(toTopic("0x" + call.getWordHex(0)));
+            log.data = "0x" + call.getTailHex(1);
+        }
+        logs.push_back(log);
+    }
+}
+
+//------------------------------------------------------------------------
+static string_q perItem(double secs, size_t n) {
+    return padLeft(double2Str(secs * 1000000. / (double)n, 3), 10) + " us";
+}
+
+//------------------------------------------------------------------------
+static COptions theOptions;
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestFunctions) {
+
+    CTransactionArray corpus;
+    ASSERT_TRUE("corpus",             loadCorpus(theOptions.corpus, corpus));
+
+    // both factories see every call, the results are tallied by selector
+    map<string_q, size_t> counts, agree;
+    size_t nPromoted = 0, nAgree = 0;
+    for (size_t i = 0 ; i < corpus.size() ; i++) {
+        const CTransaction *o = promoteToTokenOld(&corpus[i]);
+        const CTransaction *n = promoteToToken(&corpus[i]);
+        string_q key = padRight(extract(corpus[i].input, 0, 10), 10) + " " + padRight(className(n), 16);
+        bool same = sameCall(o, n);
+        counts[key]++;
+        agree[key] += same;
+        nPromoted += (n != NULL);
+        nAgree += same;
+        if (o) delete o;
+        if (n) delete n;
+    }
+    for (map<string_q, size_t>::iterator it = counts.begin() ; it != counts.end() ; ++it)
+        cout << "\t\t" << it->first << padLeft(asStringU(it->second), 5) << padLeft(asStringU(agree[it->first]), 5) << "\n";
+    ASSERT_EQ("corpus size",          corpus.size(), 199);
+    ASSERT_EQ("promoted",             nPromoted, 75);
+    ASSERT_EQ("all agree",            nAgree, corpus.size());
+
+    if (theOptions.nReps) {
+        double start = qbNow();
+        for (size_t r = 0 ; r < theOptions.nReps ; r++) {
+            for (size_t i = 0 ; i < corpus.size() ; i++) {
+                const CTransaction *o = promoteToTokenOld(&corpus[i]);
+                if (o) delete o;
+            }
+        }
+        double mid = qbNow();
+        for (size_t r = 0 ; r < theOptions.nReps ; r++) {
+            for (size_t i = 0 ; i < corpus.size() ; i++) {
+                const CTransaction *n = promoteToToken(&corpus[i]);
+                if (n) delete n;
+            }
+        }
+        double end = qbNow();
+        size_t nItems = theOptions.nReps * corpus.size();
+        cout << "\told:" << perItem(mid - start, nItems) << " per call\n";
+        cout << "\tnew:" << perItem(end - mid, nItems) << " per call\n";
+    }
+
+    return true;
+}}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestEvents) {
+
+    CTransactionArray corpus;
+    ASSERT_TRUE("corpus",             loadCorpus(theOptions.corpus, corpus));
+    CLogEntryArray logs;
+    makeLogs(corpus, logs);
+
+    size_t nPromoted = 0, nAgree = 0;
+    for (size_t i = 0 ; i < logs.size() ; i++) {
+        const CLogEntry *o = promoteToTokenEventOld(&logs[i]);
+        const CLogEntry *n = promoteToTokenEvent(&logs[i]);
+        nPromoted += (n != NULL);
+        nAgree += sameEvent(o, n);
+        if (o) delete o;
+        if (n) delete n;
+    }
+    ASSERT_EQ("logs",                 logs.size(), 199);
+    ASSERT_EQ("promoted",             nPromoted, 75);
+    ASSERT_EQ("all agree",            nAgree, logs.size());
+
+    if (theOptions.nReps) {
+        double start = qbNow();
+        for (size_t r = 0 ; r < theOptions.nReps ; r++) {
+            for (size_t i = 0 ; i < logs.size() ; i++) {
+                const CLogEntry *o = promoteToTokenEventOld(&logs[i]);
+                if (o) delete o;
+            }
+        }
+        double mid = qbNow();
+        for (size_t r = 0 ; r < theOptions.nReps ; r++) {
+            for (size_t i = 0 ; i < logs.size() ; i++) {
+                const CLogEntry *n = promoteToTokenEvent(&logs[i]);
+                if (n) delete n;
+            }
+        }
+        double end = qbNow();
+        size_t nItems = theOptions.nReps * logs.size();
+        cout << "\told:" << perItem(mid - start, nItems) << " per log\n";
+        cout << "\tnew:" << perItem(end - mid, nItems) << " per log\n";
+    }
+
+    return true;
+}}
+
+//------------------------------------------------------------------------
+int main(int argc, const char *argv[]) {
+
+    if (!theOptions.prepareArguments(argc, argv))
+        return 0;
+
+    tokenlib_init();
+    while (!theOptions.commandList.empty()) {
+        string_q command = nextTokenClear(theOptions.commandList, '\n');
+        if (!theOptions.parseArguments(command))
+            return 0;
+        switch (theOptions.testNum) {
+            case 0: LOAD_TEST(TestFunctions); break;
+            case 1: LOAD_TEST(TestEvents);    break;
+        }
+    }
+
+    return testing::RUN_ALL_TESTS();
+}
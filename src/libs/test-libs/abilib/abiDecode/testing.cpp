@@ -0,0 +1,264 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <string>
+#include "etherlib.h"
+#include "tokenlib.h"
+#include "testing.h"
+
+//------------------------------------------------------------------------
+class CThisTest : public testing::Test {
+public:
+                 CThisTest(void) : Test() {}
+    virtual void SetUp    (void) {}
+    virtual void TearDown (void) {}
+};
+
+//------------------------------------------------------------------------
+static string_q hexWord(uint64_t val) {
+    return padLeft(toLower(string_q(to_hex(SFUintBN(val)).c_str())), 64, '0');
+}
+
+//------------------------------------------------------------------------
+static string_q addrWord(const SFAddress& addr) {
+    return padLeft(extract(addr, 2), 64, '0');
+}
+
+//------------------------------------------------------------------------
+static string_q strWords(const string_q& str) {
+    string_q hex;
+    for (size_t i = 0 ; i < str.length() ; i++) {
+        char buf[3];
+        snprintf(buf, sizeof(buf), "%02x", (uint8_t)str[i]);
+        hex += buf;
+    }
+    size_t len = ((hex.length() + 63) / 64) * 64;
+    return hexWord(str.length()) + padRight(hex, len, '0');
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestSelectors) {
+
+    uint32_t sel = 0;
+    ASSERT_TRUE("selector",           toSelector("0xa9059cbb0000", sel) && sel == 0xa9059cbb);
+    ASSERT_TRUE("no prefix",          toSelector("23B872DD", sel) && sel == 0x23b872dd);
+    ASSERT_FALSE("too short",         toSelector("0xa9059c", sel));
+    ASSERT_FALSE("not hex",           toSelector("0xa9059cbg", sel));
+    ASSERT_EQ("topic",                topicSelector(toTopic(string_q("0xddf252ad1be2c89b69c2b068fc378daa952ba7f163c4a11628f55a4df523b3ef"))), 0xddf252ad);
+    ASSERT_EQ("small topic",          topicSelector(toTopic(string_q("0x1234"))), 0);
+
+    CAbiDecoder decoder;
+    ASSERT_TRUE("add signature",      decoder.addSignature(0xa9059cbb, "transfer(address,uint256)"));
+    ASSERT_FALSE("first one wins",    decoder.addSignature(0xa9059cbb, "other(uint256)"));
+    const CFunction *func = decoder.find(string_q("0xa9059cbb0000"));
+    ASSERT_TRUE("found",              func != NULL);
+    ASSERT_EQ("name",                 func->name, "transfer");
+    ASSERT_EQ("encoding",             func->encoding, "0xa9059cbb");
+    ASSERT_EQ("inputs",               func->inputs.size(), 2);
+    ASSERT_EQ("type",                 func->inputs[1].type, "uint256");
+    ASSERT_TRUE("miss",               decoder.find(0x23b872dd) == NULL);
+
+    // events have a full hash for an encoding and are not kept
+    CFunction event;
+    event.type = "event";
+    event.encoding = "0xddf252ad1be2c89b69c2b068fc378daa952ba7f163c4a11628f55a4df523b3ef";
+    ASSERT_FALSE("no events",         decoder.addFunction(event));
+
+    // enough functions to grow the table several times, including a selector of zero
+    // (functions are not copied into a CAbi here, copying one hashes its signature on the node)
+    size_t nAdded = 0;
+    for (uint32_t i = 0 ; i < 5000 ; i++) {
+        CFunction f;
+        f.type = "function";
+        f.name = "f" + asStringU(i);
+        f.encoding = "0x" + padLeft(toLower(string_q(to_hex(SFUintBN((uint64_t)(i * 2654435761u))).c_str())), 8, '0');
+        nAdded += decoder.addFunction(f);
+    }
+    ASSERT_EQ("add functions",        nAdded, 5000);
+    ASSERT_EQ("size",                 decoder.size(), 5001);
+    size_t nFound = 0;
+    for (uint32_t i = 0 ; i < 5000 ; i++) {
+        const CFunction *f = decoder.find(i * 2654435761u);
+        nFound += (f && f->name == "f" + asStringU(i));
+    }
+    ASSERT_EQ("all found",            nFound, 5000);
+    ASSERT_TRUE("pointers stable",    func == decoder.find(0xa9059cbb));
+
+    decoder.clear();
+    ASSERT_EQ("cleared",              decoder.size(), 0);
+    ASSERT_TRUE("empty find",         decoder.find(0xa9059cbb) == NULL);
+
+    return true;
+}}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestDecode) {
+
+    SFAddress from = "0x1234567890abcdef1234567890abcdef12345678";
+    SFAddress to   = "0x00000000000000000000000000000000000000ff";
+    string_q input = "0x23b872dd" + addrWord(from) + addrWord(to) +
+                        "00000000000000000000000000000000000000000000003635c9adc5dea00000";  // 1000 ether
+
+    CAbiData data;
+    ASSERT_TRUE("from input",         data.fromInput(input));
+    ASSERT_EQ("selector",             data.selector, 0x23b872dd);
+    ASSERT_EQ("words",                data.nWords(), 3);
+    ASSERT_EQ("address",              data.getAddress(0), from);
+    ASSERT_EQ("small address",        data.getAddress(1), to);
+    ASSERT_EQ("value",                asStringBN(data.getUint(2)), "1000000000000000000000");
+    ASSERT_EQ("same as toWei",        data.getUint(2), toWei("0x" + extract(input, 10 + 128, 64)));
+    ASSERT_EQ("uint64",               data.getUint64(1), 255);
+    ASSERT_EQ("too big",              data.getUint64(0), NOPOS);
+    ASSERT_EQ("past the end",         asStringBN(data.getUint(3)), "0");
+    ASSERT_EQ("word hex",             data.getWordHex(1), addrWord(to));
+    ASSERT_EQ("tail",                 data.getTailHex(1), extract(input, 10 + 64));
+    ASSERT_FALSE("short input",       data.fromInput("0x1234"));
+    ASSERT_FALSE("bad hex",           data.fromInput("0x23b872ddzz"));
+
+    // the static types articulate exactly as the string parser does
+    CFunction func;
+    func.name = "transferFrom";
+    string_q types[] = { "address", "address", "uint256" };
+    for (size_t i = 0 ; i < 3 ; i++) {
+        CParameter param;
+        param.type = types[i];
+        func.inputs.push_back(param);
+    }
+    string_q expected = toFunction("transferFrom", input, 3, types);
+    ASSERT_EQ("articulate",           articulate(func, input), expected);
+    cout << "\t\t" << articulate(func, input) << "\n";
+
+    // dynamic types follow their offsets
+    CAbiDecoder decoder;
+    decoder.addSignature(0x12345678, "setInfo(string,bool,bytes,bytes32,uint8)");
+    string_q dyn = "0x12345678" +
+                    hexWord(0xa0) + hexWord(1) + hexWord(0xe0) +
+                    "abcdef0000000000000000000000000000000000000000000000000000000000" + hexWord(7) +
+                    strWords("Say \"hi\"\nthere") +
+                    strWords("\x01\x02\x03");
+    CAbiData dynData;
+    dynData.fromInput(dyn);
+    size_t start, len;
+    ASSERT_TRUE("dynamic",            dynData.getDynamic(0, start, len));
+    ASSERT_EQ("start",                start, 6 * 32);
+    ASSERT_EQ("length",               len, 14);
+    ASSERT_FALSE("bad offset",        dynData.getDynamic(3, start, len));
+    string_q dynTypes[] = { "string", "bool", "bytes", "bytes32", "uint8" };
+    ASSERT_EQ("articulate dynamic",   articulate(*decoder.find(dyn), dyn), toFunction("setInfo", dyn, 5, dynTypes));
+    cout << "\t\t" << articulate(*decoder.find(dyn), dyn) << "\n";
+
+    // a length that runs past the end of the data is clamped
+    string_q truncated = extract(dyn, 0, dyn.length() - 64);
+    CAbiData truncData;
+    truncData.fromInput(truncated);
+    ASSERT_TRUE("truncated",          truncData.getDynamic(2, start, len));
+    ASSERT_EQ("clamped",              len, 0);
+
+    // the generated libraries read strings, arrays and signed values directly
+    ASSERT_EQ("string",               dynData.getString(0), "Say \"hi\"\nthere");
+    ASSERT_EQ("no string",            dynData.getString(3), "");
+    CAbiData arr;
+    arr.fromData("0x" + hexWord(0x40) + "ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff85" +
+                    hexWord(3) + hexWord(10) + hexWord(20) + hexWord(30));
+    size_t first, count;
+    ASSERT_TRUE("array",              arr.getArray(0, first, count));
+    ASSERT_EQ("first",                first, 3);
+    ASSERT_EQ("count",                count, 3);
+    ASSERT_EQ("element",              arr.getUint64(first + 2), 30);
+    ASSERT_EQ("negative",             arr.getInt64(1), -123);
+    ASSERT_EQ("positive",             arr.getInt64(2), 3);
+    arr.bytes.resize(5 * 32);
+    ASSERT_TRUE("short array",        arr.getArray(0, first, count) && count == 2);
+
+    SFUintBN topic = toTopic(evt_Transfer_qb);
+    ASSERT_TRUE("is topic",           isTopic(topic, topic_evt_Transfer_qb));
+    ASSERT_FALSE("is not topic",      isTopic(topic, topic_evt_Approval_qb));
+    SFUintBN addrTopic = toTopic(string_q("0x" + addrWord(from)));
+    ASSERT_EQ("topic address",        topicAddress(addrTopic), toAddress(fromTopic(addrTopic)));
+    ASSERT_EQ("zero topic",           topicAddress(SFUintBN()), toAddress(fromTopic(SFUintBN())));
+
+    return true;
+}}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestPromote) {
+
+    tokenlib_init();
+    ASSERT_TRUE("registered",         getAbiDecoder()->find(sel_transfer_qb) != NULL);
+    ASSERT_TRUE("wallet registered",  getAbiDecoder()->find(sel_execute_qb) != NULL);
+
+    CTransaction trans;
+    trans.input = "0xa9059cbb" + addrWord("0x00000000000000000000000000000000000000aa") + hexWord(1000);
+    const CTransaction *promoted = promoteToToken(&trans);
+    ASSERT_TRUE("promoted",           promoted != NULL);
+    const QTransfer *transfer = (const QTransfer *)promoted;
+    ASSERT_EQ("class",                string_q(promoted->getRuntimeClass()->m_ClassName), "QTransfer");
+    ASSERT_EQ("to",                   transfer->_to, "0x00000000000000000000000000000000000000aa");
+    ASSERT_EQ("value",                transfer->_value, 1000);
+    ASSERT_TRUE("not articulated",    transfer->function.empty());
+    cout << "\t\t" << promoted->Format("[{ARTICULATED}]") << "\n";
+    delete promoted;
+
+    // a wallet function falls through to the wallet library
+    trans.input = "0xb61d27f6" + addrWord("0x00000000000000000000000000000000000000bb") + hexWord(5) +
+                    hexWord(0x60) + strWords("\xde\xad");
+    promoted = promoteToToken(&trans);
+    ASSERT_EQ("wallet class",         string_q(promoted->getRuntimeClass()->m_ClassName), "QExecute");
+    cout << "\t\t" << promoted->Format("[{ARTICULATED}]") << "\n";
+    delete promoted;
+
+    trans.input = "0xdeadbeef";
+    ASSERT_TRUE("unknown",            promoteToToken(&trans) == NULL);
+    cout << "\t\t" << trans.Format("[{ARTICULATED}]") << "\n";
+    trans.input = "0x";
+    ASSERT_TRUE("empty",              promoteToToken(&trans) == NULL);
+
+    CLogEntry log;
+    log.topics.push_back(toTopic(evt_Transfer_qb));
+    log.topics.push_back(toTopic(string_q("0x00000000000000000000000000000000000000cc")));
+    log.topics.push_back(toTopic(string_q("0x00000000000000000000000000000000000000dd")));
+    log.data = "0x" + hexWord(2000);
+    const CLogEntry *event = promoteToTokenEvent(&log);
+    ASSERT_TRUE("event",              event != NULL);
+    const QTransferEvent *te = (const QTransferEvent *)event;
+    ASSERT_EQ("event from",           te->_from, "0x00000000000000000000000000000000000000cc");
+    ASSERT_EQ("event value",          te->_value, 2000);
+    delete event;
+
+    // the same leading bytes are not enough for an event
+    log.topics[0] = toTopic(string_q("0xddf252ad00000000000000000000000000000000000000000000000000000000"));
+    ASSERT_TRUE("near miss",          promoteToTokenEvent(&log) == NULL);
+
+    return true;
+}}
+
+#include "options.h"
+//------------------------------------------------------------------------
+int main(int argc, const char *argv[]) {
+
+    COptions options;
+    if (!options.prepareArguments(argc, argv))
+        return 0;
+
+    while (!options.commandList.empty()) {
+        string_q command = nextTokenClear(options.commandList, '\n');
+        if (!options.parseArguments(command))
+            return 0;
+        switch (options.testNum) {
+            case 0: LOAD_TEST(TestSelectors); break;
+            case 1: LOAD_TEST(TestDecode);    break;
+            case 2: LOAD_TEST(TestPromote);   break;
+        }
+    }
+
+    return testing::RUN_ALL_TESTS();
+}
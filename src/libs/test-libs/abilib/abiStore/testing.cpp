@@ -0,0 +1,265 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <string>
+#include "etherlib.h"
+#include "testing.h"
+
+//------------------------------------------------------------------------
+class CThisTest : public testing::Test {
+public:
+                 CThisTest(void) : Test() {}
+    virtual void SetUp    (void) {}
+    virtual void TearDown (void) {}
+};
+
+//------------------------------------------------------------------------
+// Functions are built with their encoding already in place, so nothing here asks the node
+// for a hash (finishParse only hashes a signature it has not seen).
+static CFunction makeFunc(const string_q& type, const string_q& name, const string_q& encoding,
+                            const string_q& types, const string_q& names, bool isConst = false) {
+    CFunction func;
+    func.type = type;
+    func.name = name;
+    func.constant = isConst;
+    string_q t = types, n = names;
+    while (!t.empty()) {
+        CParameter param;
+        param.type = nextTokenClear(t, ',');
+        param.name = nextTokenClear(n, ',');
+        param.indexed = startsWith(param.name, '*');
+        if (param.indexed)
+            param.name = extract(param.name, 1);
+        func.inputs.push_back(param);
+    }
+    if (isConst) {
+        CParameter out;
+        out.type = "uint256";
+        func.outputs.push_back(out);
+    }
+    func.signature = func.getSignature(SIG_CANONICAL);
+    func.encoding = encoding;
+    return func;
+}
+
+//------------------------------------------------------------------------
+static void makeTokenAbi(CAbi& abi) {
+    abi.abiByName.clear();
+    abi.abiByName.push_back(makeFunc("function", "balanceOf", "0x70a08231", "address", "_owner", true));
+    abi.abiByName.push_back(makeFunc("event", "Transfer",
+                                "0xddf252ad1be2c89b69c2b068fc378daa952ba7f163c4a11628f55a4df523b3ef",
+                                "address,address,uint256", "*_from,*_to,_value"));
+    abi.abiByName.push_back(makeFunc("function", "transfer", "0xa9059cbb", "address,uint256", "_to,_value"));
+    abi.abiByEncoding = abi.abiByName;
+    sort(abi.abiByEncoding.begin(), abi.abiByEncoding.end());
+}
+
+//------------------------------------------------------------------------
+static string_q report(const CAbi& abi) {
+    string_q ret;
+    for (size_t i = 0 ; i < abi.abiByEncoding.size() ; i++)
+        ret += "\t\t" + abi.abiByEncoding[i].getSignature(SIG_DETAILS) + "\n";
+    return ret;
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestStore) {
+
+    string_q fileName = "/tmp/abiStore_test.bin";
+    ::remove(fileName.c_str());
+
+    CAbi abi;
+    makeTokenAbi(abi);
+    uint64_t hash = abiSourceHash("token source");
+
+    CAbiStore store;
+    ASSERT_FALSE("no file",           store.open(fileName));
+    store.add("token.json", hash, abi);
+    ASSERT_EQ("staged",               store.size(), 1);
+    ASSERT_TRUE("write",              store.write(fileName));
+    ASSERT_FALSE("no temp file",      fileExists(fileName + "." + asStringU((uint64_t)getpid()) + ".tmp"));
+
+    CAbiStore mapped;
+    ASSERT_TRUE("open",               mapped.open(fileName));
+    ASSERT_EQ("size",                 mapped.size(), 1);
+
+    CAbi loaded;
+    ASSERT_TRUE("found",              mapped.find("token.json", hash, loaded));
+    ASSERT_EQ("count by name",        loaded.abiByName.size(), 3);
+    ASSERT_EQ("count by encoding",    loaded.abiByEncoding.size(), 3);
+    ASSERT_EQ("same functions",       report(loaded), report(abi));
+    ASSERT_EQ("first by name",        loaded.abiByName[0].name, "balanceOf");
+    ASSERT_EQ("first by encoding",    loaded.abiByEncoding[0].encoding, "0x70a08231");
+    ASSERT_EQ("outputs",              loaded.abiByEncoding[0].outputs.size(), 1);
+    ASSERT_TRUE("constant",           loaded.abiByEncoding[0].constant);
+    ASSERT_TRUE("has addresses",      loaded.abiByEncoding[0].hasAddrs);
+    ASSERT_TRUE("indexed",            loaded.abiByEncoding[2].inputs[0].indexed);
+    ASSERT_FALSE("not indexed",       loaded.abiByEncoding[2].inputs[2].indexed);
+    cout << report(loaded);
+
+    // copies keep the stored encoding
+    CFunction copy = loaded.abiByEncoding[1];
+    ASSERT_EQ("copy",                 copy.encoding, "0xa9059cbb");
+
+    ASSERT_FALSE("source changed",    mapped.find("token.json", hash + 1, loaded));
+    ASSERT_FALSE("unknown",           mapped.find("other.json", hash, loaded));
+
+    // a damaged file is not used
+    string_q contents = asciiFileToString(fileName);
+    stringToAsciiFile(fileName, extract(contents, 0, contents.length() - 1));
+    CAbiStore damaged;
+    ASSERT_FALSE("truncated",         damaged.open(fileName));
+    stringToAsciiFile(fileName, "not a store at all, but long enough to have a header");
+    ASSERT_FALSE("not a store",       damaged.open(fileName));
+
+    ::remove(fileName.c_str());
+
+    // the stamp follows the source file's size, not its name
+    string_q srcName = "/tmp/abiStore_source.json";
+    ::remove(srcName.c_str());
+    ASSERT_EQ("no source",            abiSourceStamp(srcName), 0);
+    stringToAsciiFile(srcName, "[]");
+    uint64_t stamp = abiSourceStamp(srcName);
+    ASSERT_TRUE("stamped",            stamp != 0);
+    ASSERT_EQ("unchanged",            abiSourceStamp(srcName), stamp);
+    stringToAsciiFile(srcName, "[ ]");
+    ASSERT_TRUE("resized",            abiSourceStamp(srcName) != stamp);
+    ::remove(srcName.c_str());
+    return true;
+}}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestMerge) {
+
+    string_q fileName = "/tmp/abiStore_merge.bin";
+    ::remove(fileName.c_str());
+
+    CAbi token;
+    makeTokenAbi(token);
+    CAbi wallet;
+    wallet.abiByName.push_back(makeFunc("function", "execute", "0xb61d27f6", "address,uint256,bytes", "_to,_value,_data"));
+    wallet.abiByName.push_back(makeFunc("event", "Deposit",
+                                "0xe1fffcc4923d04b559f4d29a8bfc6cda04eb5b0d3c460751c2402c5c5cc9109c",
+                                "address,uint256", "_from,value"));
+    wallet.abiByEncoding = wallet.abiByName;
+    sort(wallet.abiByEncoding.begin(), wallet.abiByEncoding.end());
+
+    // the first write holds one ABI, later writes merge new ABIs with the mapped ones
+    {
+        CAbiStore store;
+        store.add("m_token.json", 1, token);
+        ASSERT_TRUE("first write",    store.write(fileName));
+    }
+    {
+        CAbiStore store;
+        ASSERT_TRUE("reopen",         store.open(fileName));
+        store.add("a_wallet.json", 2, wallet);
+        ASSERT_EQ("merged size",      store.size(), 2);
+        ASSERT_TRUE("second write",   store.write(fileName));
+
+        // the mapped copy is still readable after the file is replaced
+        CAbi abi;
+        ASSERT_TRUE("still mapped",   store.find("m_token.json", 1, abi));
+    }
+    {
+        CAbiStore store;
+        ASSERT_TRUE("open merged",    store.open(fileName));
+        ASSERT_EQ("both",             store.size(), 2);
+        CAbi abi;
+        ASSERT_TRUE("token",          store.find("m_token.json", 1, abi) && abi.abiByName.size() == 3);
+        ASSERT_TRUE("wallet",         store.find("a_wallet.json", 2, abi) && abi.abiByName.size() == 2);
+        cout << report(abi);
+
+        // a changed source replaces its entry
+        token.abiByName.pop_back();
+        token.abiByEncoding = token.abiByName;
+        store.add("m_token.json", 3, token);
+        ASSERT_EQ("replaced size",    store.size(), 2);
+        ASSERT_TRUE("third write",    store.write(fileName));
+    }
+    {
+        CAbiStore store;
+        ASSERT_TRUE("open replaced",  store.open(fileName));
+        ASSERT_EQ("still two",        store.size(), 2);
+        CAbi abi;
+        ASSERT_FALSE("old source",    store.find("m_token.json", 1, abi));
+        ASSERT_TRUE("new source",     store.find("m_token.json", 3, abi) && abi.abiByName.size() == 2);
+        ASSERT_TRUE("wallet kept",    store.find("a_wallet.json", 2, abi) && abi.abiByName.size() == 2);
+    }
+
+    ::remove(fileName.c_str());
+    return true;
+}}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestLoad) {
+
+    string_q folder = "/tmp/abiStore_load/", fileName = folder + "compiled.bin";
+    establishFolder(folder);
+    // The encoding is given so that parsing does not ask the node for a hash. The parser still
+    // hashes the empty function it finds after the last one, that answer is put in the memo.
+    getRPCCache()->store("web3_sha3", "[\"" + string2Hex("()") + "\"]", false, "0x00");
+    string_q json = "[{\"constant\":true,\"inputs\":[{\"name\":\"_owner\",\"type\":\"address\"}],"
+                        "\"name\":\"balanceOf\",\"outputs\":[{\"name\":\"\",\"type\":\"uint256\"}],"
+                        "\"type\":\"function\",\"signature\":\"balanceOf(address)\","
+                        "\"encoding\":\"0x70a08231\"}]";
+    stringToAsciiFile(folder + "one.json", json);
+    stringToAsciiFile(folder + "two.json", json);
+    ::remove(fileName.c_str());
+
+    // a caller loading many ABIs stages them in its own store, nothing is written until it asks
+    CAbiStore store;
+    CAbi abi;
+    ASSERT_TRUE("first",              loadAbiCompiled(abi, folder + "one.json", &store));
+    ASSERT_EQ("parsed",               abi.abiByName.size(), 1);
+    ASSERT_TRUE("second",             loadAbiCompiled(abi, folder + "two.json", &store));
+    ASSERT_TRUE("again",              loadAbiCompiled(abi, folder + "one.json", &store));
+    ASSERT_EQ("staged",               store.nStaged(), 2);
+    ASSERT_FALSE("not written",       fileExists(fileName));
+    ASSERT_TRUE("written once",       store.write(fileName));
+
+    CAbiStore reopened;
+    ASSERT_TRUE("open",               reopened.open(fileName));
+    ASSERT_EQ("both",                 reopened.size(), 2);
+    ASSERT_TRUE("by full path",       reopened.find(folder + "two.json", abiSourceStamp(folder + "two.json"), abi));
+    ASSERT_FALSE("not by file name",  reopened.find("two.json", abiSourceStamp(folder + "two.json"), abi));
+    ASSERT_TRUE("compiled",           loadAbiCompiled(abi, folder + "one.json", &reopened));
+    ASSERT_EQ("nothing new",          reopened.nStaged(), 0);
+    ASSERT_EQ("same function",        abi.abiByName[0].name, "balanceOf");
+
+    ::remove((folder + "one.json").c_str());
+    ::remove((folder + "two.json").c_str());
+    ::remove(fileName.c_str());
+    return true;
+}}
+
+#include "options.h"
+//------------------------------------------------------------------------
+int main(int argc, const char *argv[]) {
+
+    COptions options;
+    if (!options.prepareArguments(argc, argv))
+        return 0;
+
+    while (!options.commandList.empty()) {
+        string_q command = nextTokenClear(options.commandList, '\n');
+        if (!options.parseArguments(command))
+            return 0;
+        switch (options.testNum) {
+            case 0: LOAD_TEST(TestStore); break;
+            case 1: LOAD_TEST(TestMerge); break;
+            case 2: LOAD_TEST(TestLoad); break;
+        }
+    }
+
+    return testing::RUN_ALL_TESTS();
+}
@@ -35,6 +35,11 @@ int main(int argc, const char *argv[]) {
             options.nBlocks = getLatestBlockFromClient();
         }
 
+        if (options.parallel) {
+            buildIndex(options);
+            continue;
+        }
+
         CReporter reporter;
         reporter.tree = new CTreeRoot;
         if (reporter.tree) {
@@ -58,6 +63,36 @@ int main(int argc, const char *argv[]) {
     return 0;
 }
 
+//-----------------------------------------------------------------------
+// Builds (or extends) the account index from the block cache using all available threads
+void buildIndex(const COptions& options) {
+
+    CAccountTreeBuilder builder;
+    if (options.nThreads)
+        builder.nThreads = options.nThreads;
+
+    double start = qbNow();
+    CAccountTrie trie;
+    builder.build(trie, options.startBlock, options.nBlocks);
+    cerr << "Found " << builder.nAddrsFound << " accounts in " << builder.nTransVisited << " transactions ("
+            << builder.nBlocksVisited << " blocks) using " << builder.nThreads << " threads in "
+            << (qbNow() - start) << " seconds\n";
+
+    if (options.merge && fileExists(accountIndex)) {
+        CAccountTrie existing;
+        if (!existing.readFromFile(accountIndex) || !trie.merge(existing)) {
+            cerr << "Could not merge into " << accountIndex << ". Quitting...\n";
+            return;
+        }
+    }
+
+    if (!trie.writeToFile(accountIndex)) {
+        cerr << "Could not write " << accountIndex << ". Quitting...\n";
+        return;
+    }
+    cerr << "Wrote " << trie.size() << " accounts to " << accountIndex << "\n";
+}
+
 //-----------------------------------------------------------------------
 bool buildTree(CBlock& block, void *data) {
 
@@ -18,6 +18,8 @@ CParams params[] = {
     CParams("-start:<uint>",   "the first block to process"),
     CParams("-end:<uint>",     "the last block (less one) to process"),
     CParams("-nblocks:<uint>", "the number of blocks to visit (ignored for -a)"),
+    CParams("-parallel:<uint>","build the account index in parallel using this many threads (0 for all cores)"),
+    CParams("-merge",          "with -p, merge the new accounts into the existing account index"),
     CParams("",                "Build an account tree listing first transaction, latest transaction, and "
                                "node balance for each account.\n"),
 };
@@ -42,6 +44,16 @@ bool COptions::parseArguments(string_q& command) {
             nBlocks = toLongU(arg);
             hasN = true;
 
+        } else if (startsWith(arg, "-p:") || startsWith(arg, "--parallel:")) {
+            arg = substitute(substitute(orig, "-p:", ""), "--parallel:", "");
+            if (!isUnsigned(arg))
+                return usage("Positive thread count expected: " + orig);
+            nThreads = toLongU(arg);
+            parallel = true;
+
+        } else if (arg == "-m" || arg == "--merge") {
+            merge = true;
+
         } else if (startsWith(arg, "-s:") || startsWith(arg, "--start:")) {
             arg = substitute(substitute(orig, "-s:", ""), "--start:", "");
             startBlock = toLongU(arg);
@@ -69,6 +81,8 @@ bool COptions::parseArguments(string_q& command) {
         return usage("You may use either -n or -e, not both. Quitting...");
     if (endBlock != NOPOS)
         nBlocks = (endBlock - startBlock);
+    if (merge && !parallel)
+        return usage("The --merge option is only available with --parallel. Quitting...");
     return true;
 }
 
@@ -81,6 +95,9 @@ void COptions::Init(void) {
     startBlock = 0;
     endBlock = NOPOS;
     nBlocks = 500;
+    nThreads = 0;
+    parallel = false;
+    merge = false;
 
     minArgs = 0;
 }
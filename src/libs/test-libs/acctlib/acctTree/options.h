@@ -21,6 +21,9 @@ public:
     blknum_t endBlock;
     blknum_t startBlock;
     blknum_t nBlocks;
+    size_t   nThreads;
+    bool     parallel;
+    bool     merge;
 
     COptions(void);
     ~COptions(void);
@@ -89,3 +89,4 @@ public:
 //-----------------------------------------------------------------------------
 extern bool printTree(const CTreeNode *node, void *data);
 extern bool buildTree(CBlock& block, void *data);
+extern void buildIndex(const COptions& options);
@@ -0,0 +1,259 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <string>
+#include <algorithm>
+#include "etherlib.h"
+#include "acctlib.h"
+#include "testing.h"
+
+//------------------------------------------------------------------------
+class CThisTest : public testing::Test {
+public:
+                 CThisTest(void) : Test() {}
+    virtual void SetUp    (void) {}
+    virtual void TearDown (void) {}
+};
+
+//------------------------------------------------------------------------
+// Repeatable pseudo-random addresses so the gold files do not change
+static void makeAddresses(CBinAddressArray& addrs, size_t n) {
+    uint64_t seed = 0x5eed;
+    for (size_t i = 0 ; i < n ; i++) {
+        CBinAddress addr;
+        for (size_t b = 0 ; b < sizeof(addr.bytes) ; b++) {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            addr.bytes[b] = (uint8_t)(seed >> 56);
+        }
+        addrs.push_back(addr);
+    }
+}
+
+//------------------------------------------------------------------------
+static bool printItem(const CBinAddress& addr, uint64_t value, void *data) {
+    cout << "\t\t" << addr.toString() << " " << value << "\n";
+    return true;
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestInsertion) {
+
+    CAccountTrie trie;
+    ASSERT_EQ("empty trie",           trie.size(), 0);
+    ASSERT_TRUE("insert new",         trie.insert(CBinAddress("0x1234567890123456789012345678901234567890"), 10));
+    ASSERT_TRUE("insert sibling",     trie.insert(CBinAddress("0x1234567890123456789012345678901234567891"), 11));
+    ASSERT_TRUE("insert split",       trie.insert(CBinAddress("0x1234000000000000000000000000000000000000"), 12));
+    ASSERT_TRUE("insert short",       trie.insert(CBinAddress("0x0"), 13));
+    ASSERT_TRUE("insert top",         trie.insert(CBinAddress("0xffffffffffffffffffffffffffffffffffffffff"), 14));
+    ASSERT_FALSE("insert existing",   trie.insert(CBinAddress("0x1234000000000000000000000000000000000000"), 15));
+    ASSERT_FALSE("increment",         trie.increment(CBinAddress("0x0")));
+    ASSERT_EQ("size",                 trie.size(), 5);
+    ASSERT_EQ("value replaced",       trie.at(CBinAddress("0x1234000000000000000000000000000000000000")), 15);
+    ASSERT_EQ("value incremented",    trie.at(CBinAddress("0x0000000000000000000000000000000000000000")), 14);
+    ASSERT_EQ("upper case",           trie.at(CBinAddress("0XFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF")), 14);
+    ASSERT_FALSE("missing",           trie.contains(CBinAddress("0x1234567890123456789012345678901234567892")));
+    ASSERT_EQ("nodes",                trie.nodeCount(), 8);
+    cout << TESTID("in order", 32) << "\n";
+    trie.visitItems(printItem, NULL);
+
+    return true;
+}}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestBulkLoad) {
+
+    CBinAddressArray addrs;
+    makeAddresses(addrs, 5000);
+
+    CAccountTrie incremental;
+    for (size_t i = 0 ; i < addrs.size() ; i++)
+        incremental.insert(addrs[i], i);
+
+    CBinAddressArray sorted = addrs;
+    sort(sorted.begin(), sorted.end());
+    SFUintArray values;
+    for (size_t i = 0 ; i < sorted.size() ; i++)
+        values.push_back(1);
+    sorted.push_back(sorted.back());  // a repeat
+    values.push_back(1);
+
+    CAccountTrie bulk;
+    ASSERT_TRUE("bulk load",          bulk.bulkLoad(sorted, values));
+    ASSERT_EQ("same size",            bulk.size(), incremental.size());
+    ASSERT_EQ("same shape",           bulk.nodeCount(), incremental.nodeCount());
+    ASSERT_EQ("repeat summed",        bulk.at(sorted.back()), 2);
+
+    size_t nFound = 0;
+    for (size_t i = 0 ; i < addrs.size() ; i++)
+        if (incremental.at(addrs[i]) == i && bulk.contains(addrs[i]))
+            nFound++;
+    ASSERT_EQ("all found",            nFound, addrs.size());
+
+    reverse(sorted.begin(), sorted.end());
+    ASSERT_FALSE("unsorted fails",    bulk.bulkLoad(sorted, values));
+
+    return true;
+}}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestRemove) {
+
+    CBinAddressArray addrs;
+    makeAddresses(addrs, 2000);
+
+    CAccountTrie trie;
+    for (size_t i = 0 ; i < addrs.size() ; i++)
+        trie.insert(addrs[i], i);
+    size_t fullSize = trie.nodeCount();
+
+    for (size_t i = 0 ; i < addrs.size() ; i += 2)
+        trie.remove(addrs[i]);
+    ASSERT_EQ("half removed",         trie.size(), addrs.size() / 2);
+    ASSERT_FALSE("remove missing",    trie.remove(addrs[0]));
+
+    size_t nOkay = 0;
+    for (size_t i = 0 ; i < addrs.size() ; i++)
+        if ((i % 2) ? (trie.at(addrs[i]) == i) : !trie.contains(addrs[i]))
+            nOkay++;
+    ASSERT_EQ("lookups after remove", nOkay, addrs.size());
+
+    for (size_t i = 0 ; i < addrs.size() ; i += 2)
+        trie.insert(addrs[i], i);
+    ASSERT_EQ("shape restored",       trie.nodeCount(), fullSize);
+
+    for (size_t i = 0 ; i < addrs.size() ; i++)
+        trie.remove(addrs[i]);
+    ASSERT_EQ("empty",                trie.size(), 0);
+
+    return true;
+}}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestFileFormat) {
+
+    CBinAddressArray addrs;
+    makeAddresses(addrs, 3000);
+
+    CAccountTrie trie;
+    for (size_t i = 0 ; i < addrs.size() ; i++)
+        trie.insert(addrs[i], i);
+    for (size_t i = 0 ; i < addrs.size() ; i += 3)
+        trie.remove(addrs[i]);
+
+    string_q fileName = "/tmp/acctTrie_test.bin";
+    ASSERT_TRUE("write",              trie.writeToFile(fileName));
+    ASSERT_EQ("file size",            fileSize(fileName), sizeof(CTrieHeader) + trie.memoryUsed());
+
+    CAccountTrie loaded;
+    ASSERT_TRUE("read",               loaded.readFromFile(fileName));
+    CAccountTrie mapped;
+    ASSERT_TRUE("map",                mapped.mapFile(fileName));
+    ASSERT_TRUE("is mapped",          mapped.isMapped());
+
+    size_t nOkay = 0;
+    for (size_t i = 0 ; i < addrs.size() ; i++) {
+        bool present = (i % 3) != 0;
+        if (loaded.contains(addrs[i]) == present && mapped.contains(addrs[i]) == present &&
+                (!present || (loaded.at(addrs[i]) == i && mapped.at(addrs[i]) == i)))
+            nOkay++;
+    }
+    ASSERT_EQ("lookups",              nOkay, addrs.size());
+
+    // a mapped trie may be written over the file it maps
+    ASSERT_TRUE("write over mapped",  mapped.writeToFile(fileName));
+    ASSERT_TRUE("still mapped",       mapped.isMapped() && mapped.at(addrs[1]) == 1);
+    ASSERT_TRUE("read back",          loaded.readFromFile(fileName));
+    ASSERT_EQ("same size",            loaded.size(), mapped.size());
+
+    ASSERT_TRUE("modify mapped",      mapped.insert(addrs[0], 1));
+    ASSERT_FALSE("detached",          mapped.isMapped());
+    ASSERT_EQ("size after modify",    mapped.size(), loaded.size() + 1);
+
+    stringToAsciiFile(fileName, "not a trie");
+    ASSERT_FALSE("bad file",          loaded.readFromFile(fileName));
+    ::remove(fileName.c_str());
+
+    return true;
+}}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestSortMerge) {
+
+    // enough items (with repeats) to use the parallel radix sort
+    CBinAddressArray addrs;
+    makeAddresses(addrs, 50000);
+    CAddressCountArray items;
+    for (size_t i = 0 ; i < 100000 ; i++) {
+        CAddressCount item;
+        item.addr = addrs[(i * 7919) % addrs.size()];
+        item.count = 1;
+        items.push_back(item);
+    }
+
+    CAddressCountArray serial = items;
+    sortAddresses(serial, 1);
+    sortAddresses(items, 4);
+    size_t nSame = 0, nSorted = 0;
+    for (size_t i = 0 ; i < items.size() ; i++) {
+        if (items[i].addr == serial[i].addr)
+            nSame++;
+        if (!i || !(items[i].addr < items[i-1].addr))
+            nSorted++;
+    }
+    ASSERT_EQ("sorted",               nSorted, items.size());
+    ASSERT_EQ("parallel matches",     nSame, items.size());
+
+    collapseSorted(items);
+    ASSERT_EQ("collapsed",            items.size(), addrs.size());
+    ASSERT_EQ("counts summed",        items[0].count, 2);
+
+    CBinAddressArray sorted;
+    SFUintArray values;
+    for (size_t i = 0 ; i < items.size() ; i++) {
+        sorted.push_back(items[i].addr);
+        values.push_back(items[i].count);
+    }
+    CAccountTrie base, delta;
+    base.bulkLoad(CBinAddressArray(sorted.begin(), sorted.begin() + 30000), SFUintArray(values.begin(), values.begin() + 30000));
+    delta.bulkLoad(CBinAddressArray(sorted.begin() + 20000, sorted.end()), SFUintArray(values.begin() + 20000, values.end()));
+    ASSERT_TRUE("merge",              base.merge(delta));
+    ASSERT_EQ("merged size",          base.size(), addrs.size());
+    ASSERT_EQ("not in overlap",       base.at(sorted[10000]), 2);
+    ASSERT_EQ("in overlap",           base.at(sorted[25000]), 4);
+    ASSERT_EQ("only in delta",        base.at(sorted[40000]), 2);
+
+    return true;
+}}
+
+#include "options.h"
+//------------------------------------------------------------------------
+int main(int argc, const char *argv[]) {
+
+    COptions options;
+    if (!options.prepareArguments(argc, argv))
+        return 0;
+
+    while (!options.commandList.empty()) {
+        string_q command = nextTokenClear(options.commandList, '\n');
+        if (!options.parseArguments(command))
+            return 0;
+        switch (options.testNum) {
+            case 0: LOAD_TEST(TestInsertion);  break;
+            case 1: LOAD_TEST(TestBulkLoad);   break;
+            case 2: LOAD_TEST(TestRemove);     break;
+            case 3: LOAD_TEST(TestFileFormat); break;
+            case 4: LOAD_TEST(TestSortMerge);  break;
+        }
+    }
+
+    return testing::RUN_ALL_TESTS();
+}
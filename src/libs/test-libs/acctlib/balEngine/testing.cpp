@@ -0,0 +1,238 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <string>
+#include "etherlib.h"
+#include "acctlib.h"
+#include "testing.h"
+
+//------------------------------------------------------------------------
+class CThisTest : public testing::Test {
+public:
+                 CThisTest(void) : Test() {}
+    virtual void SetUp    (void) {}
+    virtual void TearDown (void) {}
+};
+
+//------------------------------------------------------------------------
+#define ADDR_A "0xaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+#define ADDR_B "0xbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb"
+#define ADDR_C "0xcccccccccccccccccccccccccccccccccccccccc"
+#define MINER  "0xdddddddddddddddddddddddddddddddddddddddd"
+
+//------------------------------------------------------------------------
+static string_q balanceAt(const CBalanceEngine& engine, const SFAddress& addr, blknum_t bn) {
+    SFIntBN bal;
+    if (!engine.getBalance(addr, bn, bal))
+        return "unknown";
+    return to_string(bal).c_str();
+}
+
+//------------------------------------------------------------------------
+static CTransaction makeTrans(const SFAddress& from, const SFAddress& to, uint64_t value, SFGas gasUsed, SFGas gasPrice) {
+    CTransaction trans;
+    trans.from = from;
+    trans.to = to;
+    trans.value = value;
+    trans.gasPrice = gasPrice;
+    trans.receipt.gasUsed = gasUsed;
+    trans.receipt.status = 1;
+    return trans;
+}
+
+//------------------------------------------------------------------------
+static CTrace makeTrace(const string_q& type, const SFAddress& from, const SFAddress& to, uint64_t value) {
+    CTrace trace;
+    trace.type = type;
+    trace.traceAddress.push_back("0");
+    trace.action.callType = "call";
+    trace.action.from = from;
+    trace.action.to = to;
+    trace.action.value = value;
+    return trace;
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestTransfers) {
+
+    CBalanceEngine engine;
+    ASSERT_TRUE("watch",              engine.watch(ADDR_A, 1000000));
+    ASSERT_TRUE("watch upper",        engine.watch(toUpper(ADDR_B)));
+    ASSERT_TRUE("watch miner",        engine.watch(MINER));
+    ASSERT_FALSE("watch twice",       engine.watch(ADDR_B));
+    ASSERT_FALSE("watch bad",         engine.watch("0x1234"));
+
+    CBlock block;
+    block.blockNumber = 100;
+    block.miner = MINER;
+
+    // a plain transfer
+    block.transactions.push_back(makeTrans(ADDR_A, ADDR_B, 1000, 21000, 1));
+
+    // a failed transfer only costs gas
+    CTransaction failed = makeTrans(ADDR_A, ADDR_B, 50, 30000, 2);
+    failed.isError = 1;
+    block.transactions.push_back(failed);
+
+    // a contract call with internal transfers (the delegate call moves nothing)
+    CTransaction call = makeTrans(ADDR_A, ADDR_C, 0, 50000, 1);
+    call.traces.push_back(makeTrace("call", ADDR_C, ADDR_B, 7));
+    CTrace delegate = makeTrace("call", ADDR_C, ADDR_B, 100);
+    delegate.action.callType = "delegatecall";
+    call.traces.push_back(delegate);
+    CTrace suicide = makeTrace("suicide", "", "", 0);
+    suicide.action.address = ADDR_C;
+    suicide.action.refundAddress = ADDR_B;
+    suicide.action.balance = 3;
+    call.traces.push_back(suicide);
+    block.transactions.push_back(call);
+
+    engine.applyBlock(block);
+    ASSERT_EQ("last block",           engine.lastBlock, 100);
+    ASSERT_EQ("sender",               balanceAt(engine, ADDR_A, 100), "868000");
+    ASSERT_EQ("sender before",        balanceAt(engine, ADDR_A, 99), "1000000");
+    ASSERT_EQ("receiver",             balanceAt(engine, ADDR_B, 100), "1010");
+    ASSERT_EQ("miner",                balanceAt(engine, MINER, 100), "5000000000000131000");
+    ASSERT_EQ("not watched",          balanceAt(engine, ADDR_C, 100), "unknown");
+
+    block.transactions.clear();
+    block.blockNumber = byzantiumBlock;
+    engine.applyBlock(block);
+    ASSERT_EQ("byzantium reward",     balanceAt(engine, MINER, byzantiumBlock), "8000000000000131000");
+    ASSERT_EQ("constantinople",       blockReward(constantinopleBlock), str2BigUint("2000000000000000000"));
+
+    // a call that reverted moves nothing, and neither do the calls it made
+    CTransaction reverts = makeTrans(ADDR_C, ADDR_C, 0, 0, 0);
+    CTrace parent = makeTrace("call", ADDR_C, ADDR_B, 40);
+    parent.error = "Reverted";
+    reverts.traces.push_back(parent);
+    CTrace child = makeTrace("call", ADDR_C, ADDR_B, 20);
+    child.traceAddress.push_back("0");
+    reverts.traces.push_back(child);
+    CTrace sibling = makeTrace("call", ADDR_C, ADDR_B, 5);
+    sibling.traceAddress[0] = "1";
+    reverts.traces.push_back(sibling);
+    CTrace nephew = makeTrace("call", ADDR_C, ADDR_B, 2);
+    nephew.traceAddress[0] = "1";
+    nephew.traceAddress.push_back("0");
+    reverts.traces.push_back(nephew);
+    block.transactions.push_back(reverts);
+    block.blockNumber = byzantiumBlock + 1;
+    engine.applyBlock(block);
+    ASSERT_EQ("only the sibling",     balanceAt(engine, ADDR_B, byzantiumBlock + 1), "1017");
+
+    return true;
+}}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestCheckpoints) {
+
+    CBalanceEngine engine;
+    engine.interval = 4;
+    engine.watch(ADDR_A);
+
+    // every third block from 10 gets a delta of the block number
+    for (blknum_t bn = 10 ; bn < 400 ; bn += 3)
+        engine.addDelta(ADDR_A, bn, SFIntBN(bn));
+    // a few out of order, including one into an existing block
+    engine.addDelta(ADDR_A, 11, SFIntBN(-5));
+    engine.addDelta(ADDR_A, 100, SFIntBN(1000));
+    engine.addDelta(ADDR_A, 13, SFIntBN(2));
+
+    const CBalanceTimeline *timeline = engine.getTimeline(ADDR_A);
+    ASSERT_TRUE("timeline",           timeline != NULL);
+    ASSERT_EQ("checkpoints",          timeline->checkpoints.size(), timeline->deltas.size() / 4);
+
+    size_t nOkay = 0;
+    for (blknum_t bn = 0 ; bn < 410 ; bn++) {
+        SFIntBN expected = 0;
+        for (blknum_t b = 10 ; b <= bn && b < 400 ; b += 3)
+            expected += SFIntBN(b);
+        if (bn >= 11) expected += SFIntBN(-5);
+        if (bn >= 13) expected += SFIntBN(2);
+        if (bn >= 100) expected += SFIntBN(1000);
+        SFIntBN bal;
+        if (engine.getBalance(ADDR_A, bn, bal) && bal == expected)
+            nOkay++;
+    }
+    ASSERT_EQ("all blocks",           nOkay, 410);
+
+    CBalanceHistoryArray history;
+    ASSERT_TRUE("history",            engine.getHistory(ADDR_A, history));
+    ASSERT_EQ("history size",         history.size(), timeline->deltas.size());
+    ASSERT_EQ("history first",        history[0].bn, 10);
+    ASSERT_EQ("history second",       history[1].balance, 5);
+
+    return true;
+}}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestFileFormat) {
+
+    CBalanceEngine engine;
+    engine.interval = 3;
+    engine.watch(ADDR_A, 500, 20);
+    engine.watch(ADDR_B);
+    for (blknum_t bn = 20 ; bn < 40 ; bn++) {
+        engine.addDelta(ADDR_A, bn, SFIntBN(-1));
+        engine.addDelta(ADDR_B, bn, SFIntBN(1));
+    }
+    engine.addDelta(ADDR_A, 10, SFIntBN(1000));
+    ASSERT_EQ("before open",          balanceAt(engine, ADDR_A, 19), "unknown");
+    ASSERT_EQ("ignored before open",  balanceAt(engine, ADDR_A, 39), "480");
+
+    ASSERT_TRUE("reconcile",          engine.reconcile(ADDR_B, 30, SFIntBN(100)));
+    ASSERT_EQ("reconciled",           balanceAt(engine, ADDR_B, 30), "100");
+    ASSERT_EQ("after reconcile",      balanceAt(engine, ADDR_B, 39), "109");
+    ASSERT_EQ("before reconcile",     balanceAt(engine, ADDR_B, 29), "10");
+
+    string_q fileName = "/tmp/balEngine_test.bin";
+    ASSERT_TRUE("write",              engine.writeToFile(fileName));
+    CBalanceEngine loaded;
+    ASSERT_TRUE("read",               loaded.readFromFile(fileName));
+    ASSERT_EQ("watched",              loaded.nWatched(), 2);
+
+    size_t nOkay = 0;
+    for (blknum_t bn = 20 ; bn < 45 ; bn++)
+        if (balanceAt(loaded, ADDR_A, bn) == balanceAt(engine, ADDR_A, bn) &&
+                balanceAt(loaded, ADDR_B, bn) == balanceAt(engine, ADDR_B, bn))
+            nOkay++;
+    ASSERT_EQ("same balances",        nOkay, 25);
+
+    stringToAsciiFile(fileName, "not an engine");
+    ASSERT_FALSE("bad file",          loaded.readFromFile(fileName));
+    ::remove(fileName.c_str());
+
+    return true;
+}}
+
+#include "options.h"
+//------------------------------------------------------------------------
+int main(int argc, const char *argv[]) {
+
+    COptions options;
+    if (!options.prepareArguments(argc, argv))
+        return 0;
+
+    while (!options.commandList.empty()) {
+        string_q command = nextTokenClear(options.commandList, '\n');
+        if (!options.parseArguments(command))
+            return 0;
+        switch (options.testNum) {
+            case 0: LOAD_TEST(TestTransfers);   break;
+            case 1: LOAD_TEST(TestCheckpoints); break;
+            case 2: LOAD_TEST(TestFileFormat);  break;
+        }
+    }
+
+    return testing::RUN_ALL_TESTS();
+}
@@ -0,0 +1,246 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <string>
+#include "etherlib.h"
+#include "acctlib.h"
+#include "testing.h"
+
+//------------------------------------------------------------------------
+class CThisTest : public testing::Test {
+public:
+                 CThisTest(void) : Test() {}
+    virtual void SetUp    (void) {}
+    virtual void TearDown (void) {}
+};
+
+//------------------------------------------------------------------------
+#define token    "0x1111111111111111111111111111111111111111"
+#define other    "0x9999999999999999999999999999999999999999"
+#define holderA  "0xaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+#define holderB  "0xbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb"
+#define holderC  "0xcccccccccccccccccccccccccccccccccccccccc"
+#define holderD  "0xdddddddddddddddddddddddddddddddddddddddd"
+#define mintAddr "0x0000000000000000000000000000000000000000"
+#define transfer "0xddf252ad1be2c89b69c2b068fc378daa952ba7f163c4a11628f55a4df523b3ef"
+#define approval "0x8c5be1e5ebec7d5bd14f71427d1e84f3dd0314c0f7b2291e5b200ac8c7c3b925"
+
+//------------------------------------------------------------------------
+static string_q word(const string_q& hex) {
+    return padLeft(substitute(hex, "0x", ""), 64, '0');
+}
+
+//------------------------------------------------------------------------
+// indexed is the usual layout, otherwise all three values are in the data (early tokens)
+static CLogEntry transferLog(const SFAddress& emitter, const SFAddress& from, const SFAddress& to,
+                                uint64_t value, bool indexed = true, const string_q& topic = transfer) {
+    CLogEntry log;
+    log.address = emitter;
+    log.topics.push_back(toTopic(topic));
+    if (indexed) {
+        log.topics.push_back(toTopic("0x" + word(from)));
+        log.topics.push_back(toTopic("0x" + word(to)));
+        log.data = "0x" + word(toHex(value));
+    } else {
+        log.data = "0x" + word(from) + word(to) + word(toHex(value));
+    }
+    return log;
+}
+
+//------------------------------------------------------------------------
+static void addLog(CBlock& block, const CLogEntry& log) {
+    block.transactions.push_back(CTransaction());
+    block.transactions.back().receipt.logs.push_back(log);
+}
+
+//------------------------------------------------------------------------
+static void replay(CTokenBalances& balances) {
+    CBlock block;
+    block.blockNumber = 10;
+    addLog(block, transferLog(token, mintAddr, holderA, 1000));
+    balances.applyBlock(block);
+
+    block = CBlock();
+    block.blockNumber = 12;
+    addLog(block, transferLog(token, holderA, holderB, 300));
+    addLog(block, transferLog(token, holderA, holderC, 100, false));
+    addLog(block, transferLog(token, holderA, holderB, 5, true, approval));  // not a transfer
+    addLog(block, transferLog(other, holderA, holderB, 77));                 // not watched
+    balances.applyBlock(block);
+
+    block = CBlock();
+    block.blockNumber = 15;
+    addLog(block, transferLog(token, holderB, holderC, 50));
+    addLog(block, transferLog(token, holderB, holderB, 10));  // to self
+    balances.applyBlock(block);
+
+    // enough single unit transfers to cross several checkpoints
+    for (blknum_t bn = 20 ; bn < 220 ; bn++) {
+        block = CBlock();
+        block.blockNumber = bn;
+        addLog(block, transferLog(token, holderA, holderD, 1));
+        balances.applyLog(block.transactions[0].receipt.logs[0], bn);
+    }
+}
+
+//------------------------------------------------------------------------
+static string_q balanceStr(const CTokenBalances& balances, const SFAddress& holder, blknum_t bn) {
+    SFUintBN bal;
+    if (!balances.getBalance(token, holder, bn, bal))
+        return "not watched";
+    return to_string(bal).c_str();
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestReplay) {
+
+    SFAddress from, to;
+    SFUintBN value;
+    ASSERT_TRUE("indexed",            isTransferLog(transferLog(token, holderA, holderB, 42), from, to, value));
+    ASSERT_TRUE("indexed values",     from == holderA && to == holderB && value == 42);
+    ASSERT_TRUE("not indexed",        isTransferLog(transferLog(token, holderC, holderD, 7, false), from, to, value));
+    ASSERT_TRUE("not indexed values", from == holderC && to == holderD && value == 7);
+    ASSERT_FALSE("other event",       isTransferLog(transferLog(token, holderA, holderB, 1, true, approval), from, to, value));
+
+    CTokenBalances balances;
+    ASSERT_TRUE("watch",              balances.watchToken(token));
+    ASSERT_FALSE("watch again",       balances.watchToken(toUpper(token)));
+    replay(balances);
+
+    ASSERT_EQ("transfers",            balances.nTransfers(token), 205);
+    ASSERT_EQ("holders",              balances.nHolders(token), 5);
+    ASSERT_EQ("other not watched",    balances.nTransfers(other), 0);
+    ASSERT_EQ("before mint",          balanceStr(balances, holderA, 9), "0");
+    ASSERT_EQ("minted",               balanceStr(balances, holderA, 10), "1000");
+    ASSERT_EQ("between blocks",       balanceStr(balances, holderA, 11), "1000");
+    ASSERT_EQ("A at 12",              balanceStr(balances, holderA, 12), "600");
+    ASSERT_EQ("B at 12",              balanceStr(balances, holderB, 12), "300");
+    ASSERT_EQ("C at 12",              balanceStr(balances, holderC, 12), "100");
+    ASSERT_EQ("B at 15",              balanceStr(balances, holderB, 15), "250");
+    ASSERT_EQ("C at 15",              balanceStr(balances, holderC, 15), "150");
+    ASSERT_EQ("D at 119",             balanceStr(balances, holderD, 119), "100");
+    ASSERT_EQ("A at 119",             balanceStr(balances, holderA, 119), "500");
+    ASSERT_EQ("D latest",             balanceStr(balances, holderD, 1000), "200");
+    ASSERT_EQ("unknown holder",       balanceStr(balances, "0x1234567890123456789012345678901234567890", 1000), "0");
+    ASSERT_EQ("mint address",         balanceStr(balances, mintAddr, 1000), "0");
+    SFUintBN bal;
+    ASSERT_FALSE("unknown token",     balances.getBalance(other, holderA, 1000, bal));
+
+    const CBalanceTimeline *timeline = balances.getTimeline(token, holderD);
+    ASSERT_TRUE("timeline",           timeline != NULL);
+    ASSERT_EQ("deltas",               timeline->deltas.size(), 200);
+    ASSERT_EQ("checkpoints",          timeline->checkpoints.size(), 6);
+
+    blknum_t blocks[] = { 10, 12, 15, 100, 219 };
+    for (size_t i = 0 ; i < sizeof(blocks) / sizeof(blknum_t) ; i++) {
+        cout << "\t\tblock " << blocks[i] << ":";
+        cout << " A " << balanceStr(balances, holderA, blocks[i]);
+        cout << " B " << balanceStr(balances, holderB, blocks[i]);
+        cout << " C " << balanceStr(balances, holderC, blocks[i]);
+        cout << " D " << balanceStr(balances, holderD, blocks[i]) << "\n";
+    }
+    return true;
+}}
+
+//------------------------------------------------------------------------
+// A stand in for eth_call: the token minted 500 to C at block 14 without a Transfer event
+static uint64_t nCalls = 0;
+static SFUintBN fakeNode(const SFAddress& tok, const SFAddress& holder, blknum_t bn) {
+    nCalls++;
+    CTokenBalances balances;
+    balances.watchToken(tok);
+    replay(balances);
+    SFUintBN bal;
+    balances.getBalance(tok, holder, bn, bal);
+    if (holder == holderC && bn >= 14)
+        bal += 500;
+    return bal;
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestValidate) {
+
+    CTokenBalances balances;
+    balances.watchToken(token);
+    replay(balances);
+
+    SFAddressArray corrected;
+    ASSERT_EQ("none watched",         balances.validate(other, 15, 10, fakeNode, corrected), 0);
+    ASSERT_EQ("one sample",           balances.validate(token, 15, 1, fakeNode, corrected), 1);
+    ASSERT_EQ("agrees",               corrected.size(), 0);
+    ASSERT_EQ("all sampled",          balances.validate(token, 15, 10, fakeNode, corrected), 4);
+    ASSERT_EQ("node calls",           nCalls, 5);
+    ASSERT_EQ("one corrected",        corrected.size(), 1);
+    ASSERT_EQ("which one",            corrected[0], holderC);
+    ASSERT_EQ("C before",             balanceStr(balances, holderC, 12), "100");
+    ASSERT_EQ("C corrected",          balanceStr(balances, holderC, 15), "650");
+    ASSERT_EQ("C later",              balanceStr(balances, holderC, 500), "650");
+    ASSERT_EQ("checked again",        balances.validate(token, 200, 10, fakeNode, corrected), 4);
+    ASSERT_EQ("now agrees",           corrected.size(), 0);
+    return true;
+}}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestLoad) {
+
+    string_q folder = "/tmp/tokenBal_test/";
+    string_q indexFile = folder + "index.bin", journalFile = folder + "journal.bin";
+    ::remove(indexFile.c_str());
+    ::remove(journalFile.c_str());
+    establishFolder(folder);
+
+    // the index knows of one transfer of 'token', in a block that is not in the cache
+    CBlock block;
+    block.blockNumber = 999999999;
+    addLog(block, transferLog(token, mintAddr, holderA, 1000));
+    ASSERT_TRUE("journaled",          appendBlockLogs(block, journalFile));
+
+    CLogIndex index;
+    index.open(indexFile, journalFile);
+    CTokenBalances balances;
+    SFUintBN bal;
+    ASSERT_EQ("no history",           balances.loadToken(other, index), 0);
+    ASSERT_FALSE("not watched",       balances.isWatched(other));
+    ASSERT_FALSE("ask the node",      balances.getBalance(other, holderA, 10, bal));
+    ASSERT_EQ("block not cached",     balances.loadToken(token, index), 0);
+    ASSERT_FALSE("still not watched", balances.isWatched(token));
+
+    // a token already being watched stays watched
+    balances.watchToken(token);
+    ASSERT_EQ("nothing more",         balances.loadToken(token, index), 0);
+    ASSERT_TRUE("watched before",     balances.isWatched(token));
+
+    ::remove(journalFile.c_str());
+    return true;
+}}
+
+#include "options.h"
+//------------------------------------------------------------------------
+int main(int argc, const char *argv[]) {
+
+    COptions options;
+    if (!options.prepareArguments(argc, argv))
+        return 0;
+
+    while (!options.commandList.empty()) {
+        string_q command = nextTokenClear(options.commandList, '\n');
+        if (!options.parseArguments(command))
+            return 0;
+        switch (options.testNum) {
+            case 0: LOAD_TEST(TestReplay);   break;
+            case 1: LOAD_TEST(TestValidate); break;
+            case 2: LOAD_TEST(TestLoad);     break;
+        }
+    }
+
+    return testing::RUN_ALL_TESTS();
+}
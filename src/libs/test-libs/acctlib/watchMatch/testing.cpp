@@ -0,0 +1,199 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <string>
+#include "etherlib.h"
+#include "acctlib.h"
+#include "testing.h"
+
+//------------------------------------------------------------------------
+class CThisTest : public testing::Test {
+public:
+                 CThisTest(void) : Test() {}
+    virtual void SetUp    (void) {}
+    virtual void TearDown (void) {}
+};
+
+//------------------------------------------------------------------------
+// Repeatable pseudo-random addresses so the gold files do not change
+static void makeAddresses(CBinAddressArray& addrs, size_t n, uint64_t seed) {
+    for (size_t i = 0 ; i < n ; i++) {
+        CBinAddress addr;
+        for (size_t b = 0 ; b < sizeof(addr.bytes) ; b++) {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            addr.bytes[b] = (uint8_t)(seed >> 56);
+        }
+        addrs.push_back(addr);
+    }
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestLookups) {
+
+    CBinAddressArray watched, others;
+    makeAddresses(watched, 20000, 0x5eed);
+    makeAddresses(others, 100000, 0xbeef);
+
+    // the watch list (building CAccountWatches would need a node for their blooms)
+    CBinAddressArray watches = watched;
+    watches.push_back(watches[10]);  // a repeat
+
+    CWatchMatcher matcher;
+    ASSERT_EQ("compiled",             matcher.compile(watches), watched.size());
+    ASSERT_EQ("find first",           matcher.find(watched[0]), 0);
+    ASSERT_EQ("find string",          matcher.find(watches[123].toString()), 123);
+    ASSERT_EQ("repeat keeps first",   matcher.find(watched[10]), 10);
+    ASSERT_EQ("miss",                 matcher.find(others[0]), NOPOS);
+
+    // every fifth test address is watched
+    CBinAddressArray batch;
+    for (size_t i = 0 ; i < others.size() ; i++)
+        batch.push_back((i % 5) ? others[i] : watched[(i / 5) % watched.size()]);
+
+    vector<uint32_t> hits;
+    ASSERT_EQ("batch hits",           matcher.matchBatch(batch.data(), batch.size(), hits), batch.size() / 5);
+    size_t nOkay = 0;
+    for (size_t i = 0 ; i < batch.size() ; i++) {
+        // the linear search the matcher replaces
+        size_t expected = NO_WATCH;
+        if (!(i % 5)) {
+            for (size_t w = 0 ; w < watches.size() && expected == NO_WATCH ; w++)
+                if (watches[w] == batch[i])
+                    expected = w;
+        }
+        if (hits[i] == expected)
+            nOkay++;
+    }
+    ASSERT_EQ("same as linear",       nOkay, batch.size());
+
+    // of the 80000 misses, fewer than one percent should get past the bloom
+    uint64_t nFalse = matcher.nPassedBloom - matcher.nMatched;
+    ASSERT_TRUE("bloom prefilter",    nFalse < 800);
+
+    ASSERT_EQ("empty list",           matcher.compile(CBinAddressArray()), 0);
+    ASSERT_EQ("empty batch",          matcher.matchBatch(batch.data(), batch.size(), hits), 0);
+
+    return true;
+}}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestBlock) {
+
+    const char *names[] = { "A", "B", "C" };
+    CBinAddressArray watches;
+    watches.push_back(CBinAddress("0xaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"));
+    watches.push_back(CBinAddress("0xbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb"));
+    watches.push_back(CBinAddress("0xcccccccccccccccccccccccccccccccccccccccc"));
+    CWatchMatcher matcher;
+    matcher.compile(watches);
+
+    CBlock block;
+    block.miner = "0xcccccccccccccccccccccccccccccccccccccccc";
+
+    CTransaction trans;
+    trans.from = "0x1111111111111111111111111111111111111111";
+    trans.to = "0xaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
+    block.transactions.push_back(trans);
+
+    // sends to itself, should be reported once
+    trans.from = "0xAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA";
+    block.transactions.push_back(trans);
+
+    // nothing watched at the top level, but an internal call to B
+    trans.from = "0x1111111111111111111111111111111111111111";
+    trans.to = "0x2222222222222222222222222222222222222222";
+    CTrace trace;
+    trace.action.from = trans.to;
+    trace.action.to = "0xbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb";
+    trans.traces.push_back(trace);
+    block.transactions.push_back(trans);
+
+    // a contract creation
+    trans.traces.clear();
+    trans.to = "";
+    trans.receipt.contractAddress = "0xbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb";
+    block.transactions.push_back(trans);
+
+    CWatchHitArray hits;
+    ASSERT_EQ("hits",                 matcher.matchBlock(block, hits), 5);
+    for (size_t i = 0 ; i < hits.size() ; i++)
+        cout << "\t\t" << names[hits[i].watch] << " " << (hits[i].trans == NOPOS ? "miner" : asStringU(hits[i].trans)) << "\n";
+    ASSERT_EQ("without traces",       matcher.matchBlock(block, hits, false), 4);
+
+    return true;
+}}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestCached) {
+
+    string_q folder = "/tmp/watchMatch_test/";
+    blockDictionaries().folder = folder + "dicts/";
+    CBinAddressArray watches;
+    watches.push_back(CBinAddress("0xaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"));
+    CWatchMatcher matcher;
+    matcher.compile(watches);
+
+    CBlock missed, hit;
+    missed.blockNumber = 1;
+    missed.miner = "0xcccccccccccccccccccccccccccccccccccccccc";
+    CTransaction trans;
+    trans.from = "0x1111111111111111111111111111111111111111";
+    trans.to = "0x2222222222222222222222222222222222222222";
+    missed.transactions.push_back(trans);
+    hit = missed;
+    hit.blockNumber = 2;
+    hit.transactions[0].to = "0xaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
+    ASSERT_TRUE("write missed",       writePackedBlock(missed, folder + "missed.bin"));
+    ASSERT_TRUE("write hit",          writePackedBlock(hit, folder + "hit.bin"));
+
+    // the block's address table is enough to pass over it
+    CBlock block;
+    CWatchHitArray hits;
+    ASSERT_EQ("no hits",              matcher.matchCachedBlock(folder + "missed.bin", block, hits), 0);
+    ASSERT_EQ("not read",             block.transactions.size(), 0);
+    ASSERT_EQ("one hit",              matcher.matchCachedBlock(folder + "hit.bin", block, hits), 1);
+    ASSERT_EQ("read",                 block.transactions.size(), 1);
+    ASSERT_EQ("in the transaction",   hits[0].trans, 0);
+
+    // a block reused for a miss does not keep the earlier block
+    ASSERT_EQ("missed again",         matcher.matchCachedBlock(folder + "missed.bin", block, hits), 0);
+    ASSERT_EQ("emptied",              block.transactions.size(), 0);
+    ASSERT_EQ("no number",            block.blockNumber, 0);
+    ASSERT_EQ("no file",              matcher.matchCachedBlock(folder + "none.bin", block, hits), 0);
+    ASSERT_EQ("still empty",          block.transactions.size(), 0);
+
+    ::remove((folder + "missed.bin").c_str());
+    ::remove((folder + "hit.bin").c_str());
+    return true;
+}}
+
+#include "options.h"
+//------------------------------------------------------------------------
+int main(int argc, const char *argv[]) {
+
+    COptions options;
+    if (!options.prepareArguments(argc, argv))
+        return 0;
+
+    while (!options.commandList.empty()) {
+        string_q command = nextTokenClear(options.commandList, '\n');
+        if (!options.parseArguments(command))
+            return 0;
+        switch (options.testNum) {
+            case 0: LOAD_TEST(TestLookups); break;
+            case 1: LOAD_TEST(TestBlock);   break;
+            case 2: LOAD_TEST(TestCached);  break;
+        }
+    }
+
+    return testing::RUN_ALL_TESTS();
+}
@@ -0,0 +1,58 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include "options.h"
+
+//---------------------------------------------------------------------------------------------------
+static CParams params[] = {
+    CParams("~mode",         "the test to run (0 through 3 inclusive)"),
+    CParams("~corpus",       "a file of recorded transaction inputs, one per line"),
+    CParams("-reps:<uint>",   "time this many passes of compressing and reading the blocks"),
+    CParams("",              "Measure the compression of cached blocks, with and without an era dictionary.\n"),
+};
+size_t nParams = sizeof(params) / sizeof(CParams);
+
+//---------------------------------------------------------------------------------------------------
+bool COptions::parseArguments(string_q& command) {
+
+    if (!standardOptions(command))
+        return false;
+
+    Init();
+    while (!command.empty()) {
+        string_q arg = nextTokenClear(command, ' ');
+        if (startsWith(arg, '-')) {  // do not collapse
+
+            if (startsWith(arg, "-r:") || startsWith(arg, "--reps:")) {
+                arg = substitute(substitute(arg, "-r:", ""), "--reps:", "");
+                nReps = toLongU(arg);
+
+            } else if (!builtInCmd(arg)) {
+                return usage("Invalid option: " + arg);
+            }
+        } else if (testNum == NOPOS) {
+            testNum = toLongU(arg);
+        } else {
+            corpus = arg;
+        }
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------------------------------
+void COptions::Init(void) {
+    paramsPtr = params;
+    nParamsRef = nParams;
+    testNum = NOPOS;
+    corpus = "";
+    nReps = 0;
+}
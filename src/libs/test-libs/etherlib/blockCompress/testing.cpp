@@ -0,0 +1,640 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <set>
+#include <string>
+#include "etherlib.h"
+#include "testing.h"
+#include "options.h"
+
+//------------------------------------------------------------------------
+class CThisTest : public testing::Test {
+public:
+                 CThisTest(void) : Test() {}
+    virtual void SetUp    (void) {}
+    virtual void TearDown (void) {}
+};
+
+//------------------------------------------------------------------------
+static COptions theOptions;
+
+//------------------------------------------------------------------------
+// Counts every allocation made through operator new (which is how strings and vectors allocate)
+static uint64_t nAllocs = 0;
+void *operator new(size_t size) {
+    nAllocs++;
+    void *ptr = malloc(size ? size : 1);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+//------------------------------------------------------------------------
+// Repeatable pseudo random numbers (xorshift) for hashes and for picking addresses
+class CRandom {
+public:
+    uint64_t state;
+    explicit CRandom(uint64_t seed) : state(seed) { }
+    uint64_t next(void) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+    string_q hex(size_t nChars) {
+        string_q ret;
+        while (ret.length() < nChars)
+            ret += padLeft(toLower(string_q(to_hex(SFUintBN(next())).c_str())), 16, '0');
+        return "0x" + extract(ret, 0, nChars);
+    }
+};
+
+//------------------------------------------------------------------------
+static bool roundTrip(const string_q& data, const string_q& dict = "") {
+    string_q packed;
+    lz4Compress((const uint8_t*)data.data(), data.length(), packed,  // NOLINT
+                    (const uint8_t*)dict.data(), dict.length());  // NOLINT
+    string_q back(data.length(), '\0');
+    if (!lz4Decompress((const uint8_t*)packed.data(), packed.length(), (uint8_t*)&back[0], back.length(),  // NOLINT
+                        (const uint8_t*)dict.data(), dict.length()))  // NOLINT
+        return false;
+    return back == data;
+}
+
+//------------------------------------------------------------------------
+static size_t packedSize(const string_q& data, const string_q& dict = "") {
+    string_q packed;
+    return lz4Compress((const uint8_t*)data.data(), data.length(), packed,  // NOLINT
+                        (const uint8_t*)dict.data(), dict.length());  // NOLINT
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestCodec) {
+
+    CRandom rnd(7);
+    string_q noise;
+    for (size_t i = 0 ; i < 4096 ; i++)
+        noise += (char)(rnd.next() & 0xff);
+    string_q text;
+    for (size_t i = 0 ; i < 200 ; i++)
+        text += "0xa9059cbb000000000000000000000000" + extract(rnd.hex(40), 2) + padLeft(asStringU(i), 64, '0');
+
+    ASSERT_TRUE("empty",              roundTrip(""));
+    ASSERT_TRUE("one byte",           roundTrip("a"));
+    ASSERT_TRUE("shorter than limit", roundTrip("0123456789abc"));
+    ASSERT_TRUE("one long run",       roundTrip(string_q(100000, 'z')));
+    ASSERT_TRUE("noise",              roundTrip(noise));
+    ASSERT_TRUE("text",               roundTrip(text));
+    ASSERT_TRUE("noise then run",     roundTrip(noise + string_q(1000, '\0') + noise));
+    ASSERT_TRUE("run compresses",     packedSize(string_q(100000, 'z')) < 500);
+    ASSERT_TRUE("noise grows little", packedSize(noise) < noise.length() + noise.length() / 100 + 16);
+    ASSERT_TRUE("text compresses",    packedSize(text) < text.length() / 2);
+
+    // a small record made of pieces of the dictionary
+    string_q dict = text;
+    string_q record = extract(text, 1000, 300) + "a0b1c2" + extract(text, 9000, 300);
+    ASSERT_TRUE("with dictionary",    roundTrip(record, dict));
+    ASSERT_TRUE("dictionary helps",   packedSize(record, dict) < packedSize(record) / 5);
+
+    string_q packed;
+    lz4Compress((const uint8_t*)record.data(), record.length(), packed,  // NOLINT
+                    (const uint8_t*)dict.data(), dict.length());  // NOLINT
+    string_q back(record.length(), '\0');
+    ASSERT_FALSE("needs dictionary",  lz4Decompress((const uint8_t*)packed.data(), packed.length(),  // NOLINT
+                                                      (uint8_t*)&back[0], back.length()));  // NOLINT
+    ASSERT_FALSE("truncated",         lz4Decompress((const uint8_t*)packed.data(), packed.length() - 1,  // NOLINT
+                                                      (uint8_t*)&back[0], back.length(),  // NOLINT
+                                                      (const uint8_t*)dict.data(), dict.length()));  // NOLINT
+    ASSERT_FALSE("wrong size",        lz4Decompress((const uint8_t*)packed.data(), packed.length(),  // NOLINT
+                                                      (uint8_t*)&back[0], back.length() - 1,  // NOLINT
+                                                      (const uint8_t*)dict.data(), dict.length()));  // NOLINT
+
+    CStringArray samples;
+    samples.push_back(extract(text, 0, 1000));
+    samples.push_back(extract(text, 1000, 1000));
+    string_q trained;
+    trainDictionary(samples, 4096, trained);
+    ASSERT_EQ("small samples kept",   trained.length(), 2000);
+    samples.clear();
+    for (size_t i = 0 ; i < text.length() ; i += 2000)
+        samples.push_back(extract(text, i, 2000));
+    trainDictionary(samples, 4096, trained);
+    ASSERT_TRUE("fits",               trained.length() <= 4096 && trained.length() > 0);
+    ASSERT_EQ("whole segments",       trained.length() % 64, 0);
+
+    return true;
+}}
+
+//------------------------------------------------------------------------
+// A run of blocks built from recorded transaction inputs. Senders and contracts come from
+// small pools, as they do on chain, while hashes are random. Token transfers get a log.
+static void makeBlocks(const CStringArray& inputs, size_t nBlocks, CBlockArray& blocks) {
+    CRandom rnd(42);
+    CStringArray users, contracts;
+    for (size_t i = 0 ; i < 40 ; i++)
+        users.push_back(rnd.hex(40));
+    for (size_t i = 0 ; i < 12 ; i++)
+        contracts.push_back(rnd.hex(40));
+
+    size_t next = 0;
+    string_q parent = rnd.hex(64);
+    for (size_t b = 0 ; b < nBlocks ; b++) {
+        CBlock block;
+        block.blockNumber = 4000000 + b;
+        block.hash = rnd.hex(64);
+        block.parentHash = parent;
+        block.miner = contracts[rnd.next() % 3];
+        block.difficulty = 1500000000000000 + rnd.next() % 1000000000;
+        block.gasLimit = 6700000;
+        block.timestamp = (timestamp_t)(1500000000 + b * 15);
+        parent = block.hash;
+
+        size_t nTxs = 20 + rnd.next() % 60;
+        uint64_t logIndex = 0;
+        for (size_t t = 0 ; t < nTxs ; t++) {
+            CTransaction trans;
+            trans.hash = rnd.hex(64);
+            trans.blockHash = block.hash;
+            trans.blockNumber = block.blockNumber;
+            trans.transactionIndex = t;
+            trans.nonce = rnd.next() % 5000;
+            trans.timestamp = block.timestamp;
+            trans.from = users[rnd.next() % users.size()];
+            trans.input = inputs[next++ % inputs.size()];
+            trans.to = (trans.input == "0x" ? users[rnd.next() % users.size()] : contracts[rnd.next() % contracts.size()]);
+            trans.value = (trans.input == "0x" ? SFWei((uint64_t)(rnd.next() % 5000000000000000000ULL)) : SFWei((uint64_t)0));
+            trans.gas = 21000 + (rnd.next() % 20) * 10000;
+            trans.gasPrice = (1 + rnd.next() % 40) * 1000000000ULL;
+            trans.receipt.gasUsed = trans.gas - (rnd.next() % 1000);
+            trans.receipt.status = 1;
+            if (startsWith(trans.input, "0xa9059cbb") && trans.input.length() >= 138) {
+                CLogEntry log;
+                log.address = trans.to;
+                log.logIndex = logIndex++;
+                log.topics.push_back(toTopic("0xddf252ad1be2c89b69c2b068fc378daa952ba7f163c4a11628f55a4df523b3ef"));
+                log.topics.push_back(toTopic("0x" + padLeft(extract(trans.from, 2), 64, '0')));
+                log.topics.push_back(toTopic("0x" + extract(trans.input, 10, 64)));
+                log.data = "0x" + extract(trans.input, 74, 64);
+                trans.receipt.logs.push_back(log);
+            }
+            block.gasUsed += trans.receipt.gasUsed;
+            block.transactions.push_back(trans);
+        }
+        blocks.push_back(block);
+    }
+}
+
+//------------------------------------------------------------------------
+static string_q asRatio(uint64_t raw, uint64_t packed) {
+    return double2Str(double(raw) / max(packed, (uint64_t)1), 2) + " to 1";
+}
+
+//------------------------------------------------------------------------
+static string_q folder = "/tmp/blockCompress_test/";
+static void cleanFolder(void) {
+    ::remove((folder + "dicts/era_0004.dict").c_str());
+    ::remove((folder + "packed.bin").c_str());
+    ::remove((folder + "plain.bin").c_str());
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestBlocks) {
+
+    CStringArray inputs;
+    string_q contents = asciiFileToString(theOptions.corpus);
+    while (!contents.empty()) {
+        string_q input = nextTokenClear(contents, '\n');
+        if (!input.empty())
+            inputs.push_back(input);
+    }
+    ASSERT_EQ("corpus",               inputs.size(), 199);
+
+    CBlockArray blocks;
+    makeBlocks(inputs, 200, blocks);
+    CStringArray raws;
+    uint64_t rawBytes = 0;
+    for (size_t i = 0 ; i < blocks.size() ; i++) {
+        string_q raw;
+        serializeBlock(blocks[i], raw);
+        raws.push_back(raw);
+        rawBytes += raw.length();
+    }
+
+    // the dictionary is trained on the even blocks and measured on all of them
+    cleanFolder();
+    blockDictionaries().clear();
+    blockDictionaries().folder = folder + "dicts/";
+    CStringArray samples;
+    uint64_t encodedBytes = 0;
+    for (size_t i = 0 ; i < raws.size() ; i++) {
+        CArchiveDictionary tables;
+        string_q encoded;
+        serializeBlock(blocks[i], encoded, &tables);
+        encodedBytes += encoded.length() + tables.addresses.size() * 20 + tables.hashes.size() * 32;
+        if (!(i % 2))
+            samples.push_back(encoded);
+    }
+    ASSERT_TRUE("tables are smaller", encodedBytes < rawBytes);
+
+    uint64_t plainBytes = 0;
+    for (size_t i = 0 ; i < blocks.size() ; i++) {
+        string_q packed;
+        packBlock(blocks[i], packed);
+        plainBytes += packed.length();
+    }
+    ASSERT_TRUE("no dictionary yet",  blockDictionaries().get(4) == NULL);
+    ASSERT_TRUE("trained",            blockDictionaries().train(4, samples));
+    ASSERT_TRUE("written",            fileExists(folder + "dicts/era_0004.dict"));
+    ASSERT_TRUE("dictionary size",    blockDictionaries().get(4)->data.length() <= BLOCK_DICT_SIZE);
+
+    // a dictionary written by someone else while we trained is kept, and ours is dropped
+    ASSERT_TRUE("none for era 5",     blockDictionaries().get(5) == NULL);
+    stringToAsciiFile(folder + "dicts/era_0005.dict", string_q(64, 'x'));
+    ASSERT_FALSE("already there",     blockDictionaries().train(5, samples));
+    ASSERT_TRUE("theirs is used",     blockDictionaries().get(5) && blockDictionaries().get(5)->data == string_q(64, 'x'));
+    ::remove((folder + "dicts/era_0005.dict").c_str());
+
+    uint64_t dictBytes = 0;
+    size_t nSame = 0;
+    CStringArray packeds;
+    for (size_t i = 0 ; i < blocks.size() ; i++) {
+        string_q packed;
+        packBlock(blocks[i], packed);
+        dictBytes += packed.length();
+        packeds.push_back(packed);
+
+        CBlock block;
+        string_q back;
+        if (unpackBlock((const uint8_t*)packed.data(), packed.length(), block) && serializeBlock(block, back))  // NOLINT
+            nSame += (back == raws[i]);
+    }
+    ASSERT_EQ("all read back",        nSame, blocks.size());
+    ASSERT_TRUE("compresses",         plainBytes < rawBytes / 2);
+    ASSERT_TRUE("dictionary helps",   dictBytes < plainBytes);
+    cout << "\tblocks:        " << blocks.size() << "\n";
+    cout << "\tuncompressed:  " << rawBytes << " bytes\n";
+    cout << "\twith tables:   " << encodedBytes << " bytes (" << asRatio(rawBytes, encodedBytes) << ")\n";
+    cout << "\tno dictionary: " << plainBytes << " bytes (" << asRatio(rawBytes, plainBytes) << ")\n";
+    cout << "\tdictionary:    " << dictBytes << " bytes (" << asRatio(rawBytes, dictBytes) << ")\n";
+
+    // both forms of the file read through readBlockFromBinary
+    ASSERT_TRUE("write packed",       writePackedBlock(blocks[1], folder + "packed.bin"));
+    SFArchive archive(WRITING_ARCHIVE);
+    ASSERT_TRUE("write plain",        archive.Lock(folder + "plain.bin", binaryWriteCreate, LOCK_CREATE));
+    blocks[1].SerializeC(archive);
+    archive.Release();
+    CBlock fromPacked, fromPlain;
+    string_q s1, s2;
+    ASSERT_TRUE("read packed",        readBlockFromBinary(fromPacked, folder + "packed.bin"));
+    ASSERT_TRUE("read plain",         readBlockFromBinary(fromPlain, folder + "plain.bin"));
+    serializeBlock(fromPacked, s1);
+    serializeBlock(fromPlain, s2);
+    ASSERT_TRUE("same block",         s1 == raws[1] && s2 == raws[1]);
+    ASSERT_EQ("transactions",         fromPacked.transactions.size(), blocks[1].transactions.size());
+    ASSERT_TRUE("smaller file",       fileSize(folder + "packed.bin") < fileSize(folder + "plain.bin"));
+
+    // the address table holds each address in the block once
+    CBinAddressArray table;
+    ASSERT_TRUE("address table",      packedBlockAddresses((const uint8_t*)packeds[1].data(), packeds[1].length(), table));  // NOLINT
+    set<CBinAddress> expected;
+    expected.insert(CBinAddress(blocks[1].miner));
+    for (size_t t = 0 ; t < blocks[1].transactions.size() ; t++) {
+        const CTransaction *trans = &blocks[1].transactions[t];
+        expected.insert(CBinAddress(trans->from));
+        expected.insert(CBinAddress(trans->to));
+        for (size_t l = 0 ; l < trans->receipt.logs.size() ; l++)
+            expected.insert(CBinAddress(trans->receipt.logs[l].address));
+    }
+    set<CBinAddress> found(table.begin(), table.end());
+    ASSERT_EQ("each once",            found.size(), table.size());
+    ASSERT_TRUE("all addresses",      found == expected);
+    CBinAddressArray fromFile;
+    ASSERT_TRUE("from the file",      readBlockAddresses(folder + "packed.bin", fromFile) && fromFile.size() == table.size());
+    ASSERT_FALSE("not in plain file", readBlockAddresses(folder + "plain.bin", fromFile));
+
+    // records written before the tables (no tables, no dictionary) still read
+    CBlockRecordHeader header;
+    memcpy(header.magic, "QBZ1", sizeof(header.magic));
+    header.era = 4;
+    header.dictId = 0;
+    header.rawSize = (uint32_t)raws[1].length();
+    string_q older((const char*)&header, sizeof(header));  // NOLINT
+    lz4Compress((const uint8_t*)raws[1].data(), raws[1].length(), older);  // NOLINT
+    CBlock fromOlder;
+    string_q s3;
+    ASSERT_TRUE("older format",       unpackBlock((const uint8_t*)older.data(), older.length(), fromOlder));  // NOLINT
+    serializeBlock(fromOlder, s3);
+    ASSERT_TRUE("older reads back",   s3 == raws[1]);
+    ASSERT_FALSE("older has no table", packedBlockAddresses((const uint8_t*)older.data(), older.length(), table));  // NOLINT
+
+    // a block compressed with a dictionary cannot be read without it
+    blockDictionaries().clear();
+    blockDictionaries().folder = folder + "nodicts/";
+    CBlock lost;
+    ostringstream errors;
+    streambuf *saved = cerr.rdbuf(errors.rdbuf());
+    bool unpacked = unpackBlock((const uint8_t*)packeds[1].data(), packeds[1].length(), lost);  // NOLINT
+    cerr.rdbuf(saved);
+    ASSERT_FALSE("dictionary missing", unpacked);
+    ASSERT_TRUE("says so",            contains(errors.str(), "dictionary of era 4"));
+    blockDictionaries().clear();
+    blockDictionaries().folder = folder + "dicts/";
+
+    if (theOptions.nReps) {
+        double start = qbNow();
+        for (size_t r = 0 ; r < theOptions.nReps ; r++) {
+            for (size_t i = 0 ; i < blocks.size() ; i++) {
+                string_q packed;
+                packBlock(blocks[i], packed);
+            }
+        }
+        double mid = qbNow();
+        for (size_t r = 0 ; r < theOptions.nReps ; r++) {
+            for (size_t i = 0 ; i < packeds.size() ; i++) {
+                CBlock block;
+                unpackBlock((const uint8_t*)packeds[i].data(), packeds[i].length(), block);  // NOLINT
+            }
+        }
+        double end = qbNow();
+        double mid2 = end;
+        for (size_t r = 0 ; r < theOptions.nReps ; r++) {
+            for (size_t i = 0 ; i < packeds.size() ; i++) {
+                uint32_t counts[2];
+                memcpy(&header, packeds[i].data(), sizeof(header));
+                memcpy(counts, packeds[i].data() + sizeof(header), sizeof(counts));
+                size_t body = sizeof(header) + sizeof(counts) + counts[0] * 20 + counts[1] * 32;
+                string_q raw(header.rawSize, '\0');
+                lz4Decompress((const uint8_t*)packeds[i].data() + body, packeds[i].length() - body,  // NOLINT
+                                (uint8_t*)&raw[0], raw.length(),  // NOLINT
+                                (const uint8_t*)blockDictionaries().get(4)->data.data(),  // NOLINT
+                                blockDictionaries().get(4)->data.length());
+            }
+        }
+        double end2 = qbNow();
+        double mb = double(rawBytes) * theOptions.nReps / 1000000.;
+        cout << "\tcompress:      " << double2Str(mb / (mid - start), 1) << " MB/s\n";
+        cout << "\tdecode+parse:  " << double2Str(mb / (end - mid), 1) << " MB/s\n";
+        cout << "\tdecode only:   " << double2Str(mb / (end2 - mid2), 1) << " MB/s\n";
+    }
+    cleanFolder();
+
+    return true;
+}}
+
+//------------------------------------------------------------------------
+static bool readProjected(CBlock& block, const string_q& fileName, const CFieldProjection *projection) {
+    block = CBlock();
+    return readBlockFromBinary(block, fileName, projection);
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestProjection) {
+
+    CStringArray inputs;
+    string_q contents = asciiFileToString(theOptions.corpus);
+    while (!contents.empty()) {
+        string_q input = nextTokenClear(contents, '\n');
+        if (!input.empty())
+            inputs.push_back(input);
+    }
+    CBlockArray blocks;
+    makeBlocks(inputs, 20, blocks);
+    const CBlock& gold = blocks[1];
+
+    // projections are built from the registered fields (etherlib_init registers them)
+    CBlock::registerClass();
+    CTransaction::registerClass();
+
+    cleanFolder();
+    blockDictionaries().clear();
+    blockDictionaries().folder = folder + "dicts/";
+    ASSERT_TRUE("write packed",       writePackedBlock(gold, folder + "packed.bin"));
+    SFArchive archive(WRITING_ARCHIVE);
+    ASSERT_TRUE("write plain",        archive.Lock(folder + "plain.bin", binaryWriteCreate, LOCK_CREATE));
+    gold.SerializeC(archive);
+    archive.Release();
+
+    const char *files[] = { "plain.bin", "packed.bin" };
+    for (size_t f = 0 ; f < 2 ; f++) {
+        string_q fileName = folder + files[f];
+        cout << "\t" << files[f] << "\n";
+
+        // only the fields the format shows
+        CFieldProjection proj;
+        proj.addFormat(GETRUNTIME_CLASS(CBlock), "[{BLOCKNUMBER}]\t[{w:12:TIMESTAMP}]\t[{p:GASUSED}]");
+        CBlock block;
+        ASSERT_TRUE("read",               readProjected(block, fileName, &proj));
+        ASSERT_TRUE("shown fields",       block.blockNumber == gold.blockNumber && block.timestamp == gold.timestamp &&
+                                            block.gasUsed == gold.gasUsed);
+        ASSERT_TRUE("others skipped",     block.hash.empty() && block.miner.empty() && block.transactions.empty());
+
+        // the last field, with only one field of each transaction, shows the skips kept their place
+        proj.clear();
+        proj.addField(GETRUNTIME_CLASS(CBlock), "transactions");
+        proj.addFormat(GETRUNTIME_CLASS(CTransaction), "[{INPUT}]");
+        ASSERT_TRUE("read",               readProjected(block, fileName, &proj));
+        ASSERT_EQ("transactions",         block.transactions.size(), gold.transactions.size());
+        size_t nSame = 0;
+        for (size_t t = 0 ; t < block.transactions.size() ; t++)
+            nSame += (block.transactions[t].input == gold.transactions[t].input &&
+                        block.transactions[t].hash.empty() && block.transactions[t].receipt.logs.empty());
+        ASSERT_EQ("inputs only",          nSame, gold.transactions.size());
+
+        // a calculated field may need any stored field, as may a format that shows everything
+        proj.clear();
+        proj.addFormat(GETRUNTIME_CLASS(CBlock), "[{DATE}]");
+        ASSERT_TRUE("read",               readProjected(block, fileName, &proj));
+        ASSERT_TRUE("calculated",         block.hash == gold.hash && block.transactions.size() == gold.transactions.size());
+        proj.clear();
+        proj.addFormat(GETRUNTIME_CLASS(CBlock), "");
+        ASSERT_TRUE("read",               readProjected(block, fileName, &proj));
+        ASSERT_TRUE("empty format",       block.hash == gold.hash && block.transactions.size() == gold.transactions.size());
+
+        // getBlock's cache mode: the block's timestamp is always read, because it is copied into
+        // the transactions, which a format showing transactions may print dates for
+        proj.clear();
+        proj.addFormat(GETRUNTIME_CLASS(CBlock), "[{BLOCKNUMBER}]\t[{TRANSACTIONS}]");
+        proj.addField(GETRUNTIME_CLASS(CBlock), "timestamp");
+        ASSERT_TRUE("read",               readProjected(block, fileName, &proj));
+        for (size_t t = 0 ; t < block.transactions.size() ; t++)
+            block.transactions.at(t).timestamp = block.timestamp;
+        ASSERT_TRUE("block timestamp",    block.timestamp == gold.timestamp && !block.transactions.empty());
+        ASSERT_EQ("transaction date",     block.transactions[0].Format("[{DATE}]"), gold.transactions[0].Format("[{DATE}]"));
+    }
+
+    // receipts are only needed by formats that show a field read from them
+    CFieldProjection proj;
+    proj.addFormat(GETRUNTIME_CLASS(CBlock), "[{BLOCKNUMBER}]\t[{DATE}]");
+    ASSERT_TRUE("block fields",       !proj.wantsField(GETRUNTIME_CLASS(CBlock), "transactions") && !needsReceipts(&proj));
+    proj.addField(GETRUNTIME_CLASS(CBlock), "transactions");
+    ASSERT_TRUE("all of transaction", needsReceipts(&proj));
+    proj.addFormat(GETRUNTIME_CLASS(CTransaction), "[{HASH}]\t[{ETHER}]\t[{FUNCTION}]");
+    ASSERT_TRUE("no receipt fields",  !needsReceipts(&proj));
+    proj.addFormat(GETRUNTIME_CLASS(CTransaction), "[{GASUSED}]");
+    ASSERT_TRUE("gasUsed",            needsReceipts(&proj));
+    ASSERT_TRUE("no projection",      needsReceipts(NULL));
+
+    if (theOptions.nReps) {
+        proj.clear();
+        proj.addFormat(GETRUNTIME_CLASS(CBlock), "[{BLOCKNUMBER}]\t[{TIMESTAMP}]\t[{GASUSED}]");
+        for (size_t f = 0 ; f < 2 ; f++) {
+            string_q fileName = folder + files[f];
+            CBlock block;
+            double start = qbNow();
+            for (size_t r = 0 ; r < theOptions.nReps ; r++)
+                readProjected(block, fileName, NULL);
+            double mid = qbNow();
+            for (size_t r = 0 ; r < theOptions.nReps ; r++)
+                readProjected(block, fileName, &proj);
+            double end = qbNow();
+            cout << "\t" << padRight(files[f], 11) << " full: " << double2Str((mid - start) * 1000000. / theOptions.nReps, 1)
+                    << " usecs, projected: " << double2Str((end - mid) * 1000000. / theOptions.nReps, 1) << " usecs\n";
+        }
+    }
+    cleanFolder();
+
+    return true;
+}}
+
+//------------------------------------------------------------------------
+static bool sameBlock(const CBlock& b1, const CBlock& b2) {
+    if (b1.hash != b2.hash || b1.timestamp != b2.timestamp || b1.transactions.size() != b2.transactions.size())
+        return false;
+    for (size_t t = 0 ; t < b1.transactions.size() ; t++) {
+        const CTransaction *t1 = &b1.transactions[t], *t2 = &b2.transactions[t];
+        if (t1->hash != t2->hash || t1->input != t2->input || t1->value != t2->value ||
+                t1->receipt.logs.size() != t2->receipt.logs.size() || t1->pBlock != &b1)
+            return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------
+static bool countVisit(CTransaction& trans, void *data) {
+    *(uint64_t*)data += trans.input.length();  // NOLINT
+    return true;
+}
+
+//------------------------------------------------------------------------
+static bool countLog(CLogEntry& log, void *data) {
+    *(uint64_t*)data += log.topics.size();  // NOLINT
+    return true;
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestReuse) {
+
+    CStringArray inputs;
+    string_q contents = asciiFileToString(theOptions.corpus);
+    while (!contents.empty()) {
+        string_q input = nextTokenClear(contents, '\n');
+        if (!input.empty())
+            inputs.push_back(input);
+    }
+    CBlockArray blocks;
+    makeBlocks(inputs, 20, blocks);
+
+    cleanFolder();
+    blockDictionaries().clear();
+    blockDictionaries().folder = folder + "dicts/";
+    SFArchive archive(WRITING_ARCHIVE);
+    ASSERT_TRUE("write plain",        archive.Lock(folder + "plain.bin", binaryWriteCreate, LOCK_CREATE));
+    blocks[1].SerializeC(archive);
+    archive.Release();
+    ASSERT_TRUE("write packed",       writePackedBlock(blocks[2], folder + "packed.bin"));
+
+    // Read each file a number of times, first into a new block each time, then into one block
+    const char *files[] = { "plain.bin", "packed.bin" };
+    size_t nReads = max(theOptions.nReps, (size_t)10);
+    uint64_t before = nAllocs;
+    for (size_t f = 0 ; f < 2 ; f++) {
+        for (size_t r = 0 ; r < nReads ; r++) {
+            CBlock block;
+            readBlockFromBinary(block, folder + files[f]);
+        }
+    }
+    uint64_t fresh = nAllocs - before;
+
+    CBlock block;
+    before = nAllocs;
+    bool same = true;
+    for (size_t f = 0 ; f < 2 ; f++) {
+        for (size_t r = 0 ; r < nReads ; r++) {
+            block.resetForRead();
+            readBlockFromBinary(block, folder + files[f]);
+            same &= sameBlock(block, blocks[1 + f]);
+        }
+    }
+    uint64_t reused = nAllocs - before;
+    ASSERT_TRUE("reused block reads", same);
+    ASSERT_TRUE("fewer allocations",  reused * 3 < fresh);
+
+    // a smaller block after a larger one drops the extra transactions
+    block.resetForRead();
+    readBlockFromBinary(block, folder + (blocks[1].transactions.size() < blocks[2].transactions.size() ? files[0] : files[1]));
+    ASSERT_EQ("smaller block",        block.transactions.size(), min(blocks[1].transactions.size(), blocks[2].transactions.size()));
+
+    // a reused block read with a projection does not keep the transactions it skips
+    CBlock::registerClass();
+    CFieldProjection proj;
+    proj.addFormat(GETRUNTIME_CLASS(CBlock), "[{BLOCKNUMBER}]");
+    block.resetForRead();
+    readBlockFromBinary(block, folder + files[0], &proj);
+    ASSERT_TRUE("projected",          block.blockNumber == blocks[1].blockNumber && block.transactions.empty());
+
+    // A non-const block is visited in place, a const one through a single reused copy
+    const CBlock& gold = blocks[1];
+    uint64_t nBytes = 0;
+    before = nAllocs;
+    forEveryTransactionInBlock(countVisit, &nBytes, blocks[1]);
+    forEveryLogInBlock(countLog, &nBytes, blocks[1]);
+    uint64_t inPlace = nAllocs - before;
+    before = nAllocs;
+    forEveryTransactionInBlock(countVisit, &nBytes, gold);
+    forEveryLogInBlock(countLog, &nBytes, gold);
+    uint64_t copied = nAllocs - before;
+    ASSERT_EQ("visit in place",       inPlace, 0);
+    ASSERT_TRUE("visit copies",       copied > 0);
+    cleanFolder();
+
+    if (theOptions.nReps) {
+        cout << "\tallocations per read, new block: " << double2Str(double(fresh) / (2 * nReads), 1)
+                << ", reused block: " << double2Str(double(reused) / (2 * nReads), 1) << "\n";
+        cout << "\tallocations visiting a block, in place: " << inPlace << ", copied: " << copied << "\n";
+    }
+
+    return true;
+}}
+
+//------------------------------------------------------------------------
+int main(int argc, const char *argv[]) {
+
+    if (!theOptions.prepareArguments(argc, argv))
+        return 0;
+
+    while (!theOptions.commandList.empty()) {
+        string_q command = nextTokenClear(theOptions.commandList, '\n');
+        if (!theOptions.parseArguments(command))
+            return 0;
+        switch (theOptions.testNum) {
+            case 0: LOAD_TEST(TestCodec);  break;
+            case 1: LOAD_TEST(TestBlocks); break;
+            case 2: LOAD_TEST(TestProjection); break;
+            case 3: LOAD_TEST(TestReuse); break;
+        }
+    }
+
+    return testing::RUN_ALL_TESTS();
+}
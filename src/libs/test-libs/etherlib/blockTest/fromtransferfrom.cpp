@@ -90,8 +90,9 @@ bool QFromTransferFrom::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> whop;
-    archive >> werp;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(QFromTransferFrom), 2);
+    fields >> whop;
+    fields >> werp;
     finishParse();
     return true;
 }
@@ -91,9 +91,10 @@ bool QTransferFrom::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> _from;
-    archive >> _to;
-    archive >> _value;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(QTransferFrom), 3);
+    fields >> _from;
+    fields >> _to;
+    fields >> _value;
     finishParse();
     return true;
 }
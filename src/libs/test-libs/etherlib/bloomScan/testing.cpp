@@ -0,0 +1,233 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <string>
+#include "etherlib.h"
+#include "testing.h"
+
+//------------------------------------------------------------------------
+class CThisTest : public testing::Test {
+public:
+                 CThisTest(void) : Test() {}
+    virtual void SetUp    (void) {}
+    virtual void TearDown (void) {}
+};
+
+//------------------------------------------------------------------------
+// A made up chain of blocks, every tenth of which has a bloom of three bits and every
+// hundredth of which has two
+#define CHAIN_END 250000
+
+//------------------------------------------------------------------------
+static CRawBloom threeBits(uint64_t b1, uint64_t b2, uint64_t b3) {
+    CRawBloom raw;
+    bzero(&raw, sizeof(raw));
+    raw.words[b1 / 64] |= (uint64_t(1) << (b1 % 64));
+    raw.words[b2 / 64] |= (uint64_t(1) << (b2 % 64));
+    raw.words[b3 / 64] |= (uint64_t(1) << (b3 % 64));
+    return raw;
+}
+
+//------------------------------------------------------------------------
+static CRawBloom hashedBloom(uint64_t n) {
+    uint64_t h = (n + 1) * 0x9E3779B97F4A7C15ULL;
+    return threeBits((h >> 7) % 2048, (h >> 23) % 2048, (h >> 41) % 2048);
+}
+
+//------------------------------------------------------------------------
+static size_t nBlooms(blknum_t bn) {
+    return (bn % 100 == 0 ? 2 : (bn % 10 == 0 ? 1 : 0));
+}
+
+//------------------------------------------------------------------------
+// The blooms of a block are ORed from a few of 40 addresses, so each address is in many blocks
+static CRawBloom blockBloom(blknum_t bn, size_t i) {
+    CRawBloom raw;
+    bzero(&raw, sizeof(raw));
+    for (size_t a = 0 ; a < 40 ; a++) {
+        if (((bn / 10 + i) * 2654435761ULL >> (a % 32)) % 7 == 0) {
+            CRawBloom addr = hashedBloom(a);
+            for (size_t w = 0 ; w < 32 ; w++)
+                raw.words[w] |= addr.words[w];
+        }
+    }
+    return raw;
+}
+
+//------------------------------------------------------------------------
+static bool fakeScan(BLOOMVISITFUNC func, void *data, blknum_t start, blknum_t count) {
+    blknum_t stop = (count == NOPOS ? CHAIN_END : min(start + count, (blknum_t)CHAIN_END));
+    for (blknum_t bn = start ; bn < stop ; bn++) {
+        CRawBloom raw[2];
+        size_t n = nBlooms(bn);
+        for (size_t i = 0 ; i < n ; i++)
+            raw[i] = blockBloom(bn, i);
+        if (n && !(*func)(bn, raw, n, data))
+            return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------
+static CRawBloomArray makeQueries(void) {
+    CRawBloomArray queries;
+    for (size_t a = 0 ; a < 50 ; a++)  // the last ten are in no block
+        queries.push_back(hashedBloom(a));
+    return queries;
+}
+
+//------------------------------------------------------------------------
+static vector<CBlockNumArray> bruteForce(const CRawBloomArray& queries, blknum_t start, blknum_t stop) {
+    vector<CBlockNumArray> hits(queries.size());
+    for (blknum_t bn = start ; bn < stop ; bn++) {
+        for (size_t q = 0 ; q < queries.size() ; q++) {
+            for (size_t i = 0 ; i < nBlooms(bn) ; i++) {
+                if (isBloomHit(queries[q], blockBloom(bn, i))) {
+                    hits[q].push_back(bn);
+                    break;
+                }
+            }
+        }
+    }
+    return hits;
+}
+
+//------------------------------------------------------------------------
+static size_t countHits(const vector<CBlockNumArray>& hits) {
+    size_t n = 0;
+    for (size_t q = 0 ; q < hits.size() ; q++)
+        n += hits[q].size();
+    return n;
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestMatch) {
+
+    CRawBloom sparse = threeBits(5, 1000, 2000);
+    CBloomQuery query(sparse);
+    ASSERT_EQ("three words",          query.nWords, 3);
+    ASSERT_TRUE("hits itself",        query.isHit(sparse));
+    ASSERT_FALSE("misses other",      query.isHit(threeBits(5, 1000, 2001)));
+
+    // the blooms of 1,000 blocks laid out as in a segment
+    CRawBloomArray blooms;
+    vector<uint32_t> offsets;
+    for (blknum_t bn = 0 ; bn < 1000 ; bn++) {
+        offsets.push_back((uint32_t)blooms.size());
+        for (size_t i = 0 ; i < nBlooms(bn) ; i++)
+            blooms.push_back(blockBloom(bn, i));
+    }
+    offsets.push_back((uint32_t)blooms.size());
+
+    CRawBloomArray queries = makeQueries();
+    CBloomQueryArray reduced;
+    for (size_t q = 0 ; q < queries.size() ; q++)
+        reduced.push_back(CBloomQuery(queries[q]));
+
+    vector<CBlockNumArray> hits;
+    matchBlooms(reduced, blooms.data(), offsets.data(), 0, 1000, hits);
+    vector<CBlockNumArray> slow = bruteForce(queries, 0, 1000);
+    ASSERT_EQ("one list per query",   hits.size(), queries.size());
+    ASSERT_TRUE("same as one by one", hits == slow);
+    ASSERT_TRUE("found some",         countHits(hits) > 0);
+    ASSERT_TRUE("not everything",     countHits(hits) < queries.size() * 100);
+    ASSERT_TRUE("unused address",     hits[49].empty());
+
+    // part way through, as when a chunk starts inside a segment
+    vector<CBlockNumArray> part;
+    matchBlooms(reduced, blooms.data(), offsets.data() + 250, 250, 500, part);
+    ASSERT_TRUE("a slice",            part == bruteForce(queries, 250, 750));
+
+    return true;
+}}
+
+//------------------------------------------------------------------------
+static string_q folder = "/tmp/bloomScan_test/";
+static void cleanFolder(void) {
+    for (blknum_t bn = 0 ; bn < CHAIN_END ; bn += BLOOM_SEGMENT_SIZE)
+        ::remove(bloomSegmentPath(bn, folder).c_str());
+}
+
+//------------------------------------------------------------------------
+// Blocks that are multiples of 'late' are left out, as if cached after the segment was written
+static bool writeSegment(blknum_t first, blknum_t n, blknum_t late = 0) {
+    vector<CRawBloomArray> blocks(n);
+    for (blknum_t i = 0 ; i < n ; i++) {
+        if (late && (first + i) % late == 0)
+            continue;
+        for (size_t j = 0 ; j < nBlooms(first + i) ; j++)
+            blocks[i].push_back(blockBloom(first + i, j));
+    }
+    return writeBloomSegment(bloomSegmentPath(first, folder), first, blocks);
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestScan) {
+
+    // two full segments and a third that ends early, the rest of the chain is not in a segment
+    cleanFolder();
+    establishFolder(folder);
+    ASSERT_TRUE("first segment",      writeSegment(0, BLOOM_SEGMENT_SIZE));
+    ASSERT_TRUE("second segment",     writeSegment(BLOOM_SEGMENT_SIZE, BLOOM_SEGMENT_SIZE, 1000));
+    ASSERT_TRUE("short segment",      writeSegment(2 * BLOOM_SEGMENT_SIZE, 20000));
+
+    CRawBloomArray queries = makeQueries();
+    vector<CBlockNumArray> slow = bruteForce(queries, 0, CHAIN_END);
+
+    CBloomScanner scanner;
+    scanner.folder = folder;
+    scanner.scanBlooms = fakeScan;
+
+    vector<CBlockNumArray> hits;
+    scanner.nThreads = 1;
+    ASSERT_TRUE("one thread",         scanner.scan(queries, 0, CHAIN_END, hits));
+    ASSERT_TRUE("same as one by one", hits == slow);
+
+    scanner.nThreads = 4;
+    scanner.chunkSize = 7777;  // chunks that straddle the segments
+    ASSERT_TRUE("four threads",       scanner.scan(queries, 0, CHAIN_END, hits));
+    ASSERT_TRUE("still the same",     hits == slow);
+
+    ASSERT_TRUE("in a range",         scanner.scan(queries, 95000, 130000, hits));
+    ASSERT_TRUE("only the range",     hits == bruteForce(queries, 95000, 225000));
+
+    ASSERT_TRUE("late blocks",        scanner.scan(queries, BLOOM_SEGMENT_SIZE, 1001, hits));
+    ASSERT_TRUE("found in files",     hits == bruteForce(queries, BLOOM_SEGMENT_SIZE, BLOOM_SEGMENT_SIZE + 1001));
+
+    ASSERT_TRUE("no queries",         scanner.scan(CRawBloomArray(), 0, CHAIN_END, hits));
+    ASSERT_TRUE("no lists",           hits.empty());
+
+    cout << "\thits: " << countHits(slow) << "\n";
+    cleanFolder();
+    return true;
+}}
+
+#include "options.h"
+//------------------------------------------------------------------------
+int main(int argc, const char *argv[]) {
+
+    COptions options;
+    if (!options.prepareArguments(argc, argv))
+        return 0;
+
+    while (!options.commandList.empty()) {
+        string_q command = nextTokenClear(options.commandList, '\n');
+        if (!options.parseArguments(command))
+            return 0;
+        switch (options.testNum) {
+            case 0: LOAD_TEST(TestMatch); break;
+            case 1: LOAD_TEST(TestScan); break;
+        }
+    }
+
+    return testing::RUN_ALL_TESTS();
+}
@@ -0,0 +1,141 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <string>
+#include "etherlib.h"
+#include "testing.h"
+
+//------------------------------------------------------------------------
+class CThisTest : public testing::Test {
+public:
+                 CThisTest(void) : Test() {}
+    virtual void SetUp    (void) {}
+    virtual void TearDown (void) {}
+};
+
+//------------------------------------------------------------------------
+// three bits each, as an address sets them (makeBloom would ask the node for the hash)
+static SFBloom threeBits(size_t b1, size_t b2, size_t b3) {
+    return (SFBloom(1) << b1) | (SFBloom(1) << b2) | (SFBloom(1) << b3);
+}
+#define bloomA threeBits(3, 700, 1500)
+#define bloomB threeBits(64, 1024, 2047)
+#define bloomC threeBits(3, 800, 1500)
+
+//------------------------------------------------------------------------
+static CRawBloom toRaw(const SFBloom& bloom) {
+    CRawBloom raw;
+    bloomToRaw(bloom, raw);
+    return raw;
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestRaw) {
+
+    SFBloom a = bloomA, b = bloomB;
+    SFBloom both = joinBloom(a, b);
+
+    ASSERT_TRUE("zero",               rawToBloom(toRaw(SFBloom(0))) == 0);
+    ASSERT_TRUE("round trip",         rawToBloom(toRaw(both)) == both);
+    ASSERT_TRUE("top bit",            rawToBloom(toRaw(SFBloom(1) << 2047)) == (SFBloom(1) << 2047));
+    ASSERT_EQ("same bytes",           bloom2Bytes(rawToBloom(toRaw(both))), bloom2Bytes(both));
+
+    ASSERT_TRUE("hit a",              isBloomHit(toRaw(a), toRaw(both)));
+    ASSERT_TRUE("hit b",              isBloomHit(toRaw(b), toRaw(both)));
+    ASSERT_FALSE("miss c",            isBloomHit(toRaw(bloomC), toRaw(both)));
+    ASSERT_EQ("agrees",               isBloomHit(toRaw(bloomC), toRaw(both)),
+                                            isBloomHit(bloomC, both));
+    return true;
+}}
+
+//------------------------------------------------------------------------
+static bool visitBlock(blknum_t bn, const CRawBloom *blooms, size_t nBlooms, void *data) {
+    ostringstream *os = (ostringstream*)data;  // NOLINT
+    *os << "\t" << bn << ": " << nBlooms << " bloom(s)";
+    for (size_t i = 0 ; i < nBlooms ; i++)
+        *os << " " << (isBloomHit(toRaw(bloomA), blooms[i]) ? "A" : "-")
+                   << (isBloomHit(toRaw(bloomB), blooms[i]) ? "B" : "-");
+    *os << "\n";
+    return true;
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestSegment) {
+
+    string_q fileName = "/tmp/bloomSegment_test.seg";
+    ::remove(fileName.c_str());
+
+    // blocks 200000 to 200009: two with blooms, one with two blooms, the rest empty
+    vector<CRawBloomArray> perBlock(10);
+    perBlock[1].push_back(toRaw(bloomA));
+    perBlock[4].push_back(toRaw(bloomB));
+    perBlock[4].push_back(toRaw(joinBloom(bloomA, bloomB)));
+    perBlock[9].push_back(toRaw(bloomC));
+
+    ASSERT_TRUE("write",              writeBloomSegment(fileName, 200000, perBlock));
+    ASSERT_EQ("file size",            fileSize(fileName), 24 + 12 * 4 + 4 * 256);
+
+    CBloomSegment segment;
+    ASSERT_TRUE("open",               segment.open(fileName));
+    ASSERT_EQ("first block",          segment.firstBlock(), 200000);
+    ASSERT_EQ("blocks",               segment.nBlocks(), 10);
+    ASSERT_EQ("blooms",               segment.nBlooms(), 4);
+    ASSERT_TRUE("covers first",       segment.covers(200000));
+    ASSERT_TRUE("covers last",        segment.covers(200009));
+    ASSERT_FALSE("before",            segment.covers(199999));
+    ASSERT_FALSE("after",             segment.covers(200010));
+
+    const CRawBloom *blooms;
+    ASSERT_EQ("empty block",          segment.getBlooms(200000, blooms), 0);
+    ASSERT_EQ("one bloom",            segment.getBlooms(200001, blooms), 1);
+    ASSERT_TRUE("same bloom",         rawToBloom(blooms[0]) == bloomA);
+    ASSERT_EQ("two blooms",           segment.getBlooms(200004, blooms), 2);
+    ASSERT_TRUE("second bloom",       rawToBloom(blooms[1]) == joinBloom(bloomA, bloomB));
+    ASSERT_EQ("not covered",          segment.getBlooms(300000, blooms), 0);
+
+    ostringstream all, part;
+    ASSERT_TRUE("visit all",          segment.forEveryBlock(visitBlock, &all, 0, NOPOS));
+    ASSERT_TRUE("visit part",         segment.forEveryBlock(visitBlock, &part, 200002, 200009));
+    cout << "\tall:\n" << all.str() << "\tpart:\n" << part.str();
+    segment.close();
+
+    // a damaged segment is ignored
+    string_q contents = binaryFileToString(fileName);
+    stringToAsciiFile(fileName, extract(contents, 0, contents.length() - 8));
+    CBloomSegment damaged;
+    ASSERT_FALSE("truncated",         damaged.open(fileName));
+    ASSERT_FALSE("covers nothing",    damaged.covers(200001));
+
+    ::remove(fileName.c_str());
+    return true;
+}}
+
+#include "options.h"
+//------------------------------------------------------------------------
+int main(int argc, const char *argv[]) {
+
+    COptions options;
+    if (!options.prepareArguments(argc, argv))
+        return 0;
+
+    while (!options.commandList.empty()) {
+        string_q command = nextTokenClear(options.commandList, '\n');
+        if (!options.parseArguments(command))
+            return 0;
+        switch (options.testNum) {
+            case 0: LOAD_TEST(TestRaw); break;
+            case 1: LOAD_TEST(TestSegment); break;
+        }
+    }
+
+    return testing::RUN_ALL_TESTS();
+}
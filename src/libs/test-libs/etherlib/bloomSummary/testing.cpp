@@ -0,0 +1,217 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <string>
+#include "etherlib.h"
+#include "testing.h"
+
+//------------------------------------------------------------------------
+class CThisTest : public testing::Test {
+public:
+                 CThisTest(void) : Test() {}
+    virtual void SetUp    (void) {}
+    virtual void TearDown (void) {}
+};
+
+//------------------------------------------------------------------------
+// A made up chain of 250,000 blocks, each with one bloom of three bits. The address we search
+// for is in two of them.
+#define CHAIN_END 250000
+static blknum_t nRead = 0;
+
+//------------------------------------------------------------------------
+static CRawBloom threeBits(uint64_t b1, uint64_t b2, uint64_t b3) {
+    CRawBloom raw;
+    bzero(&raw, sizeof(raw));
+    raw.words[b1 / 64] |= (uint64_t(1) << (b1 % 64));
+    raw.words[b2 / 64] |= (uint64_t(1) << (b2 % 64));
+    raw.words[b3 / 64] |= (uint64_t(1) << (b3 % 64));
+    return raw;
+}
+#define rareAddr threeBits(5, 1000, 2000)
+
+//------------------------------------------------------------------------
+static CRawBloom blockBloom(blknum_t bn) {
+    uint64_t h = (bn + 1) * 0x9E3779B97F4A7C15ULL;
+    CRawBloom raw = threeBits((h >> 7) % 2048, (h >> 23) % 2048, (h >> 41) % 2048);
+    if (bn == 123456 || bn == 200001) {
+        CRawBloom addr = rareAddr;
+        for (size_t w = 0 ; w < 32 ; w++)
+            raw.words[w] |= addr.words[w];
+    }
+    return raw;
+}
+
+//------------------------------------------------------------------------
+static bool fakeScan(BLOOMVISITFUNC func, void *data, blknum_t start, blknum_t count) {
+    blknum_t stop = (count == NOPOS ? CHAIN_END : min(start + count, (blknum_t)CHAIN_END));
+    for (blknum_t bn = start ; bn < stop ; bn++) {
+        CRawBloom raw = blockBloom(bn);
+        nRead++;
+        if (!(*func)(bn, &raw, 1, data))
+            return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------
+static bool addHit(blknum_t bn, const CRawBloom *blooms, size_t nBlooms, void *data) {
+    CStringArray *hits = (CStringArray*)data;  // NOLINT
+    hits->push_back(asStringU(bn));
+    return true;
+}
+
+//------------------------------------------------------------------------
+static string_q search(CBloomSummary& summary, blknum_t start, blknum_t count) {
+    CStringArray hits;
+    summary.nTested = summary.nSkipped = 0;
+    summary.forEveryHit(rareAddr, addHit, &hits, start, count);
+    string_q ret;
+    for (size_t i = 0 ; i < hits.size() ; i++)
+        ret += (i ? " " : "") + hits[i];
+    return ret;
+}
+
+//------------------------------------------------------------------------
+static string_q folder = "/tmp/bloomSummary_test/";
+static void cleanFolder(void) {
+    for (size_t i = 0 ; i < BLOOM_SUMMARY_LEVELS ; i++)
+        ::remove((folder + "summary." + asStringU(summarySpans[i]) + ".seg").c_str());
+    ::remove((folder + "telemetry.toml").c_str());
+    ::remove((folder + "summary.toml").c_str());
+    ::remove((folder + "tuning.toml").c_str());
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestSearch) {
+
+    CRawBloomArray packed;
+    CRawBloom blooms[3] = { threeBits(1, 2, 3), threeBits(4, 5, 6), threeBits(1, 2, 7) };
+    packBlooms(blooms, 3, packed, 6);
+    ASSERT_EQ("packed in two",        packed.size(), 2);
+    ASSERT_EQ("first full",           bitsTwiddled(packed[0]), 6);
+    ASSERT_TRUE("nothing lost",       isBloomHit(blooms[2], packed[1]));
+
+    cleanFolder();
+    CBloomSummary summary;
+    summary.scanBlooms = fakeScan;
+    ASSERT_FALSE("nothing yet",       summary.open(folder));
+    ASSERT_TRUE("build",              summary.update(CHAIN_END - 1));
+    ASSERT_EQ("level 0",              summary.nNodes(0), 2500);
+    ASSERT_EQ("level 1",              summary.nNodes(1), 25);
+    ASSERT_EQ("level 2",              summary.nNodes(2), 1);
+    ASSERT_EQ("covered",              summary.nCovered(), CHAIN_END);
+
+    nRead = 0;
+    string_q hits = search(summary, 0, NOPOS);
+    ASSERT_TRUE("found first",        contains(hits, "123456"));
+    ASSERT_TRUE("found second",       contains(hits, "200001"));
+    ASSERT_TRUE("few blocks read",    nRead < CHAIN_END / 50);
+    ASSERT_EQ("all accounted for",    summary.nTested + summary.nSkipped, CHAIN_END);
+
+    ASSERT_TRUE("in a range",         contains(search(summary, 150000, 100000), "200001"));
+    ASSERT_FALSE("not before",        contains(search(summary, 150000, 100000), "123456"));
+    ASSERT_EQ("single block",         search(summary, 200001, 1), "200001");
+
+    // a summary does not miss what the per-block blooms would find
+    CStringArray slow;
+    CRawBloom query = rareAddr;
+    for (blknum_t bn = 0 ; bn < CHAIN_END ; bn++) {
+        CRawBloom raw = blockBloom(bn);
+        if (isBloomHit(query, raw))
+            slow.push_back(asStringU(bn));
+    }
+    string_q slowHits;
+    for (size_t i = 0 ; i < slow.size() ; i++)
+        slowHits += (i ? " " : "") + slow[i];
+    ASSERT_EQ("same as a full scan",  hits, slowHits);
+    cout << "\thits: " << hits << "\n";
+
+    cleanFolder();
+    return true;
+}}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestUpdate) {
+
+    cleanFolder();
+    CStringArray whole;
+    {
+        CBloomSummary summary;
+        summary.scanBlooms = fakeScan;
+        summary.open(folder);
+        ASSERT_TRUE("build at once",  summary.update(CHAIN_END - 1));
+        for (size_t i = 0 ; i < BLOOM_SUMMARY_LEVELS ; i++)
+            whole.push_back(binaryFileToString(folder + "summary." + asStringU(summarySpans[i]) + ".seg"));
+    }
+    cleanFolder();
+
+    // built in three steps, the first two ending part way through a summary
+    CBloomSummary summary;
+    summary.scanBlooms = fakeScan;
+    summary.open(folder);
+    ASSERT_TRUE("first part",         summary.update(123456));
+    ASSERT_EQ("partly covered",       summary.nCovered(), 123457);
+    ASSERT_TRUE("second part",        summary.update(199999));
+    nRead = 0;
+    ASSERT_TRUE("third part",         summary.update(CHAIN_END - 1));
+    ASSERT_EQ("only new blocks read", nRead, CHAIN_END - 199900);
+    for (size_t i = 0 ; i < BLOOM_SUMMARY_LEVELS ; i++)
+        ASSERT_TRUE("same file",      binaryFileToString(folder + "summary." + asStringU(summarySpans[i]) + ".seg") == whole[i]);
+
+    // blocks past the summaries are still searched
+    CBloomSummary partial;
+    partial.scanBlooms = fakeScan;
+    cleanFolder();
+    partial.open(folder);
+    ASSERT_TRUE("partial",            partial.update(150000));
+    ASSERT_TRUE("found past the end", contains(search(partial, 0, NOPOS), "200001"));
+    ASSERT_TRUE("found inside",       contains(search(partial, 0, NOPOS), "123456"));
+
+    // a block after the last one summarized is searched even if its entry exists
+    cleanFolder();
+    partial.open(folder);
+    ASSERT_TRUE("short entry",        partial.update(123410));
+    ASSERT_EQ("to the block",         partial.nCovered(), 123411);
+    ASSERT_TRUE("found in the entry", contains(search(partial, 0, NOPOS), "123456"));
+    CBloomSummary reopened;
+    reopened.scanBlooms = fakeScan;
+    reopened.open(folder);
+    ASSERT_EQ("kept",                 reopened.nCovered(), 123411);
+    ::remove((folder + "summary.toml").c_str());
+    reopened.open(folder);
+    ASSERT_EQ("whole entries only",   reopened.nCovered(), 123400);
+
+    cleanFolder();
+    return true;
+}}
+
+#include "options.h"
+//------------------------------------------------------------------------
+int main(int argc, const char *argv[]) {
+
+    COptions options;
+    if (!options.prepareArguments(argc, argv))
+        return 0;
+
+    while (!options.commandList.empty()) {
+        string_q command = nextTokenClear(options.commandList, '\n');
+        if (!options.parseArguments(command))
+            return 0;
+        switch (options.testNum) {
+            case 0: LOAD_TEST(TestSearch); break;
+            case 1: LOAD_TEST(TestUpdate); break;
+        }
+    }
+
+    return testing::RUN_ALL_TESTS();
+}
@@ -0,0 +1,259 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <string>
+#include "etherlib.h"
+#include "testing.h"
+
+//------------------------------------------------------------------------
+class CThisTest : public testing::Test {
+public:
+                 CThisTest(void) : Test() {}
+    virtual void SetUp    (void) {}
+    virtual void TearDown (void) {}
+};
+
+//------------------------------------------------------------------------
+// A made up chain of 250,000 blocks. Blocks before 200,000 have one bloom of three bits, the
+// ones after it a bloom holding a dozen addresses. The address we search for is in two blocks.
+#define CHAIN_END 250000
+#define BUSY_FROM 200000
+
+//------------------------------------------------------------------------
+static CRawBloom threeBits(uint64_t b1, uint64_t b2, uint64_t b3) {
+    CRawBloom raw;
+    bzero(&raw, sizeof(raw));
+    raw.words[b1 / 64] |= (uint64_t(1) << (b1 % 64));
+    raw.words[b2 / 64] |= (uint64_t(1) << (b2 % 64));
+    raw.words[b3 / 64] |= (uint64_t(1) << (b3 % 64));
+    return raw;
+}
+#define rareAddr threeBits(5, 1000, 2000)
+
+//------------------------------------------------------------------------
+static CRawBloom hashedBloom(uint64_t n) {
+    uint64_t h = (n + 1) * 0x9E3779B97F4A7C15ULL;
+    return threeBits((h >> 7) % 2048, (h >> 23) % 2048, (h >> 41) % 2048);
+}
+
+//------------------------------------------------------------------------
+static void orInto(CRawBloom& to, const CRawBloom& from) {
+    for (size_t w = 0 ; w < 32 ; w++)
+        to.words[w] |= from.words[w];
+}
+
+//------------------------------------------------------------------------
+static CRawBloom blockBloom(blknum_t bn) {
+    CRawBloom raw = hashedBloom(bn);
+    if (bn >= BUSY_FROM)
+        for (uint64_t i = 1 ; i < 12 ; i++)
+            orInto(raw, hashedBloom(bn * 12 + i));
+    if (bn == 123456 || bn == 200001)
+        orInto(raw, rareAddr);
+    return raw;
+}
+
+//------------------------------------------------------------------------
+static bool fakeScan(BLOOMVISITFUNC func, void *data, blknum_t start, blknum_t count) {
+    blknum_t stop = (count == NOPOS ? CHAIN_END : min(start + count, (blknum_t)CHAIN_END));
+    for (blknum_t bn = start ; bn < stop ; bn++) {
+        CRawBloom raw = blockBloom(bn);
+        if (!(*func)(bn, &raw, 1, data))
+            return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestModel) {
+
+    ASSERT_EQ("empty",                densityBand(0, 100), 0);
+    ASSERT_EQ("busy",                 densityBand(3200, 100), 1);
+    ASSERT_EQ("busiest",              densityBand(100000, 100), BLOOM_BANDS - 1);
+    ASSERT_EQ("no blocks",            densityBand(100, 0), 0);
+
+    CRawBloom half;
+    bzero(&half, sizeof(half));
+    for (size_t w = 0 ; w < 16 ; w++)
+        half.words[w] = ~uint64_t(0);
+    ASSERT_TRUE("nothing to match",   falseMatchChance(&half, 0) == 0.);
+    ASSERT_TRUE("one in eight",       falseMatchChance(&half, 1) == .125);
+    CRawBloom two[2] = { half, half };
+    ASSERT_TRUE("either one",         falseMatchChance(two, 2) == 1. - .875 * .875);
+
+    // a quiet and a busy stretch of 100 blocks
+    CRawBloom quiet[100], busy[100];
+    for (blknum_t bn = 0 ; bn < 100 ; bn++) {
+        quiet[bn] = blockBloom(bn);
+        busy[bn] = blockBloom(BUSY_FROM + bn);
+    }
+    CBloomTelemetry telemetry;
+    telemetry.bands[0].add(quiet, 100);
+    telemetry.bands[1].add(busy, 100);
+    ASSERT_EQ("one entry",            telemetry.bands[0].nNodes, 1);
+    ASSERT_EQ("packs in one",         telemetry.bands[0].nPacked[BLOOM_CANDIDATES - 1], 1);
+    ASSERT_TRUE("but not when small", telemetry.bands[0].nPacked[0] > 1);
+
+    CBloomTuning tuning;
+    tuneBlooms(telemetry, tuning);
+    ASSERT_TRUE("no correction",      tuning.correction == 1.);
+    ASSERT_TRUE("quiet packs once",   tuning.nBlooms[0] == 1.);
+    ASSERT_EQ("unsampled untouched",  tuning.maxBits[2], 512);
+    for (size_t b = 0 ; b < 2 ; b++) {
+        cout << "\tband " << b << ": maxBits " << tuning.maxBits[b] << " blooms " << tuning.nBlooms[b] << "\n";
+        for (size_t c = 0 ; c < BLOOM_CANDIDATES ; c++) {
+            const CBloomBandSample& band = telemetry.bands[b];
+            double cost = (double(band.nPacked[c]) + min(1., band.expected[c]) * band.nBlooms) * sizeof(CRawBloom);
+            ASSERT_TRUE("the cheapest",   tuning.cost[b] <= cost);
+        }
+    }
+
+    // searches that found four times the false hits the model expected favor smaller blooms
+    telemetry.ranges[0].nFalse = 80;
+    telemetry.ranges[0].expected = 20.;
+    CBloomTuning measured;
+    tuneBlooms(telemetry, measured);
+    ASSERT_TRUE("corrected",          measured.correction == 4.);
+    ASSERT_TRUE("smaller blooms",     measured.maxBits[1] <= tuning.maxBits[1]);
+    ASSERT_TRUE("costs more",         measured.cost[1] > tuning.cost[1]);
+    cout << "\tcorrected: maxBits " << measured.maxBits[1] << " blooms " << measured.nBlooms[1] << "\n";
+
+    string_q fileName = "/tmp/bloomTune_test/model.toml";
+    ASSERT_TRUE("saved",              measured.save(fileName));
+    CBloomTuning loaded;
+    ASSERT_TRUE("loaded",             loaded.load(fileName));
+    ASSERT_EQ("same maxBits",         loaded.maxBits[1], measured.maxBits[1]);
+    ASSERT_TRUE("same correction",    loaded.correction == 4.);
+    ::remove(fileName.c_str());
+
+    return true;
+}}
+
+//------------------------------------------------------------------------
+static string_q folder = "/tmp/bloomTune_test/";
+static void cleanFolder(void) {
+    for (size_t i = 0 ; i < BLOOM_SUMMARY_LEVELS ; i++)
+        ::remove((folder + "summary." + asStringU(summarySpans[i]) + ".seg").c_str());
+    ::remove((folder + "telemetry.toml").c_str());
+    ::remove((folder + "summary.toml").c_str());
+    ::remove((folder + "tuning.toml").c_str());
+}
+
+//------------------------------------------------------------------------
+static bool addHit(blknum_t bn, const CRawBloom *blooms, size_t nBlooms, void *data) {
+    CBlockNumArray *hits = (CBlockNumArray*)data;  // NOLINT
+    hits->push_back(bn);
+    return true;
+}
+
+//------------------------------------------------------------------------
+static CBloomRangeStats totals(const CBloomTelemetry& telemetry) {
+    CBloomRangeStats ret;
+    for (map<blknum_t, CBloomRangeStats>::const_iterator it = telemetry.ranges.begin() ;
+            it != telemetry.ranges.end() ; ++it) {
+        ret.nTested     += it->second.nTested;
+        ret.nTrue       += it->second.nTrue;
+        ret.nFalse      += it->second.nFalse;
+        ret.expected    += it->second.expected;
+        ret.nBlockHits  += it->second.nBlockHits;
+        ret.nBlockFalse += it->second.nBlockFalse;
+    }
+    return ret;
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestTelemetry) {
+
+    // entries are sampled once, even when built a piece at a time
+    cleanFolder();
+    uint64_t nPacked = 0;
+    {
+        CBloomSummary summary;
+        summary.scanBlooms = fakeScan;
+        summary.open(folder);
+        ASSERT_TRUE("build",          summary.update(CHAIN_END - 1));
+        ASSERT_EQ("all sampled",      summary.telemetry.sampledTo, CHAIN_END / 100);
+        ASSERT_EQ("quiet entries",    summary.telemetry.bands[0].nNodes, BUSY_FROM / 100);
+        ASSERT_EQ("busy entries",     summary.telemetry.bands[1].nNodes, (CHAIN_END - BUSY_FROM) / 100);
+        nPacked = summary.telemetry.bands[1].nPacked[0];
+    }
+    cleanFolder();
+
+    CBloomSummary summary;
+    summary.scanBlooms = fakeScan;
+    summary.open(folder);
+    ASSERT_TRUE("first part",         summary.update(123456));
+    ASSERT_EQ("complete ones",        summary.telemetry.sampledTo, 1234);
+    ASSERT_TRUE("second part",        summary.update(CHAIN_END - 1));
+    ASSERT_EQ("no repeats",           summary.telemetry.bands[0].nNodes, BUSY_FROM / 100);
+    ASSERT_EQ("same packing",         summary.telemetry.bands[1].nPacked[0], nPacked);
+
+    // searching counts the true and false hits of each range
+    CBlockNumArray hits;
+    summary.forEveryHit(rareAddr, addHit, &hits, 0, NOPOS);
+    ASSERT_EQ("found both",           hits.size(), 2);
+    CBloomRangeStats all = totals(summary.telemetry);
+    ASSERT_EQ("two true hits",        all.nTrue, 2);
+    ASSERT_EQ("two blocks",           all.nBlockHits, 2);
+    ASSERT_TRUE("something tested",   all.nTested > 0);
+    ASSERT_TRUE("per range",          summary.telemetry.ranges[100000].nTrue == 1);
+    ASSERT_TRUE("a prediction",       all.expected > 0.);
+    summary.telemetry.confirmHit(123456, false);
+    ASSERT_EQ("confirmed false",      summary.telemetry.ranges[100000].nBlockFalse, 1);
+    cout << "\ttested: " << all.nTested << " true: " << all.nTrue << " false: " << all.nFalse << "\n";
+
+    // the counts and the tuning are kept with the summaries
+    ASSERT_TRUE("tuned",              summary.tune());
+    ASSERT_TRUE("saved",              fileExists(folder + "tuning.toml"));
+    CBloomSummary reopened;
+    reopened.scanBlooms = fakeScan;
+    reopened.open(folder);
+    ASSERT_EQ("tested kept",          totals(reopened.telemetry).nTested, all.nTested);
+    ASSERT_EQ("confirmed kept",       totals(reopened.telemetry).nBlockFalse, 1);
+    ASSERT_EQ("samples kept",         reopened.telemetry.bands[1].nPacked[0], nPacked);
+    for (size_t b = 0 ; b < BLOOM_BANDS ; b++)
+        ASSERT_EQ("tuning kept",      reopened.tuning.maxBits[b], summary.tuning.maxBits[b]);
+    cout << "\tquiet: " << reopened.tuning.maxBits[0] << " busy: " << reopened.tuning.maxBits[1] << "\n";
+
+    // a summary built with the tuning still finds everything
+    for (size_t i = 0 ; i < BLOOM_SUMMARY_LEVELS ; i++)
+        ::remove((folder + "summary." + asStringU(summarySpans[i]) + ".seg").c_str());
+    reopened.open(folder);
+    ASSERT_TRUE("rebuilt",            reopened.update(CHAIN_END - 1));
+    hits.clear();
+    reopened.forEveryHit(rareAddr, addHit, &hits, 0, NOPOS);
+    ASSERT_EQ("still both",           hits.size(), 2);
+
+    cleanFolder();
+    return true;
+}}
+
+#include "options.h"
+//------------------------------------------------------------------------
+int main(int argc, const char *argv[]) {
+
+    COptions options;
+    if (!options.prepareArguments(argc, argv))
+        return 0;
+
+    while (!options.commandList.empty()) {
+        string_q command = nextTokenClear(options.commandList, '\n');
+        if (!options.parseArguments(command))
+            return 0;
+        switch (options.testNum) {
+            case 0: LOAD_TEST(TestModel); break;
+            case 1: LOAD_TEST(TestTelemetry); break;
+        }
+    }
+
+    return testing::RUN_ALL_TESTS();
+}
@@ -139,17 +139,18 @@ bool CNewBlock::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> gasLimit;
-    archive >> gasUsed;
-    archive >> hash;
-    archive >> blockNumber;
-    archive >> parentHash;
-    archive >> miner;
-    archive >> difficulty;
-    archive >> price;
-    archive >> finalized;
-    archive >> timestamp;
-    archive >> transactions;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(CNewBlock), 11);
+    fields >> gasLimit;
+    fields >> gasUsed;
+    fields >> hash;
+    fields >> blockNumber;
+    fields >> parentHash;
+    fields >> miner;
+    fields >> difficulty;
+    fields >> price;
+    fields >> finalized;
+    fields >> timestamp;
+    fields >> transactions;
     finishParse();
     return true;
 }
@@ -106,11 +106,12 @@ bool CNewReceipt::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> contractAddress;
-    archive >> gasUsed;
-    archive >> logs;
-    archive >> logsBloom;
-    archive >> isError;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(CNewReceipt), 5);
+    fields >> contractAddress;
+    fields >> gasUsed;
+    fields >> logs;
+    fields >> logsBloom;
+    fields >> isError;
     finishParse();
     return true;
 }
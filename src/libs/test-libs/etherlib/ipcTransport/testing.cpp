@@ -0,0 +1,210 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "etherlib.h"
+#include "testing.h"
+
+//------------------------------------------------------------------------
+class CThisTest : public testing::Test {
+public:
+                 CThisTest(void) : Test() {}
+    virtual void SetUp    (void) {}
+    virtual void TearDown (void) {}
+};
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestFraming) {
+
+    string_q two = " {\"a\":[1,2],\"b\":\"}]\\\"{\"}\n[{\"id\":3}]";
+    size_t end = jsonValueEnd(two, 0);
+    ASSERT_EQ("first value",          extract(two, 0, end), " {\"a\":[1,2],\"b\":\"}]\\\"{\"}");
+    ASSERT_EQ("second value",         extract(two, end, jsonValueEnd(two, end) - end), "\n[{\"id\":3}]");
+    ASSERT_EQ("incomplete",           jsonValueEnd("{\"result\":[1,2", 0), NOPOS);
+    ASSERT_EQ("empty",                jsonValueEnd("  \n", 0), NOPOS);
+
+    ASSERT_EQ("number id",            jsonRpcId("{\"jsonrpc\":\"2.0\",\"id\":12,\"result\":\"0x1\"}"), 12);
+    ASSERT_EQ("quoted id",            jsonRpcId("{\"jsonrpc\":\"2.0\",\"method\":\"x\",\"id\":\"7\"}"), 7);
+    ASSERT_EQ("nested id ignored",    jsonRpcId("{\"result\":{\"id\":99},\"id\": 4}"), 4);
+    ASSERT_EQ("id in a string",       jsonRpcId("{\"result\":\"\\\"id\\\":5\",\"id\":6}"), 6);
+    ASSERT_EQ("no id",                jsonRpcId("{\"result\":\"0x1\"}"), 0);
+
+    return true;
+}}
+
+//------------------------------------------------------------------------
+// A stand in for the node. It answers each batch of requests in reverse order (as a node
+// may), puts the id last and sends each response in two pieces. The last two batches are
+// answered as they arrive with large responses, so a client that only wrote would block
+// forever. The last one's requests alone are more than the socket buffers hold.
+static const size_t nBatches = 4;
+static const size_t batchSizes[nBatches] = { 1, 5, 400, 2000 };
+
+//------------------------------------------------------------------------
+static string_q fakeResponse(uint64_t id, size_t padding) {
+    return "{\"jsonrpc\":\"2.0\",\"result\":{\"id\":\"999\",\"echo\":\"" + asStringU(id) + "\",\"pad\":\"" +
+                string_q(padding, '0') + "\"},\"id\":" + asStringU(id) + "}\n";
+}
+
+//------------------------------------------------------------------------
+static void sendAll(int fd, const string_q& str) {
+    size_t sent = 0;
+    while (sent < str.length()) {
+        ssize_t n = write(fd, str.c_str() + sent, str.length() - sent);
+        if (n <= 0)
+            return;
+        sent += (size_t)n;
+    }
+}
+
+//------------------------------------------------------------------------
+static void runFakeNode(int listener) {
+    int conn = accept(listener, NULL, NULL);
+    string_q pending;
+    for (size_t b = 0 ; b < nBatches ; b++) {
+        vector<uint64_t> ids;
+        size_t nSeen = 0;
+        while (nSeen < batchSizes[b]) {
+            size_t end = jsonValueEnd(pending, 0);
+            if (end == NOPOS) {
+                char buff[4096];
+                ssize_t n = read(conn, buff, sizeof(buff));
+                if (n <= 0)
+                    return;
+                pending.append(buff, (size_t)n);
+                continue;
+            }
+            uint64_t id = jsonRpcId(pending.substr(0, end));
+            pending.erase(0, end);
+            nSeen++;
+            if (b >= nBatches - 2)
+                sendAll(conn, fakeResponse(id, 16000));
+            else
+                ids.push_back(id);
+        }
+        for (size_t i = ids.size() ; i > 0 ; i--) {
+            string_q resp = fakeResponse(ids[i-1], 10);
+            sendAll(conn, extract(resp, 0, 20));
+            usleep(1000);
+            sendAll(conn, extract(resp, 20));
+        }
+    }
+    close(conn);
+}
+
+//------------------------------------------------------------------------
+static string_q makeRequest(size_t id, size_t padding = 0) {
+    string_q params = (padding ? "\"" + string_q(padding, '0') + "\"" : "");
+    return "{\"jsonrpc\":\"2.0\",\"method\":\"eth_blockNumber\",\"params\":[" + params + "],\"id\":\"" +
+                asStringU(id) + "\"}";
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestPipeline) {
+
+    string_q path = "/tmp/ipcTransport_test.ipc";
+    ::remove(path.c_str());
+
+    CIpcConnection ipc;
+    ASSERT_FALSE("no node",           ipc.open(path));
+    ASSERT_FALSE("not open",          ipc.isOpen());
+
+    struct sockaddr_un addr;
+    bzero(&addr, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    bind(listener, (struct sockaddr*)&addr, sizeof(addr));
+    listen(listener, 1);
+    cout.flush();
+    pid_t node = fork();
+    if (node == 0) {
+        runFakeNode(listener);
+        _exit(0);
+    }
+    close(listener);
+
+    ASSERT_TRUE("open",               ipc.open(path));
+
+    string_q response;
+    ASSERT_TRUE("call",               ipc.call(makeRequest(1), response));
+    ASSERT_EQ("call id",              jsonRpcId(response), 1);
+    cout << "\t" << extract(response, 0, 70) << "\n";
+
+    CStringArray requests, responses;
+    for (size_t i = 0 ; i < batchSizes[1] ; i++)
+        requests.push_back(makeRequest(10 + i));
+    ASSERT_TRUE("pipeline",           ipc.pipeline(requests, responses));
+    bool inOrder = (responses.size() == requests.size());
+    for (size_t i = 0 ; i < responses.size() ; i++) {
+        inOrder = inOrder && (jsonRpcId(responses[i]) == 10 + i);
+        cout << "\t" << extract(responses[i], 0, 70) << "\n";
+    }
+    ASSERT_TRUE("paired by id",       inOrder);
+
+    requests.clear();
+    for (size_t i = 0 ; i < batchSizes[2] ; i++)
+        requests.push_back(makeRequest(1000 + i));
+    ASSERT_TRUE("large pipeline",     ipc.pipeline(requests, responses));
+    bool allThere = (responses.size() == requests.size());
+    for (size_t i = 0 ; i < responses.size() ; i++)
+        allThere = allThere && (jsonRpcId(responses[i]) == 1000 + i) && responses[i].length() > 16000;
+    ASSERT_TRUE("all responses",      allThere);
+
+    // the requests do not fit in the socket, so they are written while responses are read
+    requests.clear();
+    for (size_t i = 0 ; i < batchSizes[3] ; i++)
+        requests.push_back(makeRequest(5000 + i, 1000));
+    ASSERT_TRUE("larger than buffers", ipc.pipeline(requests, responses));
+    allThere = (responses.size() == requests.size());
+    for (size_t i = 0 ; i < responses.size() ; i++)
+        allThere = allThere && (jsonRpcId(responses[i]) == 5000 + i) && responses[i].length() > 16000;
+    ASSERT_TRUE("every response",     allThere);
+
+    // repeated ids cannot be paired
+    requests.clear();
+    requests.push_back(makeRequest(5));
+    requests.push_back(makeRequest(5));
+    ASSERT_FALSE("repeated ids",      ipc.pipeline(requests, responses));
+
+    int status = 0;
+    waitpid(node, &status, 0);
+    ASSERT_FALSE("node went away",    ipc.call(makeRequest(2), response));
+    ASSERT_FALSE("closed",            ipc.isOpen());
+
+    ::remove(path.c_str());
+    return true;
+}}
+
+#include "options.h"
+//------------------------------------------------------------------------
+int main(int argc, const char *argv[]) {
+
+    COptions options;
+    if (!options.prepareArguments(argc, argv))
+        return 0;
+
+    while (!options.commandList.empty()) {
+        string_q command = nextTokenClear(options.commandList, '\n');
+        if (!options.parseArguments(command))
+            return 0;
+        switch (options.testNum) {
+            case 0: LOAD_TEST(TestFraming); break;
+            case 1: LOAD_TEST(TestPipeline); break;
+        }
+    }
+
+    return testing::RUN_ALL_TESTS();
+}
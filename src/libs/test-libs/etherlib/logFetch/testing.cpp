@@ -0,0 +1,325 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <string>
+#include "etherlib.h"
+#include "logfetch.h"
+#include "testing.h"
+
+//------------------------------------------------------------------------
+class CThisTest : public testing::Test {
+public:
+                 CThisTest(void) : Test() {}
+    virtual void SetUp    (void) {}
+    virtual void TearDown (void) {}
+};
+
+//------------------------------------------------------------------------
+// A busy contract: block 'bn' has this many logs
+static size_t nLogsAt(blknum_t bn) {
+    if (bn % 100 == 0)
+        return 400;
+    return (bn % 3 == 0 ? 1 : 0);
+}
+
+//------------------------------------------------------------------------
+static string_q fakeLog(blknum_t bn, size_t i) {
+    return "{\"address\":\"0xbb9bc244d798123fde783fcc1c72d3bb8c189413\",\"topics\":"
+            "[\"0xddf252ad1be2c89b69c2b068fc378daa952ba7f163c4a11628f55a4df523b3ef\"],"
+            "\"data\":\"0x" + padLeft(asStringU(i), 64, '0') + "\",\"blockNumber\":\"" + toHex(bn) + "\","
+            "\"transactionHash\":\"0x" + padLeft(asStringU(bn), 64, '0') + "\",\"transactionIndex\":\"0x0\","
+            "\"logIndex\":\"" + toHex(i) + "\",\"removed\":false}";
+}
+
+//------------------------------------------------------------------------
+static blknum_t paramValue(const string_q& params, const string_q& name) {
+    string_q rest = extract(params, params.find("\"" + name + "\":\"") + name.length() + 4);
+    return toUnsigned(nextTokenClear(rest, '"'));
+}
+
+//------------------------------------------------------------------------
+// Stands in for callRPCMany. Like most nodes it refuses to return more than 3,000 logs.
+static size_t nRefused = 0;
+static bool fakeNode(const CRPCRequestArray& requests, CStringArray& results, bool raw) {
+    results.clear();
+    for (size_t r = 0 ; r < requests.size() ; r++) {
+        blknum_t first = paramValue(requests[r].params, "fromBlock");
+        blknum_t last  = paramValue(requests[r].params, "toBlock");
+
+        size_t count = 0;
+        for (blknum_t bn = first ; bn <= last ; bn++)
+            count += nLogsAt(bn);
+        if (count > 3000) {
+            nRefused++;
+            results.push_back("{\"jsonrpc\":\"2.0\",\"id\":1,\"error\":{\"code\":-32005,"
+                                "\"message\":\"query returned more than 3000 results\"}}");
+            continue;
+        }
+        string_q resp = "{\"jsonrpc\":\"2.0\",\"id\":1,\"result\":[";
+        bool firstLog = true;
+        for (blknum_t bn = first ; bn <= last ; bn++) {
+            for (size_t i = 0 ; i < nLogsAt(bn) ; i++) {
+                resp += (firstLog ? "" : ",") + fakeLog(bn, i);
+                firstLog = false;
+            }
+        }
+        results.push_back(resp + "]}");
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestParse) {
+
+    CLogFetcher fetcher;
+    cout << "\t" << fetcher.getParams(4000000, 4000100) << "\n";
+    fetcher.addresses.push_back("0xbb9bc244d798123fde783fcc1c72d3bb8c189413");
+    fetcher.topic = "0xddf252ad1be2c89b69c2b068fc378daa952ba7f163c4a11628f55a4df523b3ef";
+    cout << "\t" << fetcher.getParams(4000000, 4000100) << "\n";
+    fetcher.addresses.push_back("0x1234567890123456789012345678901234567890");
+    cout << "\t" << fetcher.getParams(1, 1) << "\n";
+
+    CFetchedLogArray logs;
+    string_q response = "{\"jsonrpc\":\"2.0\",\"id\":1,\"result\":[" + fakeLog(4000000, 0) + ",\n" + fakeLog(4000001, 7) + "]}";
+    ASSERT_TRUE("parsed",          parseLogs(response, logs));
+    ASSERT_EQ("two logs",          logs.size(), 2);
+    ASSERT_EQ("block number",      logs[1].trans.blockNumber, 4000001);
+    ASSERT_EQ("transaction hash",  logs[1].trans.hash, "0x" + padLeft("4000001", 64, '0'));
+    ASSERT_EQ("log index",         logs[1].log.logIndex, 7);
+    ASSERT_EQ("address",           logs[1].log.address, "0xbb9bc244d798123fde783fcc1c72d3bb8c189413");
+    ASSERT_EQ("topics",            logs[1].log.topics.size(), 1);
+
+    ASSERT_TRUE("no logs",         parseLogs("{\"jsonrpc\":\"2.0\",\"id\":1,\"result\":[]}", logs) && logs.empty());
+    ASSERT_FALSE("error",          parseLogs("{\"jsonrpc\":\"2.0\",\"id\":1,\"error\":{\"code\":-32000}}", logs));
+    ASSERT_FALSE("empty",          parseLogs("", logs));
+
+    return true;
+}}
+
+//------------------------------------------------------------------------
+class CSeen {
+public:
+    blknum_t lastBlock;
+    uint64_t lastIndex;
+    size_t   nLogs;
+    bool     inOrder;
+    bool     hasContext;
+    CSeen(void) : lastBlock(0), lastIndex(0), nLogs(0), inOrder(true), hasContext(true) { }
+};
+
+//------------------------------------------------------------------------
+static bool countLog(CLogEntry& log, void *data) {
+    CSeen *seen = (CSeen*)data;  // NOLINT
+    if (!log.pReceipt || !log.pReceipt->pTrans) {
+        seen->hasContext = false;
+        return true;
+    }
+    blknum_t bn = log.pReceipt->pTrans->blockNumber;
+    if (seen->nLogs && (bn < seen->lastBlock || (bn == seen->lastBlock && log.logIndex != seen->lastIndex + 1)))
+        seen->inOrder = false;
+    seen->lastBlock = bn;
+    seen->lastIndex = log.logIndex;
+    seen->nLogs++;
+    return true;
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestRanges) {
+
+    size_t expected = 0;
+    for (blknum_t bn = 1 ; bn < 20000 ; bn++)
+        expected += nLogsAt(bn);
+
+    CLogFetcher fetcher;
+    fetcher.sendRequests = fakeNode;
+    CSeen seen;
+    ASSERT_TRUE("fetched",         fetcher.fetch(1, 19999, countLog, &seen));
+    ASSERT_EQ("every log",         seen.nLogs, expected);
+    ASSERT_TRUE("in block order",  seen.inOrder);
+    ASSERT_TRUE("with context",    seen.hasContext);
+    ASSERT_EQ("last block",        seen.lastBlock, 19998);
+    ASSERT_TRUE("some refused",    fetcher.nSplits > 0 && fetcher.nSplits == nRefused);
+    cout << "\t" << seen.nLogs << " logs in " << fetcher.nRequests << " requests, " << fetcher.nSplits << " refused\n";
+
+    // a sparse stretch grows the pieces, so it takes far fewer requests than blocks
+    CLogFetcher sparse;
+    sparse.sendRequests = fakeNode;
+    sparse.chunk = 10;
+    CSeen seen2;
+    ASSERT_TRUE("sparse fetched",  sparse.fetch(101, 199, countLog, &seen2) && sparse.fetch(201, 299, countLog, &seen2));
+    ASSERT_EQ("sparse logs",       seen2.nLogs, 66);
+    ASSERT_TRUE("grew",            sparse.chunk > 10);
+
+    CSeen seen3;
+    ASSERT_TRUE("one block",       fetcher.fetch(300, 300, countLog, &seen3));
+    ASSERT_EQ("one block logs",    seen3.nLogs, 400);
+    ASSERT_TRUE("empty range",     fetcher.fetch(10, 9, countLog, &seen3));
+
+    return true;
+}}
+
+//------------------------------------------------------------------------
+// A chain of 2,000 blocks of three transactions each. Every other block has a log from a busy
+// contract in its first transaction. The rare contract logs only in blocks 777 and 1500, and a
+// decoy in block 1200 has a bloom that covers the rare contract's.
+#define RARE  "0x1111111111111111111111111111111111111111"
+#define BUSY  "0x2222222222222222222222222222222222222222"
+#define DECOY "0x3333333333333333333333333333333333333333"
+
+//------------------------------------------------------------------------
+static CRawBloom addrBloom(const string_q& addr) {
+    CRawBloom raw;
+    bzero(&raw, sizeof(raw));
+    uint64_t b1 = 5, b2 = 1000, b3 = 2000;
+    if (addr == BUSY) {
+        b1 = 17; b2 = 300; b3 = 1500;
+    }
+    raw.words[b1 / 64] |= (uint64_t(1) << (b1 % 64));
+    raw.words[b2 / 64] |= (uint64_t(1) << (b2 % 64));
+    raw.words[b3 / 64] |= (uint64_t(1) << (b3 % 64));
+    if (addr == DECOY)
+        raw.words[7] |= 0xff;
+    return raw;
+}
+
+//------------------------------------------------------------------------
+static string_q logAddress(blknum_t bn, size_t tx) {
+    if ((bn == 777 || bn == 1500) && tx == 1)
+        return RARE;
+    if (bn == 1200 && tx == 2)
+        return DECOY;
+    if (bn % 2 == 0 && tx == 0)
+        return BUSY;
+    return "";
+}
+
+//------------------------------------------------------------------------
+static string_q toBloomHex(const CRawBloom& raw) {
+    return "0x" + padLeft(toLower(string_q(to_hex(rawToBloom(raw)).c_str())), 512, '0');
+}
+
+//------------------------------------------------------------------------
+static string_q answer(const string_q& result) {
+    string_q response = "{\"jsonrpc\":\"2.0\",\"id\":1,\"result\":" + result + "}";
+    CJsonStream stream;
+    stream.reset(response.length());
+    stream.feed(response.c_str(), response.length());
+    return stream.getResult();
+}
+
+//------------------------------------------------------------------------
+// Stands in for callRPCMany answering eth_getBlockByNumber and eth_getTransactionReceipt
+static size_t nBlockAsks = 0, nReceiptAsks = 0;
+static bool fakeChain(const CRPCRequestArray& requests, CStringArray& results, bool raw) {
+    results.clear();
+    for (size_t r = 0 ; r < requests.size() ; r++) {
+        string_q params = substitute(substitute(substitute(requests[r].params, "[", ""), "]", ""), "\"", "");
+        if (requests[r].method == "eth_getBlockByNumber") {
+            nBlockAsks++;
+            blknum_t bn = toUnsigned(nextTokenClear(params, ','));
+            CRawBloom bloom;
+            bzero(&bloom, sizeof(bloom));
+            string_q hashes;
+            for (size_t tx = 0 ; tx < 3 ; tx++) {
+                if (!logAddress(bn, tx).empty()) {
+                    CRawBloom a = addrBloom(logAddress(bn, tx));
+                    for (size_t w = 0 ; w < 32 ; w++)
+                        bloom.words[w] |= a.words[w];
+                }
+                hashes += string_q(tx ? "," : "") + "\"0x" + padLeft(asStringU(bn * 10 + tx), 64, '0') + "\"";
+            }
+            results.push_back(answer("{\"number\":\"" + toHex(bn) + "\",\"logsBloom\":\"" + toBloomHex(bloom) +
+                                        "\",\"transactionsRoot\":\"0x0\",\"transactions\":[" + hashes + "]}"));
+
+        } else {
+            nReceiptAsks++;
+            uint64_t id = toLongU(substitute(params, "0x", ""));
+            blknum_t bn = id / 10;
+            size_t tx = id % 10;
+            string_q addr = logAddress(bn, tx);
+            CRawBloom bloom;
+            bzero(&bloom, sizeof(bloom));
+            string_q logs;
+            if (!addr.empty()) {
+                bloom = addrBloom(addr);
+                logs = "{\"address\":\"" + addr + "\",\"topics\":[\"0x" + string_q(64, 'a') + "\"],\"data\":\"0x\","
+                        "\"logIndex\":\"0x0\"}";
+            }
+            results.push_back(answer("{\"blockNumber\":\"" + toHex(bn) + "\",\"transactionIndex\":\"" + toHex(tx) + "\","
+                                        "\"transactionHash\":\"0x" + padLeft(asStringU(id), 64, '0') + "\","
+                                        "\"logsBloom\":\"" + toBloomHex(bloom) + "\",\"logs\":[" + logs + "],"
+                                        "\"status\":\"0x1\"}"));
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestBlooms) {
+
+    CRawBloom raw, back = addrBloom(DECOY);
+    ASSERT_TRUE("hex read",        hexToRaw(toBloomHex(back), raw));
+    ASSERT_TRUE("same bloom",      memcmp(&raw, &back, sizeof(raw)) == 0);
+    ASSERT_TRUE("short hex",       hexToRaw("0x10", raw) && raw.words[0] == 16 && !raw.words[1]);
+    ASSERT_FALSE("not hex",        hexToRaw("0xzz", raw));
+
+    CBloomLogReader reader;
+    reader.sendRequests = fakeChain;
+    reader.addresses.push_back(RARE);
+    reader.addressBlooms.push_back(addrBloom(RARE));
+    ASSERT_TRUE("decoy may hold",  reader.mayHold(addrBloom(DECOY)));
+    ASSERT_FALSE("busy may not",   reader.mayHold(addrBloom(BUSY)));
+
+    CSeen seen;
+    ASSERT_TRUE("read",            reader.read(1, 2000, countLog, &seen));
+    ASSERT_EQ("both logs",         seen.nLogs, 2);
+    ASSERT_EQ("last block",        seen.lastBlock, 1500);
+    ASSERT_TRUE("with context",    seen.hasContext);
+    ASSERT_EQ("every block",       reader.nBlocks, 2000);
+    ASSERT_EQ("three blocks' receipts", reader.nReceipts, 9);
+    ASSERT_EQ("three parsed",      reader.nParsed, 3);
+    ASSERT_EQ("blocks asked",      nBlockAsks, 2000);
+    ASSERT_EQ("receipts asked",    nReceiptAsks, 9);
+
+    // any address reads every receipt with logs
+    CBloomLogReader all;
+    all.sendRequests = fakeChain;
+    CSeen seen2;
+    ASSERT_TRUE("read all",        all.read(1, 100, countLog, &seen2));
+    ASSERT_EQ("busy logs",         seen2.nLogs, 50);
+    ASSERT_EQ("all receipts",      all.nReceipts, 300);
+    cout << "\t" << seen.nLogs << " logs from " << reader.nBlocks << " blocks, " << reader.nReceipts << " receipts\n";
+
+    return true;
+}}
+
+#include "options.h"
+//------------------------------------------------------------------------
+int main(int argc, const char *argv[]) {
+
+    COptions options;
+    if (!options.prepareArguments(argc, argv))
+        return 0;
+
+    while (!options.commandList.empty()) {
+        string_q command = nextTokenClear(options.commandList, '\n');
+        if (!options.parseArguments(command))
+            return 0;
+        switch (options.testNum) {
+            case 0: LOAD_TEST(TestParse); break;
+            case 1: LOAD_TEST(TestRanges); break;
+            case 2: LOAD_TEST(TestBlooms); break;
+        }
+    }
+
+    return testing::RUN_ALL_TESTS();
+}
@@ -0,0 +1,249 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <string>
+#include "etherlib.h"
+#include "testing.h"
+
+//------------------------------------------------------------------------
+class CThisTest : public testing::Test {
+public:
+                 CThisTest(void) : Test() {}
+    virtual void SetUp    (void) {}
+    virtual void TearDown (void) {}
+};
+
+//------------------------------------------------------------------------
+#define tokenA   "0x1111111111111111111111111111111111111111"
+#define tokenB   "0x2222222222222222222222222222222222222222"
+#define transfer "0xddf252ad1be2c89b69c2b068fc378daa952ba7f163c4a11628f55a4df523b3ef"
+#define approval "0x8c5be1e5ebec7d5bd14f71427d1e84f3dd0314c0f7b2291e5b200ac8c7c3b925"
+
+//------------------------------------------------------------------------
+static void addLog(CBlock& block, size_t tx, const SFAddress& addr, const string_q& topic, uint64_t logIndex) {
+    while (block.transactions.size() <= tx)
+        block.transactions.push_back(CTransaction());
+    CLogEntry log;
+    log.address = addr;
+    if (!topic.empty())
+        log.topics.push_back(toTopic(topic));
+    log.logIndex = logIndex;
+    block.transactions.at(tx).receipt.logs.push_back(log);
+}
+
+//------------------------------------------------------------------------
+static void makeBlocks(vector<CBlock>& blocks) {
+    blocks.resize(3);
+    blocks[0].blockNumber = 100;
+    addLog(blocks[0], 0, tokenA, transfer, 0);
+    addLog(blocks[0], 0, tokenA, approval, 1);
+    addLog(blocks[0], 1, tokenB, transfer, 2);
+    blocks[1].blockNumber = 101;
+    addLog(blocks[1], 0, tokenB, transfer, 0);
+    addLog(blocks[1], 2, tokenA, transfer, 1);
+    addLog(blocks[1], 2, tokenB, "", 2);  // no topics
+    blocks[2].blockNumber = 105;
+    addLog(blocks[2], 0, tokenA, transfer, 0);
+}
+
+//------------------------------------------------------------------------
+static string_q report(const CLogIndexRecordArray& recs) {
+    string_q ret;
+    for (size_t i = 0 ; i < recs.size() ; i++) {
+        ret += "\t\t" + asStringU(recs[i].blockNum) + "." + asStringU(recs[i].txIndex) + "." +
+                    asStringU(recs[i].logIndex) + " " + recs[i].getAddress() + " " +
+                    extract(fromTopic(recs[i].getTopic()), 0, 10) + "\n";
+    }
+    return ret;
+}
+
+//------------------------------------------------------------------------
+static size_t query(const CLogIndex& index, const SFAddress& addr, const string_q& topic,
+                        blknum_t first = 0, blknum_t last = NOPOS, string_q *out = NULL) {
+    CLogQuery q;
+    q.address = addr;
+    q.hasTopic = !topic.empty();
+    if (q.hasTopic)
+        q.topic = toTopic(topic);
+    q.firstBlock = first;
+    q.lastBlock = last;
+    CLogIndexRecordArray results;
+    index.find(q, results);
+    if (out)
+        *out = report(results);
+    return results.size();
+}
+
+//------------------------------------------------------------------------
+// the same queries are run against the journal alone and against the compacted index
+static string_q runQueries(const CLogIndex& index) {
+    string_q ret, str;
+    query(index, tokenA, "", 0, NOPOS, &str);
+    ret += "\tby address:\n" + str;
+    query(index, tokenA, transfer, 0, NOPOS, &str);
+    ret += "\tby address and topic:\n" + str;
+    query(index, "", transfer, 0, NOPOS, &str);
+    ret += "\tby topic:\n" + str;
+    query(index, "", transfer, 101, 101, &str);
+    ret += "\tby topic and block:\n" + str;
+    query(index, "", "", 100, 100, &str);
+    ret += "\tby block:\n" + str;
+    query(index, tokenB, "0x0", 0, NOPOS, &str);
+    ret += "\tno topics:\n" + str;
+    return ret;
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestQuery) {
+
+    string_q indexFile = "/tmp/logIndex_test.bin", journalFile = "/tmp/logIndex_journal.bin";
+    ::remove(indexFile.c_str());
+    ::remove(journalFile.c_str());
+
+    vector<CBlock> blocks;
+    makeBlocks(blocks);
+    CLogIndexRecordArray recs;
+    ASSERT_EQ("records",              getLogRecords(blocks[1], recs), 3);
+    ASSERT_EQ("address",              recs[1].getAddress(), tokenA);
+    ASSERT_EQ("topic",                fromTopic(recs[1].getTopic()), transfer);
+    ASSERT_EQ("position",             recs[1].txIndex, 2);
+
+    CLogIndex index;
+    ASSERT_FALSE("nothing yet",       index.open(indexFile, journalFile));
+    for (size_t i = 0 ; i < blocks.size() ; i++)
+        ASSERT_TRUE("append",         appendBlockLogs(blocks[i], journalFile));
+    ASSERT_TRUE("re-cached",          appendBlockLogs(blocks[1], journalFile));
+    ASSERT_TRUE("no logs",            appendBlockLogs(CBlock(), journalFile));
+
+    ASSERT_TRUE("open",               index.open(indexFile, journalFile));
+    ASSERT_EQ("journaled",            index.nJournaled(), 10);
+    ASSERT_EQ("last block",           index.lastBlock(), 105);
+    ASSERT_EQ("by address",           query(index, tokenA, ""), 4);
+    ASSERT_EQ("by address and topic", query(index, tokenA, transfer), 3);
+    ASSERT_EQ("by topic",             query(index, "", transfer), 5);
+    ASSERT_EQ("by topic and block",   query(index, "", transfer, 101, 101), 2);
+    ASSERT_EQ("by block",             query(index, "", "", 100, 100), 3);
+    ASSERT_EQ("by block range",       query(index, "", "", 101, 200), 4);
+    ASSERT_EQ("unknown address",      query(index, "0x3333333333333333333333333333333333333333", ""), 0);
+    cout << runQueries(index);
+
+    ::remove(journalFile.c_str());
+    return true;
+}}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestCompact) {
+
+    string_q indexFile = "/tmp/logIndex_test.bin", journalFile = "/tmp/logIndex_journal.bin";
+    ::remove(indexFile.c_str());
+    ::remove(journalFile.c_str());
+
+    vector<CBlock> blocks;
+    makeBlocks(blocks);
+    for (size_t i = 0 ; i < blocks.size() ; i++)
+        appendBlockLogs(blocks[i], journalFile);
+    appendBlockLogs(blocks[0], journalFile);
+
+    CLogIndex index;
+    index.open(indexFile, journalFile);
+    string_q fromJournal = runQueries(index);
+
+    ASSERT_TRUE("compact",            index.compact());
+    ASSERT_FALSE("journal removed",   fileExists(journalFile));
+    ASSERT_EQ("nothing journaled",    index.nJournaled(), 0);
+    ASSERT_EQ("duplicates dropped",   index.size(), 7);
+    ASSERT_EQ("same results",         runQueries(index), fromJournal);
+
+    // a newly cached block is seen before the next compact
+    CBlock block;
+    block.blockNumber = 110;
+    addLog(block, 3, tokenB, transfer, 7);
+    appendBlockLogs(block, journalFile);
+    CLogIndex reopened;
+    ASSERT_TRUE("reopen",             reopened.open(indexFile, journalFile));
+    ASSERT_EQ("index and journal",    reopened.size(), 8);
+    ASSERT_EQ("last block",           reopened.lastBlock(), 110);
+    ASSERT_EQ("new transfer",         query(reopened, "", transfer), 6);
+    ASSERT_EQ("new for address",      query(reopened, tokenB, transfer, 105), 1);
+    ASSERT_TRUE("compact again",      reopened.compact());
+    ASSERT_EQ("all indexed",          reopened.size(), 8);
+    ASSERT_EQ("still there",          query(reopened, tokenB, transfer, 105), 1);
+    string_q str;
+    query(reopened, tokenB, "", 0, NOPOS, &str);
+    cout << "\tall for tokenB:\n" << str;
+
+    // a long journal is compacted when the index is opened
+    for (blknum_t bn = 200 ; bn <= 200 + MAX_JOURNALED ; bn++) {
+        block = CBlock();
+        block.blockNumber = bn;
+        addLog(block, 0, tokenA, approval, 0);
+        appendBlockLogs(block, journalFile);
+    }
+    CLogIndex busy;
+    ASSERT_TRUE("open busy",          busy.open(indexFile, journalFile));
+    ASSERT_EQ("compacted on open",    busy.nJournaled(), 0);
+    ASSERT_EQ("all there",            busy.size(), 8 + MAX_JOURNALED + 1);
+    ASSERT_EQ("approvals",            query(busy, tokenA, approval, 200), MAX_JOURNALED + 1);
+
+    // blocks cached after the journal was read, and another compaction since, are not lost
+    size_t nBefore = busy.size();
+    CLogIndex first, second;
+    for (blknum_t bn = 6000 ; bn < 6003 ; bn++) {
+        block = CBlock();
+        block.blockNumber = bn;
+        addLog(block, 0, tokenB, approval, 0);
+        appendBlockLogs(block, journalFile);
+        if (bn == 6000) {
+            first.open(indexFile, journalFile);
+            second.open(indexFile, journalFile);
+        } else if (bn == 6001) {
+            ASSERT_TRUE("first compact",  first.compact());
+        }
+    }
+    ASSERT_TRUE("second compact",     second.compact());
+    ASSERT_EQ("every block",          second.size(), nBefore + 3);
+    ASSERT_EQ("late approvals",       query(second, tokenB, approval, 6000), 3);
+    string_q pid = asStringU((uint64_t)getpid());
+    ASSERT_FALSE("no temp index",     fileExists(indexFile + "." + pid + ".tmp"));
+    ASSERT_FALSE("no journal aside",  fileExists(journalFile + "." + pid + ".tmp"));
+
+    // a damaged index is ignored
+    string_q contents = asciiFileToString(indexFile);
+    stringToAsciiFile(indexFile, extract(contents, 0, contents.length() - 4));
+    CLogIndex damaged;
+    ASSERT_FALSE("truncated",         damaged.open(indexFile, journalFile));
+    ASSERT_EQ("empty",                damaged.size(), 0);
+
+    ::remove(indexFile.c_str());
+    return true;
+}}
+
+#include "options.h"
+//------------------------------------------------------------------------
+int main(int argc, const char *argv[]) {
+
+    COptions options;
+    if (!options.prepareArguments(argc, argv))
+        return 0;
+
+    while (!options.commandList.empty()) {
+        string_q command = nextTokenClear(options.commandList, '\n');
+        if (!options.parseArguments(command))
+            return 0;
+        switch (options.testNum) {
+            case 0: LOAD_TEST(TestQuery); break;
+            case 1: LOAD_TEST(TestCompact); break;
+        }
+    }
+
+    return testing::RUN_ALL_TESTS();
+}
@@ -0,0 +1,173 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <string>
+#include "etherlib.h"
+#include "testing.h"
+
+//------------------------------------------------------------------------
+class CThisTest : public testing::Test {
+public:
+                 CThisTest(void) : Test() {}
+    virtual void SetUp    (void) {}
+    virtual void TearDown (void) {}
+};
+
+//------------------------------------------------------------------------
+// Five minute quotes with a three hour gap and a repeated quote
+static void makeQuotes(CPriceQuoteArray& quotes) {
+    timestamp_t times[] = { 1000, 1300, 1600, 1600, 12400, 12700, 13000 };
+    double closes[] = { 10.011, 10.5, 11.0, 11.25, 300.0, 301.5, 1234.56 };
+    quotes.clear();
+    for (size_t i = 0 ; i < sizeof(times) / sizeof(timestamp_t) ; i++) {
+        CPriceQuote quote;
+        quote.timestamp = times[i];
+        quote.close = closes[i];
+        quotes.push_back(quote);
+    }
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestLookup) {
+
+    string_q fileName = "/tmp/priceSeries_test.col";
+    ::remove(fileName.c_str());
+
+    CPriceQuoteArray quotes;
+    makeQuotes(quotes);
+
+    CPriceSeries series;
+    ASSERT_FALSE("no file",           series.open(fileName));
+    ASSERT_TRUE("write",              writePriceSeries(fileName, quotes));
+    ASSERT_FALSE("no temp file",      fileExists(fileName + ".tmp"));
+    ASSERT_TRUE("open",               series.open(fileName));
+    ASSERT_EQ("repeat replaced",      series.size(), 6);
+    ASSERT_EQ("cents",                series[0].cents, 1001);
+    ASSERT_EQ("last of repeat",       series[2].cents, 1125);
+
+    ASSERT_EQ("before first",         series.indexOf(10), 0);
+    ASSERT_EQ("exact",                series.indexOf(1300), 1);
+    ASSERT_EQ("between",              series.indexOf(1599), 1);
+    ASSERT_EQ("in the gap",           series.indexOf(9000), 2);
+    ASSERT_EQ("after the gap",        series.indexOf(12400), 3);
+    ASSERT_EQ("after last",           series.indexOf(99999), 5);
+    ASSERT_EQ("good hint",            series.indexOf(12750, 4), 4);
+    ASSERT_EQ("short hint",           series.indexOf(12750, 3), 4);
+    ASSERT_EQ("bad hint",             series.indexOf(1400, 4), 1);
+    ASSERT_EQ("price",                series.priceAt(12999), 30150);
+
+    // the array lookup agrees with the mapped one everywhere
+    bool same = true;
+    for (timestamp_t ts = 0 ; ts < 14000 ; ts += 7)
+        same = same && (quotes[indexFromTimeStamp(quotes, ts)].timestamp == series[series.indexOf(ts)].timestamp);
+    ASSERT_TRUE("array agrees",       same);
+    for (size_t i = 0 ; i < series.size() ; i++)
+        cout << "\t" << series[i].timestamp << "\t" << series[i].cents << "\n";
+
+    // a damaged file is not used
+    string_q contents = asciiFileToString(fileName);
+    stringToAsciiFile(fileName, extract(contents, 0, contents.length() - 1));
+    CPriceSeries damaged;
+    ASSERT_FALSE("truncated",         damaged.open(fileName));
+    stringToAsciiFile(fileName, "not a price series at all");
+    ASSERT_FALSE("not a series",      damaged.open(fileName));
+
+    ::remove(fileName.c_str());
+    return true;
+}}
+
+//------------------------------------------------------------------------
+// What asDollars and dispDollars used to compute with big numbers
+static string_q oldWay(const SFUintBN& weiIn, uint64_t cents) {
+    SFUintBN wei = weiIn * cents;
+    wei /= 100;
+    string_q sBal = wei2Ether(to_string(wei).c_str());
+    string_q d = nextTokenClear(sBal, '.');
+    return insertCommas(d) + "." + extract(sBal, 0, 2);
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestDollars) {
+
+    ASSERT_EQ("zero",                 centsToDollars(0), "0.00");
+    ASSERT_EQ("cents",                centsToDollars(5), "0.05");
+    ASSERT_EQ("dollars",              centsToDollars(123456), "1,234.56");
+    ASSERT_EQ("exact thousands",      centsToDollars(100000000), "1,000,000.00");
+    ASSERT_EQ("largest",              centsToDollars(UINT64_MAX), "184,467,440,737,095,516.15");
+
+    const char *weis[] = {
+        "1", "999999999999999999", "1000000000000000000", "1500000000000000001",
+        "123456789012345678901234", "340282366920938463463374607431768211455",
+    };
+    uint64_t prices[] = { 1, 1001, 30150, 123456, 4294967295ULL };
+    bool same = true;
+    for (size_t w = 0 ; w < sizeof(weis) / sizeof(char*) ; w++) {
+        for (size_t p = 0 ; p < sizeof(prices) / sizeof(uint64_t) ; p++) {
+            SFUintBN wei = str2BigUint(weis[w]);
+            uint64_t cents;
+            if (weiToCents(wei, prices[p], cents))
+                same = same && (centsToDollars(cents) == oldWay(wei, prices[p]));
+        }
+    }
+    ASSERT_TRUE("same as big numbers", same);
+
+    SFUintBN huge = str2BigUint("340282366920938463463374607431768211456");
+    uint64_t cents;
+    ASSERT_FALSE("too wide",          weiToCents(huge, 100, cents));
+    ASSERT_FALSE("too many cents",    weiToCents(str2BigUint("340282366920938463463374607431768211455"), 4294967295ULL, cents));
+
+    string_q fileName = "/tmp/priceSeries_dollars.col";
+    CPriceQuoteArray quotes;
+    makeQuotes(quotes);
+    ASSERT_TRUE("write",              writePriceSeries(fileName, quotes));
+    CPriceSeries series;
+    ASSERT_TRUE("open",               series.open(fileName));
+
+    CWeiAtTimeArray rows;
+    rows.push_back(CWeiAtTime(1000, str2BigUint("2000000000000000000")));
+    rows.push_back(CWeiAtTime(1650, str2BigUint("2000000000000000000")));
+    rows.push_back(CWeiAtTime(12800, str2BigUint("1")));
+    rows.push_back(CWeiAtTime(12800, str2BigUint("123456789012345678901234")));
+    rows.push_back(CWeiAtTime(13000, huge));
+    rows.push_back(CWeiAtTime(500, str2BigUint("1000000000000000000")));
+    CStringArray dollars;
+    series.toDollars(rows, dollars);
+    ASSERT_EQ("count",                dollars.size(), rows.size());
+    for (size_t i = 0 ; i < rows.size() ; i++) {
+        ASSERT_EQ("one at a time",    dollars[i], series.toDollars(rows[i].timestamp, rows[i].wei));
+        cout << "\t" << rows[i].timestamp << "\t$" << dollars[i] << "\n";
+    }
+
+    ::remove(fileName.c_str());
+    return true;
+}}
+
+#include "options.h"
+//------------------------------------------------------------------------
+int main(int argc, const char *argv[]) {
+
+    COptions options;
+    if (!options.prepareArguments(argc, argv))
+        return 0;
+
+    while (!options.commandList.empty()) {
+        string_q command = nextTokenClear(options.commandList, '\n');
+        if (!options.parseArguments(command))
+            return 0;
+        switch (options.testNum) {
+            case 0: LOAD_TEST(TestLookup); break;
+            case 1: LOAD_TEST(TestDollars); break;
+        }
+    }
+
+    return testing::RUN_ALL_TESTS();
+}
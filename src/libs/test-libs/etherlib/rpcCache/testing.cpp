@@ -0,0 +1,171 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <string>
+#include "etherlib.h"
+#include "testing.h"
+
+//------------------------------------------------------------------------
+class CThisTest : public testing::Test {
+public:
+                 CThisTest(void) : Test() {}
+    virtual void SetUp    (void) {}
+    virtual void TearDown (void) {}
+};
+
+//------------------------------------------------------------------------
+static const char *classNames[] = { "never", "head", "session", "history", "immutable" };
+
+//------------------------------------------------------------------------
+static string_q showClass(const string_q& method, const string_q& params) {
+    return padRight(method, 28) + padRight(params, 74) + classNames[rpcCacheClass(method, params)];
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestClasses) {
+
+    string_q hash = "[\"0x0b4c6fb75ded4b90218cf0346b0885e442878f104e1b60bf75d5b6860eeacd53\"]";
+    cout << "\t" << showClass("eth_getTransactionReceipt", hash) << "\n";
+    cout << "\t" << showClass("trace_transaction",         hash) << "\n";
+    cout << "\t" << showClass("eth_getBlockByNumber",      "[\"0x3d0900\",true]") << "\n";
+    cout << "\t" << showClass("eth_getBlockByNumber",      "[\"latest\",false]") << "\n";
+    cout << "\t" << showClass("eth_getBalance",            "[\"0xbb9bc244d798123fde783fcc1c72d3bb8c189413\",\"0x16e361\"]") << "\n";
+    cout << "\t" << showClass("eth_getCode",               "[\"0xbb9bc244d798123fde783fcc1c72d3bb8c189413\"]") << "\n";
+    cout << "\t" << showClass("eth_call",                  "[{\"to\":\"0x1\"},\"pending\"]") << "\n";
+    cout << "\t" << showClass("web3_clientVersion",        "[]") << "\n";
+    cout << "\t" << showClass("eth_blockNumber",           "[]") << "\n";
+    cout << "\t" << showClass("eth_sendRawTransaction",    "[\"0xf86b\"]") << "\n";
+    cout << "\t" << showClass("eth_newFilter",             "[{}]") << "\n";
+
+    ASSERT_EQ("receipt",          rpcCacheClass("eth_getTransactionReceipt", hash), RPC_IMMUTABLE);
+    ASSERT_EQ("latest block",     rpcCacheClass("eth_getBlockByNumber", "[\"latest\",false]"), RPC_HEAD);
+    ASSERT_EQ("unknown method",   rpcCacheClass("eth_sendRawTransaction", "[]"), RPC_NOCACHE);
+
+    return true;
+}}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestMemo) {
+
+    CRPCCache memo;
+    string_q value;
+
+    ASSERT_FALSE("empty",          memo.lookup("eth_blockNumber", "[]", false, value));
+    memo.store("eth_blockNumber", "[]", false, "0x4b7");
+    ASSERT_TRUE("head hit",        memo.lookup("eth_blockNumber", "[]", false, value));
+    ASSERT_EQ("head value",        value, "0x4b7");
+    ASSERT_FALSE("raw is separate", memo.lookup("eth_blockNumber", "[]", true, value));
+
+    memo.store("eth_getBlockByNumber", "[\"0x1\",false]", false, "{number:0x1}");
+    memo.store("eth_sendRawTransaction", "[\"0xf86b\"]", false, "0xabcd");
+    memo.store("eth_getTransactionReceipt", "[\"0x12\"]", false, "null");
+    memo.store("eth_getTransactionReceipt", "[\"0x34\"]", true, "{\"id\":1,\"result\":null}");
+    ASSERT_TRUE("history hit",     memo.lookup("eth_getBlockByNumber", "[\"0x1\",false]", false, value));
+    ASSERT_FALSE("never kept",     memo.lookup("eth_sendRawTransaction", "[\"0xf86b\"]", false, value));
+    ASSERT_FALSE("null not kept",  memo.lookup("eth_getTransactionReceipt", "[\"0x12\"]", false, value));
+    ASSERT_FALSE("raw null",       memo.lookup("eth_getTransactionReceipt", "[\"0x34\"]", true, value));
+
+    // a negative time to live expires head entries at once, but nothing else
+    memo.setHeadTTL(-1);
+    ASSERT_FALSE("head expired",   memo.lookup("eth_blockNumber", "[]", false, value));
+    ASSERT_TRUE("history stays",   memo.lookup("eth_getBlockByNumber", "[\"0x1\",false]", false, value));
+    ASSERT_FALSE("not alive",      memo.nodeIsAlive());
+    memo.setHeadTTL(5);
+    memo.nodeAnswered();
+    ASSERT_TRUE("alive",           memo.nodeIsAlive());
+
+    // only lookups of cacheable methods are counted
+    ASSERT_EQ("hits",              memo.hits, 3);
+    ASSERT_EQ("misses",            memo.misses, 5);
+
+    string_q folder = "./rpcCacheTest/";
+    doCommand("rm -fR " + folder);
+    memo.setDiskFolder(folder);
+    memo.store("eth_getTransactionReceipt", "[\"0x56\"]", true, "{\"id\":1,\n\"result\":{}}");
+    memo.store("eth_getBlockByNumber", "[\"0x2\",false]", false, "{number:0x2}");
+
+    CRPCCache later;
+    later.setDiskFolder(folder);
+    ASSERT_TRUE("from disk",       later.lookup("eth_getTransactionReceipt", "[\"0x56\"]", true, value));
+    ASSERT_EQ("disk value",        value, "{\"id\":1,\n\"result\":{}}");
+    ASSERT_FALSE("not by number",  later.lookup("eth_getBlockByNumber", "[\"0x2\",false]", false, value));
+    ASSERT_TRUE("now in memory",   later.lookup("eth_getTransactionReceipt", "[\"0x56\"]", true, value));
+    ASSERT_EQ("disk hits",         later.diskHits, 1);
+    doCommand("rm -fR " + folder);
+
+    return true;
+}}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestBound) {
+
+    CRPCCache memo;
+    string_q value;
+
+    // each entry is a 41 byte key plus a 59 byte value, so a 1000 byte budget holds ten
+    memo.setMaxBytes(1000);
+    size_t most = 0;
+    for (size_t i = 0 ; i < 100 ; i++) {
+        string_q params = "[\"" + padLeft(asStringU(i), 10, '0') + "\",false]";
+        memo.store("eth_getBlockByNumber", params, false, string_q(59, 'x'));
+        memo.lookup("eth_getBlockByNumber", "[\"0000000000\",false]", false, value);  // keep the first in use
+        most = max(most, memo.nBytes());
+    }
+    cout << "\tentries: " << memo.nEntries() << " bytes: " << memo.nBytes() << "\n";
+    ASSERT_TRUE("within budget",   most <= 1000);
+    ASSERT_EQ("entries",           memo.nEntries(), 10);
+    ASSERT_TRUE("in use kept",     memo.lookup("eth_getBlockByNumber", "[\"0000000000\",false]", false, value));
+    ASSERT_FALSE("oldest dropped", memo.lookup("eth_getBlockByNumber", "[\"0000000001\",false]", false, value));
+    ASSERT_TRUE("newest kept",     memo.lookup("eth_getBlockByNumber", "[\"0000000099\",false]", false, value));
+
+    // an answer larger than the budget is not kept and does not push out the others
+    memo.store("eth_getBlockByNumber", "[\"0x1\",true]", false, string_q(2000, 'y'));
+    ASSERT_FALSE("too large",      memo.lookup("eth_getBlockByNumber", "[\"0x1\",true]", false, value));
+    ASSERT_EQ("still ten",         memo.nEntries(), 10);
+
+    memo.setMaxBytes(500);
+    ASSERT_EQ("shrunk",            memo.nEntries(), 5);
+    ASSERT_TRUE("most recent kept", memo.lookup("eth_getBlockByNumber", "[\"0000000099\",false]", false, value));
+
+    // only an error at the top of the response makes it a failure
+    string_q trace = "{\"jsonrpc\":\"2.0\",\"result\":[{\"error\":\"Reverted\",\"type\":\"call\"}],\"id\":1}";
+    string_q failed = "{\"jsonrpc\":\"2.0\",\"error\":{\"code\":-32602,\"message\":\"bad\"},\"id\":1}";
+    string_q quoted = "{\"id\":1,\"result\":\"\\\"error\\\":1\"}";
+    ASSERT_FALSE("reverted trace", isRPCError(trace));
+    ASSERT_TRUE("failed request",  isRPCError(failed));
+    ASSERT_TRUE("with spaces",     isRPCError("{ \"id\": 1, \"error\" : {} }"));
+    ASSERT_FALSE("in a string",    isRPCError(quoted));
+
+    return true;
+}}
+
+#include "options.h"
+//------------------------------------------------------------------------
+int main(int argc, const char *argv[]) {
+
+    COptions options;
+    if (!options.prepareArguments(argc, argv))
+        return 0;
+
+    while (!options.commandList.empty()) {
+        string_q command = nextTokenClear(options.commandList, '\n');
+        if (!options.parseArguments(command))
+            return 0;
+        switch (options.testNum) {
+            case 0: LOAD_TEST(TestClasses); break;
+            case 1: LOAD_TEST(TestMemo); break;
+            case 2: LOAD_TEST(TestBound); break;
+        }
+    }
+
+    return testing::RUN_ALL_TESTS();
+}
@@ -0,0 +1,144 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <string>
+#include "etherlib.h"
+#include "testing.h"
+
+//------------------------------------------------------------------------
+class CThisTest : public testing::Test {
+public:
+                 CThisTest(void) : Test() {}
+    virtual void SetUp    (void) {}
+    virtual void TearDown (void) {}
+};
+
+//------------------------------------------------------------------------
+// Feeds 'str' to a fresh matcher in two pieces split at every position. True only if every split finds it.
+static bool foundAtEverySplit(const string_q& pattern, const string_q& str) {
+    for (size_t split = 0 ; split <= str.length() ; split++) {
+        CRollingMatcher matcher(pattern);
+        bool found = matcher.feed(str.c_str(), split);
+        found = matcher.feed(str.c_str() + split, str.length() - split) || found;
+        if (!found)
+            return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestMatcher) {
+
+    string_q hack(58, ' ');
+    for (size_t i = 0 ; i < hack.length() ; i++)
+        hack[i] = (i % 2 ? 'b' : '5');
+    string_q trace = "{\"result\":[{\"action\":{\"input\":\"0x6060" + hack + hack + "00\"}}]}";
+
+    ASSERT_TRUE("hack at every split",     foundAtEverySplit(hack, trace));
+    ASSERT_FALSE("hack too short",         foundAtEverySplit(hack, "0x" + extract(hack, 0, 56) + "00"));
+    ASSERT_TRUE("overlapping prefix",      foundAtEverySplit("aab", "xaaaab"));
+    ASSERT_TRUE("error at every split",    foundAtEverySplit("erro", "{\"jsonrpc\":\"2.0\",\"error\":{\"code\":-32000}}"));
+    ASSERT_FALSE("no error",               foundAtEverySplit("erro", "{\"jsonrpc\":\"2.0\",\"result\":\"err0r\"}"));
+
+    CRollingMatcher matcher("erro");
+    ASSERT_FALSE("first piece",            matcher.feed("...er", 5));
+    matcher.reset();
+    ASSERT_FALSE("reset forgets",          matcher.feed("ro...", 5));
+    ASSERT_TRUE("one byte at a time",      matcher.feed("e", 1) || matcher.feed("r", 1) || matcher.feed("r", 1) || matcher.feed("o", 1));
+
+    return true;
+}}
+
+//------------------------------------------------------------------------
+// The result callRPC returned before responses were streamed
+static string_q parsedResult(const string_q& response) {
+    string_q copy = response;
+    CRPCResult generic;
+    generic.parseJson(cleanUpJson((char*)copy.c_str()));  // NOLINT
+    return generic.result;
+}
+
+//------------------------------------------------------------------------
+static const char *responses[] = {
+    "{\"jsonrpc\":\"2.0\",\"id\":\"1\",\"result\":\"0x4b7\"}\n",
+    "{ \"jsonrpc\" : \"2.0\",\n  \"result\" : { \"number\" : \"0x1b4\", \"hash\" : \"0xdc0818\" },\n  \"id\" : 1\n}",
+    "{\"jsonrpc\":\"2.0\",\"result\":[{\"a\":[1,[2,3]],\"b\":\"x\"},{\"c\":{}}],\"id\":\"7\"}",
+    "{\"jsonrpc\":\"2.0\",\"id\":\"1\",\"result\":[]}",
+    "{\"jsonrpc\":\"2.0\",\"id\":\"1\",\"result\":null}",
+    "{\"jsonrpc\":\"2.0\",\"id\":\"1\",\"error\":{\"code\":-32601,\"message\":\"the method foo does not exist\"}}",
+    "{\"Result\":\"first\",\"id\":2,\"RESULT\":{\"nested\":{\"result\":\"inner\"}}}",
+    "{\"id\":1,,\"result\":\"after two commas\"}",
+    "[{\"id\":1,\"result\":\"0x1\"},{\"id\":2,\"result\":\"0x2\"}]",
+    "{\"id\":1,\"result\":{\"logs\":[{\"topics\":[\"0xddf2\"]}]",
+    "{\"id\":1,\"result\":[\"0xaa\",\"0xbb\"",
+    "",
+};
+static const size_t nResponses = sizeof(responses) / sizeof(char*);
+
+//------------------------------------------------------------------------
+TEST_F(CThisTest, TestTokenizer) {
+
+    bool sameEverywhere = true;
+    for (size_t r = 0 ; r < nResponses ; r++) {
+        string_q response = responses[r];
+        string_q expected = parsedResult(response);
+
+        CJsonStream whole;
+        whole.feed(response.c_str(), response.length());
+        cout << "\t" << padRight(expected.empty() ? "<empty>" : expected, 50) << " " << whole.getResult() << "\n";
+        sameEverywhere = sameEverywhere && (whole.getResult() == expected);
+
+        for (size_t split = 0 ; split <= response.length() ; split++) {
+            CJsonStream stream;
+            stream.reset(response.length());
+            stream.feed(response.c_str(), split);
+            stream.feed(response.c_str() + split, response.length() - split);
+            sameEverywhere = sameEverywhere && (stream.getResult() == expected);
+        }
+
+        CJsonStream bytes;
+        for (size_t i = 0 ; i < response.length() ; i++)
+            bytes.feed(response.c_str() + i, 1);
+        sameEverywhere = sameEverywhere && (bytes.getResult() == expected);
+    }
+    ASSERT_TRUE("matches parseJson",      sameEverywhere);
+
+    CJsonStream stream;
+    string_q response = responses[1];
+    stream.feed(response.c_str(), response.length());
+    ASSERT_EQ("cleaned",                  stream.cleaned, "{jsonrpc:2.0,result:{number:0x1b4,hash:0xdc0818},id:1}");
+    stream.reset();
+    ASSERT_EQ("reset",                    stream.getResult(), "");
+
+    return true;
+}}
+
+#include "options.h"
+//------------------------------------------------------------------------
+int main(int argc, const char *argv[]) {
+
+    COptions options;
+    if (!options.prepareArguments(argc, argv))
+        return 0;
+
+    while (!options.commandList.empty()) {
+        string_q command = nextTokenClear(options.commandList, '\n');
+        if (!options.parseArguments(command))
+            return 0;
+        switch (options.testNum) {
+            case 0: LOAD_TEST(TestMatcher); break;
+            case 1: LOAD_TEST(TestTokenizer); break;
+        }
+    }
+
+    return testing::RUN_ALL_TESTS();
+}
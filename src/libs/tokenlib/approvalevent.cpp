@@ -91,9 +91,10 @@ bool QApprovalEvent::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> _owner;
-    archive >> _spender;
-    archive >> _value;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(QApprovalEvent), 3);
+    fields >> _owner;
+    fields >> _spender;
+    fields >> _value;
     finishParse();
     return true;
 }
@@ -90,8 +90,9 @@ bool QApprove::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> _spender;
-    archive >> _value;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(QApprove), 2);
+    fields >> _spender;
+    fields >> _value;
     finishParse();
     return true;
 }
@@ -91,9 +91,10 @@ bool QApproveAndCall::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> _spender;
-    archive >> _value;
-    archive >> _extraData;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(QApproveAndCall), 3);
+    fields >> _spender;
+    fields >> _value;
+    fields >> _extraData;
     finishParse();
     return true;
 }
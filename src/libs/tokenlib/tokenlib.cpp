@@ -20,6 +20,18 @@ void tokenlib_init(void) {
     QApproveAndCall::registerClass();
     QTransfer::registerClass();
     QTransferFrom::registerClass();
+
+    getAbiDecoder()->addSignature(sel_allowance_qb, "allowance(address,address)");
+    getAbiDecoder()->addSignature(sel_approve_qb, "approve(address,uint256)");
+    getAbiDecoder()->addSignature(sel_approveAndCall_qb, "approveAndCall(address,uint256,bytes)");
+    getAbiDecoder()->addSignature(sel_balanceOf_qb, "balanceOf(address)");
+    getAbiDecoder()->addSignature(sel_decimals_qb, "decimals()");
+    getAbiDecoder()->addSignature(sel_name_qb, "name()");
+    getAbiDecoder()->addSignature(sel_symbol_qb, "symbol()");
+    getAbiDecoder()->addSignature(sel_totalSupply_qb, "totalSupply()");
+    getAbiDecoder()->addSignature(sel_transfer_qb, "transfer(address,uint256)");
+    getAbiDecoder()->addSignature(sel_transferFrom_qb, "transferFrom(address,address,uint256)");
+    getAbiDecoder()->addSignature(sel_version_qb, "version()");
     walletlib_init();
 }
 
@@ -38,67 +50,60 @@ const string_q func_version_qb = "0x54fd4d50";
 
 //-----------------------------------------------------------------------
 const CTransaction *promoteToToken(const CTransaction *p) {
-    if (p && (p->input.length() >= 10 || p->input == "0x")) {
-        string_q items[256];
-        size_t nItems = 0;
-
-        string_q encoding = extract(p->input, 0, 10);
-        string_q params   = extract(p->input, 10);
+    CAbiData call;
+    if (p && call.fromInput(p->input)) {
         // EXISTING_CODE
         // EXISTING_CODE
 
-        if (encoding == func_approve_qb) {
-            // function approve(address _spender, uint256 _value)
-            // 0x095ea7b3
-            QApprove *a = new QApprove;
-            *(CTransaction*)a = *p;  // NOLINT
-            a->_spender = toAddress(extract(params, 0*64, 64));
-            a->_value = toWei("0x"+extract(params, 1*64, 64));
-            items[nItems++] = "address";
-            items[nItems++] = "uint256";
-            a->function = toFunction("approve", params, nItems, items);
-            return a;
-
-        } else if (encoding == func_approveAndCall_qb) {
-            // function approveAndCall(address _spender, uint256 _value, bytes _extraData)
-            // 0xcae9ca51
-            QApproveAndCall *a = new QApproveAndCall;
-            *(CTransaction*)a = *p;  // NOLINT
-            a->_spender = toAddress(extract(params, 0*64, 64));
-            a->_value = toWei("0x"+extract(params, 1*64, 64));
-            a->_extraData = extract(params, 2*64);
-            items[nItems++] = "address";
-            items[nItems++] = "uint256";
-            items[nItems++] = "bytes";
-            a->function = toFunction("approveAndCall", params, nItems, items);
-            return a;
-
-        } else if (encoding == func_transfer_qb) {
-            // function transfer(address _to, uint256 _value)
-            // 0xa9059cbb
-            QTransfer *a = new QTransfer;
-            *(CTransaction*)a = *p;  // NOLINT
-            a->_to = toAddress(extract(params, 0*64, 64));
-            a->_value = toWei("0x"+extract(params, 1*64, 64));
-            items[nItems++] = "address";
-            items[nItems++] = "uint256";
-            a->function = toFunction("transfer", params, nItems, items);
-            return a;
-
-        } else if (encoding == func_transferFrom_qb) {
-            // function transferFrom(address _from, address _to, uint256 _value)
-            // 0x23b872dd
-            QTransferFrom *a = new QTransferFrom;
-            *(CTransaction*)a = *p;  // NOLINT
-            a->_from = toAddress(extract(params, 0*64, 64));
-            a->_to = toAddress(extract(params, 1*64, 64));
-            a->_value = toWei("0x"+extract(params, 2*64, 64));
-            items[nItems++] = "address";
-            items[nItems++] = "address";
-            items[nItems++] = "uint256";
-            a->function = toFunction("transferFrom", params, nItems, items);
-            return a;
-
+        switch (call.selector) {
+            case sel_approve_qb: {
+                // function approve(address _spender, uint256 _value)
+                // 0x095ea7b3
+                QApprove *a = new QApprove;
+                *(CTransaction*)a = *p;  // NOLINT
+                a->_spender = call.getAddress(0);
+                a->_value = call.getUint(1);
+                a->funcPtr = getAbiDecoder()->find(call.selector);
+                return a;
+            }
+
+            case sel_approveAndCall_qb: {
+                // function approveAndCall(address _spender, uint256 _value, bytes _extraData)
+                // 0xcae9ca51
+                QApproveAndCall *a = new QApproveAndCall;
+                *(CTransaction*)a = *p;  // NOLINT
+                a->_spender = call.getAddress(0);
+                a->_value = call.getUint(1);
+                a->_extraData = call.getTailHex(2);
+                a->funcPtr = getAbiDecoder()->find(call.selector);
+                return a;
+            }
+
+            case sel_transfer_qb: {
+                // function transfer(address _to, uint256 _value)
+                // 0xa9059cbb
+                QTransfer *a = new QTransfer;
+                *(CTransaction*)a = *p;  // NOLINT
+                a->_to = call.getAddress(0);
+                a->_value = call.getUint(1);
+                a->funcPtr = getAbiDecoder()->find(call.selector);
+                return a;
+            }
+
+            case sel_transferFrom_qb: {
+                // function transferFrom(address _from, address _to, uint256 _value)
+                // 0x23b872dd
+                QTransferFrom *a = new QTransferFrom;
+                *(CTransaction*)a = *p;  // NOLINT
+                a->_from = call.getAddress(0);
+                a->_to = call.getAddress(1);
+                a->_value = call.getUint(2);
+                a->funcPtr = getAbiDecoder()->find(call.selector);
+                return a;
+            }
+
+            default:
+                break;
         }
         // falls through
     }
@@ -121,30 +126,40 @@ const CLogEntry *promoteToTokenEvent(const CLogEntry *p) {
 
     size_t nTops = p->topics.size();
     if (nTops > 0) {  // the '0'th topic is the event signature
-        string_q data = extract(p->data, 2);
+        CAbiData data;
+        data.fromData(p->data);
         // EXISTING_CODE
         // EXISTING_CODE
 
-        if (fromTopic(p->topics[0]) % evt_Approval_qb) {
-            // event Approval(address indexed _owner, address indexed _spender, uint256 _value)
-            // 0x8c5be1e5ebec7d5bd14f71427d1e84f3dd0314c0f7b2291e5b200ac8c7c3b925
-            QApprovalEvent *a = new QApprovalEvent;
-            *(CLogEntry*)a = *p;  // NOLINT
-            a->_owner = toAddress(nTops > 1 ? fromTopic(p->topics[1]) : "");
-            a->_spender = toAddress(nTops > 2 ? fromTopic(p->topics[2]) : "");
-            a->_value = toWei("0x" + extract(data, 0*64, 64));
-            return a;
-
-        } else if (fromTopic(p->topics[0]) % evt_Transfer_qb) {
-            // event Transfer(address indexed _from, address indexed _to, uint256 _value)
-            // 0xddf252ad1be2c89b69c2b068fc378daa952ba7f163c4a11628f55a4df523b3ef
-            QTransferEvent *a = new QTransferEvent;
-            *(CLogEntry*)a = *p;  // NOLINT
-            a->_from = toAddress(nTops > 1 ? fromTopic(p->topics[1]) : "");
-            a->_to = toAddress(nTops > 2 ? fromTopic(p->topics[2]) : "");
-            a->_value = toWei("0x" + extract(data, 0*64, 64));
-            return a;
-
+        switch (topicSelector(p->topics[0])) {
+            case sel_evt_Approval_qb:
+                if (isTopic(p->topics[0], topic_evt_Approval_qb)) {
+                    // event Approval(address indexed _owner, address indexed _spender, uint256 _value)
+                    // 0x8c5be1e5ebec7d5bd14f71427d1e84f3dd0314c0f7b2291e5b200ac8c7c3b925
+                    QApprovalEvent *a = new QApprovalEvent;
+                    *(CLogEntry*)a = *p;  // NOLINT
+                    a->_owner = (nTops > 1 ? topicAddress(p->topics[1]) : "0x0");
+                    a->_spender = (nTops > 2 ? topicAddress(p->topics[2]) : "0x0");
+                    a->_value = data.getUint(0);
+                    return a;
+                }
+                break;
+
+            case sel_evt_Transfer_qb:
+                if (isTopic(p->topics[0], topic_evt_Transfer_qb)) {
+                    // event Transfer(address indexed _from, address indexed _to, uint256 _value)
+                    // 0xddf252ad1be2c89b69c2b068fc378daa952ba7f163c4a11628f55a4df523b3ef
+                    QTransferEvent *a = new QTransferEvent;
+                    *(CLogEntry*)a = *p;  // NOLINT
+                    a->_from = (nTops > 1 ? topicAddress(p->topics[1]) : "0x0");
+                    a->_to = (nTops > 2 ? topicAddress(p->topics[2]) : "0x0");
+                    a->_value = data.getUint(0);
+                    return a;
+                }
+                break;
+
+            default:
+                break;
         }
         // fall through
     }
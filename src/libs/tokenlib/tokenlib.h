@@ -45,6 +45,25 @@ extern const string_q func_version_qb;
 extern const string_q evt_Approval_qb;
 extern const string_q evt_Transfer_qb;
 
+//------------------------------------------------------------------------
+const uint32_t sel_allowance_qb = 0xdd62ed3e;
+const uint32_t sel_approve_qb = 0x095ea7b3;
+const uint32_t sel_approveAndCall_qb = 0xcae9ca51;
+const uint32_t sel_balanceOf_qb = 0x70a08231;
+const uint32_t sel_decimals_qb = 0x313ce567;
+const uint32_t sel_name_qb = 0x06fdde03;
+const uint32_t sel_symbol_qb = 0x95d89b41;
+const uint32_t sel_totalSupply_qb = 0x18160ddd;
+const uint32_t sel_transfer_qb = 0xa9059cbb;
+const uint32_t sel_transferFrom_qb = 0x23b872dd;
+const uint32_t sel_version_qb = 0x54fd4d50;
+
+//------------------------------------------------------------------------
+const uint32_t sel_evt_Approval_qb = 0x8c5be1e5;
+const uint64_t topic_evt_Approval_qb[4] = { 0x8c5be1e5ebec7d5bULL, 0xd14f71427d1e84f3ULL, 0xdd0314c0f7b2291eULL, 0x5b200ac8c7c3b925ULL };
+const uint32_t sel_evt_Transfer_qb = 0xddf252ad;
+const uint64_t topic_evt_Transfer_qb[4] = { 0xddf252ad1be2c89bULL, 0x69c2b068fc378daaULL, 0x952ba7f163c4a116ULL, 0x28f55a4df523b3efULL };
+
 // EXISTING_CODE
 //-----------------------------------------------------------------------
 inline bool isTokenRelated(const CTransaction *trans) {
@@ -90,8 +90,9 @@ bool QTransfer::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> _to;
-    archive >> _value;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(QTransfer), 2);
+    fields >> _to;
+    fields >> _value;
     finishParse();
     return true;
 }
@@ -91,9 +91,10 @@ bool QTransferEvent::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> _from;
-    archive >> _to;
-    archive >> _value;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(QTransferEvent), 3);
+    fields >> _from;
+    fields >> _to;
+    fields >> _value;
     finishParse();
     return true;
 }
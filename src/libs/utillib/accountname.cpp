@@ -97,11 +97,12 @@ bool CAccountName::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> symbol;
-    archive >> name;
-    archive >> addr;
-    archive >> source;
-    archive >> description;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(CAccountName), 5);
+    fields >> symbol;
+    fields >> name;
+    fields >> addr;
+    fields >> source;
+    fields >> description;
     finishParse();
     return true;
 }
@@ -0,0 +1,139 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include "basetypes.h"
+#include "binaddress.h"
+
+namespace qblocks {
+
+    //-------------------------------------------------------------------------
+    static inline int hexVal(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    //-------------------------------------------------------------------------
+    bool CBinAddress::fromString(const SFAddress& addr) {
+        bzero(bytes, sizeof(bytes));
+
+        // Short addresses (such as '0x0' which we use for contract creations) are left padded
+        const char *s = addr.c_str();
+        size_t len = addr.length();
+        if (len >= 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+            s += 2;
+            len -= 2;
+        }
+        if (len > 40) {
+            // topics hold addresses left padded to 64 characters, keep the right most 40
+            s += (len - 40);
+            len = 40;
+        }
+
+        size_t nib = 40 - len;
+        for (size_t i = 0 ; i < len ; i++, nib++) {
+            int v = hexVal(s[i]);
+            if (v < 0) {
+                bzero(bytes, sizeof(bytes));
+                return false;
+            }
+            bytes[nib >> 1] |= (uint8_t)((nib & 1) ? v : (v << 4));
+        }
+        return true;
+    }
+
+    //-------------------------------------------------------------------------
+    SFAddress CBinAddress::toString(void) const {
+        SFAddress ret;
+        toString(ret);
+        return ret;
+    }
+
+    //-------------------------------------------------------------------------
+    void CBinAddress::toString(SFAddress& addr) const {
+        static const char *digits = "0123456789abcdef";
+        char ret[42];
+        ret[0] = '0'; ret[1] = 'x';
+        for (size_t i = 0 ; i < 20 ; i++) {
+            ret[2 + i * 2]     = digits[bytes[i] >> 4];
+            ret[2 + i * 2 + 1] = digits[bytes[i] & 0x0f];
+        }
+        addr.assign(ret, sizeof(ret));
+    }
+
+    //-------------------------------------------------------------------------
+    uint64_t CBinAddress::hash(void) const {
+        // Addresses are already uniformly distributed, so any eight bytes are a good hash. We
+        // mix in the tail anyway so that hand-made test addresses (0x...0001) do not collide.
+        uint64_t a, b;
+        memcpy(&a, &bytes[0],  sizeof(a));
+        memcpy(&b, &bytes[12], sizeof(b));
+        uint64_t h = a ^ (b * 0x9E3779B97F4A7C15ULL);
+        h ^= (h >> 29);
+        return h;
+    }
+
+    //-------------------------------------------------------------------------
+    bool CBinAddress::isZero(void) const {
+        for (size_t i = 0 ; i < sizeof(bytes) ; i++)
+            if (bytes[i])
+                return false;
+        return true;
+    }
+
+    //-------------------------------------------------------------------------
+    // Only a full length hash converts
+    bool CBinHash::fromString(const SFHash& hash) {
+        bzero(bytes, sizeof(bytes));
+        if (hash.length() != 66 || hash[0] != '0' || (hash[1] != 'x' && hash[1] != 'X'))
+            return false;
+        for (size_t i = 0 ; i < 64 ; i++) {
+            int v = hexVal(hash[i + 2]);
+            if (v < 0) {
+                bzero(bytes, sizeof(bytes));
+                return false;
+            }
+            bytes[i >> 1] |= (uint8_t)((i & 1) ? v : (v << 4));
+        }
+        return true;
+    }
+
+    //-------------------------------------------------------------------------
+    SFHash CBinHash::toString(void) const {
+        SFHash ret;
+        toString(ret);
+        return ret;
+    }
+
+    //-------------------------------------------------------------------------
+    void CBinHash::toString(SFHash& hash) const {
+        static const char *digits = "0123456789abcdef";
+        char ret[66];
+        ret[0] = '0'; ret[1] = 'x';
+        for (size_t i = 0 ; i < 32 ; i++) {
+            ret[2 + i * 2]     = digits[bytes[i] >> 4];
+            ret[2 + i * 2 + 1] = digits[bytes[i] & 0x0f];
+        }
+        hash.assign(ret, sizeof(ret));
+    }
+
+    //-------------------------------------------------------------------------
+    size_t firstDiffNibble(const CBinAddress& a, const CBinAddress& b) {
+        for (size_t i = 0 ; i < 20 ; i++) {
+            if (a.bytes[i] != b.bytes[i])
+                return (i * 2) + ((a.bytes[i] >> 4) == (b.bytes[i] >> 4) ? 1 : 0);
+        }
+        return 40;
+    }
+
+}  // namespace qblocks
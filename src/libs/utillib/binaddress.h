@@ -0,0 +1,66 @@
+#pragma once
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include "conversions.h"
+
+namespace qblocks {
+
+    //-------------------------------------------------------------------------
+    // A fixed width, binary representation of an address. Twenty bytes, big endian, so that
+    // memcmp order is the same as the order of the lower cased hex string.
+    //-------------------------------------------------------------------------
+    class CBinAddress {
+    public:
+        uint8_t bytes[20];
+
+                 CBinAddress (void) { bzero(bytes, sizeof(bytes)); }
+        explicit CBinAddress (const SFAddress& addr) { fromString(addr); }
+
+        bool     fromString  (const SFAddress& addr);
+        SFAddress toString   (void) const;
+        void     toString    (SFAddress& addr) const;  // into the string's own memory
+
+        // the i-th nibble (0 <= i < 40) counting from the most significant
+        uint8_t  nibble      (size_t i) const { return (uint8_t)((i & 1) ? (bytes[i >> 1] & 0x0f) : (bytes[i >> 1] >> 4)); }  // NOLINT
+        uint64_t hash        (void) const;
+        bool     isZero      (void) const;
+
+        bool operator==(const CBinAddress& b) const { return !memcmp(bytes, b.bytes, sizeof(bytes)); }
+        bool operator!=(const CBinAddress& b) const { return  memcmp(bytes, b.bytes, sizeof(bytes)) != 0; }
+        bool operator< (const CBinAddress& b) const { return  memcmp(bytes, b.bytes, sizeof(bytes)) < 0; }
+    };
+    typedef vector<CBinAddress> CBinAddressArray;
+
+    //-------------------------------------------------------------------------
+    // A 32-byte hash in binary, big endian
+    //-------------------------------------------------------------------------
+    class CBinHash {
+    public:
+        uint8_t bytes[32];
+
+                 CBinHash    (void) { bzero(bytes, sizeof(bytes)); }
+
+        bool     fromString  (const SFHash& hash);
+        SFHash   toString    (void) const;
+        void     toString    (SFHash& hash) const;  // into the string's own memory
+
+        bool operator==(const CBinHash& b) const { return !memcmp(bytes, b.bytes, sizeof(bytes)); }
+        bool operator< (const CBinHash& b) const { return  memcmp(bytes, b.bytes, sizeof(bytes)) < 0; }
+    };
+    typedef vector<CBinHash> CBinHashArray;
+
+    //-------------------------------------------------------------------------
+    // index (0 <= ret < 40) of the first nibble at which the two addresses differ, 40 if they are equal
+    extern size_t firstDiffNibble(const CBinAddress& a, const CBinAddress& b);
+
+}  // namespace qblocks
@@ -253,7 +253,7 @@ namespace qblocks {
         string_q ret = substitute(strIn, "0x", "");
 
         // Shorten, but only if all leading zeros
-        string_q leading('0', 64-40);
+        string_q leading(64-40, '0');
         if (ret.length() == 64 && startsWith(ret, leading))
             replace(ret, leading, "");
 
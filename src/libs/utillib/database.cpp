@@ -148,7 +148,8 @@ namespace qblocks {
         // it under one of the create modes then do not create a lock, do not open the file,
         // and let the user know.
         if (!fileExists(m_filename) &&
-            (m_mode != asciiWriteCreate && m_mode != asciiWriteAppend && m_mode != binaryWriteCreate)
+            (m_mode != asciiWriteCreate && m_mode != asciiWriteAppend &&
+             m_mode != binaryWriteCreate && m_mode != binaryWriteAppend)
             ) {
             m_error = LK_FILE_NOT_EXIST;
             m_errorMsg = "File does not exist: " + m_filename;
@@ -167,7 +168,7 @@ namespace qblocks {
 
         } else if (m_mode == binaryReadWrite || m_mode == binaryWriteCreate ||
                    m_mode == asciiReadWrite  || m_mode == asciiWriteAppend  ||
-                   m_mode == asciiWriteCreate) {
+                   m_mode == asciiWriteCreate || m_mode == binaryWriteAppend) {
 
             ASSERT(lockType == LOCK_CREATE || lockType == LOCK_WAIT);
             openIt = createLock(lockType != LOCK_WAIT);
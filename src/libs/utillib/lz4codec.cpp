@@ -0,0 +1,268 @@
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include <algorithm>
+#include <unordered_map>
+#include "utillib.h"
+#include "lz4codec.h"
+
+namespace qblocks {
+
+    //-------------------------------------------------------------------------
+    // The format's limits: a match is at least four bytes, the last five bytes are always
+    // literals, and no match starts in the last twelve bytes
+    #define MIN_MATCH     4
+    #define LAST_LITERALS 5
+    #define MATCH_LIMIT   12
+    #define HASH_LOG      14
+
+    //-------------------------------------------------------------------------
+    inline uint32_t read32(const uint8_t *p) {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    //-------------------------------------------------------------------------
+    inline uint32_t hash4(uint32_t v) {
+        return (v * 2654435761U) >> (32 - HASH_LOG);
+    }
+
+    //-------------------------------------------------------------------------
+    static void putLength(string_q& out, size_t len) {
+        while (len >= 255) {
+            out += (char)255;
+            len -= 255;
+        }
+        out += (char)len;
+    }
+
+    //-------------------------------------------------------------------------
+    static void putSequence(string_q& out, const uint8_t *lits, size_t nLits, size_t offset, size_t matchLen) {
+        size_t m = (matchLen ? matchLen - MIN_MATCH : 0);
+        out += (char)((min(nLits, (size_t)15) << 4) | min(m, (size_t)15));
+        if (nLits >= 15)
+            putLength(out, nLits - 15);
+        out.append((const char*)lits, nLits);  // NOLINT
+        if (!matchLen)
+            return;
+        out += (char)(offset & 0xff);
+        out += (char)(offset >> 8);
+        if (m >= 15)
+            putLength(out, m - 15);
+    }
+
+    //-------------------------------------------------------------------------
+    size_t lz4Compress(const uint8_t *src, size_t srcLen, string_q& out, const uint8_t *dict, size_t dictLen) {
+        size_t startSize = out.size();
+
+        // the dictionary (only the part a match can reach) is laid out in front of the input
+        if (dictLen > LZ4_MAX_DISTANCE) {
+            dict += dictLen - LZ4_MAX_DISTANCE;
+            dictLen = LZ4_MAX_DISTANCE;
+        }
+        string_q work;
+        const uint8_t *buf = src;
+        if (dictLen) {
+            work.reserve(dictLen + srcLen);
+            work.append((const char*)dict, dictLen);  // NOLINT
+            work.append((const char*)src, srcLen);  // NOLINT
+            buf = (const uint8_t*)work.data();  // NOLINT
+        }
+        size_t start = (dictLen ? dictLen : 0);
+        size_t end = start + srcLen;
+
+        // positions are kept plus one so that zero means empty
+        vector<uint32_t> table((size_t)1 << HASH_LOG, 0);
+        for (size_t p = 0 ; p + MIN_MATCH <= dictLen ; p++)
+            table[hash4(read32(buf + p))] = (uint32_t)(p + 1);
+
+        size_t anchor = start, ip = start;
+        size_t limit = (srcLen > MATCH_LIMIT ? end - MATCH_LIMIT : start);
+        while (ip < limit) {
+            uint32_t h = hash4(read32(buf + ip));
+            size_t ref = table[h];
+            table[h] = (uint32_t)(ip + 1);
+            if (!ref || ip - (ref - 1) > LZ4_MAX_DISTANCE || read32(buf + ref - 1) != read32(buf + ip)) {
+                // step faster through data that does not compress
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            size_t m = ref - 1;
+            while (ip > anchor && m > 0 && buf[ip - 1] == buf[m - 1]) {
+                ip--;
+                m--;
+            }
+            size_t len = MIN_MATCH;
+            while (ip + len < end - LAST_LITERALS && buf[m + len] == buf[ip + len])
+                len++;
+
+            putSequence(out, buf + anchor, ip - anchor, ip - m, len);
+            ip += len;
+            anchor = ip;
+            if (ip < limit && ip >= 2)
+                table[hash4(read32(buf + ip - 2))] = (uint32_t)(ip - 1);
+        }
+        putSequence(out, buf + anchor, end - anchor, 0, 0);
+        return out.size() - startSize;
+    }
+
+    //-------------------------------------------------------------------------
+    static bool getLength(const uint8_t *src, size_t srcLen, size_t& ip, size_t& len) {
+        uint8_t b;
+        do {
+            if (ip >= srcLen)
+                return false;
+            b = src[ip++];
+            len += b;
+        } while (b == 255);
+        return true;
+    }
+
+    //-------------------------------------------------------------------------
+    // Copies in eight byte steps, so may write up to seven bytes past dst + len. The caller
+    // makes sure there is room, and that src is at least WILD_COPY bytes behind dst if they overlap.
+    #define WILD_COPY 8
+    inline void wildCopy(uint8_t *dst, const uint8_t *src, size_t len) {
+        for (size_t i = 0 ; i < len ; i += WILD_COPY)
+            memcpy(dst + i, src + i, WILD_COPY);
+    }
+
+    //-------------------------------------------------------------------------
+    bool lz4Decompress(const uint8_t *src, size_t srcLen, uint8_t *dst, size_t dstLen, const uint8_t *dict,
+                        size_t dictLen) {
+        size_t ip = 0, op = 0;
+        while (true) {
+            if (ip >= srcLen)
+                return false;
+            uint8_t token = src[ip++];
+
+            size_t nLits = (token >> 4);
+            if (nLits == 15 && !getLength(src, srcLen, ip, nLits))
+                return false;
+            if (nLits > srcLen - ip || nLits > dstLen - op)
+                return false;
+            if (nLits + WILD_COPY <= srcLen - ip && nLits + WILD_COPY <= dstLen - op)
+                wildCopy(dst + op, src + ip, nLits);
+            else
+                memcpy(dst + op, src + ip, nLits);
+            ip += nLits;
+            op += nLits;
+            if (ip == srcLen)
+                return (op == dstLen);
+
+            if (srcLen - ip < 2)
+                return false;
+            size_t offset = src[ip] | ((size_t)src[ip + 1] << 8);
+            ip += 2;
+            size_t len = (token & 0x0f);
+            if (len == 15 && !getLength(src, srcLen, ip, len))
+                return false;
+            len += MIN_MATCH;
+            if (!offset || offset > op + dictLen || len > dstLen - op)
+                return false;
+
+            if (offset <= op && offset >= WILD_COPY && len + WILD_COPY <= dstLen - op) {
+                wildCopy(dst + op, dst + op - offset, len);
+                op += len;
+
+            } else if (offset <= op && len + WILD_COPY <= dstLen - op) {
+                // a short repeat: lay down eight bytes one at a time, then copy whole periods
+                for (size_t i = 0 ; i < WILD_COPY ; i++)
+                    dst[op + i] = dst[op + i - offset];
+                size_t period = offset * ((WILD_COPY + offset - 1) / offset);
+                if (len > WILD_COPY)
+                    wildCopy(dst + op + WILD_COPY, dst + op + WILD_COPY - period, len - WILD_COPY);
+                op += len;
+
+            } else if (offset <= op && offset >= len) {
+                memcpy(dst + op, dst + op - offset, len);
+                op += len;
+
+            } else {
+                // overlapping, or starting in the dictionary
+                for (size_t i = 0 ; i < len ; i++, op++)
+                    dst[op] = (offset > op ? dict[dictLen - (offset - op)] : dst[op - offset]);
+            }
+        }
+    }
+
+    //-------------------------------------------------------------------------
+    // The dictionary is built from segments of SEGMENT_LEN bytes, scored by how many samples
+    // share each of their GRAM_LEN byte substrings
+    #define GRAM_LEN    8
+    #define SEGMENT_LEN 64
+
+    //-------------------------------------------------------------------------
+    inline uint64_t read64(const uint8_t *p) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    //-------------------------------------------------------------------------
+    void trainDictionary(const CStringArray& samples, size_t maxSize, string_q& dict) {
+        dict = "";
+        string_q corpus;
+        for (size_t i = 0 ; i < samples.size() ; i++)
+            corpus += samples[i];
+        if (corpus.length() <= maxSize) {
+            dict = corpus;
+            return;
+        }
+        const uint8_t *data = (const uint8_t*)corpus.data();  // NOLINT
+
+        // how many samples each gram appears in
+        unordered_map<uint64_t, uint32_t> freq;
+        unordered_map<uint64_t, uint32_t> lastSample;
+        for (size_t s = 0, base = 0 ; s < samples.size() ; base += samples[s].length(), s++) {
+            for (size_t p = 0 ; p + GRAM_LEN <= samples[s].length() ; p++) {
+                uint64_t g = read64(data + base + p);
+                unordered_map<uint64_t, uint32_t>::iterator it = lastSample.find(g);
+                if (it == lastSample.end() || it->second != s + 1) {
+                    lastSample[g] = (uint32_t)(s + 1);
+                    freq[g]++;
+                }
+            }
+        }
+
+        // the corpus is cut into one epoch per segment, and each epoch gives its best segment.
+        // A segment's grams no longer count once it is chosen.
+        size_t nSegments = maxSize / SEGMENT_LEN;
+        size_t epoch = max(corpus.length() / nSegments, (size_t)SEGMENT_LEN);
+        size_t nGrams = SEGMENT_LEN - GRAM_LEN + 1;
+        for (size_t e = 0 ; e + SEGMENT_LEN <= corpus.length() && dict.length() + SEGMENT_LEN <= maxSize ; e += epoch) {
+            size_t last = min(e + epoch, corpus.length() - SEGMENT_LEN + 1);
+            uint64_t score = 0, best = 0;
+            size_t bestAt = e;
+            for (size_t g = 0 ; g < nGrams ; g++)
+                score += freq[read64(data + e + g)];
+            for (size_t p = e ; p < last ; p++) {
+                if (score > best) {
+                    best = score;
+                    bestAt = p;
+                }
+                if (p + 1 < last) {
+                    score -= freq[read64(data + p)];
+                    score += freq[read64(data + p + nGrams)];
+                }
+            }
+            if (best < 2 * nGrams)  // nothing in this epoch recurs
+                continue;
+            dict.append(corpus, bestAt, SEGMENT_LEN);
+            for (size_t g = 0 ; g < nGrams ; g++)
+                freq[read64(data + bestAt + g)] = 0;
+        }
+    }
+
+}  // namespace qblocks
@@ -0,0 +1,42 @@
+#pragma once
+/*-------------------------------------------------------------------------------------------
+ * QuickBlocks - Decentralized, useful, and detailed data from Ethereum blockchains
+ * Copyright (c) 2018 Great Hill Corporation (http://quickblocks.io)
+ *
+ * This program is free software: you may redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version. This program is
+ * distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details. You should have received a copy of the GNU General
+ * Public License along with this program. If not, see http://www.gnu.org/licenses/.
+ *-------------------------------------------------------------------------------------------*/
+#include "conversions.h"
+
+namespace qblocks {
+
+    //-------------------------------------------------------------------------
+    // A compressor and decompressor for the LZ4 block format (sequences of literals and
+    // matches reaching back at most 64KB). A dictionary is treated as data that came just
+    // before the input, so the first bytes of a small record can refer to it. The same
+    // dictionary must be handed to the decompressor.
+    //-------------------------------------------------------------------------
+    #define LZ4_MAX_DISTANCE 65535
+
+    //-------------------------------------------------------------------------
+    // Appends the compressed form of src to out and returns the number of bytes appended
+    extern size_t lz4Compress(const uint8_t *src, size_t srcLen, string_q& out,
+                                const uint8_t *dict = NULL, size_t dictLen = 0);
+
+    //-------------------------------------------------------------------------
+    // Decodes exactly dstLen bytes into dst. Returns false if src is damaged, is not
+    // exactly dstLen bytes of output, or reaches back further than the dictionary.
+    extern bool lz4Decompress(const uint8_t *src, size_t srcLen, uint8_t *dst, size_t dstLen,
+                                const uint8_t *dict = NULL, size_t dictLen = 0);
+
+    //-------------------------------------------------------------------------
+    // Builds a dictionary of at most maxSize bytes from the segments that recur most often
+    // across the samples. Samples shorter in total than maxSize are simply concatenated.
+    extern void trainDictionary(const CStringArray& samples, size_t maxSize, string_q& dict);
+
+}  // namespace qblocks
@@ -67,7 +67,7 @@ bool CMemMapFile::open(const std::string& filename, size_t mappedBytes, CacheHin
 void CMemMapFile::close() {
     _filesize = 0;
     if (_mappedView) {
-        ::munmap(_mappedView, _filesize);
+        ::munmap(_mappedView, _mappedBytes);
         _mappedView = NULL;
     }
 
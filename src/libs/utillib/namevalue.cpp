@@ -90,8 +90,9 @@ bool CNameValue::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> name;
-    archive >> value;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(CNameValue), 2);
+    fields >> name;
+    fields >> value;
     finishParse();
     return true;
 }
@@ -737,6 +737,15 @@ const char *STR_ONE_LINE = "| {S} | {L} | {D} |\n";
         if (verbose && !isTestMode())
             cout << "txtDate: " << txtDate << " binDate: " << binDate << "\n";
 
+        // Long running processes (resident servers) read the database once, until it changes
+        static CAccountNameArray loaded;
+        static string_q loadedFrom;
+        static SFTime loadedDate;
+        if (!loaded.empty() && loadedFrom == textFile && loadedDate == txtDate) {
+            namedAccounts = loaded;
+            return true;
+        }
+
         if (binDate > txtDate) {
             SFArchive nameCache(READING_ARCHIVE);
             if (nameCache.Lock(binFile, binaryReadOnly, LOCK_NOWAIT)) {
@@ -744,6 +753,9 @@ const char *STR_ONE_LINE = "| {S} | {L} | {D} |\n";
                     cout << "Reading from binary cache\n";
                 nameCache >> namedAccounts;
                 nameCache.Release();
+                loaded = namedAccounts;
+                loadedFrom = textFile;
+                loadedDate = txtDate;
                 return true;
             }
         }
@@ -779,6 +791,9 @@ const char *STR_ONE_LINE = "| {S} | {L} | {D} |\n";
             nameCache.Release();
         }
 
+        loaded = namedAccounts;
+        loadedFrom = textFile;
+        loadedDate = txtDate;
         return true;
     }
 
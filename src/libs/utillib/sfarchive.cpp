@@ -13,6 +13,7 @@
 #include "basetypes.h"
 #include "biglib.h"
 #include "sfarchive.h"
+#include "runtimeclass.h"
 
 namespace qblocks {
 
@@ -63,7 +64,144 @@ namespace qblocks {
         return *this;
     }
 
+    //----------------------------------------------------------------------
+    uint32_t CArchiveDictionary::addressId(const CBinAddress& addr) {
+        map<CBinAddress, uint32_t>::iterator it = addressIds.find(addr);
+        if (it != addressIds.end())
+            return it->second;
+        uint32_t id = (uint32_t)addresses.size();
+        addressIds[addr] = id;
+        addresses.push_back(addr);
+        return id;
+    }
+
+    //----------------------------------------------------------------------
+    uint32_t CArchiveDictionary::hashId(const CBinHash& hash) {
+        map<CBinHash, uint32_t>::iterator it = hashIds.find(hash);
+        if (it != hashIds.end())
+            return it->second;
+        uint32_t id = (uint32_t)hashes.size();
+        hashIds[hash] = id;
+        hashes.push_back(hash);
+        return id;
+    }
+
+    //----------------------------------------------------------------------
+    void CArchiveDictionary::clear(void) {
+        addresses.clear();
+        hashes.clear();
+        addressIds.clear();
+        hashIds.clear();
+    }
+
+    //----------------------------------------------------------------------
+    // Every class registers schema, deleted and showing (ids 1001 to 1003) and then the
+    // fields it stores in the order it stores them, so a stored field's id gives its place
+    // even after the field list has been sorted for display
+    #define FIRST_STORED_ID 1004
+    #define ALL_FIELDS      ((uint64_t)-1)
+
+    //----------------------------------------------------------------------
+    void CFieldProjection::addField(const CRuntimeClass *pClass, const string_q& fieldName) {
+        uint64_t& mask = masks[pClass];
+        if (mask == ALL_FIELDS)
+            return;
+        string_q name = toLower(fieldName);
+        for (size_t i = 0 ; i < pClass->fieldList.size() ; i++) {
+            const CFieldData *field = &pClass->fieldList[i];
+            if (toLower(field->getName()) != name)
+                continue;
+            if (field->getID() >= FIRST_STORED_ID + 64)
+                mask = ALL_FIELDS;
+            else if (field->getID() >= FIRST_STORED_ID)
+                mask |= (1ULL << (field->getID() - FIRST_STORED_ID));
+            return;
+        }
+        mask = ALL_FIELDS;  // not a registered field, so we cannot tell what it needs
+    }
+
+    //----------------------------------------------------------------------
+    // Adds the fields a display format shows ({NAME}, {p:NAME}, {w:10:NAME} and so on). An
+    // empty format shows every field.
+    void CFieldProjection::addFormat(const CRuntimeClass *pClass, const string_q& format) {
+        masks[pClass];  // the class is projected even if the format shows none of its fields
+        if (format.empty()) {
+            masks[pClass] = ALL_FIELDS;
+            return;
+        }
+        string_q fmt = format;
+        while (contains(fmt, "{")) {
+            nextTokenClear(fmt, '{', false);
+            string_q name = nextTokenClear(fmt, '}', false);
+            replace(name, "b:", "");
+            replace(name, "p:", "");
+            while (contains(name, ":"))
+                nextTokenClear(name, ':');
+            if (!name.empty())
+                addField(pClass, name);
+        }
+    }
+
+    //----------------------------------------------------------------------
+    uint64_t CFieldProjection::fieldMask(const CRuntimeClass *pClass) const {
+        map<const CRuntimeClass*, uint64_t>::const_iterator it = masks.find(pClass);
+        return (it == masks.end() ? ALL_FIELDS : it->second);
+    }
+
+    //----------------------------------------------------------------------
+    // True if the projection asks for the field (calculated fields included), or cannot tell
+    bool CFieldProjection::wantsField(const CRuntimeClass *pClass, const string_q& fieldName) const {
+        uint64_t mask = fieldMask(pClass);
+        if (mask == ALL_FIELDS)
+            return true;
+        CFieldProjection one;
+        one.addField(pClass, fieldName);
+        return (one.fieldMask(pClass) & mask) != 0;
+    }
+
+    //----------------------------------------------------------------------
+    CFieldReader::CFieldReader(SFArchive& ar, const CRuntimeClass *pClass, size_t nFields)
+        : archive(ar), mask(ALL_FIELDS), next(0) {
+        if (archive.m_skipping) {
+            mask = 0;
+        } else if (archive.m_projection) {
+            mask = archive.m_projection->fieldMask(pClass);
+            // a field past the stored ones is calculated, and may need any of them
+            if (nFields < 64 && (mask >> nFields))
+                mask = ALL_FIELDS;
+        }
+    }
+
+    //----------------------------------------------------------------------
+    // A string's length is written first, so these values (which no length can have) mark
+    // a reference into the archive's dictionary
+    #define ADDRESS_REF ((unsigned long)-2)  // NOLINT
+    #define HASH_REF    ((unsigned long)-3)  // NOLINT
+
+    //----------------------------------------------------------------------
+    // Only strings that convert back exactly go into the dictionary
+    static bool isLowerHex(const string_q& str, size_t len) {
+        if (str.length() != len || str[0] != '0' || str[1] != 'x')
+            return false;
+        for (size_t i = 2 ; i < len ; i++)
+            if (!((str[i] >= '0' && str[i] <= '9') || (str[i] >= 'a' && str[i] <= 'f')))
+                return false;
+        return true;
+    }
+
     SFArchive& SFArchive::operator<<(const string_q& str) {
+        if (m_dictionary && isLowerHex(str, 42)) {
+            Write(ADDRESS_REF);
+            Write(m_dictionary->addressId(CBinAddress(str)));
+            return *this;
+        }
+        if (m_dictionary && isLowerHex(str, 66)) {
+            CBinHash hash;
+            hash.fromString(str);
+            Write(HASH_REF);
+            Write(m_dictionary->hashId(hash));
+            return *this;
+        }
         Write(str);
         return *this;
     }
@@ -148,10 +286,49 @@ namespace qblocks {
     }
 
     SFArchive& SFArchive::operator>>(string_q& str) {
-        Read(str);
+        if (!m_dictionary) {
+            Read(str);
+            return *this;
+        }
+
+        unsigned long len = 0;  // NOLINT
+        Read(len);
+        if (len == ADDRESS_REF || len == HASH_REF) {
+            unsigned int id = 0;
+            Read(id);
+            // written straight into the string, so a string being read again keeps its memory
+            if (len == ADDRESS_REF && id < m_dictionary->addresses.size())
+                m_dictionary->addresses[id].toString(str);
+            else if (len == HASH_REF && id < m_dictionary->hashes.size())
+                m_dictionary->hashes[id].toString(str);
+            else
+                str.clear();
+            return *this;
+        }
+        str.resize(len);
+        if (len)
+            Read(&str[0], sizeof(char), len);
         return *this;
     }
 
+    //----------------------------------------------------------------------
+    void SFArchive::skipString(void) {
+        unsigned long len = 0;  // NOLINT
+        Read(len);
+        if (m_dictionary && (len == ADDRESS_REF || len == HASH_REF))
+            Seek(sizeof(unsigned int), SEEK_CUR);
+        else
+            Seek((long)len, SEEK_CUR);  // NOLINT
+    }
+
+    //----------------------------------------------------------------------
+    void SFArchive::skipBigUint(void) {
+        unsigned int capacity = 0, len = 0;
+        Read(capacity);
+        Read(len);
+        Seek((long)(len * sizeof(uint64_t)), SEEK_CUR);  // NOLINT
+    }
+
     SFArchive& SFArchive::operator>>(SFUintBN& bn) {
         // Note: I experimented with writing out
         // the blk in one Read/Write but it was
@@ -11,11 +11,13 @@
  * General Public License for more details. You should have received a copy of the GNU General
  * Public License along with this program. If not, see http://www.gnu.org/licenses/.
  *-------------------------------------------------------------------------------------------*/
+#include <type_traits>
 #include "exportcontext.h"
 #include "database.h"
 #include "conversions.h"
 #include "version.h"
 #include "sftime.h"
+#include "binaddress.h"
 
 namespace qblocks {
 
@@ -23,8 +25,47 @@ namespace qblocks {
     #define WRITING_ARCHIVE false
 
     class CBaseNode;
+    class CRuntimeClass;
     typedef bool (*VISITARCHIVEFUNC)(CBaseNode& node, void *data);
 
+    //-----------------------------------------------------------------------------------------
+    // The fields of each class a reading archive decodes. The rest are skipped over (using
+    // the lengths written with them) and keep their default values. A class with no entry is
+    // read in full, as is a class asked for a field that is not stored (a calculated field
+    // may depend on any of them). Classes must be registered before they are added. Objects
+    // still run finishParse on what was read.
+    //-----------------------------------------------------------------------------------------
+    class CFieldProjection {
+    public:
+        void     addField   (const CRuntimeClass *pClass, const string_q& fieldName);
+        void     addFormat  (const CRuntimeClass *pClass, const string_q& format);
+        uint64_t fieldMask  (const CRuntimeClass *pClass) const;
+        bool     wantsField (const CRuntimeClass *pClass, const string_q& fieldName) const;
+        void     clear      (void) { masks.clear(); }
+
+    private:
+        map<const CRuntimeClass*, uint64_t> masks;  // bit i is the i-th field the class stores
+    };
+
+    //-----------------------------------------------------------------------------------------
+    // Addresses and hashes that an archive writes once, in binary, and refers to by number. An
+    // archive with a dictionary writes each lower case address or hash string as a reference
+    // into it. The dictionary is kept (and must be restored) by whoever owns the archive.
+    //-----------------------------------------------------------------------------------------
+    class CArchiveDictionary {
+    public:
+        CBinAddressArray addresses;
+        CBinHashArray    hashes;
+
+        uint32_t addressId(const CBinAddress& addr);
+        uint32_t hashId   (const CBinHash& hash);
+        void     clear    (void);
+
+    private:
+        map<CBinAddress, uint32_t> addressIds;
+        map<CBinHash, uint32_t>    hashIds;
+    };
+
     //-----------------------------------------------------------------------------------------
     class SFArchive : public CSharedResource {
     private:
@@ -37,13 +78,19 @@ namespace qblocks {
         };
 
     public:
-        SFArchiveHeader  m_header;
-        bool             m_isReading;
+        SFArchiveHeader     m_header;
+        bool                m_isReading;
+        CArchiveDictionary *m_dictionary;
+        const CFieldProjection *m_projection;  // NULL to read every field
+        size_t              m_skipping;        // greater than zero while skipping an object
         // VISITARCHIVEFUNC writeMsgFunc;
         // VISITARCHIVEFUNC readMsgFunc;
 
         explicit SFArchive(bool isReading) : CSharedResource() {
             m_isReading        = isReading;
+            m_dictionary       = NULL;
+            m_projection       = NULL;
+            m_skipping         = 0;
             m_header.m_version = getVersionNum();
             // writeMsgFunc     = NULL;
             // readMsgFunc      = NULL;
@@ -100,6 +147,9 @@ namespace qblocks {
         SFArchive& operator>>(string_q& str);
         SFArchive& operator>>(SFUintBN& bn);
         SFArchive& operator>>(SFIntBN& bn);
+
+        void skipString(void);
+        void skipBigUint(void);
     };
 
     extern SFArchive& operator<<(SFArchive& archive, const CStringArray& array);
@@ -110,4 +160,67 @@ namespace qblocks {
     extern SFArchive& operator>>(SFArchive& archive, SFBigUintArray& array);
     extern SFArchive& operator>>(SFArchive& archive, SFUintArray& array);
 
+    //-----------------------------------------------------------------------------------------
+    // Moves an archive past a value without keeping it. Numbers and strings are seeked over.
+    // An object (a CBaseNode) is read with every one of its own fields skipped.
+    template<class T> inline void skipValue(SFArchive& archive, T& unused, true_type isNumber) {
+        archive.Seek(sizeof(T), SEEK_CUR);
+    }
+    template<class T> inline void skipValue(SFArchive& archive, T& unused, false_type isNumber) {
+        archive.m_skipping++;
+        T scratch;
+        scratch.Serialize(archive);
+        archive.m_skipping--;
+    }
+    template<class T> inline void skipValue(SFArchive& archive, T& val) {
+        skipValue(archive, val, is_arithmetic<T>());
+    }
+    inline void skipValue(SFArchive& archive, string_q& unused) {
+        archive.skipString();
+    }
+    inline void skipValue(SFArchive& archive, SFUintBN& unused) {
+        archive.skipBigUint();
+    }
+    inline void skipValue(SFArchive& archive, SFIntBN& unused) {
+        archive.Seek(sizeof(unsigned int), SEEK_CUR);
+        archive.skipBigUint();
+    }
+    template<class T> inline void skipValues(SFArchive& archive, uint64_t count, T& unused, true_type isNumber) {
+        archive.Seek((long)(count * sizeof(T)), SEEK_CUR);  // NOLINT
+    }
+    template<class T> inline void skipValues(SFArchive& archive, uint64_t count, T& unused, false_type isNumber) {
+        for (uint64_t i = 0 ; i < count ; i++)
+            skipValue(archive, unused);
+    }
+    template<class T> inline void skipValue(SFArchive& archive, vector<T>& array) {
+        array.clear();  // an object read again may still hold an earlier array
+        uint64_t count = 0;
+        archive >> count;
+        T element;
+        skipValues(archive, count, element, is_arithmetic<T>());
+    }
+
+    //-----------------------------------------------------------------------------------------
+    // Reads the fields of one object in the order they were written, decoding the ones the
+    // archive's projection wants and skipping the others. makeClass generates its use in
+    // each class's Serialize. nFields is the number of fields the class stores.
+    //-----------------------------------------------------------------------------------------
+    class CFieldReader {
+    public:
+        CFieldReader(SFArchive& ar, const CRuntimeClass *pClass, size_t nFields);
+
+        template<class T> CFieldReader& operator>>(T& val) {
+            if ((mask >> (next++ & 63)) & 1)
+                archive >> val;
+            else
+                skipValue(archive, val);
+            return *this;
+        }
+
+    private:
+        SFArchive& archive;
+        uint64_t   mask;
+        size_t     next;
+    };
+
 }  // namespace qblocks
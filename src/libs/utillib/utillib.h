@@ -33,5 +33,7 @@
 #include "namevalue.h"
 #include "accountname.h"
 #include "memmap.h"
+#include "binaddress.h"
+#include "lz4codec.h"
 
 using namespace qblocks;  // NOLINT
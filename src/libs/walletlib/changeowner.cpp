@@ -90,8 +90,9 @@ bool QChangeOwner::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> _from;
-    archive >> _to;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(QChangeOwner), 2);
+    fields >> _from;
+    fields >> _to;
     finishParse();
     return true;
 }
@@ -89,7 +89,8 @@ bool QChangeRequirement::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> _newRequired;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(QChangeRequirement), 1);
+    fields >> _newRequired;
     finishParse();
     return true;
 }
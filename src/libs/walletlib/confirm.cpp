@@ -89,7 +89,8 @@ bool QConfirm::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> _h;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(QConfirm), 1);
+    fields >> _h;
     finishParse();
     return true;
 }
@@ -101,11 +101,12 @@ bool QConfirmationNeededEvent::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> operation;
-    archive >> initiator;
-    archive >> value;
-    archive >> to;
-    archive >> data;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(QConfirmationNeededEvent), 5);
+    fields >> operation;
+    fields >> initiator;
+    fields >> value;
+    fields >> to;
+    fields >> data;
     finishParse();
     return true;
 }
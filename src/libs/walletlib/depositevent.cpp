@@ -92,8 +92,9 @@ bool QDepositEvent::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> from;
-    archive >> value;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(QDepositEvent), 2);
+    fields >> from;
+    fields >> value;
     finishParse();
     return true;
 }
@@ -91,9 +91,10 @@ bool QExecute::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> _to;
-    archive >> _value;
-    archive >> _data;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(QExecute), 3);
+    fields >> _to;
+    fields >> _value;
+    fields >> _data;
     finishParse();
     return true;
 }
@@ -89,7 +89,8 @@ bool QIsOwner::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> _addr;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(QIsOwner), 1);
+    fields >> _addr;
     finishParse();
     return true;
 }
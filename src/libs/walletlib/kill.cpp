@@ -89,7 +89,8 @@ bool QKill::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> _to;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(QKill), 1);
+    fields >> _to;
     finishParse();
     return true;
 }
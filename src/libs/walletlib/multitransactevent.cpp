@@ -99,11 +99,12 @@ bool QMultiTransactEvent::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> owner;
-    archive >> operation;
-    archive >> value;
-    archive >> to;
-    archive >> data;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(QMultiTransactEvent), 5);
+    fields >> owner;
+    fields >> operation;
+    fields >> value;
+    fields >> to;
+    fields >> data;
     finishParse();
     return true;
 }
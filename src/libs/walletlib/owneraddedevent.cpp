@@ -89,7 +89,8 @@ bool QOwnerAddedEvent::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> newOwner;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(QOwnerAddedEvent), 1);
+    fields >> newOwner;
     finishParse();
     return true;
 }
@@ -92,8 +92,9 @@ bool QOwnerChangedEvent::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> oldOwner;
-    archive >> newOwner;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(QOwnerChangedEvent), 2);
+    fields >> oldOwner;
+    fields >> newOwner;
     finishParse();
     return true;
 }
@@ -89,7 +89,8 @@ bool QOwnerRemovedEvent::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> oldOwner;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(QOwnerRemovedEvent), 1);
+    fields >> oldOwner;
     finishParse();
     return true;
 }
@@ -89,7 +89,8 @@ bool QRemoveOwner::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> _owner;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(QRemoveOwner), 1);
+    fields >> _owner;
     finishParse();
     return true;
 }
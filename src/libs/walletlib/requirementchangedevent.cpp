@@ -89,7 +89,8 @@ bool QRequirementChangedEvent::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> newRequirement;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(QRequirementChangedEvent), 1);
+    fields >> newRequirement;
     finishParse();
     return true;
 }
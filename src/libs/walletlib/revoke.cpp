@@ -89,7 +89,8 @@ bool QRevoke::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> _operation;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(QRevoke), 1);
+    fields >> _operation;
     finishParse();
     return true;
 }
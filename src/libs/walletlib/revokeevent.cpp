@@ -90,8 +90,9 @@ bool QRevokeEvent::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> owner;
-    archive >> operation;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(QRevokeEvent), 2);
+    fields >> owner;
+    fields >> operation;
     finishParse();
     return true;
 }
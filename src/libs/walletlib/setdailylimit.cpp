@@ -89,7 +89,8 @@ bool QSetDailyLimit::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> _newLimit;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(QSetDailyLimit), 1);
+    fields >> _newLimit;
     finishParse();
     return true;
 }
@@ -98,10 +98,11 @@ bool QSingleTransactEvent::Serialize(SFArchive& archive) {
 
     // EXISTING_CODE
     // EXISTING_CODE
-    archive >> owner;
-    archive >> value;
-    archive >> to;
-    archive >> data;
+    CFieldReader fields(archive, GETRUNTIME_CLASS(QSingleTransactEvent), 4);
+    fields >> owner;
+    fields >> value;
+    fields >> to;
+    fields >> data;
     finishParse();
     return true;
 }
@@ -35,6 +35,22 @@ void walletlib_init(void) {
     QResetSpentToday::registerClass();
     QRevoke::registerClass();
     QSetDailyLimit::registerClass();
+
+    getAbiDecoder()->addSignature(sel_addOwner_qb, "addOwner(address)");
+    getAbiDecoder()->addSignature(sel_changeOwner_qb, "changeOwner(address,address)");
+    getAbiDecoder()->addSignature(sel_changeRequirement_qb, "changeRequirement(uint256)");
+    getAbiDecoder()->addSignature(sel_confirm_qb, "confirm(bytes32)");
+    getAbiDecoder()->addSignature(sel_execute_qb, "execute(address,uint256,bytes)");
+    getAbiDecoder()->addSignature(sel_hasConfirmed_qb, "hasConfirmed(bytes32,address)");
+    getAbiDecoder()->addSignature(sel_isOwner_qb, "isOwner(address)");
+    getAbiDecoder()->addSignature(sel_kill_qb, "kill(address)");
+    getAbiDecoder()->addSignature(sel_mdailyLimit_qb, "m_dailyLimit()");
+    getAbiDecoder()->addSignature(sel_mnumOwners_qb, "m_numOwners()");
+    getAbiDecoder()->addSignature(sel_mrequired_qb, "m_required()");
+    getAbiDecoder()->addSignature(sel_removeOwner_qb, "removeOwner(address)");
+    getAbiDecoder()->addSignature(sel_resetSpentToday_qb, "resetSpentToday()");
+    getAbiDecoder()->addSignature(sel_revoke_qb, "revoke(bytes32)");
+    getAbiDecoder()->addSignature(sel_setDailyLimit_qb, "setDailyLimit(uint256)");
 }
 
 //-----------------------------------------------------------------------
@@ -56,129 +72,126 @@ const string_q func_setDailyLimit_qb = "0xb20d30a9";
 
 //-----------------------------------------------------------------------
 const CTransaction *promoteToWallet(const CTransaction *p) {
-    if (p && (p->input.length() >= 10 || p->input == "0x")) {
-        string_q items[256];
-        size_t nItems = 0;
-
-        string_q encoding = extract(p->input, 0, 10);
-        string_q params   = extract(p->input, 10);
+    CAbiData call;
+    if (p && call.fromInput(p->input)) {
         // EXISTING_CODE
         // EXISTING_CODE
 
-        if (encoding == func_addOwner_qb) {
-            // function addOwner(address _owner)
-            // 0x7065cb48
-            QAddOwner *a = new QAddOwner;
-            *(CTransaction*)a = *p;  // NOLINT
-            a->_owner = toAddress(extract(params, 0*64, 64));
-            items[nItems++] = "address";
-            a->function = toFunction("addOwner", params, nItems, items);
-            return a;
-
-        } else if (encoding == func_changeOwner_qb) {
-            // function changeOwner(address _from, address _to)
-            // 0xf00d4b5d
-            QChangeOwner *a = new QChangeOwner;
-            *(CTransaction*)a = *p;  // NOLINT
-            a->_from = toAddress(extract(params, 0*64, 64));
-            a->_to = toAddress(extract(params, 1*64, 64));
-            items[nItems++] = "address";
-            items[nItems++] = "address";
-            a->function = toFunction("changeOwner", params, nItems, items);
-            return a;
-
-        } else if (encoding == func_changeRequirement_qb) {
-            // function changeRequirement(uint256 _newRequired)
-            // 0xba51a6df
-            QChangeRequirement *a = new QChangeRequirement;
-            *(CTransaction*)a = *p;  // NOLINT
-            a->_newRequired = toWei("0x"+extract(params, 0*64, 64));
-            items[nItems++] = "uint256";
-            a->function = toFunction("changeRequirement", params, nItems, items);
-            return a;
-
-        } else if (encoding == func_confirm_qb) {
-            // function confirm(bytes32 _h)
-            // 0x797af627
-            QConfirm *a = new QConfirm;
-            *(CTransaction*)a = *p;  // NOLINT
-            a->_h = extract(params, 0*64, 64);
-            items[nItems++] = "bytes32";
-            a->function = toFunction("confirm", params, nItems, items);
-            return a;
-
-        } else if (encoding == func_execute_qb) {
-            // function execute(address _to, uint256 _value, bytes _data)
-            // 0xb61d27f6
-            QExecute *a = new QExecute;
-            *(CTransaction*)a = *p;  // NOLINT
-            a->_to = toAddress(extract(params, 0*64, 64));
-            a->_value = toWei("0x"+extract(params, 1*64, 64));
-            a->_data = extract(params, 2*64);
-            items[nItems++] = "address";
-            items[nItems++] = "uint256";
-            items[nItems++] = "bytes";
-            a->function = toFunction("execute", params, nItems, items);
-            return a;
-
-        } else if (encoding == func_isOwner_qb) {
-            // function isOwner(address _addr)
-            // 0x2f54bf6e
-            QIsOwner *a = new QIsOwner;
-            *(CTransaction*)a = *p;  // NOLINT
-            a->_addr = toAddress(extract(params, 0*64, 64));
-            items[nItems++] = "address";
-            a->function = toFunction("isOwner", params, nItems, items);
-            return a;
-
-        } else if (encoding == func_kill_qb) {
-            // function kill(address _to)
-            // 0xcbf0b0c0
-            QKill *a = new QKill;
-            *(CTransaction*)a = *p;  // NOLINT
-            a->_to = toAddress(extract(params, 0*64, 64));
-            items[nItems++] = "address";
-            a->function = toFunction("kill", params, nItems, items);
-            return a;
-
-        } else if (encoding == func_removeOwner_qb) {
-            // function removeOwner(address _owner)
-            // 0x173825d9
-            QRemoveOwner *a = new QRemoveOwner;
-            *(CTransaction*)a = *p;  // NOLINT
-            a->_owner = toAddress(extract(params, 0*64, 64));
-            items[nItems++] = "address";
-            a->function = toFunction("removeOwner", params, nItems, items);
-            return a;
-
-        } else if (encoding == func_resetSpentToday_qb) {
-            // function resetSpentToday()
-            // 0x5c52c2f5
-            QResetSpentToday *a = new QResetSpentToday;
-            *(CTransaction*)a = *p;  // NOLINT
-            a->function = toFunction("resetSpentToday", params, nItems, items);
-            return a;
-
-        } else if (encoding == func_revoke_qb) {
-            // function revoke(bytes32 _operation)
-            // 0xb75c7dc6
-            QRevoke *a = new QRevoke;
-            *(CTransaction*)a = *p;  // NOLINT
-            a->_operation = extract(params, 0*64, 64);
-            items[nItems++] = "bytes32";
-            a->function = toFunction("revoke", params, nItems, items);
-            return a;
-
-        } else if (encoding == func_setDailyLimit_qb) {
-            // function setDailyLimit(uint256 _newLimit)
-            // 0xb20d30a9
-            QSetDailyLimit *a = new QSetDailyLimit;
-            *(CTransaction*)a = *p;  // NOLINT
-            a->_newLimit = toWei("0x"+extract(params, 0*64, 64));
-            items[nItems++] = "uint256";
-            a->function = toFunction("setDailyLimit", params, nItems, items);
-            return a;
-
+        switch (call.selector) {
+            case sel_addOwner_qb: {
+                // function addOwner(address _owner)
+                // 0x7065cb48
+                QAddOwner *a = new QAddOwner;
+                *(CTransaction*)a = *p;  // NOLINT
+                a->_owner = call.getAddress(0);
+                a->funcPtr = getAbiDecoder()->find(call.selector);
+                return a;
+            }
+
+            case sel_changeOwner_qb: {
+                // function changeOwner(address _from, address _to)
+                // 0xf00d4b5d
+                QChangeOwner *a = new QChangeOwner;
+                *(CTransaction*)a = *p;  // NOLINT
+                a->_from = call.getAddress(0);
+                a->_to = call.getAddress(1);
+                a->funcPtr = getAbiDecoder()->find(call.selector);
+                return a;
+            }
+
+            case sel_changeRequirement_qb: {
+                // function changeRequirement(uint256 _newRequired)
+                // 0xba51a6df
+                QChangeRequirement *a = new QChangeRequirement;
+                *(CTransaction*)a = *p;  // NOLINT
+                a->_newRequired = call.getUint(0);
+                a->funcPtr = getAbiDecoder()->find(call.selector);
+                return a;
+            }
+
+            case sel_confirm_qb: {
+                // function confirm(bytes32 _h)
+                // 0x797af627
+                QConfirm *a = new QConfirm;
+                *(CTransaction*)a = *p;  // NOLINT
+                a->_h = call.getWordHex(0);
+                a->funcPtr = getAbiDecoder()->find(call.selector);
+                return a;
+            }
+
+            case sel_execute_qb: {
+                // function execute(address _to, uint256 _value, bytes _data)
+                // 0xb61d27f6
+                QExecute *a = new QExecute;
+                *(CTransaction*)a = *p;  // NOLINT
+                a->_to = call.getAddress(0);
+                a->_value = call.getUint(1);
+                a->_data = call.getTailHex(2);
+                a->funcPtr = getAbiDecoder()->find(call.selector);
+                return a;
+            }
+
+            case sel_isOwner_qb: {
+                // function isOwner(address _addr)
+                // 0x2f54bf6e
+                QIsOwner *a = new QIsOwner;
+                *(CTransaction*)a = *p;  // NOLINT
+                a->_addr = call.getAddress(0);
+                a->funcPtr = getAbiDecoder()->find(call.selector);
+                return a;
+            }
+
+            case sel_kill_qb: {
+                // function kill(address _to)
+                // 0xcbf0b0c0
+                QKill *a = new QKill;
+                *(CTransaction*)a = *p;  // NOLINT
+                a->_to = call.getAddress(0);
+                a->funcPtr = getAbiDecoder()->find(call.selector);
+                return a;
+            }
+
+            case sel_removeOwner_qb: {
+                // function removeOwner(address _owner)
+                // 0x173825d9
+                QRemoveOwner *a = new QRemoveOwner;
+                *(CTransaction*)a = *p;  // NOLINT
+                a->_owner = call.getAddress(0);
+                a->funcPtr = getAbiDecoder()->find(call.selector);
+                return a;
+            }
+
+            case sel_resetSpentToday_qb: {
+                // function resetSpentToday()
+                // 0x5c52c2f5
+                QResetSpentToday *a = new QResetSpentToday;
+                *(CTransaction*)a = *p;  // NOLINT
+                a->funcPtr = getAbiDecoder()->find(call.selector);
+                return a;
+            }
+
+            case sel_revoke_qb: {
+                // function revoke(bytes32 _operation)
+                // 0xb75c7dc6
+                QRevoke *a = new QRevoke;
+                *(CTransaction*)a = *p;  // NOLINT
+                a->_operation = call.getWordHex(0);
+                a->funcPtr = getAbiDecoder()->find(call.selector);
+                return a;
+            }
+
+            case sel_setDailyLimit_qb: {
+                // function setDailyLimit(uint256 _newLimit)
+                // 0xb20d30a9
+                QSetDailyLimit *a = new QSetDailyLimit;
+                *(CTransaction*)a = *p;  // NOLINT
+                a->_newLimit = call.getUint(0);
+                a->funcPtr = getAbiDecoder()->find(call.selector);
+                return a;
+            }
+
+            default:
+                break;
         }
         // falls through
     }
@@ -209,105 +222,139 @@ const CLogEntry *promoteToWalletEvent(const CLogEntry *p) {
 
     size_t nTops = p->topics.size();
     if (nTops > 0) {  // the '0'th topic is the event signature
-        string_q data = extract(p->data, 2);
+        CAbiData data;
+        data.fromData(p->data);
         // EXISTING_CODE
         // EXISTING_CODE
 
-        if (fromTopic(p->topics[0]) % evt_Confirmation_qb) {
-            // event Confirmation(address owner, bytes32 operation)
-            // 0xe1c52dc63b719ade82e8bea94cc41a0d5d28e4aaf536adb5e9cccc9ff8c1aeda
-            QConfirmationEvent *a = new QConfirmationEvent;
-            *(CLogEntry*)a = *p;  // NOLINT
-            a->owner = toAddress(extract(data, 0*64, 64));
-            a->operation = "0x" + extract(data, 1*64, 64);
-            return a;
-
-        } else if (fromTopic(p->topics[0]) % evt_ConfirmationNeeded_qb) {
-            // event ConfirmationNeeded(bytes32 operation, address initiator, uint256 value, address to, bytes data)
-            // 0x1733cbb53659d713b79580f79f3f9ff215f78a7c7aa45890f3b89fc5cddfbf32
-            QConfirmationNeededEvent *a = new QConfirmationNeededEvent;
-            *(CLogEntry*)a = *p;  // NOLINT
-            a->operation = "0x" + extract(data, 0*64, 64);
-            a->initiator = toAddress(extract(data, 1*64, 64));
-            a->value = toWei("0x" + extract(data, 2*64, 64));
-            a->to = toAddress(extract(data, 3*64, 64));
-            a->data = "0x" + extract(data, 4*64);
-            return a;
-
-        } else if (fromTopic(p->topics[0]) % evt_Deposit_qb) {
-            // event Deposit(address from, uint256 value)
-            // 0xe1fffcc4923d04b559f4d29a8bfc6cda04eb5b0d3c460751c2402c5c5cc9109c
-            QDepositEvent *a = new QDepositEvent;
-            *(CLogEntry*)a = *p;  // NOLINT
-            a->from = toAddress(extract(data, 0*64, 64));
-            a->value = toWei("0x" + extract(data, 1*64, 64));
-            return a;
-
-        } else if (fromTopic(p->topics[0]) % evt_MultiTransact_qb) {
-            // event MultiTransact(address owner, bytes32 operation, uint256 value, address to, bytes data)
-            // 0xe7c957c06e9a662c1a6c77366179f5b702b97651dc28eee7d5bf1dff6e40bb4a
-            QMultiTransactEvent *a = new QMultiTransactEvent;
-            *(CLogEntry*)a = *p;  // NOLINT
-            a->owner = toAddress(extract(data, 0*64, 64));
-            a->operation = "0x" + extract(data, 1*64, 64);
-            a->value = toWei("0x" + extract(data, 2*64, 64));
-            a->to = toAddress(extract(data, 3*64, 64));
-            a->data = "0x" + extract(data, 4*64);
-            return a;
-
-        } else if (fromTopic(p->topics[0]) % evt_OwnerAdded_qb) {
-            // event OwnerAdded(address newOwner)
-            // 0x994a936646fe87ffe4f1e469d3d6aa417d6b855598397f323de5b449f765f0c3
-            QOwnerAddedEvent *a = new QOwnerAddedEvent;
-            *(CLogEntry*)a = *p;  // NOLINT
-            a->newOwner = toAddress(extract(data, 0*64, 64));
-            return a;
-
-        } else if (fromTopic(p->topics[0]) % evt_OwnerChanged_qb) {
-            // event OwnerChanged(address oldOwner, address newOwner)
-            // 0xb532073b38c83145e3e5135377a08bf9aab55bc0fd7c1179cd4fb995d2a5159c
-            QOwnerChangedEvent *a = new QOwnerChangedEvent;
-            *(CLogEntry*)a = *p;  // NOLINT
-            a->oldOwner = toAddress(extract(data, 0*64, 64));
-            a->newOwner = toAddress(extract(data, 1*64, 64));
-            return a;
-
-        } else if (fromTopic(p->topics[0]) % evt_OwnerRemoved_qb) {
-            // event OwnerRemoved(address oldOwner)
-            // 0x58619076adf5bb0943d100ef88d52d7c3fd691b19d3a9071b555b651fbf418da
-            QOwnerRemovedEvent *a = new QOwnerRemovedEvent;
-            *(CLogEntry*)a = *p;  // NOLINT
-            a->oldOwner = toAddress(extract(data, 0*64, 64));
-            return a;
-
-        } else if (fromTopic(p->topics[0]) % evt_RequirementChanged_qb) {
-            // event RequirementChanged(uint256 newRequirement)
-            // 0xacbdb084c721332ac59f9b8e392196c9eb0e4932862da8eb9beaf0dad4f550da
-            QRequirementChangedEvent *a = new QRequirementChangedEvent;
-            *(CLogEntry*)a = *p;  // NOLINT
-            a->newRequirement = toWei("0x" + extract(data, 0*64, 64));
-            return a;
-
-        } else if (fromTopic(p->topics[0]) % evt_Revoke_qb) {
-            // event Revoke(address owner, bytes32 operation)
-            // 0xc7fb647e59b18047309aa15aad418e5d7ca96d173ad704f1031a2c3d7591734b
-            QRevokeEvent *a = new QRevokeEvent;
-            *(CLogEntry*)a = *p;  // NOLINT
-            a->owner = toAddress(extract(data, 0*64, 64));
-            a->operation = "0x" + extract(data, 1*64, 64);
-            return a;
-
-        } else if (fromTopic(p->topics[0]) % evt_SingleTransact_qb) {
-            // event SingleTransact(address owner, uint256 value, address to, bytes data)
-            // 0x92ca3a80853e6663fa31fa10b99225f18d4902939b4c53a9caae9043f6efd004
-            QSingleTransactEvent *a = new QSingleTransactEvent;
-            *(CLogEntry*)a = *p;  // NOLINT
-            a->owner = toAddress(extract(data, 0*64, 64));
-            a->value = toWei("0x" + extract(data, 1*64, 64));
-            a->to = toAddress(extract(data, 2*64, 64));
-            a->data = "0x" + extract(data, 3*64);
-            return a;
-
+        switch (topicSelector(p->topics[0])) {
+            case sel_evt_Confirmation_qb:
+                if (isTopic(p->topics[0], topic_evt_Confirmation_qb)) {
+                    // event Confirmation(address owner, bytes32 operation)
+                    // 0xe1c52dc63b719ade82e8bea94cc41a0d5d28e4aaf536adb5e9cccc9ff8c1aeda
+                    QConfirmationEvent *a = new QConfirmationEvent;
+                    *(CLogEntry*)a = *p;  // NOLINT
+                    a->owner = data.getAddress(0);
+                    a->operation = "0x" + data.getWordHex(1);
+                    return a;
+                }
+                break;
+
+            case sel_evt_ConfirmationNeeded_qb:
+                if (isTopic(p->topics[0], topic_evt_ConfirmationNeeded_qb)) {
+                    // event ConfirmationNeeded(bytes32 operation, address initiator, uint256 value, address to, bytes data)
+                    // 0x1733cbb53659d713b79580f79f3f9ff215f78a7c7aa45890f3b89fc5cddfbf32
+                    QConfirmationNeededEvent *a = new QConfirmationNeededEvent;
+                    *(CLogEntry*)a = *p;  // NOLINT
+                    a->operation = "0x" + data.getWordHex(0);
+                    a->initiator = data.getAddress(1);
+                    a->value = data.getUint(2);
+                    a->to = data.getAddress(3);
+                    a->data = "0x" + data.getTailHex(4);
+                    return a;
+                }
+                break;
+
+            case sel_evt_Deposit_qb:
+                if (isTopic(p->topics[0], topic_evt_Deposit_qb)) {
+                    // event Deposit(address from, uint256 value)
+                    // 0xe1fffcc4923d04b559f4d29a8bfc6cda04eb5b0d3c460751c2402c5c5cc9109c
+                    QDepositEvent *a = new QDepositEvent;
+                    *(CLogEntry*)a = *p;  // NOLINT
+                    a->from = data.getAddress(0);
+                    a->value = data.getUint(1);
+                    return a;
+                }
+                break;
+
+            case sel_evt_MultiTransact_qb:
+                if (isTopic(p->topics[0], topic_evt_MultiTransact_qb)) {
+                    // event MultiTransact(address owner, bytes32 operation, uint256 value, address to, bytes data)
+                    // 0xe7c957c06e9a662c1a6c77366179f5b702b97651dc28eee7d5bf1dff6e40bb4a
+                    QMultiTransactEvent *a = new QMultiTransactEvent;
+                    *(CLogEntry*)a = *p;  // NOLINT
+                    a->owner = data.getAddress(0);
+                    a->operation = "0x" + data.getWordHex(1);
+                    a->value = data.getUint(2);
+                    a->to = data.getAddress(3);
+                    a->data = "0x" + data.getTailHex(4);
+                    return a;
+                }
+                break;
+
+            case sel_evt_OwnerAdded_qb:
+                if (isTopic(p->topics[0], topic_evt_OwnerAdded_qb)) {
+                    // event OwnerAdded(address newOwner)
+                    // 0x994a936646fe87ffe4f1e469d3d6aa417d6b855598397f323de5b449f765f0c3
+                    QOwnerAddedEvent *a = new QOwnerAddedEvent;
+                    *(CLogEntry*)a = *p;  // NOLINT
+                    a->newOwner = data.getAddress(0);
+                    return a;
+                }
+                break;
+
+            case sel_evt_OwnerChanged_qb:
+                if (isTopic(p->topics[0], topic_evt_OwnerChanged_qb)) {
+                    // event OwnerChanged(address oldOwner, address newOwner)
+                    // 0xb532073b38c83145e3e5135377a08bf9aab55bc0fd7c1179cd4fb995d2a5159c
+                    QOwnerChangedEvent *a = new QOwnerChangedEvent;
+                    *(CLogEntry*)a = *p;  // NOLINT
+                    a->oldOwner = data.getAddress(0);
+                    a->newOwner = data.getAddress(1);
+                    return a;
+                }
+                break;
+
+            case sel_evt_OwnerRemoved_qb:
+                if (isTopic(p->topics[0], topic_evt_OwnerRemoved_qb)) {
+                    // event OwnerRemoved(address oldOwner)
+                    // 0x58619076adf5bb0943d100ef88d52d7c3fd691b19d3a9071b555b651fbf418da
+                    QOwnerRemovedEvent *a = new QOwnerRemovedEvent;
+                    *(CLogEntry*)a = *p;  // NOLINT
+                    a->oldOwner = data.getAddress(0);
+                    return a;
+                }
+                break;
+
+            case sel_evt_RequirementChanged_qb:
+                if (isTopic(p->topics[0], topic_evt_RequirementChanged_qb)) {
+                    // event RequirementChanged(uint256 newRequirement)
+                    // 0xacbdb084c721332ac59f9b8e392196c9eb0e4932862da8eb9beaf0dad4f550da
+                    QRequirementChangedEvent *a = new QRequirementChangedEvent;
+                    *(CLogEntry*)a = *p;  // NOLINT
+                    a->newRequirement = data.getUint(0);
+                    return a;
+                }
+                break;
+
+            case sel_evt_Revoke_qb:
+                if (isTopic(p->topics[0], topic_evt_Revoke_qb)) {
+                    // event Revoke(address owner, bytes32 operation)
+                    // 0xc7fb647e59b18047309aa15aad418e5d7ca96d173ad704f1031a2c3d7591734b
+                    QRevokeEvent *a = new QRevokeEvent;
+                    *(CLogEntry*)a = *p;  // NOLINT
+                    a->owner = data.getAddress(0);
+                    a->operation = "0x" + data.getWordHex(1);
+                    return a;
+                }
+                break;
+
+            case sel_evt_SingleTransact_qb:
+                if (isTopic(p->topics[0], topic_evt_SingleTransact_qb)) {
+                    // event SingleTransact(address owner, uint256 value, address to, bytes data)
+                    // 0x92ca3a80853e6663fa31fa10b99225f18d4902939b4c53a9caae9043f6efd004
+                    QSingleTransactEvent *a = new QSingleTransactEvent;
+                    *(CLogEntry*)a = *p;  // NOLINT
+                    a->owner = data.getAddress(0);
+                    a->value = data.getUint(1);
+                    a->to = data.getAddress(2);
+                    a->data = "0x" + data.getTailHex(3);
+                    return a;
+                }
+                break;
+
+            default:
+                break;
         }
         // fall through
     }
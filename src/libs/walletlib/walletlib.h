@@ -70,5 +70,44 @@ extern const string_q evt_RequirementChanged_qb;
 extern const string_q evt_Revoke_qb;
 extern const string_q evt_SingleTransact_qb;
 
+//------------------------------------------------------------------------
+const uint32_t sel_addOwner_qb = 0x7065cb48;
+const uint32_t sel_changeOwner_qb = 0xf00d4b5d;
+const uint32_t sel_changeRequirement_qb = 0xba51a6df;
+const uint32_t sel_confirm_qb = 0x797af627;
+const uint32_t sel_execute_qb = 0xb61d27f6;
+const uint32_t sel_hasConfirmed_qb = 0xc2cf7326;
+const uint32_t sel_isOwner_qb = 0x2f54bf6e;
+const uint32_t sel_kill_qb = 0xcbf0b0c0;
+const uint32_t sel_mdailyLimit_qb = 0x893ec080;
+const uint32_t sel_mnumOwners_qb = 0x4c68cda4;
+const uint32_t sel_mrequired_qb = 0x6f88eef4;
+const uint32_t sel_removeOwner_qb = 0x173825d9;
+const uint32_t sel_resetSpentToday_qb = 0x5c52c2f5;
+const uint32_t sel_revoke_qb = 0xb75c7dc6;
+const uint32_t sel_setDailyLimit_qb = 0xb20d30a9;
+
+//------------------------------------------------------------------------
+const uint32_t sel_evt_Confirmation_qb = 0xe1c52dc6;
+const uint64_t topic_evt_Confirmation_qb[4] = { 0xe1c52dc63b719adeULL, 0x82e8bea94cc41a0dULL, 0x5d28e4aaf536adb5ULL, 0xe9cccc9ff8c1aedaULL };
+const uint32_t sel_evt_ConfirmationNeeded_qb = 0x1733cbb5;
+const uint64_t topic_evt_ConfirmationNeeded_qb[4] = { 0x1733cbb53659d713ULL, 0xb79580f79f3f9ff2ULL, 0x15f78a7c7aa45890ULL, 0xf3b89fc5cddfbf32ULL };
+const uint32_t sel_evt_Deposit_qb = 0xe1fffcc4;
+const uint64_t topic_evt_Deposit_qb[4] = { 0xe1fffcc4923d04b5ULL, 0x59f4d29a8bfc6cdaULL, 0x04eb5b0d3c460751ULL, 0xc2402c5c5cc9109cULL };
+const uint32_t sel_evt_MultiTransact_qb = 0xe7c957c0;
+const uint64_t topic_evt_MultiTransact_qb[4] = { 0xe7c957c06e9a662cULL, 0x1a6c77366179f5b7ULL, 0x02b97651dc28eee7ULL, 0xd5bf1dff6e40bb4aULL };
+const uint32_t sel_evt_OwnerAdded_qb = 0x994a9366;
+const uint64_t topic_evt_OwnerAdded_qb[4] = { 0x994a936646fe87ffULL, 0xe4f1e469d3d6aa41ULL, 0x7d6b855598397f32ULL, 0x3de5b449f765f0c3ULL };
+const uint32_t sel_evt_OwnerChanged_qb = 0xb532073b;
+const uint64_t topic_evt_OwnerChanged_qb[4] = { 0xb532073b38c83145ULL, 0xe3e5135377a08bf9ULL, 0xaab55bc0fd7c1179ULL, 0xcd4fb995d2a5159cULL };
+const uint32_t sel_evt_OwnerRemoved_qb = 0x58619076;
+const uint64_t topic_evt_OwnerRemoved_qb[4] = { 0x58619076adf5bb09ULL, 0x43d100ef88d52d7cULL, 0x3fd691b19d3a9071ULL, 0xb555b651fbf418daULL };
+const uint32_t sel_evt_RequirementChanged_qb = 0xacbdb084;
+const uint64_t topic_evt_RequirementChanged_qb[4] = { 0xacbdb084c721332aULL, 0xc59f9b8e392196c9ULL, 0xeb0e4932862da8ebULL, 0x9beaf0dad4f550daULL };
+const uint32_t sel_evt_Revoke_qb = 0xc7fb647e;
+const uint64_t topic_evt_Revoke_qb[4] = { 0xc7fb647e59b18047ULL, 0x309aa15aad418e5dULL, 0x7ca96d173ad704f1ULL, 0x031a2c3d7591734bULL };
+const uint32_t sel_evt_SingleTransact_qb = 0x92ca3a80;
+const uint64_t topic_evt_SingleTransact_qb[4] = { 0x92ca3a80853e6663ULL, 0xfa31fa10b99225f1ULL, 0x8d4902939b4c53a9ULL, 0xcaae9043f6efd004ULL };
+
 // EXISTING_CODE
 // EXISTING_CODE
@@ -16,7 +16,10 @@ extern const char* STR_NAME_DATA;
 //-----------------------------------------------------------------------
 int main(int argc, const char *argv[]) {
 
+    forwardToServer(argc, argv);
     etherlib_init();
+    if (!serveRequests(argc, argv))
+        return 0;
 
     COptions options;
     if (!options.prepareArguments(argc, argv))
@@ -15,7 +15,10 @@
 //-----------------------------------------------------------------------
 int main(int argc, const char *argv[]) {
 
+    forwardToServer(argc, argv);
     etherlib_init();
+    if (!serveRequests(argc, argv))
+        return 0;
 
     COptions options;
     if (!options.prepareArguments(argc, argv))
@@ -17,7 +17,10 @@ bool visitBlock(uint64_t num, void *data);
 //--------------------------------------------------------------
 int main(int argc, const char *argv[]) {
 
+    forwardToServer(argc, argv);
     etherlib_init(quickQuitHander);
+    if (!serveRequests(argc, argv))
+        return 0;
 
     // Parse command line, allowing for command files
     COptions options;
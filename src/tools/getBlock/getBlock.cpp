@@ -16,7 +16,10 @@
 //------------------------------------------------------------
 int main(int argc, const char * argv[]) {
 
+    forwardToServer(argc, argv);
     etherlib_init();
+    if (!serveRequests(argc, argv))
+        return 0;
 
     // Parse command line, allowing for command files
     COptions options;
@@ -28,6 +31,26 @@ int main(int argc, const char * argv[]) {
         if (!options.parseArguments(command))
             return 0;
 
+        if (options.compress) {
+            uint64_t rawBytes = 0, packedBytes = 0;
+            string_q list = options.getBlockNumList();
+            while (!list.empty() && !shouldQuit()) {
+                blknum_t bn = toLongU(nextTokenClear(list, '|'));
+                uint64_t r = 0, p = 0;
+                if (!compressCachedBlocks(bn, bn, r, p)) {
+                    cerr << "Could not compress block " << bn << ".\n";
+                    break;
+                }
+                rawBytes += r;
+                packedBytes += p;
+            }
+            cout << "Compressed " << rawBytes << " bytes to " << packedBytes << " bytes";
+            if (packedBytes)
+                cout << " (" << double2Str(double(rawBytes) / packedBytes, 2) << " to 1)";
+            cout << ".\n";
+            continue;
+        }
+
         // There can be more than one thing to do...
         if (!options.quiet && !options.showAddrs && !options.uniqAddrs)
             cout << (options.isMulti() ? "[" : "");
@@ -101,13 +124,15 @@ string_q doOneBlock(uint64_t num, const COptions& opt) {
         string_q fileName = getBinaryFilename(gold.blockNumber);
         if (opt.isCache) {
 
-            // --source::cache mode doesn't include timestamp in transactions
-            readBlockFromBinary(gold, fileName);
+            // --source::cache mode doesn't include timestamp in transactions. Only the fields
+            // the format shows are read, unless the block is going to be written back.
+            readBlockFromBinary(gold, fileName, (opt.format.empty() || opt.force ? NULL : &opt.projection));
             for (size_t t = 0 ; t < gold.transactions.size() ; t++)
                 gold.transactions.at(t).timestamp = gold.timestamp;  // .at cannot go past end of vector!
 
         } else {
-            queryBlock(gold, numStr, true, false);
+            // Receipts and traces are skipped if nothing the format shows needs them
+            queryBlock(gold, numStr, true, false, (opt.format.empty() || opt.force ? NULL : &opt.projection));
         }
 
         if (opt.force) {  // turn this on to force a write of the block to the disc
@@ -26,6 +26,7 @@ CParams params[] = {
 //            "self-destruct | create | log-topic | log-data | input-data |\n\t\t\t\t"
 //            "trace-to | trace-from | trace-data | trace-call ]"),
     CParams("@f(o)rce",          "force a re-write of the block to the cache"),
+    CParams("@compress",         "rewrite the listed blocks in the cache compressed, training era dictionaries as needed"),
     CParams("@quiet",            "do not print results to screen, used for speed testing and data checking"),
     CParams("@source:[c|r]",     "either :c(a)che or :(r)aw, source for data retrival. (shortcuts "
                                     "-c = qblocks, -r = node)"),
@@ -76,6 +77,9 @@ bool COptions::parseArguments(string_q& command) {
         } else if (arg == "--normalize") {
             normalize = true;
 
+        } else if (arg == "--compress") {
+            compress = true;
+
         } else if (arg == "-l" || arg == "--latest") {
             uint64_t lastUpdate = toUnsigned(asciiFileToString("/tmp/getBlock_junk.txt"));
             uint64_t cache = NOPOS, client = NOPOS;
@@ -230,6 +234,12 @@ bool COptions::parseArguments(string_q& command) {
         return usage("You must specify at least one block.");
 
     format = getGlobalConfig()->getDisplayStr(false, "");
+    projection.clear();
+    if (!format.empty()) {
+        projection.addFormat(GETRUNTIME_CLASS(CBlock), format);
+        // the block's timestamp is copied into its transactions whether the format shows it or not
+        projection.addField(GETRUNTIME_CLASS(CBlock), "timestamp");
+    }
     if (contains(format, "{PRICE:CLOSE}")) {
 //        priceBlocks = true;
     }
@@ -252,9 +262,11 @@ void COptions::Init(void) {
     traces      = false;
     force       = false;
     normalize   = false;
+    compress    = false;
     silent      = false;
     quiet       = 0;  // quiet has levels
     format      = "";
+    projection.clear();
     priceBlocks = false;
     blocks.Init();
 }
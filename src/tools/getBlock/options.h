@@ -25,9 +25,11 @@ public:
     bool traces;
     bool force;
     bool normalize;
+    bool compress;
     bool silent;
     int quiet;
     string_q format;
+    CFieldProjection projection;  // the fields the format shows
     bool priceBlocks;
 
     COptions(void);
@@ -82,12 +82,21 @@ bool CBloomBlock::setValueByName(const string_q& fieldName, const string_q& fiel
     if (fieldName == "logsBloom"   ) { logsBloom    = fieldValue; return true; }
     if (fieldName == "number"      ) { number       = toUnsigned(fieldValue); return true; }
     if (fieldName == "transactions") {
+        // receipts are only asked for if they are shown, and not at all if the block has no logs
+        if (GETRUNTIME_CLASS(CBloomBlock)->isFieldHidden("transactions"))
+            return true;
+        CRawBloom blockBloom;
+        bool noLogs = (hexToRaw(logsBloom, blockBloom) && !logsBloom.empty() && !bitsTwiddled(blockBloom));
         char *p = cleanUpJson((char*)fieldValue.c_str());  // NOLINT
         while (p && *p) {
             CBloomTrans item;
             size_t nFields = 0;
             p = item.parseJson(p, nFields);
-            if (nFields) {
+            if (nFields && noLogs) {
+                item.receipt.logsBloom = logsBloom;
+                transactions.push_back(item);
+
+            } else if (nFields) {
                 string_q result;
                 queryRawReceipt(result, item.hash);
                 CRPCResult generic;
@@ -18,7 +18,10 @@ extern string_q doOneBloom(uint64_t num, const COptions& opt);
 //------------------------------------------------------------
 int main(int argc, const char * argv[]) {
 
+    forwardToServer(argc, argv);
     etherlib_init(quickQuitHander);
+    if (!serveRequests(argc, argv))
+        return 0;
 
     // Parse command line, allowing for command files
     COptions options;
@@ -30,6 +33,23 @@ int main(int argc, const char * argv[]) {
         if (!options.parseArguments(command))
             return 0;
 
+        if (options.migrate) {
+            blknum_t first = 0, last = getLatestBlockFromCache();
+            if (options.blocks.start != options.blocks.stop) {
+                first = options.blocks.start;
+                last  = options.blocks.stop - 1;
+            }
+            if (!migrateBlooms(first, last, true))
+                cerr << "Could not migrate the blooms between blocks " << first << " and " << last << ".\n";
+            CBloomSummary summary;
+            summary.open(bloomSummaryFolder());
+            if (!summary.update(last))
+                cerr << "Could not update the bloom summaries.\n";
+            else if (!summary.tune())
+                cerr << "Could not save the bloom tuning.\n";
+            continue;
+        }
+
         cout << (options.isMulti() ? "[" : "");
         string_q list = options.getBlockNumList();
         while (!list.empty()) {
@@ -125,7 +145,7 @@ string_q doOneBloom(uint64_t num, const COptions& opt) {
     } else {
 
         SFBloomArray blooms;
-        readBloomArray(blooms, substitute(getBinaryFilename(num), "/blocks/", "/blooms/"));
+        readBlooms(num, blooms);
         ostringstream os;
         os << "\n" << string_q(90, '-') << " " << num << string_q(90, '-') << "\n";
         for (size_t i = 0 ; i < blooms.size(); i++) {
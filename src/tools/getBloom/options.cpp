@@ -21,6 +21,7 @@ CParams params[] = {
     CParams("-a(s)bars",         "display the bloom filter as bar charts instead of hex"),
     CParams("-recei(p)t",        "display blooms from the transaction receipts as opposed to block (--raw only)"),
     CParams("@force",            "force a re-write of the bloom to the cache"),
+    CParams("@migrate",          "fold the per-block bloom files into segment files, then update and retune the summaries (all blocks, or a range)"),
     CParams("",                  "Returns bloom filter(s) from running node (the default) or as EAB "
                                     "from local cache.\n"),
 };
@@ -42,6 +43,9 @@ bool COptions::parseArguments(string_q& command) {
             etherlib_init("binary");
             force = true;
 
+        } else if (arg == "-m" || arg == "--migrate") {
+            migrate = true;
+
         } else if (arg == "-r" || arg == "--raw") {
             isRaw = true;
 
@@ -77,6 +81,9 @@ bool COptions::parseArguments(string_q& command) {
         }
     }
 
+    if (migrate)
+        return true;
+
     if (!blocks.hasBlocks())
         return usage("You must specify at least one block number or block hash. Quitting...");
 
@@ -97,6 +104,7 @@ void COptions::Init(void) {
     asBars     = false;
     force      = false;
     receipt    = false;
+    migrate    = false;
     blocks.Init();
 }
 
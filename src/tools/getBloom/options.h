@@ -21,6 +21,7 @@ public:
     bool force;
     bool asBits;
     bool asBars;
+    bool migrate;
 
     COptions(void);
     ~COptions(void);
@@ -14,10 +14,15 @@
 #include "options.h"
 
 extern bool visitTransaction(CTransaction& trans, void *data);
+extern void queryLogIndex(const COptions& options);
+extern void queryNodeLogs(const COptions& options);
 //--------------------------------------------------------------
 int main(int argc, const char *argv[]) {
 
+    forwardToServer(argc, argv);
     etherlib_init();
+    if (!serveRequests(argc, argv))
+        return 0;
 
     // Parse command line, allowing for command files
     COptions options;
@@ -28,7 +33,12 @@ int main(int argc, const char *argv[]) {
         string_q command = nextTokenClear(options.commandList, '\n');
         if (!options.parseArguments(command))
             return 0;
-        forEveryTransactionInList(visitTransaction, &options, options.transList.queries);
+        if (options.isNodeQuery())
+            queryNodeLogs(options);
+        else if (options.isIndexQuery())
+            queryLogIndex(options);
+        else
+            forEveryTransactionInList(visitTransaction, &options, options.transList.queries);
     }
     return 0;
 }
@@ -73,3 +83,135 @@ bool visitTransaction(CTransaction& trans, void *data) {
 
     return true;
 }
+
+//--------------------------------------------------------------
+bool visitIndexBlock(CBlock& block, void *data) {
+    appendBlockLogs(block, logJournalPath());
+    return true;
+}
+
+//--------------------------------------------------------------
+bool sortByBlock(const CLogIndexRecord& a, const CLogIndexRecord& b) {
+    if (a.blockNum != b.blockNum)
+        return a.blockNum < b.blockNum;
+    if (a.txIndex != b.txIndex)
+        return a.txIndex < b.txIndex;
+    return a.logIndex < b.logIndex;
+}
+
+//--------------------------------------------------------------
+void queryLogIndex(const COptions& options) {
+
+    if (options.rebuild) {
+        ::remove(logIndexPath().c_str());
+        ::remove(logJournalPath().c_str());
+        forEveryNonEmptyBlockOnDisc(visitIndexBlock, NULL, 0, getLatestBlockFromCache() + 1);
+    }
+
+    CLogIndex index;
+    index.open(logIndexPath(), logJournalPath());
+    if (index.nJournaled())
+        index.compact();
+    if (options.rebuild) {
+        cerr << "Indexed " << index.size() << " logs through block " << index.lastBlock() << "\n";
+        if (options.address_list.empty() && !options.hasTopic && !options.blocks.hasBlocks())
+            return;
+    }
+
+    CLogQuery query;
+    query.topic = options.topic;
+    query.hasTopic = options.hasTopic;
+    if (options.blocks.start != options.blocks.stop) {
+        query.firstBlock = options.blocks.start;
+        query.lastBlock = options.blocks.stop - 1;
+    } else if (options.blocks.numList.size()) {
+        query.firstBlock = query.lastBlock = options.blocks.numList[0];
+    }
+
+    string_q addrs = options.address_list;
+    if (addrs.empty())
+        addrs = "|";
+    CLogIndexRecordArray hits;
+    while (!addrs.empty()) {
+        query.address = nextTokenClear(addrs, '|');
+        CLogIndexRecordArray these;
+        index.find(query, these);
+        hits.insert(hits.end(), these.begin(), these.end());
+    }
+    sort(hits.begin(), hits.end(), sortByBlock);
+
+    // each hit is read from the cached block, which is read once for all of its hits
+    CBlock block;
+    size_t nShown = 0;
+    cout << "[";
+    for (size_t i = 0 ; i < hits.size() ; i++) {
+        if (i == 0 || hits[i].blockNum != block.blockNumber) {
+            block = CBlock();
+            readBlockFromBinary(block, getBinaryFilename(hits[i].blockNum));
+        }
+        const CLogEntry *log = NULL;
+        if (hits[i].txIndex < block.transactions.size()) {
+            const CReceipt *receipt = &block.transactions[hits[i].txIndex].receipt;
+            for (size_t l = 0 ; l < receipt->logs.size() && !log ; l++)
+                if (receipt->logs[l].logIndex == hits[i].logIndex)
+                    log = &receipt->logs[l];
+        }
+        if (!log) {
+            cerr << cRed << "Warning:" << cOff << " log " << hits[i].blockNum << "." << hits[i].txIndex << "."
+                    << hits[i].logIndex << " is in the index but not in the cache.\n";
+            continue;
+        }
+        // the separator comes first, since any hit may turn out to be missing from the cache
+        if (nShown++)
+            cout << ",\n";
+        log->doExport(cout);
+    }
+    cout << (nShown ? "\n" : "") << "]\n";
+}
+
+//--------------------------------------------------------------
+bool visitNodeLog(CLogEntry& log, void *data) {
+    size_t *nSeen = (size_t*)data;  // NOLINT
+    if ((*nSeen)++)
+        cout << ",\n";
+    log.doExport(cout);
+    return true;
+}
+
+//--------------------------------------------------------------
+// The query the log index would answer, answered by the node instead
+void queryNodeLogs(const COptions& options) {
+
+    CLogFetcher fetcher;
+    string_q addrs = options.address_list;
+    while (!addrs.empty())
+        fetcher.addresses.push_back(nextTokenClear(addrs, '|'));
+    if (options.hasTopic)
+        fetcher.topic = fromTopic(options.topic);
+
+    blknum_t first = 0, last = getLatestBlockFromClient();
+    if (options.blocks.start != options.blocks.stop) {
+        first = options.blocks.start;
+        last = options.blocks.stop - 1;
+    } else if (options.blocks.numList.size()) {
+        first = last = options.blocks.numList[0];
+    }
+
+    size_t nSeen = 0;
+    cout << "[";
+    if (options.scanBlooms) {
+        CBloomLogReader reader;
+        reader.addresses = fetcher.addresses;
+        reader.topic = fetcher.topic;
+        reader.read(first, last, visitNodeLog, &nSeen);
+        cout << (nSeen ? "\n" : "") << "]\n";
+        if (verbose)
+            cerr << nSeen << " logs from " << reader.nBlocks << " blocks, " << reader.nReceipts
+                    << " receipts asked for, " << reader.nParsed << " parsed\n";
+        return;
+    }
+    fetcher.fetch(first, last, visitNodeLog, &nSeen);
+    cout << (nSeen ? "\n" : "") << "]\n";
+    if (verbose)
+        cerr << nSeen << " logs in " << fetcher.nRequests << " requests (" << fetcher.nSplits << " refused)\n";
+}
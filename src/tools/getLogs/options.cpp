@@ -16,8 +16,13 @@
 CParams params[] = {
     CParams("~!trans_list",    "a space-separated list of one or more transaction identifiers "
                                     "(tx_hash, bn.txID, blk_hash.txID)"),
-//    CParams("-address:<addr>", "retrieve raw transaction for a given Ethereum address"),
+    CParams("-address:<addr>", "list logs emitted by this address from the log index"),
+    CParams("-topic:<hash>",   "list logs whose first topic is this hash from the log index"),
+    CParams("-blocks:<range>", "limit log index queries to a block range (:start[-stop])"),
+    CParams("-node",           "with --address or --topic, ask the node for the logs (eth_getLogs) instead of the index"),
+    CParams("-scan",           "with --node, read only the receipts of blocks whose logsBloom may match instead of using eth_getLogs"),
     CParams("-raw",            "retrieve raw transaction directly from the running node"),
+    CParams("@index",          "rebuild the log index from every block in the cache"),
     CParams("",                "Retrieve a transaction's logs from the local cache or a running node."),
 };
 size_t nParams = sizeof(params) / sizeof(CParams);
@@ -29,6 +34,7 @@ bool COptions::parseArguments(string_q& command) {
         return false;
 
     Init();
+    string_q blockList;
     while (!command.empty()) {
         string_q arg = nextTokenClear(command, ' ');
         string_q orig = arg;
@@ -41,6 +47,25 @@ bool COptions::parseArguments(string_q& command) {
                 return usage(orig + " does not appear to be a valid Ethereum address. Quitting...");
             address_list += (arg + "|");
 
+        } else if (startsWith(arg, "-t:") || startsWith(arg, "--topic:")) {
+            arg = substitute(substitute(arg, "-t:", ""), "--topic:", "");
+            if (!isHash(arg))
+                return usage(orig + " does not appear to be a valid topic. Quitting...");
+            topic = toTopic(arg);
+            hasTopic = true;
+
+        } else if (startsWith(arg, "-b:") || startsWith(arg, "--blocks:")) {
+            blockList += (substitute(substitute(arg, "-b:", ""), "--blocks:", "") + " ");
+
+        } else if (arg == "-i" || arg == "--index") {
+            rebuild = true;
+
+        } else if (arg == "-n" || arg == "--node") {
+            fromNode = true;
+
+        } else if (arg == "-s" || arg == "--scan") {
+            scanBlooms = true;
+
         } else if (startsWith(arg, '-')) {  // do not collapse
 
             if (!builtInCmd(arg)) {
@@ -56,6 +81,19 @@ bool COptions::parseArguments(string_q& command) {
         }
     }
 
+    // parsed last because the node knows of blocks the cache does not
+    if (!blockList.empty()) {
+        blknum_t latest = (fromNode ? getLatestBlockFromClient() : getLatestBlockFromCache());
+        while (!blockList.empty()) {
+            string_q ret = blocks.parseBlockList(nextTokenClear(blockList, ' '), latest);
+            if (!ret.empty())
+                return usage(ret);
+        }
+    }
+
+    if (isIndexQuery())
+        return true;
+
     if (!transList.hasTrans())
         return usage("Please specify at least one transaction identifier.");
 
@@ -70,6 +108,12 @@ void COptions::Init(void) {
 
     transList.Init();
     address_list = "";
+    topic = 0;
+    hasTopic = false;
+    blocks.Init();
+    rebuild = false;
+    fromNode = false;
+    scanBlooms = false;
     isRaw = false;
 }
 
@@ -101,6 +145,12 @@ string_q COptions::postProcess(const string_q& which, const string_q& str) const
         ret += "This tool retrieves information from the local node or the ${FALLBACK} node, if configured "
                     "(see documentation).\n";
         ret += "If the queried node does not store historical state, the results may be undefined.\n";
+        ret += "[{address}], [{topic}] and [{blocks}] query the log index, which is built with [{index}], or as "
+                    "blocks are written\n  to the cache if [{indexLogs}] is set in quickBlocks.toml.\n";
+        ret += "With [{node}], the same query goes to the node in block ranges sized to the results, "
+                    "several at a time,\n  so blocks not in the cache are included.\n";
+        ret += "With [{scan}], each block's logsBloom is checked first and only receipts that may hold a match "
+                    "are asked for,\n  which suits nodes without [{eth_getLogs}] and contracts that rarely log.\n";
         return ret;
     }
     return str;
@@ -12,12 +12,19 @@
  * Public License along with this program. If not, see http://www.gnu.org/licenses/.
  *-------------------------------------------------------------------------------------------*/
 #include "etherlib.h"
+#include "logfetch.h"
 
 //-----------------------------------------------------------------------------
 class COptions : public COptionsBase {
 public:
     COptionsTransList transList;
     SFAddress address_list;
+    SFUintBN topic;
+    bool hasTopic;
+    COptionsBlockList blocks;
+    bool rebuild;
+    bool fromNode;
+    bool scanBlooms;
     bool isRaw;
 
     COptions(void);
@@ -26,4 +33,7 @@ public:
     string_q postProcess(const string_q& which, const string_q& str) const override;
     bool parseArguments(string_q& command) override;
     void Init(void) override;
+
+    bool isIndexQuery(void) const { return !address_list.empty() || hasTopic || blocks.hasBlocks() || rebuild; }
+    bool isNodeQuery(void) const { return fromNode && (!address_list.empty() || hasTopic); }
 };
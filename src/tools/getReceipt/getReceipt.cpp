@@ -17,7 +17,10 @@ extern bool visitTransaction(CTransaction& trans, void *data);
 //--------------------------------------------------------------
 int main(int argc, const char *argv[]) {
 
+    forwardToServer(argc, argv);
     etherlib_init();
+    if (!serveRequests(argc, argv))
+        return 0;
 
     // Parse command line, allowing for command files
     COptions options;
@@ -12,15 +12,26 @@
  *-------------------------------------------------------------------------------------------*/
 #define NOWALLETLIB
 #include "etherlib.h"
+#include "acctlib.h"
 #include "options.h"
 
 void reportByToken(COptions& options);
 void reportByAccount(COptions& options);
+void loadReplay(COptions& options);
 extern SFUintBN getTokenInfo(const string_q& value, const SFAddress& token, const SFAddress& holder, blknum_t blockNum);
+extern SFUintBN getTokenBalance(const COptions& options, const SFAddress& token, const SFAddress& holder,
+                                    blknum_t blockNum);
+
+//--------------------------------------------------------------
+CTokenBalances replayed;
+blknum_t replayedThrough = 0;
 //--------------------------------------------------------------
 int main(int argc, const char *argv[]) {
 
+    forwardToServer(argc, argv);
     etherlib_init(quickQuitHander);
+    if (!serveRequests(argc, argv))
+        return 0;
 
     // Parse command line, allowing for command files
     COptions options;
@@ -33,6 +44,8 @@ int main(int argc, const char *argv[]) {
         if (!options.parseArguments(command))
             return 0;
 
+        if (options.replay)
+            loadReplay(options);
         if (options.asData)
             cout << "block\ttoken\tholder\ttoken balance\n";
         if (options.byAccount)
@@ -75,7 +88,7 @@ void reportByToken(COptions& options) {
                 blknum_t blockNum = toLongU(nextTokenClear(blocks, '|'));
                 if (blockNum < options.earliestBlock)
                     options.earliestBlock = blockNum;
-                SFUintBN bal = getTokenInfo("balance", token, holder, blockNum);
+                SFUintBN bal = getTokenBalance(options, token, holder, blockNum);
                 totalVal += bal;
                 string_q sBal = to_string(bal).c_str();
                 if (expContext().asEther) {
@@ -155,7 +168,7 @@ void reportByAccount(COptions& options) {
                 blknum_t blockNum = toLongU(nextTokenClear(blocks, '|'));
                 if (blockNum < options.earliestBlock)
                     options.earliestBlock = blockNum;
-                SFUintBN bal = getTokenInfo("balance", token, holder, blockNum);
+                SFUintBN bal = getTokenBalance(options, token, holder, blockNum);
                 totalVal += bal;
                 string_q sBal = to_string(bal).c_str();
                 if (expContext().asEther) {
@@ -227,3 +240,56 @@ SFUintBN getTokenInfo(const string_q& value, const SFAddress& token, const SFAdd
     return toWei(callRPC("eth_call", cmd, false));
 }
 
+
+//-------------------------------------------------------------------------
+SFUintBN nodeBalance(const SFAddress& token, const SFAddress& holder, blknum_t blockNum) {
+    return getTokenInfo("balance", token, holder, blockNum);
+}
+
+//-------------------------------------------------------------------------
+// Rebuilds each token's balances from the Transfer events in the log index, then checks a sample
+// of holders against the node at the last requested block the cache covers.
+void loadReplay(COptions& options) {
+
+    CLogIndex index;
+    index.open(logIndexPath(), logJournalPath());
+    if (index.nJournaled())
+        index.compact();
+    replayedThrough = index.lastBlock();
+
+    blknum_t checkAt = 0;
+    string_q blocks = options.getBlockNumList();
+    while (!blocks.empty()) {
+        blknum_t bn = toLongU(nextTokenClear(blocks, '|'));
+        if (bn <= replayedThrough)
+            checkAt = max(checkAt, bn);
+    }
+
+    replayed.clear();
+    string_q tokens = options.tokens;
+    while (!tokens.empty()) {
+        SFAddress token = nextTokenClear(tokens, '|');
+        if (!replayed.loadToken(token, index, replayedThrough)) {
+            cerr << cYellow << "    Note: " << cOff << "no transfers of " << token << " could be replayed from the cache, "
+                    "asking the node.\n";
+            continue;
+        }
+        if (checkAt) {
+            SFAddressArray corrected;
+            size_t nChecked = replayed.validate(token, checkAt, options.nSamples, nodeBalance, corrected);
+            if (!isTestMode() || corrected.size()) {
+                cerr << "    Replayed " << replayed.nTransfers(token) << " transfers of " << token << " to ";
+                cerr << replayed.nHolders(token) << " holders, " << corrected.size() << " of " << nChecked;
+                cerr << " sampled balances corrected at block " << checkAt << "\n";
+            }
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+SFUintBN getTokenBalance(const COptions& options, const SFAddress& token, const SFAddress& holder, blknum_t blockNum) {
+    SFUintBN bal;
+    if (options.replay && blockNum <= replayedThrough && replayed.getBalance(token, holder, blockNum, bal))
+        return bal;
+    return getTokenInfo("balance", token, holder, blockNum);
+}
@@ -26,6 +26,9 @@ CParams params[] = {
     CParams("-noZero",       "suppress the display of zero balance accounts"),
     CParams("-total",        "if more than one balance is requested, display a total as well"),
     CParams("-info",         "retreive standarized information (name, decimals, totalSupply, etc.) about the token"),
+    CParams("-replay",       "rebuild balances from Transfer events in the local cache instead of asking the node "
+                                "for each balance"),
+    CParams("@sample:<n>",   "with --replay, check this many holders per token against the node (default 10)"),
     CParams("",              "Retrieve the token balance(s) for one or more addresses at the given (or "
                                 "latest) block(s).\n"),
 };
@@ -59,6 +62,15 @@ bool COptions::parseArguments(string_q& command) {
         } else if (arg == "-b" || arg == "--byAcct") {
             byAccount = true;
 
+        } else if (arg == "-r" || arg == "--replay") {
+            replay = true;
+
+        } else if (startsWith(arg, "-s:") || startsWith(arg, "--sample:")) {
+            arg = substitute(substitute(arg, "-s:", ""), "--sample:", "");
+            if (!isNumeral(arg))
+                return usage("Not a number: " + orig + ". Quitting...");
+            nSamples = toLongU(arg);
+
         } else if (startsWith(arg, "-l:") || startsWith(arg, "--list:")) {
 
             CFilename fileName(substitute(substitute(arg, "-l:", ""), "--list:", ""));
@@ -152,6 +164,8 @@ void COptions::Init(void) {
     byAccount = false;
     total = false;
     tokenInfo = false;
+    replay = false;
+    nSamples = 10;
     blocks.Init();
 }
 
@@ -188,6 +202,8 @@ string_q COptions::postProcess(const string_q& which, const string_q& str) const
         ret += "If the token contract(s) from which you request balances are not ERC20 compliant, the results "
                     "are undefined.\n";
         ret += "If the queried node does not store historical state, the results are undefined.\n";
+        ret += "With [{--replay}], balances come from the log index (see getLogs). Blocks past the end of the "
+                    "cache and tokens\n  with no indexed transfers are asked of the node.\n";
         ret += "[{special}] blocks are detailed under " + cTeal + "[{whenBlock --list}]" + cOff + ".\n";
         return ret;
     }
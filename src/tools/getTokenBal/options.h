@@ -25,6 +25,8 @@ public:
     bool noZero;
     bool total;
     bool tokenInfo;
+    bool replay;
+    uint64_t nSamples;
 
     COptions(void);
     ~COptions(void);
@@ -14,13 +14,17 @@
 #include "options.h"
 
 //---------------------------------------------------------------
-extern bool lookupDate(CBlock& block, const SFTime& date);
+extern bool lookupDate(CBlock& block, const SFTime& date, const CFieldProjection *projection);
+extern void loadCache(void);
 extern void unloadCache(void);
 
 //---------------------------------------------------------------
 int main(int argc, const char *argv[]) {
 
+    forwardToServer(argc, argv);
     etherlib_init();
+    if (!serveRequests(argc, argv, loadCache))
+        return 0;
 
     // Parse command line, allowing for command files
     COptions options;
@@ -51,9 +55,22 @@ int main(int argc, const char *argv[]) {
                 }
             }
 
+            string_q def = (options.alone ?
+                                    "[{BLOCKNUMBER}\\t][{DATE}]\\n" :
+                                    "block #[{BLOCKNUMBER}][ : {TIMESTAMP}][ : {DATE}]\\n");
+            string_q fmt = getGlobalConfig()->getDisplayStr(options.alone, def);
+            if (verbose && !special.empty()) {
+                string_q sp = "(" + special + ")";
+                replace(fmt, "{BLOCKNUMBER}", "{BLOCKNUMBER} " + sp);
+            }
+
+            // We only show block-level fields, so there is no need for the receipts
+            CFieldProjection projection;
+            projection.addFormat(GETRUNTIME_CLASS(CBlock), fmt);
+
             CBlock block;
             if (mode == "block") {
-                queryBlock(block, value, false, false);
+                queryBlock(block, value, false, false, &projection);
 
             } else if (mode == "date") {
                 if (!fileExists(miniBlockCache)) {
@@ -62,7 +79,7 @@ int main(int argc, const char *argv[]) {
 
                 } else {
                     SFTime date = dateFromTimeStamp((timestamp_t)toUnsigned(value));
-                    bool found = lookupDate(block, date);
+                    bool found = lookupDate(block, date, &projection);
                     if (!found) {
                         unloadCache();
                         return 0;
@@ -74,14 +91,6 @@ int main(int argc, const char *argv[]) {
             if (block.blockNumber == 0)
                 block.timestamp = 1438269960;
 
-            string_q def = (options.alone ?
-                                    "[{BLOCKNUMBER}\\t][{DATE}]\\n" :
-                                    "block #[{BLOCKNUMBER}][ : {TIMESTAMP}][ : {DATE}]\\n");
-            string_q fmt = getGlobalConfig()->getDisplayStr(options.alone, def);
-            if (verbose && !special.empty()) {
-                string_q sp = "(" + special + ")";
-                replace(fmt, "{BLOCKNUMBER}", "{BLOCKNUMBER} " + sp);
-            }
             cout << block.Format(fmt);
         }
     }
@@ -126,7 +135,8 @@ bool lookCloser(CBlock& block, void *data) {
 }
 
 //---------------------------------------------------------------
-bool lookupDate(CBlock& block, const SFTime& date) {
+// Reads the entire mini-block database into memory once
+static bool loadMiniBlocks(void) {
     if (!blocks) {
         nBlocks = fileSize(miniBlockCache) / sizeof(CMiniBlock);
         blocks = new CMiniBlock[nBlocks];
@@ -143,24 +153,40 @@ bool lookupDate(CBlock& block, const SFTime& date) {
 
         // Read the entire mini-block database into memory in one chunk
         size_t nRead = fread(blocks, sizeof(CMiniBlock), nBlocks, fpBlocks);
+        fclose(fpBlocks);
         if (nRead != nBlocks)
             return usage("Error encountered reading mini-blocks database.\n Quitting...");
         if (verbose)
             cerr << "Read " << nRead << " miniBlocks into memory.\n";
     }
 
+    return true;
+}
+
+//---------------------------------------------------------------
+// Warms a resident server (see toolserver.h)
+void loadCache(void) {
+    if (fileExists(miniBlockCache))
+        loadMiniBlocks();
+}
+
+//---------------------------------------------------------------
+bool lookupDate(CBlock& block, const SFTime& date, const CFieldProjection *projection) {
+    if (!loadMiniBlocks())
+        return false;
+
     CMiniBlock mini;
     mini.timestamp = toTimestamp(date);
     CMiniBlock *found = reinterpret_cast<CMiniBlock*>(bsearch(&mini, blocks, nBlocks, sizeof(CMiniBlock), findFunc));
     if (found) {
-        queryBlock(block, asStringU(found->blockNumber), false, false);
+        queryBlock(block, asStringU(found->blockNumber), false, false, projection);
         return true;
     }
 
     //  cout << mini.timestamp << " is somewhere between " << below << " and " << above << "\n";
     CBlockFinder finder(mini.timestamp);
     forEveryBlockOnDisc(lookCloser, &finder, below, above-below);
-    queryBlock(block, asStringU(finder.found), false, false);
+    queryBlock(block, asStringU(finder.found), false, false, projection);
     return true;
 }
 
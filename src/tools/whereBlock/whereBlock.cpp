@@ -16,7 +16,10 @@
 //--------------------------------------------------------------
 int main(int argc, const char *argv[]) {
 
+    forwardToServer(argc, argv);
     etherlib_init();
+    if (!serveRequests(argc, argv))
+        return 0;
 
     // Parse command line, allowing for command files
     COptions options;
@@ -35,6 +38,11 @@ int main(int argc, const char *argv[]) {
         cout << cYellow << "\nReport on " << options.mode << " locations:" << cOff;
         cout << (verbose ? "" : "\n  (cache folder: " + cachePath + ")") << "\n";
 
+        // the same for every block
+        string_q vers = (isTestMode() ? "--" : getVersionFromClient());
+        string_q fallback = getEnvStr("FALLBACK");
+        bool running_node = isNodeRunning();
+
         string_q list = options.getBlockNumList();
         while (!list.empty()) {
             blknum_t bn = toLongU(nextTokenClear(list, '|'));
@@ -44,13 +52,8 @@ int main(int argc, const char *argv[]) {
             string_q path = (verbose ? fileName.getFullPath() :
                                 fileName.relativePath(substitute(blockCachePath(""),
                                                         "/blocks/", "/"+options.mode + "s/")));
-            string_q vers = getVersionFromClient();
             if (isTestMode() && verbose)
                 path = "--";
-            if (isTestMode())
-                vers = "--";
-            string_q fallback = getEnvStr("FALLBACK");
-            bool running_node = isNodeRunning();
 
             cout << "\t" << options.mode << " " << cTeal << padLeft(asStringU(bn), 9) << cOff << " ";
             if (exists)            cout << "found at cache:  " << cTeal << path << cOff << "\n";